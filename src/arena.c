@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "arena.h"
+
+/**
+ * Initializes an empty arena, the first block is allocated by the first allocation.
+ *
+ * @param[out] a the arena
+**/
+void arena_init(arena *a)
+{
+  a->first = a->current = NULL;
+  a->used = 0;
+  a->kept = 0;
+}
+
+/**
+ * Allocates a new block after the current one, the blocks following it stay in the list.
+ *
+ * @return the block, NULL if the memory cannot be allocated
+**/
+static arena_block *arena_grow(arena *a, size_t size)
+{
+  if (size < ARENA_BLOCK)
+    size = ARENA_BLOCK;
+  arena_block *block = malloc(sizeof(arena_block) + size);
+  if (block == NULL)
+  {
+    printf("Array not allocated \n");
+    return NULL;
+  }
+  block->size = size;
+  a->kept += size;
+
+  if (a->current == NULL)
+  {
+    block->next = a->first;
+    a->first = block;
+  }
+  else
+  {
+    block->next = a->current->next;
+    a->current->next = block;
+  }
+  return block;
+}
+
+/**
+ * Allocates memory in an arena. The memory is not initialized and is released by arena_reset().
+ *
+ * @param[in] a the arena
+ * @param[in] size the number of bytes
+ * @return the memory, aligned on ARENA_ALIGN, NULL if it cannot be allocated
+**/
+void *arena_alloc(arena *a, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+  if (a->current == NULL || a->used + size > a->current->size)
+  {
+    // The blocks kept from the previous tests are used again before allocating a new one
+    arena_block *next = a->current ? a->current->next : a->first;
+    if (next == NULL || size > next->size)
+      next = arena_grow(a, size);
+    if (next == NULL)
+      return NULL;
+    a->current = next;
+    a->used = 0;
+  }
+
+  void *p = a->current->data + a->used;
+  a->used += size;
+  return p;
+}
+
+/**
+ * Formats a string in an arena.
+ *
+ * @param[in] a the arena
+ * @param[out] len the length of the string, may be NULL
+ * @param[in] format the format, as printf()
+ * @return the string, NULL if it cannot be allocated
+**/
+char *arena_printf(arena *a, size_t *len, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (n < 0)
+    return NULL;
+
+  char *s = arena_alloc(a, n + 1);
+  if (s == NULL)
+    return NULL;
+  va_start(args, format);
+  vsnprintf(s, n + 1, format, args);
+  va_end(args);
+
+  if (len)
+    *len = n;
+  return s;
+}
+
+/**
+ * Releases everything allocated in an arena. The blocks are kept for the next test, so
+ * the reset only rewinds the arena, unless the test needed more than ARENA_KEEP bytes:
+ * then the blocks bigger than ARENA_BLOCK are freed.
+ *
+ * @param[in] a the arena
+**/
+void arena_reset(arena *a)
+{
+  a->current = NULL;
+  a->used = 0;
+  if (a->kept <= ARENA_KEEP)
+    return;
+
+  arena_block **link = &a->first;
+  while (*link)
+  {
+    arena_block *block = *link;
+    if (block->size > ARENA_BLOCK)
+    {
+      *link = block->next;
+      a->kept -= block->size;
+      free(block);
+    }
+    else
+      link = &block->next;
+  }
+}
+
+/**
+ * Frees the blocks of an arena.
+ *
+ * @param[in] a the arena
+**/
+void arena_free(arena *a)
+{
+  arena_block *block = a->first;
+  while (block)
+  {
+    arena_block *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena_init(a);
+}
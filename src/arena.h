@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK (256 * 1024)    // size of the blocks of an arena
+#define ARENA_ALIGN 16              // alignment of the allocations
+#define ARENA_KEEP (4 * 1024 * 1024) // blocks are kept across resets up to this total size
+
+// A block of memory, the allocations are carved out of it one after the other
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size;                    // number of usable bytes in data
+    char data[];
+} arena_block;
+
+// Memory of a test: everything allocated in it is released at once by arena_reset()
+typedef struct
+{
+    arena_block *first;     // the blocks, kept for the next test
+    arena_block *current;   // block the allocations are carved out of
+    size_t used;            // bytes used in the current block
+    size_t kept;            // total size of the blocks
+} arena;
+
+void arena_init(arena *a);
+void *arena_alloc(arena *a, size_t size);
+char *arena_printf(arena *a, size_t *len, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void arena_reset(arena *a);
+void arena_free(arena *a);
+
+#endif
@@ -0,0 +1,377 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "fuzzer.h"
+#include "tar.h"
+#include "checksum.h"
+#include "sched.h"
+
+#define BENCH_MIN_TIME 0.5      // each benchmark runs for at least this number of seconds
+#define BENCH_ENTRIES 16        // number of entries of the archives written by write_tar_entries()
+#define BENCH_CONTENT 512       // size of the content of each entry
+#define BENCH_TRACED_RUNS 200   // executions traced to count the system calls of the fuzzer
+
+// Keeps the results of the benchmarked functions alive so that they are not optimized away
+static volatile unsigned long sink;
+
+static int first_result = 1;
+
+/**
+ * Prints the result of a benchmark as a JSON object of the "benchmarks" array.
+ *
+ * @param[in] name the name of the benchmark
+ * @param[in] ops number of operations done
+ * @param[in] seconds time taken by the operations
+**/
+static void report(const char *name, unsigned long ops, double seconds)
+{
+  printf("%s\n    {\"name\": \"%s\", \"ops\": %lu, \"seconds\": %.6f, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f}",
+         first_result ? "" : ",", name, ops, seconds, seconds / ops * 1e9, ops / seconds);
+  first_result = 0;
+}
+
+/**
+ * Runs a function a growing number of times until it took at least BENCH_MIN_TIME, and reports it.
+ *
+ * @param[in] name the name of the benchmark
+ * @param[in] run the function to benchmark, doing one operation
+ * @param[in] arg argument given to the function
+**/
+static void measure(const char *name, void (*run)(void *), void *arg)
+{
+  unsigned long ops = 0;
+  unsigned long batch = 1;
+  double start = now_seconds();
+  double elapsed = 0;
+
+  while (elapsed < BENCH_MIN_TIME)
+  {
+    for (unsigned long i = 0; i < batch; i++)
+      run(arg);
+    ops += batch;
+    batch *= 2;
+    elapsed = now_seconds() - start;
+  }
+
+  report(name, ops, elapsed);
+}
+
+static void bench_checksum(void *arg)
+{
+  sink += calculate_checksum(arg);
+}
+
+static void bench_checksum_headers(void *arg)
+{
+  static unsigned sums[BENCH_ENTRIES];
+  static int signed_sums[BENCH_ENTRIES];
+  checksum_headers(arg, BENCH_ENTRIES, sums, signed_sums);
+  sink += sums[0] + signed_sums[0];
+}
+
+static void bench_set_header(void *arg)
+{
+  set_header(arg);
+  sink += ((tar_t *)arg)->name[5];
+}
+
+// Buffer the archives are built in, kept from one archive to the next as the fuzzer does
+static tar_buffer bench_archive;
+
+static void bench_write_tar(void *arg)
+{
+  static char content[BENCH_CONTENT];
+  write_tar(&bench_archive, TEST_FILE, arg, content, sizeof(content));
+}
+
+static arena bench_arena;
+
+static void bench_write_tar_entries(void *arg)
+{
+  tar_entry *entries = arg;
+
+  // The contents are built in an arena reset for each archive, as the generators do
+  arena_reset(&bench_arena);
+  for (unsigned i = 0; i < BENCH_ENTRIES; i++)
+  {
+    char *content = arena_alloc(&bench_arena, BENCH_CONTENT);
+    memset(content, 0, BENCH_CONTENT);
+    entries[i].content = content;
+    entries[i].size = BENCH_CONTENT;
+  }
+  write_tar_entries(&bench_archive, TEST_FILE, entries, BENCH_ENTRIES);
+}
+
+typedef struct
+{
+    const char *extractor;
+    const char *archive;
+    exec_options options;
+} exec_bench;
+
+static void bench_exec(void *arg)
+{
+  exec_bench *bench = arg;
+  exec_result result;
+  if (exec_target(bench->extractor, bench->archive, &bench->options, &result) == 0)
+    sink += result.status;
+}
+
+/**
+ * Writes the archive then runs the extractor on it, the I/O done by the fuzzer for each execution.
+**/
+static void bench_write_exec(void *arg)
+{
+  static char content[BENCH_CONTENT];
+  exec_bench *bench = arg;
+  tar_t header;
+  set_header(&header);
+  write_tar(&bench_archive, TEST_FILE, &header, content, sizeof(content));
+  bench_exec(bench);
+}
+
+/**
+ * Counts the system calls made by the fuzzer for each operation: the operations run in a child
+ * traced by the benchmark, the extractors it starts are not traced. The first operation is
+ * not counted, it opens what the next ones reuse.
+ *
+ * @param[in] name the name of the benchmark
+ * @param[in] run the function doing one operation
+ * @param[in] arg argument given to the function
+ * @param[in] ring 1 to set up io_uring in the child first
+**/
+static void count_syscalls(const char *name, void (*run)(void *), void *arg, int ring)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == -1)
+    return;
+  if (pid == 0)
+  {
+    if (ring && uring_init() == -1)
+      _exit(2);
+    run(arg);
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    raise(SIGSTOP);
+    for (unsigned i = 0; i < BENCH_TRACED_RUNS; i++)
+      run(arg);
+    _exit(0);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status) ||
+      ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL) == -1)
+  {
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return;
+  }
+
+  // The stops at the entries are counted, the signals of the extractors are passed through
+  unsigned long syscalls = 0;
+  int sig = 0;
+  for (;;)
+  {
+    if (ptrace(PTRACE_SYSCALL, pid, NULL, sig) == -1 || waitpid(pid, &status, 0) == -1)
+      break;
+    sig = 0;
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+      break;
+    if (WSTOPSIG(status) != (SIGTRAP | 0x80))
+    {
+      sig = WSTOPSIG(status);
+      continue;
+    }
+    struct __ptrace_syscall_info info;
+    if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0 && info.op == PTRACE_SYSCALL_INFO_ENTRY)
+      syscalls++;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    return;
+
+  // Without the exit_group() of the child
+  printf(",\n    {\"name\": \"%s\", \"ops\": %u, \"syscalls_per_op\": %.2f}", name, BENCH_TRACED_RUNS,
+         (double)(syscalls - 1) / BENCH_TRACED_RUNS);
+}
+
+static harness bench_harness;
+
+static void bench_harness_run(void *arg)
+{
+  exec_bench *bench = arg;
+  exec_result result;
+  if (harness_run(&bench_harness, bench->archive, &bench->options, &result) == 0)
+    sink += result.status;
+}
+
+static snapshot bench_snapshot;
+
+static void bench_snapshot_run(void *arg)
+{
+  (void)arg;
+  exec_result result;
+  if (snapshot_run(&bench_snapshot, &result) == 0)
+    sink += result.status;
+}
+
+/**
+ * Runs the generation tests of the fuzzer against the extractor until BENCH_MIN_TIME has passed,
+ * and reports the number of executions per second. The output of the fuzzer is discarded.
+ *
+ * @param[in] extractor absolute path of the extractor, shorter than PATH_MAX
+**/
+static void bench_end_to_end(const char *extractor)
+{
+  Options options = {.mode = MODE_GENERATION, .stats_file = "bench_stats.dat", .store_file = "bench.store"};
+
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  close(null);
+
+  Fuzzer *fuzzer = init_fuzzer(&options);
+  strcpy(fuzzer->extractor_file, extractor);
+  fuzzer->label = extractor;
+
+  double start = now_seconds();
+  double elapsed = 0;
+  while (elapsed < BENCH_MIN_TIME)
+  {
+    sched_run_families(fuzzer);
+    elapsed = now_seconds() - start;
+  }
+  unsigned long execs = fuzzer->execs;
+
+  scratch_remove(&fuzzer->scratch);
+  free_fuzzer(fuzzer);
+
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  report("end_to_end", execs, elapsed);
+}
+
+/**
+ * Measures the overhead of the fuzzer: the tar writers, the executor and the whole generation
+ * loop run against a stub extractor that exits at once, so that the fuzzer itself is what is timed.
+ * The results are printed as JSON, to be compared between versions.
+ *
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv the path of the stub extractor, then optionally the path of the stub library
+ * @param[out] 0 if the benchmarks ran, -1 otherwise.
+**/
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    printf("./bench ./<path-to-stub-extractor> [./<path-to-stub-library>]\n");
+    return -1;
+  }
+
+  exec_bench exec = {0};
+  char extractor[PATH_MAX];
+  if (realpath(argv[1], extractor) == NULL)
+  {
+    printf("The extractor \"%s\" doesn't exist\n", argv[1]);
+    return -1;
+  }
+  exec.extractor = extractor;
+  char library[PATH_MAX];
+  int has_library = argc > 2 && realpath(argv[2], library) != NULL;
+
+  // Everything is written in a scratch directory removed at the end
+  int cwd = open(".", O_RDONLY | O_DIRECTORY);
+  scratch_dir work;
+  if (cwd == -1 || scratch_create(&work, 0) == -1 || chdir(work.path) == -1)
+  {
+    printf("Scratch directory not created \n");
+    return -1;
+  }
+
+  char archive[PATH_MAX + sizeof(TEST_FILE)];
+  snprintf(archive, sizeof(archive), "%s/" TEST_FILE, work.path);
+  exec.archive = archive;
+
+  srand(0);
+  printf("{\n  \"extractor\": \"%s\",\n  \"date\": %ld,\n  \"checksum_kernel\": \"%s\",\n  \"benchmarks\": [",
+         extractor, (long)time(NULL), checksum_kernel());
+
+  tar_t header;
+  set_header(&header);
+  measure("calculate_checksum", bench_checksum, &header);
+  measure("set_header", bench_set_header, &header);
+
+  tar_t headers[BENCH_ENTRIES];
+  for (unsigned i = 0; i < BENCH_ENTRIES; i++)
+    set_header(&headers[i]);
+  measure("checksum_headers", bench_checksum_headers, headers);
+
+  set_header(&header);
+  measure("write_tar", bench_write_tar, &header);
+
+  tar_entry entries[BENCH_ENTRIES];
+  for (unsigned i = 0; i < BENCH_ENTRIES; i++)
+  {
+    set_header(&entries[i].header);
+    snprintf(entries[i].header.name, NAME_LEN, "entry_%u" EXT, i);
+  }
+  arena_init(&bench_arena);
+  measure("write_tar_entries", bench_write_tar_entries, entries);
+  arena_free(&bench_arena);
+
+  // The executor on an archive without the crash marker
+  write_tar(&bench_archive, TEST_FILE, &header, "", 0);
+  measure("exec_target", bench_exec, &exec);
+
+  sandbox box;
+  if (sandbox_start(&box) == 0)
+  {
+    exec.options.sandbox = &box;
+    measure("exec_sandbox", bench_exec, &exec);
+    exec.options.sandbox = NULL;
+    sandbox_stop(&box);
+  }
+
+  // The system calls of the fuzzer for each execution, with the regular system calls then with io_uring
+  count_syscalls("syscalls_exec", bench_write_exec, &exec, 0);
+  count_syscalls("syscalls_exec_uring", bench_write_exec, &exec, 1);
+  measure("write_exec", bench_write_exec, &exec);
+  if (uring_init() == 0)
+  {
+    measure("write_exec_uring", bench_write_exec, &exec);
+    uring_free();
+  }
+
+  // The stub built as a library, called in process
+  if (has_library && harness_open(&bench_harness, library, 0) == 0)
+  {
+    measure("exec_harness", bench_harness_run, &exec);
+    harness_close(&bench_harness);
+  }
+
+  // The stub rewound to the open of the archive
+  if (snapshot_open(&bench_snapshot, exec.extractor, exec.archive, &exec.options) == 0)
+  {
+    measure("exec_snapshot", bench_snapshot_run, NULL);
+    snapshot_close(&bench_snapshot);
+  }
+
+  bench_end_to_end(extractor);
+  printf("\n  ]\n}\n");
+  tar_buffer_free(&bench_archive);
+
+  if (fchdir(cwd) == -1)
+    return -1;
+  close(cwd);
+  scratch_remove(&work);
+  return 0;
+}
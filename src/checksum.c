@@ -0,0 +1,249 @@
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHECKSUM_X86
+#endif
+
+#include "checksum.h"
+
+// Sums the bytes of a header as unsigned and as signed chars
+typedef void (*sum_kernel)(const unsigned char *header, unsigned *sum, int *signed_sum);
+
+// Two octal digits for each value from 0 to 63
+static const char OCTAL_PAIRS[] =
+    "00010203040506071011121314151617"
+    "20212223242526273031323334353637"
+    "40414243444546475051525354555657"
+    "60616263646566677071727374757677";
+
+/**
+ * Sums the bytes of a header one at a time, used when no vector unit is available.
+ *
+ * @param[in] header the 512 bytes of the header
+ * @param[out] sum the sum of the bytes as unsigned chars
+ * @param[out] signed_sum the sum of the bytes as signed chars
+**/
+static void sum_scalar(const unsigned char *header, unsigned *sum, int *signed_sum)
+{
+  unsigned u = 0;
+  int s = 0;
+  for (int i = 0; i < CHECKSUM_HEADER_LEN; i++)
+  {
+    u += header[i];
+    s += (signed char)header[i];
+  }
+  *sum = u;
+  *signed_sum = s;
+}
+
+#ifdef CHECKSUM_X86
+/**
+ * Sums the bytes of a header 16 at a time. psadbw against zero gives the sum of 8 bytes,
+ * and a byte read as signed char is the byte xored with 0x80, minus 128,
+ * so the same instruction gives both sums.
+**/
+__attribute__((target("sse2")))
+static void sum_sse2(const unsigned char *header, unsigned *sum, int *signed_sum)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  __m128i u = zero, s = zero;
+
+  for (int i = 0; i < CHECKSUM_HEADER_LEN; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(header + i));
+    u = _mm_add_epi64(u, _mm_sad_epu8(v, zero));
+    s = _mm_add_epi64(s, _mm_sad_epu8(_mm_xor_si128(v, bias), zero));
+  }
+
+  u = _mm_add_epi64(u, _mm_unpackhi_epi64(u, u));
+  s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+  *sum = _mm_cvtsi128_si32(u);
+  *signed_sum = _mm_cvtsi128_si32(s) - 128 * CHECKSUM_HEADER_LEN;
+}
+
+/**
+ * Same as sum_sse2(), 32 bytes at a time.
+**/
+__attribute__((target("avx2")))
+static void sum_avx2(const unsigned char *header, unsigned *sum, int *signed_sum)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i bias = _mm256_set1_epi8((char)0x80);
+  __m256i u = zero, s = zero;
+
+  for (int i = 0; i < CHECKSUM_HEADER_LEN; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(header + i));
+    u = _mm256_add_epi64(u, _mm256_sad_epu8(v, zero));
+    s = _mm256_add_epi64(s, _mm256_sad_epu8(_mm256_xor_si256(v, bias), zero));
+  }
+
+  __m128i u2 = _mm_add_epi64(_mm256_castsi256_si128(u), _mm256_extracti128_si256(u, 1));
+  __m128i s2 = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+  u2 = _mm_add_epi64(u2, _mm_unpackhi_epi64(u2, u2));
+  s2 = _mm_add_epi64(s2, _mm_unpackhi_epi64(s2, s2));
+  *sum = _mm_cvtsi128_si32(u2);
+  *signed_sum = _mm_cvtsi128_si32(s2) - 128 * CHECKSUM_HEADER_LEN;
+}
+#endif
+
+static sum_kernel kernel;
+static const char *kernel_name;
+
+// The kernels from the fastest to the slowest, the scalar one runs everywhere
+static const struct
+{
+    const char *name;
+    sum_kernel sum;
+} KERNELS[] = {
+#ifdef CHECKSUM_X86
+    {"avx2", sum_avx2},
+    {"sse2", sum_sse2},
+#endif
+    {"scalar", sum_scalar},
+};
+
+/**
+ * Tells whether the CPU can run a kernel.
+**/
+static int kernel_supported(const char *name)
+{
+#ifdef CHECKSUM_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "avx2"))
+    return __builtin_cpu_supports("avx2");
+  if (!strcmp(name, "sse2"))
+    return __builtin_cpu_supports("sse2");
+#endif
+  return !strcmp(name, "scalar");
+}
+
+/**
+ * Picks the fastest kernel supported by the CPU, the first time a checksum is computed.
+**/
+static void pick_kernel(void)
+{
+  for (size_t i = 0; i < sizeof(KERNELS) / sizeof(KERNELS[0]); i++)
+    if (kernel_supported(KERNELS[i].name))
+    {
+      kernel = KERNELS[i].sum;
+      kernel_name = KERNELS[i].name;
+      return;
+    }
+}
+
+/**
+ * Sums a header as both kinds of chars, with the chksum field counted as spaces whatever it holds.
+**/
+static void sum_header(const unsigned char *header, unsigned *sum, int *signed_sum)
+{
+  if (!kernel)
+    pick_kernel();
+  kernel(header, sum, signed_sum);
+
+  // The chksum field is replaced by spaces, which read the same signed or not
+  for (int i = CHECKSUM_OFFSET; i < CHECKSUM_OFFSET + CHECKSUM_LEN; i++)
+  {
+    *sum += ' ' - header[i];
+    *signed_sum += ' ' - (signed char)header[i];
+  }
+}
+
+/**
+ * Computes the checksum of a tar header: the sum of its bytes as unsigned chars,
+ * with the chksum field counted as spaces. The header is not modified.
+ *
+ * @param[in] header the 512 bytes of the header
+ * @return the checksum
+**/
+unsigned checksum_header(const void *header)
+{
+  unsigned sum;
+  int signed_sum;
+  sum_header(header, &sum, &signed_sum);
+  return sum;
+}
+
+/**
+ * Computes the checksum of a tar header the way some historic tar implementations did,
+ * summing the bytes as signed chars. It only differs from checksum_header() when
+ * the header holds bytes above 0x7f, and can be negative.
+ *
+ * @param[in] header the 512 bytes of the header
+ * @return the signed checksum
+**/
+int checksum_header_signed(const void *header)
+{
+  unsigned sum;
+  int signed_sum;
+  sum_header(header, &sum, &signed_sum);
+  return signed_sum;
+}
+
+/**
+ * Computes the checksums of headers laid out one after the other.
+ *
+ * @param[in] headers the headers, 512 bytes each
+ * @param[in] count the number of headers
+ * @param[out] sums the checksum of each header
+ * @param[out] signed_sums the signed checksum of each header, can be NULL
+**/
+void checksum_headers(const void *headers, size_t count, unsigned sums[], int signed_sums[])
+{
+  const unsigned char *header = headers;
+  for (size_t i = 0; i < count; i++, header += CHECKSUM_HEADER_LEN)
+  {
+    int signed_sum;
+    sum_header(header, &sums[i], &signed_sum);
+    if (signed_sums)
+      signed_sums[i] = signed_sum;
+  }
+}
+
+/**
+ * Writes a checksum in a chksum field the way tar does: six octal digits, a null and a space.
+ * Only the low 18 bits are written, which is more than the sum of 512 bytes can use.
+ *
+ * @param[out] field the 8 bytes of the chksum field
+ * @param[in] value the checksum
+**/
+void checksum_encode(char *field, unsigned value)
+{
+  memcpy(field, OCTAL_PAIRS + 2 * ((value >> 12) & 63), 2);
+  memcpy(field + 2, OCTAL_PAIRS + 2 * ((value >> 6) & 63), 2);
+  memcpy(field + 4, OCTAL_PAIRS + 2 * (value & 63), 2);
+  field[6] = '\0';
+  field[7] = ' ';
+}
+
+/**
+ * Gives the name of the kernel used to sum the headers on this CPU.
+ *
+ * @return "avx2", "sse2" or "scalar"
+**/
+const char *checksum_kernel(void)
+{
+  if (!kernel)
+    pick_kernel();
+  return kernel_name;
+}
+
+/**
+ * Makes the checksums use a given kernel instead of the fastest one, to compare them.
+ *
+ * @param[in] name "avx2", "sse2" or "scalar"
+ * @return 1 if the kernel is now used, 0 if it is not built or the CPU cannot run it
+**/
+int checksum_use_kernel(const char *name)
+{
+  for (size_t i = 0; i < sizeof(KERNELS) / sizeof(KERNELS[0]); i++)
+    if (!strcmp(KERNELS[i].name, name) && kernel_supported(name))
+    {
+      kernel = KERNELS[i].sum;
+      kernel_name = KERNELS[i].name;
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+
+#define CHECKSUM_HEADER_LEN 512    // size of a tar header
+#define CHECKSUM_OFFSET 148        // offset of the chksum field in the header
+#define CHECKSUM_LEN 8             // size of the chksum field
+
+unsigned checksum_header(const void *header);
+int checksum_header_signed(const void *header);
+void checksum_headers(const void *headers, size_t count, unsigned sums[], int signed_sums[]);
+void checksum_encode(char *field, unsigned value);
+const char *checksum_kernel(void);
+int checksum_use_kernel(const char *name);
+
+#endif
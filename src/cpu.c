@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/file.h>
+
+#include "cpu.h"
+#include "exec.h"
+
+/**
+ * Reads a list of CPUs in the format of /sys, like "0-3,8,10-11".
+ *
+ * @param[in] path the file holding the list
+ * @param[out] cpus the CPUs of the list
+ * @param[in] max the size of cpus
+ * @return the number of CPUs read, 0 if the file cannot be read
+**/
+static unsigned read_cpu_list(const char *path, int cpus[], unsigned max)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return 0;
+  char line[256];
+  unsigned count = 0;
+  if (fgets(line, sizeof(line), f))
+  {
+    char *p = line;
+    while (*p >= '0' && *p <= '9')
+    {
+      long first = strtol(p, &p, 10), last = first;
+      if (*p == '-')
+        last = strtol(p + 1, &p, 10);
+      for (long cpu = first; cpu <= last && count < max; cpu++)
+        cpus[count++] = cpu;
+      if (*p == ',')
+        p++;
+    }
+  }
+  fclose(f);
+  return count;
+}
+
+/**
+ * Groups the CPUs the fuzzer may run on by core, following the hardware threads listed in /sys.
+ * A CPU whose topology cannot be read is a core of its own.
+ *
+ * @param[out] t the topology
+ * @return 0 on success, -1 if the CPUs the fuzzer may run on are not known
+**/
+int cpu_topology_read(cpu_topology *t)
+{
+  memset(t, 0, sizeof(cpu_topology));
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    return -1;
+
+  t->cores = calloc(CPU_COUNT(&allowed), sizeof(cpu_slot));
+  t->first = calloc(CPU_COUNT(&allowed), sizeof(int));
+  if (t->cores == NULL || t->first == NULL)
+  {
+    printf("Array not allocated \n");
+    exit(0);
+  }
+
+  for (int cpu = 0; cpu < CPU_MAX && cpu < CPU_SETSIZE; cpu++)
+  {
+    if (!CPU_ISSET(cpu, &allowed))
+      continue;
+
+    // The core is identified by the first of its threads
+    char path[128];
+    int siblings[CPU_SLOT_MAX];
+    snprintf(path, sizeof(path), CPU_TOPOLOGY, cpu);
+    unsigned count = read_cpu_list(path, siblings, CPU_SLOT_MAX);
+    int first = count ? siblings[0] : cpu;
+    for (unsigned i = 1; i < count; i++)
+      first = siblings[i] < first ? siblings[i] : first;
+
+    unsigned c = 0;
+    while (c < t->count && t->first[c] != first)
+      c++;
+    if (c == t->count)
+      t->first[t->count++] = first;
+    if (t->cores[c].count < CPU_SLOT_MAX)
+    {
+      t->cores[c].cpus[t->cores[c].count++] = cpu;
+      t->threads++;
+    }
+  }
+  return t->count ? 0 : -1;
+}
+
+/**
+ * Releases the cores of a topology.
+ *
+ * @param[in] t the topology
+**/
+void cpu_topology_free(cpu_topology *t)
+{
+  free(t->cores);
+  free(t->first);
+  memset(t, 0, sizeof(cpu_topology));
+}
+
+/**
+ * Gives the CPUs of a worker. When there are no more workers than cores, each worker gets a core
+ * of its own with all its hardware threads, so that nothing else shares its caches. Otherwise each
+ * worker gets a single hardware thread, the first thread of every core being handed out before the
+ * second ones, so the first workers still do not share a core.
+ *
+ * @param[in] t the topology
+ * @param[in] worker the number of the worker
+ * @param[in] workers the number of workers
+ * @param[out] slot the CPUs of the worker
+**/
+void cpu_assign(const cpu_topology *t, unsigned worker, unsigned workers, cpu_slot *slot)
+{
+  memset(slot, 0, sizeof(cpu_slot));
+  if (t->count == 0)
+    return;
+  if (workers <= t->count)
+  {
+    *slot = t->cores[worker];
+    return;
+  }
+
+  unsigned index = worker % t->threads;
+  for (unsigned thread = 0; thread < CPU_SLOT_MAX; thread++)
+  {
+    for (unsigned c = 0; c < t->count; c++)
+    {
+      if (thread >= t->cores[c].count)
+        continue;
+      if (index-- == 0)
+      {
+        slot->cpus[slot->count++] = t->cores[c].cpus[thread];
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * Pins the calling process to CPUs, the processes it forks afterwards inherit them.
+ *
+ * @param[in] slot the CPUs
+ * @return 0 on success, -1 otherwise
+**/
+int cpu_pin(const cpu_slot *slot)
+{
+  if (slot->count == 0)
+    return -1;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned i = 0; i < slot->count; i++)
+    CPU_SET(slot->cpus[i], &set);
+  return sched_setaffinity(0, sizeof(set), &set);
+}
+
+/**
+ * Gives the directory of the locks of the cores: $XDG_RUNTIME_DIR, private to the user, or
+ * CPU_LOCK_DIR when it is not set.
+ *
+ * @return the directory
+**/
+const char *cpu_lock_dir(void)
+{
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  return dir != NULL && dir[0] == '/' ? dir : CPU_LOCK_DIR;
+}
+
+/**
+ * Claims a core no other instance of the host holds. The instances hold their core with a lock
+ * on CPU_LOCK_FILE in dir, released by the kernel when they exit, so that they keep apart without
+ * a coordinator. The lock files are not followed when they are links, and a core whose file
+ * cannot be opened is taken for held. The search starts at the core the process is running on.
+ * The process is not pinned, see cpu_pin().
+ *
+ * @param[in] t the topology
+ * @param[in] dir the directory of the locks, usually cpu_lock_dir()
+ * @param[out] slot the CPUs of the core claimed
+ * @param[out] lock the descriptor holding the lock, to keep open while the core is used
+ * @return 0 on success, -1 if every core is held
+**/
+int cpu_claim(const cpu_topology *t, const char *dir, cpu_slot *slot, int *lock)
+{
+  int current = sched_getcpu();
+  unsigned start = 0;
+  for (unsigned c = 0; c < t->count; c++)
+    for (unsigned i = 0; i < t->cores[c].count; i++)
+      if (t->cores[c].cpus[i] == current)
+        start = c;
+
+  for (unsigned n = 0; n < t->count; n++)
+  {
+    unsigned c = (start + n) % t->count;
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), CPU_LOCK_FILE, dir, t->first[c]) >= (int)sizeof(path))
+      return -1;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+    if (fd == -1)
+      continue;
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+    {
+      close(fd);
+      continue;
+    }
+    *slot = t->cores[c];
+    *lock = fd;
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * Counts the CPUs the calling process may run on, which are fewer than the CPUs online
+ * when it is pinned or confined by a cpuset.
+ *
+ * @return the number of CPUs, at least 1
+**/
+unsigned cpu_count(void)
+{
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0)
+    return CPU_COUNT(&allowed);
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? cpus : 1;
+}
+
+/**
+ * Writes the CPUs of a slot separated by commas, for the reports.
+**/
+void cpu_slot_format(const cpu_slot *slot, char *out, size_t size)
+{
+  size_t len = 0;
+  out[0] = '\0';
+  for (unsigned i = 0; i < slot->count && len < size; i++)
+    len += snprintf(out + len, size - len, i ? ",%d" : "%d", slot->cpus[i]);
+}
+
+/**
+ * Starts the concurrency controller.
+ *
+ * @param[out] c the controller
+ * @param[in] initial the extractors running at once to start with
+ * @param[in] max the extractors running at once at most
+**/
+void concurrency_init(concurrency *c, unsigned initial, unsigned max)
+{
+  memset(c, 0, sizeof(concurrency));
+  c->max = max ? max : 1;
+  c->limit = initial == 0 ? 1 : initial > c->max ? c->max : initial;
+  c->step = 1;
+  c->window_start = now_seconds();
+  c->cpus = cpu_count();
+}
+
+/**
+ * Counts executions and, once a window of CONCURRENCY_WINDOW seconds is over, moves the number
+ * of extractors running at once by one, hill climbing on the execs/s: the limit goes on in the same
+ * direction while the execs/s do not drop, and turns back when they do. It ends up going back and
+ * forth around the peak. The load average, minus the extractors of the fuzzer, tells when other
+ * processes compete for the CPUs: the limit then only goes down. The load average is smoothed over
+ * a minute, so it only brakes a campaign that lasts.
+ *
+ * @param[in] c the controller
+ * @param[in] execs the executions done since the last call
+ * @return the extractors to run at once from now on
+**/
+unsigned concurrency_update(concurrency *c, unsigned long execs)
+{
+  c->window_execs += execs;
+  double now = now_seconds();
+  if (now - c->window_start < CONCURRENCY_WINDOW)
+    return c->limit;
+
+  double rate = c->window_execs / (now - c->window_start);
+  if (rate > c->best_rate)
+  {
+    c->best_rate = rate;
+    c->best_limit = c->limit;
+  }
+
+  double load = 0;
+  if (getloadavg(&load, 1) == 1 && load - c->limit > CONCURRENCY_OTHERS * c->cpus)
+  {
+    if (c->limit > 1)
+    {
+      c->limit--;
+      c->changes++;
+    }
+  }
+  else if (c->max > 1)
+  {
+    if (c->last_rate > 0 && rate < c->last_rate * (1 - CONCURRENCY_TOLERANCE))
+      c->step = -c->step;
+
+    // At a bound, the limit turns back rather than staying
+    if ((c->step < 0 && c->limit == 1) || (c->step > 0 && c->limit == c->max))
+      c->step = -c->step;
+    c->limit += c->step;
+    c->changes++;
+  }
+
+  c->last_rate = rate;
+  c->window_start = now;
+  c->window_execs = 0;
+  return c->limit;
+}
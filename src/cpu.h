@@ -0,0 +1,58 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stddef.h>
+
+#define CPU_MAX 1024                // CPUs of the host considered at most
+#define CPU_SLOT_MAX 8              // hardware threads of a core at most
+#define CPU_TOPOLOGY "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list"
+#define CPU_LOCK_DIR "/tmp"         // directory of the locks when $XDG_RUNTIME_DIR is not set
+#define CPU_LOCK_FILE "%s/fuzzy_core_%d.lock" // locked by the instance using the core with this first CPU
+
+#define CONCURRENCY_WINDOW 0.5      // seconds of executions measured before the concurrency changes
+#define CONCURRENCY_TOLERANCE 0.03  // drop of the execs/s taken for noise rather than for too much concurrency
+#define CONCURRENCY_OTHERS 0.5      // load of the other processes, per CPU, above which the concurrency only goes down
+
+// CPUs a worker and its extractors are pinned to: a core, all its hardware threads, or one of them
+typedef struct cpu_slot
+{
+    unsigned count;
+    int cpus[CPU_SLOT_MAX];
+} cpu_slot;
+
+// Cores the fuzzer may run on, from the topology in /sys, in the order of their first CPU
+typedef struct
+{
+    cpu_slot *cores;    // the hardware threads of each core, only the ones the fuzzer may run on
+    int *first;         // the first hardware thread of each core, allowed or not, identifying it
+    unsigned count;     // number of cores
+    unsigned threads;   // number of CPUs over all the cores
+} cpu_topology;
+
+// Number of extractors running at once, raised or lowered by concurrency_update() to the peak execs/s
+typedef struct
+{
+    unsigned limit;             // extractors running at once
+    unsigned max;
+    int step;                   // direction of the next change, +1 or -1
+    double window_start;        // beginning of the measure of the current limit
+    unsigned long window_execs; // executions since window_start
+    double last_rate;           // execs/s of the previous window, 0 before the first one
+    double best_rate;           // best execs/s seen, and the limit it was seen with
+    unsigned best_limit;
+    unsigned cpus;              // CPUs the fuzzer may run on, for the load average
+    unsigned changes;           // number of changes of the limit
+} concurrency;
+
+int cpu_topology_read(cpu_topology *t);
+void cpu_topology_free(cpu_topology *t);
+void cpu_assign(const cpu_topology *t, unsigned worker, unsigned workers, cpu_slot *slot);
+int cpu_pin(const cpu_slot *slot);
+const char *cpu_lock_dir(void);
+int cpu_claim(const cpu_topology *t, const char *dir, cpu_slot *slot, int *lock);
+unsigned cpu_count(void);
+void cpu_slot_format(const cpu_slot *slot, char *out, size_t size);
+void concurrency_init(concurrency *c, unsigned initial, unsigned max);
+unsigned concurrency_update(concurrency *c, unsigned long execs);
+
+#endif
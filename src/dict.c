@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dict.h"
+#include "novelty.h"
+
+// Index of the tokens by hash while harvesting, open addressing kept at most half full
+typedef struct
+{
+    size_t *slots;      // index of the token + 1, 0 for a free slot
+    size_t cap;
+} dict_index;
+
+/**
+ * Adds a token to the dictionary, or adds its score to the token already there.
+ *
+ * @param[in] d the dictionary
+ * @param[in] index the index of the tokens of the dictionary
+ * @param[in] text the token, not null terminated
+ * @param[in] len the length of the token
+ * @param[in] score the score of this occurrence
+**/
+static void dict_add(dictionary *d, dict_index *index, const char *text, size_t len, unsigned score)
+{
+  if (len < DICT_MIN_LEN || len >= DICT_TOKEN_LEN)
+    return;
+
+  if (2 * (d->count + 1) > index->cap)
+  {
+    size_t cap = index->cap ? index->cap * 2 : 1024;
+    size_t *slots = calloc(cap, sizeof(size_t));
+    if (slots == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+    for (size_t i = 0; i < d->count; i++)
+    {
+      size_t j = d->tokens[i].hash & (cap - 1);
+      while (slots[j])
+        j = (j + 1) & (cap - 1);
+      slots[j] = i + 1;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->cap = cap;
+  }
+
+  uint64_t hash = hash_bytes(text, len);
+  size_t j = hash & (index->cap - 1);
+  while (index->slots[j])
+  {
+    dict_token *token = &d->tokens[index->slots[j] - 1];
+    if (token->hash == hash && token->len == len && memcmp(token->text, text, len) == 0)
+    {
+      // The words of the messages never add up to a literal
+      if (score != DICT_WORD_SCORE || token->score % DICT_LITERAL_SCORE < DICT_LITERAL_SCORE - DICT_WORD_SCORE)
+        token->score += score;
+      return;
+    }
+    j = (j + 1) & (index->cap - 1);
+  }
+
+  if (d->count == d->cap)
+  {
+    d->cap = d->cap ? d->cap * 2 : 256;
+    d->tokens = realloc(d->tokens, d->cap * sizeof(dict_token));
+    if (d->tokens == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+  dict_token *token = &d->tokens[d->count];
+  memset(token, 0, sizeof(dict_token));
+  memcpy(token->text, text, len);
+  token->len = len;
+  token->score = score;
+  token->hash = hash;
+  index->slots[j] = ++d->count;
+}
+
+/**
+ * Tells whether a character can be part of a word: names, paths, numbers and magic values.
+**/
+static int is_word(unsigned char c)
+{
+  return isalnum(c) || c == '_' || c == '-' || c == '.' || c == '/';
+}
+
+/**
+ * Adds the tokens of a string of the binary. A short string without conversion is kept whole,
+ * it is most likely compared as such with what the extractor reads (a magic value, a keyword).
+ * The words of the longer strings and of the formats are kept as well, with a lower score:
+ * the messages of the extractor name the fields and the values it looks for.
+ * The conversions of the formats are skipped, "%s" is not a word.
+ *
+ * @param[in] d the dictionary
+ * @param[in] index the index of the tokens of the dictionary
+ * @param[in] str the string
+ * @param[in] len the length of the string
+**/
+static void dict_add_string(dictionary *d, dict_index *index, const char *str, size_t len)
+{
+  d->strings++;
+  if (memchr(str, '%', len) == NULL)
+    dict_add(d, index, str, len, DICT_LITERAL_SCORE);
+
+  size_t i = 0;
+  while (i < len)
+  {
+    if (str[i] == '%')
+    {
+      // Flags, width, precision and length, then the conversion itself
+      i++;
+      while (i < len && strchr("-+ #0123456789.*hlLqjzt", str[i]))
+        i++;
+      i++;
+      continue;
+    }
+    if (!is_word(str[i]))
+    {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    while (i < len && is_word(str[i]) && str[i] != '%')
+      i++;
+    // A word that is the whole string is already there
+    if (i - start < len)
+      dict_add(d, index, str + start, i - start, DICT_WORD_SCORE);
+  }
+}
+
+/**
+ * Adds the strings of a section: the runs of printable characters ended by a null byte.
+ *
+ * @param[in] d the dictionary
+ * @param[in] index the index of the tokens of the dictionary
+ * @param[in] data the section
+ * @param[in] size the size of the section
+**/
+static void dict_scan(dictionary *d, dict_index *index, const char *data, size_t size)
+{
+  d->sections++;
+  size_t start = 0;
+  for (size_t i = 0; i < size; i++)
+  {
+    unsigned char c = data[i];
+    if (isprint(c) || c == '\t' || c == '\n')
+      continue;
+    if (c == '\0' && i - start >= DICT_MIN_LEN)
+      dict_add_string(d, index, data + start, i - start);
+    start = i + 1;
+  }
+}
+
+/**
+ * Orders the tokens, the highest score first and the shortest first among the same score:
+ * a short token fits in more fields and leaves room for the rest of the field.
+**/
+static int compare_tokens(const void *a, const void *b)
+{
+  const dict_token *x = a, *y = b;
+  if (x->score != y->score)
+    return x->score < y->score ? 1 : -1;
+  if (x->len != y->len)
+    return x->len > y->len ? 1 : -1;
+  return memcmp(x->text, y->text, DICT_TOKEN_LEN);
+}
+
+/**
+ * Scans the read-only sections (.rodata and the like) of an ELF file, 32 or 64 bits, through its section headers.
+ *
+ * @return 0 on success, -1 if the file is not an ELF file or has no section headers
+**/
+static int dict_scan_elf(dictionary *d, dict_index *index, const unsigned char *file, size_t size)
+{
+  if (size < EI_NIDENT || memcmp(file, ELFMAG, SELFMAG) != 0)
+    return -1;
+
+  int is64 = file[EI_CLASS] == ELFCLASS64;
+  size_t ehdr_size = is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+  if (size < ehdr_size)
+    return -1;
+
+  uint64_t shoff;
+  size_t shnum, shentsize, shstrndx;
+  if (is64)
+  {
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)file;
+    shoff = ehdr->e_shoff;
+    shnum = ehdr->e_shnum;
+    shentsize = ehdr->e_shentsize;
+    shstrndx = ehdr->e_shstrndx;
+  }
+  else
+  {
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)file;
+    shoff = ehdr->e_shoff;
+    shnum = ehdr->e_shnum;
+    shentsize = ehdr->e_shentsize;
+    shstrndx = ehdr->e_shstrndx;
+  }
+  if (shoff == 0 || shnum == 0 || shstrndx >= shnum || shentsize < (is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) ||
+      shoff > size || shnum * shentsize > size - shoff)
+    return -1;
+
+  // Offset, size, type and name of a section
+  #define SECTION(i, field) (is64 ? (uint64_t)((const Elf64_Shdr *)(file + shoff + (i) * shentsize))->field \
+                                  : (uint64_t)((const Elf32_Shdr *)(file + shoff + (i) * shentsize))->field)
+  uint64_t names = SECTION(shstrndx, sh_offset), names_size = SECTION(shstrndx, sh_size);
+  if (names > size || names_size > size - names)
+    return -1;
+
+  for (size_t i = 0; i < shnum; i++)
+  {
+    uint64_t offset = SECTION(i, sh_offset), length = SECTION(i, sh_size), name = SECTION(i, sh_name);
+    if (SECTION(i, sh_type) != SHT_PROGBITS || name >= names_size || offset > size || length > size - offset)
+      continue;
+    const char *section = (const char *)file + names + name;
+    if (strnlen(section, names_size - name) == names_size - name || strncmp(section, ".rodata", 7) != 0)
+      continue;
+    dict_scan(d, index, (const char *)file + offset, length);
+  }
+  #undef SECTION
+  return 0;
+}
+
+/**
+ * Builds the dictionary of an extractor from the strings of its read-only data: the magic values,
+ * keywords and field names it compares the archive with are there, next to its messages.
+ * A string kept whole scores DICT_LITERAL_SCORE and a word of a longer string DICT_WORD_SCORE,
+ * for each of their occurrences, the words adding up to less than a literal so that the strings
+ * kept whole come first. Only the DICT_MAX_TOKENS best ranked tokens are kept.
+ *
+ * @param[out] d the dictionary
+ * @param[in] path the extractor, a program or a library
+ * @return 0 on success, -1 if the file cannot be read or is not an ELF file
+**/
+int dict_harvest(dictionary *d, const char *path)
+{
+  memset(d, 0, sizeof(dictionary));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0)
+  {
+    close(fd);
+    return -1;
+  }
+  const unsigned char *file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED)
+    return -1;
+
+  dict_index index = {NULL, 0};
+  int rv = dict_scan_elf(d, &index, file, st.st_size);
+  munmap((void *)file, st.st_size);
+  free(index.slots);
+  if (rv == -1)
+  {
+    dict_free(d);
+    return -1;
+  }
+
+  qsort(d->tokens, d->count, sizeof(dict_token), compare_tokens);
+  if (d->count > DICT_MAX_TOKENS)
+    d->count = DICT_MAX_TOKENS;
+  return 0;
+}
+
+/**
+ * Picks a token at random, favouring the best ranked ones: the lower of two random ranks.
+ *
+ * @param[in] d the dictionary
+ * @return the token, NULL if the dictionary is empty
+**/
+const dict_token *dict_pick(const dictionary *d)
+{
+  if (d == NULL || d->count == 0)
+    return NULL;
+  size_t a = rand() % d->count, b = rand() % d->count;
+  return &d->tokens[a < b ? a : b];
+}
+
+/**
+ * Prints the size of the dictionary and its best ranked tokens.
+ *
+ * @param[in] d the dictionary
+**/
+void dict_report(const dictionary *d)
+{
+  printf("Dictionary: %zu tokens from %zu strings in %zu read-only sections", d->count, d->strings, d->sections);
+  for (size_t i = 0; i < d->count && i < 8; i++)
+    printf("%s\"%s\"", i ? ", " : ": ", d->tokens[i].text);
+  printf("\n");
+}
+
+/**
+ * Releases the tokens of a dictionary.
+ *
+ * @param[in] d the dictionary
+**/
+void dict_free(dictionary *d)
+{
+  free(d->tokens);
+  memset(d, 0, sizeof(dictionary));
+}
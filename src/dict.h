@@ -0,0 +1,36 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DICT_TOKEN_LEN 32     // size of a token, null included: no field of a header is longer than 155 but most are under 32
+#define DICT_MIN_LEN 2        // shorter runs of printable bytes are not tokens
+#define DICT_MAX_TOKENS 256   // tokens kept, the best ranked ones
+#define DICT_LITERAL_SCORE 8  // score of a whole string of the binary, likely compared as such
+#define DICT_WORD_SCORE 1     // score of each word found in a longer string or in a format
+
+// A token of the dictionary
+typedef struct
+{
+    char text[DICT_TOKEN_LEN];
+    unsigned len;
+    unsigned score;     // how likely the extractor compares a field with it, see dict_harvest()
+    uint64_t hash;
+} dict_token;
+
+// Tokens harvested from the read-only data of the extractor, best ranked first
+typedef struct
+{
+    dict_token *tokens;
+    size_t count, cap;
+    size_t strings;     // strings found in the read-only sections
+    size_t sections;    // read-only sections scanned
+} dictionary;
+
+int dict_harvest(dictionary *d, const char *path);
+const dict_token *dict_pick(const dictionary *d);
+void dict_report(const dictionary *d);
+void dict_free(dictionary *d);
+
+#endif
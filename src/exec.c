@@ -0,0 +1,846 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "exec.h"
+#include "sandbox.h"
+#include "profile.h"
+#include "uring.h"
+#include "cpu.h"
+
+/**
+ * Code executed by the child after the fork: redirects stdout and stderr to the pipe,
+ * moves to its working directory, applies the resource limits, pins itself to its CPUs
+ * and replaces itself with the extractor.
+ *
+ * @param[in] extractor path of the extractor to run
+ * @param[in] archive path of the archive given as argument to the extractor
+ * @param[in] options the executor options (memory limit, working directory)
+ * @param[in] out write end of the pipe collecting the output
+**/
+static void exec_child(const char *extractor, const char *archive, const exec_options *options, int out)
+{
+  // Same as "2>&1" in the shell: both streams go to the pipe
+  dup2(out, STDOUT_FILENO);
+  dup2(out, STDERR_FILENO);
+  close(out);
+
+  // The files extracted go to the working directory
+  if (options && options->workdir && chdir(options->workdir) == -1)
+    _exit(127);
+
+  // Cap the address space so that over-allocations fail inside the extractor
+  if (options && options->mem_limit)
+  {
+    struct rlimit limit = {options->mem_limit, options->mem_limit};
+    setrlimit(RLIMIT_AS, &limit);
+  }
+
+  // The worker keeps its extractors on its own core, away from the other workers
+  if (options && options->cpus)
+    cpu_pin(options->cpus);
+
+  char *argv[] = {(char *)extractor, (char *)archive, NULL};
+  execvp(extractor, argv);
+
+  // Only reached if the extractor could not be executed
+  _exit(127);
+}
+
+// A request to the launcher: start the extractor, or call a function in a child of the launcher
+typedef struct
+{
+    char extractor[PATH_MAX];
+    char archive[PATH_MAX];
+    char workdir[PATH_MAX];
+    size_t mem_limit;
+    cpu_slot cpus;              // none to keep the CPUs of the launcher
+    launch_fn call;             // called with the descriptor instead of starting the extractor, NULL otherwise
+} launch_request;
+
+// The launcher, forked before the fuzzer allocates anything, see exec_launcher_start()
+static struct
+{
+    pid_t pid;
+    int sock;                   // socket of the requests, -1 when there is no launcher
+} launcher = {0, -1};
+
+/**
+ * Starts a child of the launcher for a request. The extractor is started with CLONE_PARENT so that
+ * it is a child of the fuzzer, which waits for it and kills it like any other child. It goes straight
+ * to execve(), so the state of the C library, which a raw clone() does not update, does not matter.
+ * A function is called in a regular child of the launcher instead.
+ *
+ * @return the pid of the child, -1 if it could not be started
+**/
+static pid_t launch_child(const launch_request *request, int fd)
+{
+  if (request->call)
+  {
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      close(launcher.sock);
+      signal(SIGCHLD, SIG_DFL);
+      request->call(fd);
+      _exit(0);
+    }
+    return pid;
+  }
+
+  pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, NULL, NULL, NULL, 0);
+  if (pid == 0)
+  {
+    // The launcher ignores SIGCHLD, and execve() would keep it ignored in the extractor
+    signal(SIGCHLD, SIG_DFL);
+    exec_options options = {.mem_limit = request->mem_limit,
+                            .workdir = request->workdir[0] ? request->workdir : NULL,
+                            .cpus = request->cpus.count ? &request->cpus : NULL};
+    exec_child(request->extractor, request->archive, &options, fd);
+  }
+  return pid;
+}
+
+/**
+ * Main loop of the launcher: for each request, starts a child with the descriptor received along
+ * with the request and sends back its pid. Stops when the fuzzer closes the socket.
+**/
+static void launcher_loop(int sock)
+{
+  // The functions called run in children of the launcher, nobody waits for them
+  signal(SIGCHLD, SIG_IGN);
+  for (;;)
+  {
+    launch_request request;
+    int fd = -1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n != sizeof(request))
+      _exit(0);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    pid_t pid = fd != -1 ? launch_child(&request, fd) : -1;
+    if (fd != -1)
+      close(fd);
+    if (send(sock, &pid, sizeof(pid), 0) != sizeof(pid))
+      _exit(0);
+  }
+}
+
+/**
+ * Starts the launcher, a small process forked before the fuzzer allocates its buffers, its arena
+ * and its ring. A child forked from the fuzzer shares its pages, and the max RSS the kernel gives
+ * for the child includes them even after execve(): the max RSS of the extractor would be the one
+ * of the fuzzer. The extractors are started by the launcher instead, as children of the fuzzer.
+ * Without launcher, they are forked from the fuzzer.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+int exec_launcher_start(void)
+{
+  int socks[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks) == -1)
+    return -1;
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == -1)
+  {
+    close(socks[0]);
+    close(socks[1]);
+    return -1;
+  }
+  if (pid == 0)
+  {
+    close(socks[0]);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    launcher.sock = socks[1];
+    launcher_loop(socks[1]);
+  }
+  close(socks[1]);
+  launcher.pid = pid;
+  launcher.sock = socks[0];
+  return 0;
+}
+
+/**
+ * Stops the launcher.
+**/
+void exec_launcher_stop(void)
+{
+  if (launcher.sock == -1)
+    return;
+  close(launcher.sock);
+  launcher.sock = -1;
+  waitpid(launcher.pid, NULL, 0);
+}
+
+/**
+ * Sends a request to the launcher with a descriptor, and gets the pid of the child it started.
+ *
+ * @return the pid of the child, -1 if it could not be started
+**/
+static pid_t launch(const launch_request *request, int fd)
+{
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {(void *)request, sizeof(launch_request)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  pid_t pid = -1;
+  if (sendmsg(launcher.sock, &msg, 0) != sizeof(launch_request) ||
+      recv(launcher.sock, &pid, sizeof(pid), 0) != sizeof(pid))
+    return -1;
+  return pid;
+}
+
+/**
+ * Calls a function in a child of the launcher, which is as small as the fuzzer when it started.
+ * Used for the long-lived helpers that fork the extractors themselves, like the zygote of the sandbox.
+ * The child is not a child of the fuzzer, the fuzzer cannot wait for it.
+ *
+ * @param[in] call the function, the child exits when it returns
+ * @param[in] fd descriptor given to the function, the caller keeps its own copy
+ * @return the pid of the child, -1 if there is no launcher or the child could not be started
+**/
+pid_t exec_launch_call(launch_fn call, int fd)
+{
+  if (launcher.sock == -1)
+    return -1;
+  launch_request request;
+  memset(&request, 0, sizeof(request));
+  request.call = call;
+  return launch(&request, fd);
+}
+
+/**
+ * Gives the wall-clock time, used for the budgets and the latency measurements.
+ *
+ * @return the time in seconds from an arbitrary point
+**/
+double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Reads one chunk of the output of a child. The beginning of the output is kept
+ * and the rest is drained so the child never blocks on a full pipe.
+ *
+ * @param[in] fd read end of the pipe
+ * @param[in,out] result output and output_len are updated
+ * @return the number of bytes read, 0 once the child closed the pipe
+**/
+static ssize_t read_chunk(int fd, exec_result *result)
+{
+  char drain[OUTPUT_LEN];
+  ssize_t n;
+  do
+  {
+    if (result->output_len < OUTPUT_LEN - 1)
+      n = read(fd, result->output + result->output_len, OUTPUT_LEN - 1 - result->output_len);
+    else
+      n = read(fd, drain, sizeof(drain));
+  } while (n == -1 && errno == EINTR);
+
+  if (n > 0 && result->output_len < OUTPUT_LEN - 1)
+    result->output_len += n;
+  result->output[result->output_len] = '\0';
+  return n;
+}
+
+/**
+ * Reads the output of the child until it closes the pipe, or until the deadline. A child that is
+ * not a child of the fuzzer is killed at the deadline by its parent, the reading only stops in case
+ * a process it started keeps the pipe open.
+ *
+ * @param[in] fd read end of the pipe
+ * @param[out] result output and output_len are filled, timed_out is set if the deadline passed
+ * @param[in] deadline time at which the reading stops, 0 for never
+**/
+void exec_read_output(int fd, exec_result *result, double deadline)
+{
+  result->output_len = 0;
+  result->timed_out = 0;
+  for (;;)
+  {
+    if (deadline > 0)
+    {
+      double left = deadline - now_seconds();
+      struct pollfd pfd = {fd, POLLIN, 0};
+      if (left <= 0 || poll(&pfd, 1, (int)(left * 1000) + 1) == 0)
+      {
+        result->timed_out = 1;
+        return;
+      }
+    }
+    if (read_chunk(fd, result) <= 0)
+      return;
+  }
+}
+
+/**
+ * Starts the extractor on an archive without waiting for it, so that several extractors can run at once.
+ *
+ * @param[in] extractor path of the extractor to run, absolute if a working directory is given
+ * @param[in] archive path of the archive given to the extractor, absolute if a working directory is given
+ * @param[in] options the executor options, can be NULL, the sandbox is not supported
+ * @param[out] proc the pid of the child and the read end of its output
+ * @return 0 on success, -1 if the child could not be started
+**/
+int exec_spawn(const char *extractor, const char *archive, const exec_options *options, exec_proc *proc)
+{
+  // The read end must not leak into the other children, or they would keep the pipe open
+  uint64_t start = profile_start();
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1)
+  {
+    printf("Error opening pipe!");
+    return -1;
+  }
+
+  pid_t pid;
+  if (launcher.sock != -1)
+  {
+    // The launcher runs the extractor in the current directory of the fuzzer, not its own
+    launch_request request;
+    memset(&request, 0, sizeof(request));
+    snprintf(request.extractor, PATH_MAX, "%s", extractor);
+    snprintf(request.archive, PATH_MAX, "%s", archive);
+    if (options && options->workdir)
+      snprintf(request.workdir, PATH_MAX, "%s", options->workdir);
+    else if (getcwd(request.workdir, PATH_MAX) == NULL)
+      request.workdir[0] = '\0';
+    request.mem_limit = options ? options->mem_limit : 0;
+    if (options && options->cpus)
+      request.cpus = *options->cpus;
+    pid = launch(&request, fds[1]);
+  }
+  else
+  {
+    pid = fork();
+    if (pid == 0)
+      exec_child(extractor, archive, options, fds[1]);
+  }
+  close(fds[1]);
+  if (pid == -1)
+  {
+    printf("Error forking the extractor!");
+    close(fds[0]);
+    return -1;
+  }
+
+  proc->pid = pid;
+  proc->fd = fds[0];
+  proc->pidfd = -1;
+  proc->deadline = options && options->timeout > 0 ? now_seconds() + options->timeout : 0;
+  profile_stop(PHASE_SPAWN, start);
+  return 0;
+}
+
+/**
+ * Gives the time left before the nearest deadline of the children, for poll().
+ *
+ * @param[in] procs the children
+ * @param[in] count the number of children
+ * @param[in] closed 1 to count the children that closed their output, 0 for the ones still writing only
+ * @return the time in milliseconds, -1 if no child has a deadline
+**/
+static int poll_timeout(const exec_proc procs[], unsigned count, int closed)
+{
+  double nearest = 0;
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (procs[i].pid > 0 && (closed || procs[i].fd != -1) && procs[i].deadline > 0 && (nearest == 0 || procs[i].deadline < nearest))
+      nearest = procs[i].deadline;
+  }
+  if (nearest == 0)
+    return -1;
+
+  double left = nearest - now_seconds();
+  return left > 0 ? (int)(left * 1000) + 1 : 0;
+}
+
+/**
+ * Queues a read of the output of a child in the ring: into its result while there is room,
+ * then into a buffer that is thrown away.
+ *
+ * @return 0 on success, -1 if the ring is full
+**/
+static int queue_read(const exec_proc *proc, exec_result *result, unsigned index)
+{
+  static char drain[OUTPUT_LEN];
+  struct io_uring_sqe *sqe = uring_get_sqe();
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = proc->fd;
+  sqe->off = (uint64_t)-1;
+  sqe->user_data = index;
+  if (result->output_len < OUTPUT_LEN - 1)
+  {
+    sqe->addr = (uintptr_t)(result->output + result->output_len);
+    sqe->len = OUTPUT_LEN - 1 - result->output_len;
+  }
+  else
+  {
+    sqe->addr = (uintptr_t)drain;
+    sqe->len = sizeof(drain);
+  }
+  return 0;
+}
+
+/**
+ * Kills a child past its deadline.
+ *
+ * @return 1 if the child was killed, 0 if it still has time
+**/
+static int check_deadline(exec_proc *proc, exec_result *result, double now)
+{
+  if (proc->deadline == 0 || now < proc->deadline)
+    return 0;
+  kill(proc->pid, SIGKILL);
+  result->timed_out = 1;
+  proc->deadline = 0;
+  return 1;
+}
+
+/**
+ * Queues the cancellation of the read of a child in the ring, its completion has the user data count.
+ *
+ * @return 1 if it was queued, 0 if the ring is full
+**/
+static int queue_cancel(unsigned index, unsigned count)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe();
+  if (sqe == NULL)
+    return 0;
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = index;
+  sqe->user_data = count;
+  return 1;
+}
+
+/**
+ * Reaps the completions of the reads and cancellations still in the ring, so that nothing is
+ * written into the results once the function returns, and the next archive write does not see
+ * them. The reads still in flight are cancelled first. If the ring cannot even wait anymore, the
+ * children are killed so that their reads complete at the end of their pipes.
+ *
+ * @param[in] procs the children
+ * @param[in,out] reading the children whose read is in flight
+ * @param[in] count the number of children
+ * @param[in] cancels the cancellations in flight
+**/
+static void reap_reads(const exec_proc procs[], unsigned char reading[], unsigned count, unsigned cancels)
+{
+  unsigned inflight = 0;
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (reading[i])
+    {
+      cancels += queue_cancel(i, count);
+      inflight++;
+    }
+  }
+
+  while (inflight || cancels)
+  {
+    if (uring_submit_wait(1, -1) == -1)
+    {
+      for (unsigned i = 0; i < count; i++)
+      {
+        if (reading[i])
+          kill(procs[i].pid, SIGKILL);
+      }
+      usleep(1000);
+    }
+
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek()) != NULL)
+    {
+      uint64_t i = cqe->user_data;
+      uring_seen();
+      if (i < count && reading[i])
+      {
+        reading[i] = 0;
+        inflight--;
+      }
+      else if (i == count && cancels)
+        cancels--;
+    }
+  }
+}
+
+/**
+ * Reads the outputs of the children through the ring: a read of each pipe is in flight, and a
+ * single io_uring_enter() submits the next reads and waits for the completions of all of them.
+ * A child still writing after its deadline is killed and its read cancelled. Every read and
+ * cancellation is reaped before returning, the reads write into the results of the caller.
+ *
+ * @return the number of pipes still open, left to the poll() loop if the ring failed
+**/
+static unsigned read_outputs_ring(exec_proc procs[], exec_result results[], unsigned count, unsigned open)
+{
+  unsigned char reading[count + 1];
+  unsigned cancels = 0;
+  memset(reading, 0, count + 1);
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (procs[i].fd == -1)
+      continue;
+    if (queue_read(&procs[i], &results[i], i) == -1)
+    {
+      reap_reads(procs, reading, count, cancels);
+      return open;
+    }
+    reading[i] = 1;
+  }
+
+  while (open)
+  {
+    if (uring_submit_wait(1, poll_timeout(procs, count, 0)) == -1)
+      break;
+
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek()) != NULL)
+    {
+      uint64_t i = cqe->user_data;
+      int n = cqe->res;
+      uring_seen();
+      if (i == count && cancels)
+        cancels--;
+      if (i >= count || !reading[i])
+        continue;
+      reading[i] = 0;
+      if (n > 0 && results[i].output_len < OUTPUT_LEN - 1)
+      {
+        results[i].output_len += n;
+        results[i].output[results[i].output_len] = '\0';
+      }
+      if ((n > 0 || n == -EINTR || n == -EAGAIN) && queue_read(&procs[i], &results[i], i) == 0)
+      {
+        reading[i] = 1;
+        continue;
+      }
+
+      close(procs[i].fd);
+      procs[i].fd = -1;
+      open--;
+    }
+
+    // The read of a child out of time completes once it is cancelled
+    double now = now_seconds();
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (procs[i].fd == -1 || !check_deadline(&procs[i], &results[i], now))
+        continue;
+      cancels += queue_cancel(i, count);
+    }
+  }
+
+  // When the ring failed, the pipes still open are left to poll() once their reads are cancelled
+  reap_reads(procs, reading, count, cancels);
+  return open;
+}
+
+/**
+ * Empties a result before the output of a child is read into it.
+ *
+ * @param[out] result the result
+**/
+void exec_result_reset(exec_result *result)
+{
+  result->output_len = 0;
+  result->output[0] = '\0';
+  result->timed_out = 0;
+}
+
+/**
+ * Tells whether a child exited, without reaping it: wait4() still has to give its resource usage.
+**/
+static int has_exited(const exec_proc *proc)
+{
+  siginfo_t info;
+  info.si_pid = 0;
+  if (waitid(P_PID, proc->pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1)
+    return errno != EINTR;
+  return info.si_pid == proc->pid;
+}
+
+/**
+ * Gives what to poll to know when a child that closed its output exits: its pidfd, opened the
+ * first time. Without pidfds nothing is polled and the child is checked every EXEC_REAP_POLL ms.
+ *
+ * @param[in,out] proc the child
+ * @param[in,out] timeout the timeout of the poll in milliseconds, -1 for none, shortened without a pidfd
+ * @return the pidfd, -1 if there is none
+**/
+static int exit_fd(exec_proc *proc, int *timeout)
+{
+  if (proc->pidfd == -1)
+    proc->pidfd = syscall(EXEC_PIDFD_OPEN, proc->pid, 0);
+  if (proc->pidfd == -1 && (*timeout == -1 || *timeout > EXEC_REAP_POLL))
+    *timeout = EXEC_REAP_POLL;
+  return proc->pidfd;
+}
+
+/**
+ * Waits until a child that closed its output exits. A child can close its output and keep
+ * running, it is killed at its deadline all the same.
+ *
+ * @param[in,out] proc the child
+ * @param[in,out] result its result, flagged when it runs out of time
+**/
+static void wait_exit(exec_proc *proc, exec_result *result)
+{
+  while (proc->deadline > 0 && !has_exited(proc))
+  {
+    if (check_deadline(proc, result, now_seconds()))
+      break;
+    int timeout = poll_timeout(proc, 1, 1);
+    struct pollfd pfd = {exit_fd(proc, &timeout), POLLIN, 0};
+    poll(&pfd, 1, timeout);
+  }
+}
+
+/**
+ * Reaps a child and gets its resource usage.
+ *
+ * @param[in,out] proc the child, its pid is set to -1
+ * @param[out] result its status and resource usage
+ * @param[in] options 0 to wait for the child, WNOHANG to only reap it if it exited
+ * @return 1 if the child was reaped, 0 if it still runs, -1 if it could not be reaped
+**/
+static int reap(exec_proc *proc, exec_result *result, int options)
+{
+  pid_t pid;
+  while ((pid = wait4(proc->pid, &result->status, options, &result->usage)) == -1 && errno == EINTR)
+    ;
+  if (pid == 0)
+    return 0;
+  if (proc->pidfd != -1)
+    close(proc->pidfd);
+  proc->pidfd = -1;
+  proc->pid = -1;
+  if (pid == -1)
+  {
+    printf("Command not found");
+    return -1;
+  }
+  return 1;
+}
+
+/**
+ * Collects the output of several children started by exec_spawn() as it comes, then reaps them.
+ * A child still running after its deadline is killed, whether its output is closed or not. The
+ * outputs are read through the ring when uring_init() set it up.
+ *
+ * @param[in] procs the children
+ * @param[out] results the status, resource usage and beginning of the output of each child
+ * @param[in] count the number of children
+ * @return 0 on success, -1 if a child could not be reaped
+**/
+int exec_wait_all(exec_proc procs[], exec_result results[], unsigned count)
+{
+  uint64_t start = profile_start();
+  unsigned open = 0;
+  for (unsigned i = 0; i < count; i++)
+  {
+    exec_result_reset(&results[i]);
+    if (procs[i].fd != -1)
+      open++;
+  }
+
+  // Read the pipes that have something until they are all closed
+  if (uring.enabled)
+    open = read_outputs_ring(procs, results, count, open);
+  while (open)
+  {
+    struct pollfd pfds[count];
+    for (unsigned i = 0; i < count; i++)
+    {
+      pfds[i].fd = procs[i].fd;
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+    }
+
+    if (poll(pfds, count, poll_timeout(procs, count, 0)) == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    double now = now_seconds();
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (procs[i].fd == -1)
+        continue;
+      if (pfds[i].revents == 0 && procs[i].deadline > 0 && now >= procs[i].deadline)
+      {
+        kill(procs[i].pid, SIGKILL);
+        results[i].timed_out = 1;
+      }
+      else if (pfds[i].revents == 0 || read_chunk(procs[i].fd, &results[i]) > 0)
+        continue;
+
+      close(procs[i].fd);
+      procs[i].fd = -1;
+      open--;
+    }
+  }
+
+  // Reap the children and get their resource usage
+  int rv = 0;
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (procs[i].fd != -1)
+    {
+      close(procs[i].fd);
+      procs[i].fd = -1;
+    }
+    wait_exit(&procs[i], &results[i]);
+    if (reap(&procs[i], &results[i], 0) == -1)
+      rv = -1;
+  }
+
+  profile_stop(PHASE_WAIT, start);
+  return rv;
+}
+
+/**
+ * Waits for the first of several children started by exec_spawn() to be done, reading the output
+ * of all of them meanwhile, so that the caller can start another child in its place rather than
+ * waiting for the slowest one. The children past their deadline are killed. The slots whose pid
+ * is -1 are free, and the result of a child must be emptied by exec_result_reset() when it starts.
+ * The outputs are read with poll(), the ring is only used by exec_wait_all().
+ *
+ * @param[in,out] procs the children, the one reaped gets a pid of -1
+ * @param[out] results the status, resource usage and beginning of the output of each child
+ * @param[in] count the number of slots
+ * @return the slot of the child reaped, -1 if no child is running
+**/
+int exec_wait_any(exec_proc procs[], exec_result results[], unsigned count)
+{
+  uint64_t start = profile_start();
+  for (;;)
+  {
+    struct pollfd pfds[count];
+    int running = 0;
+    double now = now_seconds();
+    for (unsigned i = 0; i < count; i++)
+    {
+      pfds[i].fd = -1;
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+      if (procs[i].pid <= 0)
+        continue;
+      running = 1;
+      if (check_deadline(&procs[i], &results[i], now) && procs[i].fd != -1)
+      {
+        close(procs[i].fd);
+        procs[i].fd = -1;
+      }
+      if (procs[i].fd != -1)
+        pfds[i].fd = procs[i].fd;
+      else if (reap(&procs[i], &results[i], WNOHANG) != 0)
+      {
+        profile_stop(PHASE_WAIT, start);
+        return i;
+      }
+    }
+    if (!running)
+    {
+      profile_stop(PHASE_WAIT, start);
+      return -1;
+    }
+
+    // The children that closed their output are polled through their pidfd until they exit
+    int timeout = poll_timeout(procs, count, 1);
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (procs[i].pid > 0 && procs[i].fd == -1)
+        pfds[i].fd = exit_fd(&procs[i], &timeout);
+    }
+    if (poll(pfds, count, timeout) == -1)
+      continue;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (pfds[i].revents == 0 || procs[i].fd == -1 || pfds[i].fd != procs[i].fd)
+        continue;
+      if (read_chunk(procs[i].fd, &results[i]) <= 0)
+      {
+        close(procs[i].fd);
+        procs[i].fd = -1;
+      }
+    }
+  }
+}
+
+/**
+ * Runs the extractor on an archive and collects its output and resource usage.
+ * Unlike popen() no shell is involved and the child is reaped with wait4(),
+ * so the exit status, the max RSS and the page faults of the child are available.
+ *
+ * @param[in] extractor path of the extractor to run, absolute if a working directory is given
+ * @param[in] archive path of the archive given to the extractor, absolute if a working directory is given
+ * @param[in] options the executor options, can be NULL
+ * @param[out] result the status, resource usage and beginning of the output of the child
+ * @return 0 on success, -1 if the child could not be started or reaped
+**/
+int exec_target(const char *extractor, const char *archive, const exec_options *options, exec_result *result)
+{
+  // The sandbox has its own way of starting the child, its whole run counts as waiting
+  if (options && options->sandbox)
+  {
+    uint64_t start = profile_start();
+    int rv = sandbox_exec(options->sandbox, extractor, archive, options, result);
+    profile_stop(PHASE_WAIT, start);
+    return rv;
+  }
+
+  exec_proc proc;
+  if (exec_spawn(extractor, archive, options, &proc) == -1)
+    return -1;
+
+  return exec_wait_all(&proc, result, 1);
+}
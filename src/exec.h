@@ -0,0 +1,55 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define OUTPUT_LEN 4096 // number of bytes of the extractor output kept for classification
+#define EXEC_PIDFD_OPEN 434 // pidfd_open(), from Linux 5.3, missing from older headers
+#define EXEC_REAP_POLL 1    // milliseconds between two checks of a child that closed its output, without a pidfd
+
+struct sandbox;
+struct cpu_slot;
+
+// Function called in a child of the launcher, with a descriptor sent by the fuzzer
+typedef void (*launch_fn)(int fd);
+
+typedef struct
+{
+    size_t mem_limit;   // RLIMIT_AS applied to the child in bytes, 0 for no limit
+    const char *workdir; // directory the child runs in, NULL to stay in the current directory
+    struct sandbox *sandbox; // run the child in the namespaces of this sandbox, NULL to run it directly
+    double timeout;     // the child is killed after this number of seconds, 0 for no limit (not in the sandbox)
+    const struct cpu_slot *cpus; // CPUs the child is pinned to, NULL to keep the ones of the fuzzer
+} exec_options;
+
+typedef struct
+{
+    int status;                 // wait status of the child as returned by wait4()
+    struct rusage usage;        // resource usage of the child (ru_maxrss, page faults...)
+    char output[OUTPUT_LEN];    // beginning of stdout and stderr of the child, null terminated
+    size_t output_len;          // number of bytes stored in output
+    int timed_out;              // the child was killed because it ran out of time
+} exec_result;
+
+typedef struct
+{
+    pid_t pid;  // pid of the child, -1 once reaped by exec_wait_any()
+    int fd;     // read end of the output of the child
+    int pidfd;  // pidfd of the child, opened when it closed its output but is still running, -1 otherwise
+    double deadline; // time at which the child is killed, 0 for never
+} exec_proc;
+
+int exec_launcher_start(void);
+void exec_launcher_stop(void);
+pid_t exec_launch_call(launch_fn call, int fd);
+double now_seconds(void);
+void exec_read_output(int fd, exec_result *result, double deadline);
+int exec_spawn(const char *extractor, const char *archive, const exec_options *options, exec_proc *proc);
+void exec_result_reset(exec_result *result);
+int exec_wait_all(exec_proc procs[], exec_result results[], unsigned count);
+int exec_wait_any(exec_proc procs[], exec_result results[], unsigned count);
+int exec_target(const char *extractor, const char *archive, const exec_options *options, exec_result *result);
+
+#endif
@@ -1,840 +1,2092 @@
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include "fuzzer.h"
-#include "tar.h"
-
-static tar_t header;
-static const char WEIRD_CHARS[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 127, 128, 130, 200, 255}; // pensar se colocamos mais
-
-static const unsigned POSSIBLE_MODES[] = {
-    TSUID,
-    TSGID,
-    TSVTX,
-    TUREAD,
-    TUWRITE,
-    TUEXEC,
-    TGREAD,
-    TGWRITE,
-    TGEXEC,
-    TOREAD,
-    TOWRITE,
-    TOEXEC
-};
-
-static const unsigned TYPE_FLAG_VALUES[] = {
-    REGTYPE,        
-    AREGTYPE,         
-    LNKTYPE,            
-    SYMTYPE,            
-    CHRTYPE,            
-    BLKTYPE,  
-    DIRTYPE,  
-    FIFOTYPE, 
-    CONTTYPE,
-    XHDTYPE, 
-    XGLTYPE, 
-};
-
-
-/**
-  * This function tests the extractor with the file TEST_FILE and records some stats.
-  * 
-  * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
-  * @param[out] int The function returns an integer indicating the outcome of the test.
-  *             Returns 0: If the extractor ran without any errors, but the output did not contain the crash message.
-  *             Returns 1: If the extractor ran without any errors and the output contained the crash message.
-  *             Returns -1: If there was an error running the extractor or if the command to close the file pipe failed.
-  * 
-*/
-int test_file_extractor(Fuzzer* fuzzer)
-{
-  // Return value
-  int rv = 0; 
-  // Command buffer
-  char cmd[250]; 
-  
-  // Create command to execute the extractor with the TEST_FILE as input
-  sprintf(cmd, "%s %s 2>&1", fuzzer->extractor_file, TEST_FILE);
-
-  char buf[LEN_CRASH_MSG];
-  FILE *fp;
-
-  // Open a pipe to execute the extractor command
-  if ((fp = popen(cmd, "r")) == NULL)
-  {
-    printf("Error opening pipe!");
-    return -1;
-  }
-
-  // Read the output of the extractor command
-  if (fgets(buf, LEN_CRASH_MSG, fp) == NULL)
-    fuzzer->no_out_number++;  // No output from extractor
-  else if (strncmp(buf, CRASH_MSG, LEN_CRASH_MSG) != 0)
-    fuzzer->errors_number++;  // Extractor returned an error message
-  else
-  {
-    // Extractor identified a crash
-    rv = 1;
-    fuzzer->crashes_number++;
-
-    // Rename the input file with a new name indicating the test and crash number
-    char new_name[100];
-    sprintf(new_name, "success_%03u_%s.tar", fuzzer->crashes_number, fuzzer->current_test);
-    printf(KGRN "Crash message n°%u " KNRM "-> %s \n", fuzzer->crashes_number, fuzzer->current_test);
-    rename(TEST_FILE, new_name);
-  }
-  
-  // Close the pipe and check if there was an error
-  if (pclose(fp) == -1)
-  {
-    printf("Command not found");
-    rv = -1;
-  }
-  
-  // Return the outcome of the test
-  return rv;
-}
-
-/** 
- * This function tests the header of an empty tar archive by creating an empty tar file 
- *  with the given header and passing it to the extractor. 
- * 
-* @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
-**/
-void test_header(Fuzzer *fuzzer)
-{
-  write_empty_tar(TEST_FILE, &header); // Create an empty tar file with the given header // Podemos sq meter o TEST_FILE na struct
-  test_file_extractor(fuzzer); // Pass the file to the extractor for testing
-}
-
-/** 
-  * This function sets the current test name being run in the Fuzzer struct. 
-  * 
-  * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
-  * @param[in] name the test name (a string) 
-  * @param[in] field_name the field name (also a string).
-  **/
-void set_name(Fuzzer* fuzzer, const char *name, const char *field_name)
-{
-  // Use sprintf to format the current test name and save it in the Fuzzer struct
-  sprintf(fuzzer->current_test, "%s_%s", field_name, name);
-}
-
-/**
- * This function applies a set of tests to the field, such as testing for an empty field, 
- * a non-numeric field, a field with all the same character, and so on. Each test is 
- * performed by setting the field buffer to a specific value and then calling a test_header function, 
- * which generates an informative test name and runs the test using the Fuzzer objectm and 
- * then checking how the program behaves in response.
- * 
- * Note that this function does not return anything; it is only responsible for performing tests
- * on the field and logging the results.
- * 
- * By calling this function with different field names and sizes, you can quickly generate a wide 
- * variety of tests for different fields in your codebase.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * @param[in] field_name: A null-terminated string representing the name of the field being tested. This is used for generating informative test names.
- * @param[in] field: A pointer to the buffer containing the field being tested.
- * @param[in] size: The size of the field buffer.
- * 
-**/
-void generic_field_tests(Fuzzer* fuzzer, const char *field_name, char *field, unsigned size)
-{
-  // Test case: empty field
-  set_name(fuzzer, "empty", field_name);
-  strncpy(field, "", size);
-  test_header(fuzzer);
-
-  // Test case: non-numeric field
-  set_name(fuzzer, "not_numeric", field_name);
-  strncpy(field, "hello", size);
-  test_header(fuzzer);
-
-  // Test case: field filled with the maximum digit '7'
-  set_name(fuzzer, "big", field_name);
-  memset(field, '7', size - 1);
-  field[size - 1] = 0;
-  test_header(fuzzer);
-
-  // Test case: field filled with non-octal digit '9'
-  set_name(fuzzer, "not_octal", field_name);
-  memset(field, '9', size - 1);
-  field[size - 1] = 0;
-  test_header(fuzzer);
-
-  // Test case: field not terminated with a null character
-  set_name(fuzzer, "not_terminated", field_name);
-  memset(field, '4', size);
-  test_header(fuzzer);
-
-  // Test case: field with a null character in the middle, but not at the end
-  set_name(fuzzer, "middle_null_termination", field_name);
-  memset(field, 0, size);
-  memset(field, '2', size / 2);
-  test_header(fuzzer);
-
-  // Test case: field with a null character in the middle and at the end
-  set_name(fuzzer, "0 and_middle_null_termination", field_name);
-  memset(field, 0, size);
-  memset(field, '0', size / 2);
-  test_header(fuzzer);
-
-  // Test case: field containing non-ASCII character
-  set_name(fuzzer, "not_ascii", field_name);
-  strncpy(field, "😂", size);
-  test_header(fuzzer);
-
-  // Test case: field filled with '0' character
-  set_name(fuzzer, "all_0", field_name);
-  memset(field, '0', size - 1);
-  field[size - 1] = 0;
-  test_header(fuzzer);
-
-  // Test case: field with all null characters except for the last one, which is '0'
-  set_name(fuzzer, "all_null_but_end_0", field_name);
-  memset(field, 0, size - 1);
-  field[size - 1] = '0';
-  test_header(fuzzer);
-}
-
-/**
-  * This function tests the "name" and "linkname" fields of the tar header by calling
-  * various tests on them, including empty values, weird characters, forbidden characters,
-  * non-null terminated strings, strings of zeros, non-ASCII characters (emojis), and directories.
-  * 
-  *@param[in]linkname: A boolean indicating whether to test the "linkname" or "name" field.
-  *@param[in]fuzzer: A pointer to the Fuzzer struct containing the test case and options.
-  * 
-**/
-void test_names(int linkname, Fuzzer *fuzzer) //Aqui verificar se não dá para otimizar, escrever em menos linhas
-{
-      // Set the tar header with default values
-      set_header(&header);
-
-      // Get the appropriate field to test (linkname or name)
-      char *field = header.linkname;
-      char field_name[] = "linkname";
-      unsigned size = LINKNAME_LEN;
-
-      if (!linkname)
-      {
-        field = header.name;
-        sprintf(field_name, "name");
-        size = NAME_LEN;
-      }
-      else
-      {
-        // Test the linkname with the same value as the name
-        set_name(fuzzer, "same_as_name", field_name);
-        strncpy(field, header.name, size);
-        test_header(fuzzer);
-      }
-
-      // Test an empty field
-      set_name(fuzzer, "empty", field_name);
-      strncpy(field, "", size);
-      test_header(fuzzer);
-
-      // Test the field with weird characters
-      strncpy(field, "0" EXT, size);
-      for (unsigned i = 0; i < sizeof(WEIRD_CHARS); i++)
-      {
-        field[0] = WEIRD_CHARS[i];
-        sprintf(fuzzer->current_test, "%s_weird_char='%c'", field_name, field[0]);
-        test_header(fuzzer);
-      }
-
-      // Test the field with forbidden characters
-      char forbidden_char[] = {'*', '\\', '/', '"', '?', ' '};
-      for (unsigned i = 0; i < sizeof(forbidden_char); i++)
-      {
-        field[0] = forbidden_char[i];
-        sprintf(fuzzer->current_test, "%s_weird_char='%c'", field_name, field[0]);
-        test_header(fuzzer);
-      }
-
-      // Test the field with a string that's not null-terminated
-      set_name(fuzzer, "not_terminated", field_name);
-      memset(field, 'a', size);
-      test_header(fuzzer);
-
-      // Test the field with a string of zeros
-      set_name(fuzzer, "fill_all", field_name);
-      sprintf(field, "%0*d" EXT, (int)(size - strlen(EXT) - 1), 0);
-      test_header(fuzzer);
-
-      // Test the field with non-ASCII characters (in this case, emojis)
-      set_name(fuzzer, "non_ascii", field_name);
-      strncpy(field, "😂 😎" EXT, size);
-      test_header(fuzzer);
-
-      // Test the field as a directory
-      set_name(fuzzer, "directory", field_name);
-      strncpy(field, "tests" EXT "/", size);
-      test_header(fuzzer);
-}
-
-/**
- * This function tests the "mode" field of the header by calling
- * the generic_field_tests function with the appropriate arguments, 
- * then test all possible values of the mode field.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- **/
-void test_mode(Fuzzer *fuzzer)
-{
-  // Initialize the header and the field for the mode
-  set_header(&header);
-  char *field = header.mode;
-
-  // Run generic tests on the mode field
-  generic_field_tests(fuzzer, "mode", field, MODE_LEN);
-
-  // Test all possible values of the mode field
-  for (unsigned i = 0; i < sizeof(POSSIBLE_MODES) / sizeof(POSSIBLE_MODES[0]); i++)
-  {
-    // Initialize the header and format the current mode value into the field
-    set_header(&header);
-    sprintf(field, "%07o", POSSIBLE_MODES[i]);
-
-    // Set the current test name to reflect the current mode value
-    sprintf(fuzzer->current_test, "mode='%s'", field);
-
-    // Run the header test with the current mode value
-    test_header(fuzzer);
-  }
-}
-
-/**
- * This function tests the "uid" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- **/
-void test_uid(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the uid
-  set_header(&header);
-  char *field = header.uid;
-
-  // Run generic tests on the uid field
-  generic_field_tests(fuzzer, "uid", field, UID_LEN);
-}
-
-/**
- * This function tests the "gid" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- **/
-void test_gid(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the gid
-  set_header(&header);
-  char *field = header.gid;
-
-  // Run generic tests on the gid field
-  generic_field_tests(fuzzer, "gid", field, GID_LEN);
-}
-
-/**
- * 
- * This function tests the "size" field of the header by calling
- * the generic_field_tests function with the appropriate arguments, and then
- * runs a series of tests on various edge cases for the field.
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
-**/
-void test_size(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the size
-  set_header(&header);
-  char *field = header.size;
-
-  // Run generic tests on the size field
-  generic_field_tests(fuzzer, "size", field, SIZE_LEN);
-
-  // Test various edge cases for the size field
-  // First, test a file with a size of 0 bytes
-  char buffer[] = "hello";
-  unsigned long len_buffer = strlen(buffer);
-  set_name(fuzzer, "0", "size");
-  set_size_header(&header, 0);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-
-  // Next, test a file with a size smaller than the actual size of the data
-  set_name(fuzzer, "too_small", "size");
-  set_size_header(&header, 2);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-
-  // Then, test a file with a size larger than the actual size of the data
-  set_name(fuzzer, "too_big", "size");
-  set_size_header(&header, 20);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-
-  // Test a file with a size that exceeds the maximum allowed value
-  set_name(fuzzer, "far_too_big", "size");
-  set_size_header(&header, END_LEN * 2);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-
-  // Test a file with a size that exceeds the maximum allowed value and has a long filename
-  set_name(fuzzer, "far_far_too_big", "size");
-  set_size_header(&header, END_LEN * 2);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-
-  // Test a file with a negative size
-  set_name(fuzzer, "negative", "size");
-  sprintf(field, "%011o", -2);
-  write_tar(TEST_FILE, &header, buffer, len_buffer);
-  test_file_extractor(fuzzer);
-}
-
-/**
- * This function tests the "mtime" field of the header by calling
- * the generic_field_tests function with the appropriate arguments, 
- * and then tests it with several specific values.
- * 
- *@param[in]fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- **/
-void test_mtime(Fuzzer* fuzzer)
-{
-  // Set the tar header with default values
-  set_header(&header);
-
-  // Get the appropriate field to test (mtime)
-  char *field = header.mtime;
-  char field_name[] = "mtime";
-
-  // Call the generic_field_tests function to test the field with default values
-  generic_field_tests(fuzzer, field_name, field, MTIME_LEN);
-
-  // Test the field with the current time
-  set_name(fuzzer, "current", field_name);
-  sprintf(field, "%lo", (unsigned long)time(NULL));
-  test_header(fuzzer);
-
-  // Test the field with a time 50 hours in the future
-  set_name(fuzzer, "later", field_name);
-  sprintf(field, "%lo", (unsigned long)time(NULL) + 50 * 3600);
-  test_header(fuzzer);
-
-  // Test the field with a time 50 hours in the past
-  set_name(fuzzer, "sooner", field_name);
-  sprintf(field, "%lo", (unsigned long)time(NULL) - 50 * 3600);
-  test_header(fuzzer);
-
-  // Test the field with a time far in the future
-  set_name(fuzzer, "far_future", field_name);
-  sprintf(field, "%lo", (unsigned long)time(NULL) * 2);
-  test_header(fuzzer);
-}
-
-/**
- * This function tests the "chksum" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- **/
-void test_chksum(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the chksum
-  set_header(&header);
-  char *field = header.chksum;
-
-  // Run generic tests on the gid field
-  generic_field_tests(fuzzer, "chksum", field, CHKSUM_LEN);
-}
-
-/**
-  * This function tests the `typeflag` field of the header struct
-  * by assigning it all possible values (0x00 to 0xFF) and testing the resulting header with each value.
-  * 
-  *@param[in]fuzzer a pointer to a Fuzzer object to be used for testing.
-  **/
-void test_typeflag(Fuzzer* fuzzer)
-{
-  // Initialize header struct to initial values
-  set_header(&header);
-
-  // Name of the field being tested
-  char field_name[] = "typeflag";
-
-  // String to hold the current test name
-  char name_current_test[30];
-
-  // Loop through each possible value for the typeflag field
-  for (unsigned i = 0; i < sizeof(TYPE_FLAG_VALUES)/sizeof(TYPE_FLAG_VALUES[0]); i++)
-  {
-      // Set the name of the current test to indicate the value of typeflag
-      sprintf(name_current_test, "value=%c", TYPE_FLAG_VALUES[i]);
-
-      // Set the typeflag field of the header struct to the current value of i
-      header.typeflag = TYPE_FLAG_VALUES[i];
-
-      // Set the name of the current test case to the value of typeflag
-      set_name(fuzzer, name_current_test, field_name);
-
-      // Test the header with the updated typeflag value
-      test_header(fuzzer);
-  }
-
- /* 
- // Iterate over all possible values of `typeflag`
-  for (unsigned i = 0; i < 0x100; i++)
-  {
-    // Set the name of the current test to indicate the value of `typeflag`
-    sprintf(name_current_test, "value=0x%02x", i);
-
-    // Set the `typeflag` field of the header struct to the current value of `i`
-    header.typeflag = (char)i;
-
-    // Set the name of the current test case to the value of `typeflag`
-    set_name(fuzzer, name_current_test, field_name);
-
-    // Test the header with the updated `typeflag` value
-    test_header(fuzzer);
-  }
-  */
-
-//generic_field_tests(fuzzer, "mode", field, MODE_LEN);
-}
-
-/**
- * This function tests the "linkname" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- **/
-void test_linkname(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the linkname
-  set_header(&header);
-  char *field = header.linkname;
-
-  // Run generic tests on the linkname field
-  generic_field_tests(fuzzer, "linkname", field, LINKNAME_LEN);
-
-  // Test the linkname field for valid names
-  // This function tests the linkname for invalid characters and empty names
-  test_names(1, fuzzer);
-}
-
-/**
- * This function tests the "magic" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- **/
-void test_magic(Fuzzer* fuzzer)
-{
-  // Initialize the header and the field for the magic field
-  set_header(&header);
-  char *field = header.magic;
-
-  // Run generic tests on the magic field
-  generic_field_tests(fuzzer, "magic", field, MAGIC_LEN);
-}
-
-/**
- * This function tests the "version" field of the header by calling
- * the generic_field_tests function with the appropriate arguments, 
- * then test all possible values for the digits of the version field.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- **/
-void test_version(Fuzzer* fuzzer)
-{
-  // Set up the header and field for the version test
-  set_header(&header);
-  char *field = header.version;
-  
-  // Run generic tests on the version field
-  generic_field_tests(fuzzer, "version", field, VERSION_LEN);
-
-  // Loop over all possible values for the version field (64 total)
-  for (unsigned i = 0; i < 64; i++)
-  {
-    // Set the version field to the current value of i
-    field[1] = i % 8 + '0';  // octal digit represented by the lower 3 bits
-    field[0] = i / 8 + '0';  // octal digit represented by the upper 3 bits
-    
-    // Format the current test case name using the current value of the version field
-    sprintf(fuzzer->current_test, "version=\'%c%c\'", field[0], field[1]);
-    
-    // Run the header test with the current version field value
-    test_header(fuzzer);
-  }
-}
-
-/**
- * This function tests the "uname/gname" field of the header by calling
- * the generic_field_tests function with the appropriate arguments.
- * @param[in] gname  If is set to 0, the function tests the uname field.
- *                   If is set to 1, the function tests the gname field.
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- **/
-void test_uname(Fuzzer* fuzzer, int gname)
-{
-  char *field = header.uname;  // Set the field pointer to the uname field
-  char field_name[] = "uname";  // Set the field name to "uname" by default
-  unsigned size = UNAME_LEN;  // Set the field size to the length of the uname field
-
-  if (!gname)  // If gname is 0, test the uname field
-  {
-    field = header.gname;  // Set the field pointer to the gname field
-    sprintf(field_name, "gname");  // Change the field name to "gname"
-    size = GNAME_LEN;  // Set the field size to the length of the gname field
-  }
-  
-  set_header(&header);  // Initialize the header
-  generic_field_tests(fuzzer, field_name, field, size);  // Run generic tests on the field
-}
-
-/**
- * This function tests the behavior of the tar archive end-of-file (EOF) bytes.
- * It sets up a tar header and writes it to a test file along with a buffer of
- * data. Then it writes the specified number of EOF bytes to the end of the
- * file and tests the extractor's behavior with and without a file.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
- * 
- */
-void test_end_bytes(Fuzzer* fuzzer)
-{
-  char end_bytes[END_LEN * 2]; // buffer to hold the end-of-file bytes
-  memset(end_bytes, 0, END_LEN * 2); // initialize buffer to all zeroes
-
-  char buffer[] = "hello"; // data buffer to write to the test file
-  size_t len_buffer = strlen(buffer); // length of data buffer
-
-  set_header(&header); // initialize tar header
-  set_size_header(&header, strlen(buffer)); // set the size of the data in the header
-
-  int lengths[] = {END_LEN * 2, END_LEN, 512, 1, 0}; // array of different EOF byte lengths to test
-
-  // iterate through the different EOF byte lengths to test
-  for (unsigned i = 0; i < sizeof(lengths) / sizeof(int); i++)
-  {
-    // test with a file containing data
-    sprintf(fuzzer->current_test, "end_bytes(%d)_with_file", lengths[i]);
-    write_tar_fields(TEST_FILE, &header, buffer, len_buffer, end_bytes, lengths[i]);
-    test_file_extractor(fuzzer);
-
-    // test without a file (empty file)
-    sprintf(fuzzer->current_test, "end_bytes(%d)_w-o_file", lengths[i]);
-    write_tar_fields(TEST_FILE, &header, "", 0, end_bytes, lengths[i]);
-    test_file_extractor(fuzzer);
-  }
-}
-
-/**
- * This function generates various tar archive files with different types of entries, 
- * including regular files, directories, and an empty archive. It also creates a 
- * large file entry to test the handling of large files. After creating each archive, 
- * the function tests the file extractor with the generated archive to ensure 
- * that the extraction is successful.
- * 
- * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options. 
- * 
-**/
-void test_files(Fuzzer* fuzzer)
-{
-  const size_t N = 50;
-  tar_entry files[N]; // declare an array of 50 tar_entry structs
-  tar_entry *entries = &files[0]; // create a pointer to the first element of the array
-
-  // initialize each element of the array
-  for (size_t i = 0; i < N; i++)
-  {
-    set_header(&files[i].header); // set the header of the i-th file
-    files[i].content = NULL; // initialize the content of the i-th file to NULL
-    files[i].size = 0; // set the size of the i-th file to zero
-  }
-
-  // Create and write N files to the tar archive
-  sprintf(fuzzer->current_test, "%lu_files", N); // set the current test name
-
-  for (size_t i = 0; i < N; i++)
-  {
-    sprintf(files[i].header.name, "this_is_the_file_number_%lu" EXT, i); // set the name of the i-th file
-    files[i].content = malloc(30); // allocate memory for the content of the i-th file
-    sprintf(files[i].content, "file number %lu", i); // set the content to a string with the i-th file number
-    files[i].size = strlen(files[i].content); // set the size of the i-th file
-  }
-
-  write_tar_entries(TEST_FILE, files, N); // write the tar archive to disk
-  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
-
-  // create a tar archive with 5 files having the same name
-  set_name(fuzzer, "same_name", "files"); // set the name of the current test
-  for (unsigned i = 0; i < 5; i++)
-  {
-    strncpy(files[i].header.name, "same_name" EXT, NAME_LEN); // set the name of the i-th file
-    files[i].content = malloc(50); // allocate memory for the content of the i-th file
-    sprintf(files[i].content, "file number %d", i); // set the content of the i-th file
-    files[i].size = strlen(files[i].content); // set the size of the i-th file
-  }
-  write_tar_entries(TEST_FILE, files, 5); // write the tar archive to disk
-  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
-
-  // create a tar archive with a directory-like file
-  set_name(fuzzer, "dir_with_data", "files"); // set the name of the current test
-
-  strncpy(entries->header.name, "test" EXT "/", NAME_LEN); // set the name of the directory-like file
-  entries->content = malloc(50); // allocate memory for the content of the directory-like file
-  entries->size = sprintf(entries->content, "content of the directory like if it was a file"); // set the content and size of the directory-like file
-  
-  write_tar_entries(TEST_FILE, files, 1); // write the tar archive to disk
-  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
-
-  // create an empty tar archive and test it
-  FILE *f = fopen(TEST_FILE, "wb"); // create an empty file
-  if (f)
-  {
-    fclose(f); // close the file
-    set_name(fuzzer, "empty_tar", "files"); // set the name of the current test
-    test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
-  }
-  
-  // Create and write a large file to the tar archive
-  set_name(fuzzer, "big_file", "files");
-  set_header(&entries->header); // Set the header of the entry to default values
-
-  size_t big = 50 * 1000 * 1000; // Size of the large file in bytes
-
-  entries->content = malloc(big); // Allocate memory for the content of the tar entry entries to store the large file.
-  memset(entries->content, 'A', big); // Fill the allocated memory with the character 'A'. This is done to ensure that the file content is completely written to the allocated memory.
-  entries->size = big; // Set the size of the tar entry to the size of the large file in bytes.
-  
-  write_tar_entries(TEST_FILE, files, 1); // Write the tar entry entries containing the large file to the tar archive file TEST_FILE
-  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
-}
-
-/** 
- * init the path-planning struct
- * 
- * @param[out] fuzzer fuzzer main structure
- **/
-Fuzzer* init_fuzzer(){
-
-  Fuzzer *fuzzer;
-
-  fuzzer = (Fuzzer*) malloc(sizeof(Fuzzer));
-    
-    if (fuzzer == NULL)
-    {
-		printf("Struct not allocated \n");
-		exit(0);
-	  }
-
-    fuzzer->crashes_number = 0;
-    fuzzer->errors_number = 0;
-    fuzzer->no_out_number = 0;
-
-    
-    fuzzer->extractor_file = malloc(sizeof(char) * NAME_LEN); // allocate memory for the filename
-    if (fuzzer->extractor_file == NULL)
-    {
-		printf("Array not allocated \n");
-		exit(0);
-	  }
-    memset(fuzzer->extractor_file, 0, NAME_LEN); // initialize the memory to zero
-
-    fuzzer->current_test = malloc(sizeof(char) * NAME_LEN/2); // allocate memory for the filename
-    if (fuzzer->current_test == NULL)
-    {
-		printf("Array not allocated \n");
-		exit(0);
-	  }
-    memset(fuzzer->current_test, 0, NAME_LEN/2); // initialize the memory to zero
-  
-    return fuzzer;
-}
-
-/**
- * close the fuzzer struct (memory released)
- *
- * \param[in] fuzzer fuzzer main structure
-**/
-void free_fuzzer(Fuzzer *fuzzer)
-{
-  free(fuzzer->extractor_file);
-  free(fuzzer->current_test);
-  free(fuzzer);
-}
-
-/**
- * This function implements the main fuzzing process for evaluating an extractor.
- * It performs a series of tests on the various fields of a tar header using a fuzzer.
- * The tests include setting names, testing the mode, user ID, group ID, size, modification time,
- * checksum, type flag, link name, magic number, version, and user/group names.
- * Additionally, it tests the end-of-archive and file contents fields.
- * After running the tests, it cleans up any extractor results and outprintf the number of tests passed,
- * along with the number of errors and crashes detected by the fuzzer.
- * 
- * @param[in] extractor a pointer to the file path of the extractor being tested
- * 
-**/
-void fuzz(const char *extractor)
-{
-  // Initialize a fuzzer struct to keep track of tests and errors.
-  Fuzzer *fuzzer;
-  fuzzer = init_fuzzer();
-
-  // Copy the filename of the extractor file into the fuzzer struct.
-  strcpy(fuzzer->extractor_file, extractor);
-
-  // Print a message to indicate the beginning of the fuzzing process.
-  printf("Begin fuzzing...");
-
-  // Start the clock to measure the duration of the fuzzing process.
-  clock_t start = clock();
-
-  // Run a series of tests on different fields in the header.
-  test_names(0, fuzzer);
-  test_mode(fuzzer);
-  test_uid(fuzzer);
-  test_gid(fuzzer);
-  test_size(fuzzer);
-  test_mtime(fuzzer);
-  test_chksum(fuzzer);
-  test_typeflag(fuzzer);
-  test_linkname(fuzzer);
-  test_magic(fuzzer);
-  test_version(fuzzer);
-  test_uname(fuzzer, 0);
-  test_uname(fuzzer, 1);
-  test_end_bytes(fuzzer);
-  test_files(fuzzer);
-
-  // Measure the total duration of the fuzzing process.
-  clock_t duration = clock() - start;
-
-  // Print a message to indicate that the extractor results are being cleaned up.
-  printf("Cleaning extractor results...");
-
-  // Remove any generated files by the extractor and the test file used during the fuzzing process.
-  system("rm -rf *" EXT" "TEST_FILE);
-
-  // Print a summary of the results of the fuzzing process.
-  printf("\n%u tests passed in %.3f s:\n", fuzzer->errors_number + fuzzer->no_out_number + fuzzer->crashes_number, (float)duration / CLOCKS_PER_SEC);
-  printf(KYEL "%u without output" KNRM "\n", fuzzer->no_out_number);
-  printf(KRED "%u errors" KNRM " catched by the extractor\n", fuzzer->errors_number);
-  printf(KGRN "%u crashes" KNRM " detected by the fuzzer\n", fuzzer->crashes_number);
-
-  // Free up memory used by the fuzzer struct.
-  free_fuzzer(fuzzer);
-}
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "fuzzer.h"
+#include "tar.h"
+#include "checksum.h"
+#include "numeric.h"
+#include "reader.h"
+#include "store.h"
+#include "exec.h"
+#include "mutate.h"
+#include "sched.h"
+#include "structure.h"
+#include "cpu.h"
+
+static tar_t header;
+static const char WEIRD_CHARS[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 127, 128, 130, 200, 255}; // pensar se colocamos mais
+
+static const unsigned POSSIBLE_MODES[] = {
+    TSUID,
+    TSGID,
+    TSVTX,
+    TUREAD,
+    TUWRITE,
+    TUEXEC,
+    TGREAD,
+    TGWRITE,
+    TGEXEC,
+    TOREAD,
+    TOWRITE,
+    TOEXEC
+};
+
+static const unsigned TYPE_FLAG_VALUES[] = {
+    REGTYPE,        
+    AREGTYPE,         
+    LNKTYPE,            
+    SYMTYPE,            
+    CHRTYPE,            
+    BLKTYPE,  
+    DIRTYPE,  
+    FIFOTYPE, 
+    CONTTYPE,
+    XHDTYPE, 
+    XGLTYPE, 
+};
+
+
+/**
+ * Keeps TEST_FILE in the store of the fuzzer, unless the same input was already kept for the same reason.
+ * The crashes are also shared with the other instances, unless one of them already found their bucket.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] kind why the input is kept
+ * @param[in] result the result of the run of the extractor, giving the bucket of the input
+**/
+static void save_input(Fuzzer *fuzzer, store_kind kind, const exec_result *result)
+{
+  tar_reader reader;
+  if (tar_open(&reader, TEST_FILE) == -1)
+    return;
+  uint64_t bucket = novelty_bucket(result->output, result->status);
+  store_add(&fuzzer->saved, reader.data, reader.size, kind, bucket, fuzzer->current_test);
+  if (fuzzer->sync && kind == STORE_CRASH && !sync_known_crash(fuzzer->sync, bucket))
+    sync_add(fuzzer->sync, SYNC_CRASH, hash_bytes(reader.data, reader.size), bucket, reader.data, reader.size);
+  tar_close(&reader);
+}
+
+/**
+ * Classifies the response of the extractor in the novelty mode. When the response contains
+ * a new behaviour class or a new combination of classes, TEST_FILE is added to the corpus.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] result the result of the last run of the extractor
+**/
+static void track_novelty(Fuzzer *fuzzer, const exec_result *result)
+{
+  if (fuzzer->novelty == NULL)
+    return;
+
+  int novelty = novelty_classify(fuzzer->novelty, result->output, result->status, result->usage.ru_maxrss);
+  fuzzer->last_novelty = novelty;
+  if (novelty == NOVELTY_NONE)
+    return;
+
+  if (novelty == NOVELTY_CLASS)
+    printf(KCYN "New behaviour class" KNRM " -> %s\n", fuzzer->current_test);
+
+  // The corpus keeps its own copy, taken from the mapping, and so do the other instances
+  tar_reader reader;
+  if (tar_open(&reader, TEST_FILE) == 0)
+  {
+    novelty_add_input(fuzzer->novelty, reader.data, reader.size, novelty == NOVELTY_CLASS ? NOVELTY_SCORE_CLASS : NOVELTY_SCORE_COMBO);
+    if (fuzzer->sync)
+      sync_add(fuzzer->sync, SYNC_INPUT, hash_bytes(reader.data, reader.size), 0, reader.data, reader.size);
+    tar_close(&reader);
+  }
+}
+
+/**
+ * Records the max RSS and the CPU time of the last run of the extractor. In memory mode, an input that sets
+ * a new high is kept as memhog_<n>_<test>.tar.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] result the result of the last run of the extractor
+**/
+static void track_memory(Fuzzer *fuzzer, const exec_result *result)
+{
+  fuzzer->last_rss = result->usage.ru_maxrss;
+  fuzzer->last_time = result->usage.ru_utime.tv_sec + result->usage.ru_stime.tv_sec +
+                      (result->usage.ru_utime.tv_usec + result->usage.ru_stime.tv_usec) / 1e6;
+  if (result->usage.ru_maxrss <= fuzzer->max_rss)
+    return;
+  fuzzer->max_rss = result->usage.ru_maxrss;
+
+  if (fuzzer->options.mode != MODE_MEMORY)
+    return;
+
+  fuzzer->memhog_number++;
+  save_input(fuzzer, STORE_MEMHOG, result);
+
+  printf(KMAG "New max RSS %ld KB" KNRM " -> %s", fuzzer->max_rss, fuzzer->current_test);
+  if (fuzzer->options.page_faults)
+    printf(" (%ld minor / %ld major page faults)", result->usage.ru_minflt, result->usage.ru_majflt);
+  printf("\n");
+}
+
+/**
+ * Tells whether a run of the extractor failed because of the memory limit.
+ * The output is first checked for an allocation failure message. Otherwise, if the extractor printed
+ * something or was killed under the limit, it is run again without it: the run is an over-allocation
+ * when the extractor succeeds silently without the limit, or when the crash does not happen without it.
+ * A response already run again and found to have nothing to do with the limit is not run again:
+ * most runs print one of a few error messages, which would double the executions otherwise.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] result the result of the run under the memory limit
+ * @param[in] crashed whether an oracle found a crash in the run
+ * @return 1 if the run is an over-allocation, 0 otherwise
+**/
+static int is_over_allocation(Fuzzer *fuzzer, const exec_result *result, int crashed)
+{
+  if (!fuzzer->options.mem_limit)
+    return 0;
+
+  if (strstr(result->output, "Cannot allocate memory") || strstr(result->output, "out of memory"))
+    return 1;
+
+  // A silent run did not hit the limit, and the child of a library cannot run without it
+  if ((result->output_len == 0 && !WIFSIGNALED(result->status)) || fuzzer->library)
+    return 0;
+
+  // The responses cleared are remembered by their bucket, a slot each, a collision only costs a run
+  uint64_t bucket = novelty_bucket(result->output, result->status);
+  uint64_t *checked = fuzzer->oom_checked ? &fuzzer->oom_checked[bucket % OOM_CHECKED] : NULL;
+  if (checked && *checked == bucket)
+    return 0;
+
+  // Run again without the limit to see if the outcome is caused by it
+  exec_options options = fuzzer->exec;
+  options.mem_limit = 0;
+  exec_result unlimited;
+  scratch_clean(&fuzzer->scratch);
+  if (exec_target(fuzzer->extractor_file, fuzzer->archive, &options, &unlimited) == -1)
+    return 0;
+
+  oracle_result verdict;
+  int over = 0;
+  if (WIFSIGNALED(unlimited.status))
+    over = 0;
+  else if (crashed)
+    over = oracle_judge(unlimited.output, unlimited.output_len, unlimited.status, &verdict) != VERDICT_CRASH;
+  else
+    over = unlimited.output_len == 0;
+  if (!over && checked)
+    *checked = bucket;
+  return over;
+}
+
+/**
+ * Runs the reference extractor and its peers on TEST_FILE. They all run at the same time,
+ * each in its own scratch directory, and read the same archive, which is generated once.
+ * In the sandbox they run one after the other through the zygote.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[out] results the result of the reference extractor, followed by the results of the peers
+ * @return 0 on success, -1 if an extractor could not be run
+**/
+static int run_targets(Fuzzer *fuzzer, exec_result results[])
+{
+  // The library is called in its child, without starting a process
+  if (fuzzer->library)
+    return harness_run(fuzzer->library, fuzzer->archive, &fuzzer->exec, &results[0]);
+
+  // The extractor is rewound to where it opens the archive, without starting a process
+  if (fuzzer->snapshot)
+    return snapshot_run(fuzzer->snapshot, &results[0]);
+
+  if (fuzzer->peers_count == 0 || fuzzer->exec.sandbox)
+  {
+    if (exec_target(fuzzer->extractor_file, fuzzer->archive, &fuzzer->exec, &results[0]) == -1)
+      return -1;
+    for (unsigned i = 0; i < fuzzer->peers_count; i++)
+    {
+      exec_options options = fuzzer->exec;
+      options.workdir = fuzzer->peers[i].scratch.path;
+      profile_use(&fuzzer->peers[i].profile);
+      int rv = exec_target(fuzzer->peers[i].path, fuzzer->archive, &options, &results[i + 1]);
+      profile_use(&fuzzer->profile);
+      if (rv == -1)
+        return -1;
+    }
+    return 0;
+  }
+
+  exec_proc procs[MAX_TARGETS];
+  unsigned count = 0;
+  if (exec_spawn(fuzzer->extractor_file, fuzzer->archive, &fuzzer->exec, &procs[count]) == 0)
+    count++;
+  for (unsigned i = 0; i < fuzzer->peers_count && count == i + 1; i++)
+  {
+    exec_options options = fuzzer->exec;
+    options.workdir = fuzzer->peers[i].scratch.path;
+    profile_use(&fuzzer->peers[i].profile);
+    if (exec_spawn(fuzzer->peers[i].path, fuzzer->archive, &options, &procs[count]) == 0)
+      count++;
+    profile_use(&fuzzer->profile);
+  }
+
+  // Reap what was started even if an extractor could not be
+  int rv = exec_wait_all(procs, results, count);
+  return count == fuzzer->peers_count + 1 ? rv : -1;
+}
+
+/**
+ * Compares the runs of the peers with the run of the reference extractor in differential mode.
+ * The extractors diverge when their verdicts differ, or when their first lines of output differ
+ * once the names and numbers are removed. A diverging input is kept in the store.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] results the result of the reference extractor, followed by the results of the peers
+**/
+static void compare_peers(Fuzzer *fuzzer, const exec_result results[])
+{
+  if (fuzzer->peers_count == 0)
+    return;
+
+  oracle_verdict verdicts[MAX_TARGETS];
+  uint64_t lines[MAX_TARGETS];
+  int diverged = 0;
+
+  for (unsigned i = 0; i <= fuzzer->peers_count; i++)
+  {
+    char text[NOVELTY_LINE_LEN];
+    const char *end = strchr(results[i].output, '\n');
+    size_t len = end ? (size_t)(end - results[i].output) : results[i].output_len;
+    normalize_line(results[i].output, len, text, sizeof(text));
+    lines[i] = hash_bytes(text, strlen(text));
+    oracle_result verdict;
+    verdicts[i] = oracle_judge(results[i].output, results[i].output_len, results[i].status, &verdict);
+
+    if (i > 0)
+    {
+      Peer *peer = &fuzzer->peers[i - 1];
+      peer->no_out_number += verdicts[i] == VERDICT_NO_OUTPUT;
+      peer->errors_number += verdicts[i] == VERDICT_ERROR;
+      peer->crashes_number += verdicts[i] == VERDICT_CRASH;
+      diverged |= verdicts[i] != verdicts[0] || lines[i] != lines[0];
+    }
+  }
+
+  if (!diverged)
+    return;
+
+  fuzzer->divergences_number++;
+  save_input(fuzzer, STORE_DIFF, &results[0]);
+
+  // The verdicts side by side
+  printf(KBLU "Divergence n°%d " KNRM "-> %s:", fuzzer->divergences_number, fuzzer->current_test);
+  printf(" %s=%s", fuzzer->label, oracle_verdict_name(verdicts[0]));
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+    printf(" %s=%s%s", fuzzer->peers[i].label, oracle_verdict_name(verdicts[i + 1]), verdicts[i + 1] == verdicts[0] ? "*" : "");
+  printf("\n");
+}
+
+/**
+ * Prints the verdicts of each extractor side by side in differential mode.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+**/
+static void report_peers(const Fuzzer *fuzzer)
+{
+  if (fuzzer->peers_count == 0)
+    return;
+
+  printf("%-40s %10s %10s %10s\n", "extractor", "no output", "errors", "crashes");
+  printf("%-40s %10d %10d %10d\n", fuzzer->label, fuzzer->no_out_number, fuzzer->errors_number, fuzzer->crashes_number);
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+  {
+    const Peer *peer = &fuzzer->peers[i];
+    printf("%-40s %10d %10d %10d\n", peer->label, peer->no_out_number, peer->errors_number, peer->crashes_number);
+  }
+  printf(KBLU "%d divergences" KNRM " kept in %s (* same verdict, different message)\n", fuzzer->divergences_number, fuzzer->options.store_file);
+}
+
+/**
+  * This function tests the extractor with the file TEST_FILE and records some stats.
+  * 
+  * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+  * @param[out] int The function returns an integer indicating the outcome of the test.
+  *             Returns 0: If the extractor ran and no oracle found a crash.
+  *             Returns 1: If the extractor ran and an oracle found a crash (message, sanitizer report or signal).
+  *             Returns 2: If the extractor went over the memory limit.
+  *             Returns -1: If there was an error running the extractor or if a stop condition was reached.
+  * 
+*/
+int test_file_extractor(Fuzzer* fuzzer)
+{
+  // Return value
+  int rv = 0; 
+  exec_result results[MAX_TARGETS];
+  exec_result *result = &results[0];
+
+  // The archive is written, the memory it was built in is released for the next test
+  arena_reset(&fuzzer->arena);
+
+  // Nothing is run anymore once a stop condition is reached
+  if (fuzzer->stop_reason)
+    return -1;
+
+  // Everything since the previous execution went into building the archive
+  profile_generated();
+
+  // Execute the extractors with the TEST_FILE as input, in their scratch directory
+  if (run_targets(fuzzer, results) == -1)
+  {
+    profile_executed();
+    return -1;
+  }
+  fuzzer->execs++;
+  uint64_t classify = profile_start();
+
+  // Keep track of the memory used by the reference extractor and of its behaviour
+  track_memory(fuzzer, result);
+  track_novelty(fuzzer, result);
+  compare_peers(fuzzer, results);
+
+  // The oracles decide whether the run is a crash, from the output and the wait status
+  oracle_result verdict;
+  int crashed = oracle_judge(result->output, result->output_len, result->status, &verdict) == VERDICT_CRASH;
+
+  if (is_over_allocation(fuzzer, result, crashed))
+  {
+    // Extractor went over the memory limit
+    rv = 2;
+    fuzzer->oom_number++;
+
+    printf(KMAG "Over-allocation n°%d " KNRM "-> %s \n", fuzzer->oom_number, fuzzer->current_test);
+    save_input(fuzzer, STORE_OOM, result);
+  }
+  else if (verdict.verdict == VERDICT_NO_OUTPUT)
+    fuzzer->no_out_number++;  // No output from extractor
+  else if (verdict.verdict == VERDICT_ERROR)
+    fuzzer->errors_number++;  // Extractor returned an error message
+  else
+  {
+    // An oracle identified a crash, the ones the extractor does not report itself are described
+    rv = 1;
+    fuzzer->crashes_number++;
+    for (unsigned i = 0; i < ORACLES_COUNT; i++)
+      fuzzer->oracle_crashes[i] += ORACLES[i].name == verdict.oracle;
+    char described[ORACLE_DETAIL_LEN + 8] = "";
+    if (verdict.oracle != ORACLES[0].name)
+      snprintf(described, sizeof(described), " [%s]", verdict.detail);
+    if (fuzzer->crashes_number == 1)
+    {
+      fuzzer->first_crash_time = now_seconds();
+      fuzzer->first_crash_execs = fuzzer->execs;
+    }
+
+    // Keep the input in the store, with the test that produced it, even when another instance already has this crash
+    if (fuzzer->sync && sync_known_crash(fuzzer->sync, novelty_bucket(result->output, result->status)))
+    {
+      fuzzer->sync->known_crashes++;
+      printf(KGRN "Crash message n°%d " KNRM "-> %s%s (already found)\n", fuzzer->crashes_number, fuzzer->current_test, described);
+    }
+    else
+      printf(KGRN "Crash message n°%d " KNRM "-> %s%s \n", fuzzer->crashes_number, fuzzer->current_test, described);
+    save_input(fuzzer, STORE_CRASH, result);
+  }
+
+  // Remove the files extracted by this execution, the sandbox drops them by itself
+  if (!fuzzer->exec.sandbox)
+  {
+    scratch_clean(&fuzzer->scratch);
+    for (unsigned i = 0; i < fuzzer->peers_count; i++)
+      scratch_clean(&fuzzer->peers[i].scratch);
+  }
+
+  // What the other instances found since the last exchange
+  if (fuzzer->sync)
+    sync_exchange(fuzzer->sync, fuzzer->novelty, 0);
+
+  sched_update_stop(fuzzer);
+  profile_stop(PHASE_CLASSIFY, classify);
+  profile_executed();
+  
+  // Return the outcome of the test
+  return rv;
+}
+
+/** 
+ * This function tests the header of an empty tar archive by creating an empty tar file 
+ *  with the given header and passing it to the extractor. 
+ * 
+* @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+**/
+void test_header(Fuzzer *fuzzer)
+{
+  // Once a stop condition is reached the archives are not even written
+  if (fuzzer->stop_reason)
+    return;
+  write_empty_tar(&fuzzer->archive_buffer, TEST_FILE, &header); // Create an empty tar file with the given header // Podemos sq meter o TEST_FILE na struct
+  test_file_extractor(fuzzer); // Pass the file to the extractor for testing
+}
+
+/** 
+  * This function sets the current test name being run in the Fuzzer struct. 
+  * 
+  * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+  * @param[in] name the test name (a string) 
+  * @param[in] field_name the field name (also a string).
+  **/
+void set_name(Fuzzer* fuzzer, const char *name, const char *field_name)
+{
+  // Use snprintf to format the current test name and save it in the Fuzzer struct, cut if too long
+  snprintf(fuzzer->current_test, TEST_NAME_LEN, "%s_%s", field_name, name);
+}
+
+/**
+ * This function applies a set of tests to the field, such as testing for an empty field, 
+ * a non-numeric field, a field with all the same character, and so on. Each test is 
+ * performed by setting the field buffer to a specific value and then calling a test_header function, 
+ * which generates an informative test name and runs the test using the Fuzzer objectm and 
+ * then checking how the program behaves in response.
+ * 
+ * Note that this function does not return anything; it is only responsible for performing tests
+ * on the field and logging the results.
+ * 
+ * By calling this function with different field names and sizes, you can quickly generate a wide 
+ * variety of tests for different fields in your codebase.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * @param[in] field_name: A null-terminated string representing the name of the field being tested. This is used for generating informative test names.
+ * @param[in] field: A pointer to the buffer containing the field being tested.
+ * @param[in] size: The size of the field buffer.
+ * 
+**/
+void generic_field_tests(Fuzzer* fuzzer, const char *field_name, char *field, unsigned size)
+{
+  // Test case: empty field
+  set_name(fuzzer, "empty", field_name);
+  strncpy(field, "", size);
+  test_header(fuzzer);
+
+  // Test case: non-numeric field
+  set_name(fuzzer, "not_numeric", field_name);
+  strncpy(field, "hello", size);
+  test_header(fuzzer);
+
+  // Test case: field filled with the maximum digit '7'
+  set_name(fuzzer, "big", field_name);
+  memset(field, '7', size - 1);
+  field[size - 1] = 0;
+  test_header(fuzzer);
+
+  // Test case: field filled with non-octal digit '9'
+  set_name(fuzzer, "not_octal", field_name);
+  memset(field, '9', size - 1);
+  field[size - 1] = 0;
+  test_header(fuzzer);
+
+  // Test case: field not terminated with a null character
+  set_name(fuzzer, "not_terminated", field_name);
+  memset(field, '4', size);
+  test_header(fuzzer);
+
+  // Test case: field with a null character in the middle, but not at the end
+  set_name(fuzzer, "middle_null_termination", field_name);
+  memset(field, 0, size);
+  memset(field, '2', size / 2);
+  test_header(fuzzer);
+
+  // Test case: field with a null character in the middle and at the end
+  set_name(fuzzer, "0 and_middle_null_termination", field_name);
+  memset(field, 0, size);
+  memset(field, '0', size / 2);
+  test_header(fuzzer);
+
+  // Test case: field containing non-ASCII character
+  set_name(fuzzer, "not_ascii", field_name);
+  strncpy(field, "😂", size);
+  test_header(fuzzer);
+
+  // Test case: field filled with '0' character
+  set_name(fuzzer, "all_0", field_name);
+  memset(field, '0', size - 1);
+  field[size - 1] = 0;
+  test_header(fuzzer);
+
+  // Test case: field with all null characters except for the last one, which is '0'
+  set_name(fuzzer, "all_null_but_end_0", field_name);
+  memset(field, 0, size - 1);
+  field[size - 1] = '0';
+  test_header(fuzzer);
+}
+
+/**
+  * This function tests the "name" and "linkname" fields of the tar header by calling
+  * various tests on them, including empty values, weird characters, forbidden characters,
+  * non-null terminated strings, strings of zeros, non-ASCII characters (emojis), and directories.
+  * 
+  *@param[in]linkname: A boolean indicating whether to test the "linkname" or "name" field.
+  *@param[in]fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+  * 
+**/
+void test_names(int linkname, Fuzzer *fuzzer) //Aqui verificar se não dá para otimizar, escrever em menos linhas
+{
+      // Set the tar header with default values
+      set_header(&header);
+
+      // Get the appropriate field to test (linkname or name)
+      char *field = header.linkname;
+      char field_name[] = "linkname";
+      unsigned size = LINKNAME_LEN;
+
+      if (!linkname)
+      {
+        field = header.name;
+        sprintf(field_name, "name");
+        size = NAME_LEN;
+      }
+      else
+      {
+        // Test the linkname with the same value as the name
+        set_name(fuzzer, "same_as_name", field_name);
+        strncpy(field, header.name, size);
+        test_header(fuzzer);
+      }
+
+      // Test an empty field
+      set_name(fuzzer, "empty", field_name);
+      strncpy(field, "", size);
+      test_header(fuzzer);
+
+      // Test the field with weird characters
+      strncpy(field, "0" EXT, size);
+      for (unsigned i = 0; i < sizeof(WEIRD_CHARS) && !fuzzer->stop_reason; i++)
+      {
+        field[0] = WEIRD_CHARS[i];
+        snprintf(fuzzer->current_test, TEST_NAME_LEN, "%s_weird_char='%c'", field_name, field[0]);
+        test_header(fuzzer);
+      }
+
+      // Test the field with forbidden characters
+      char forbidden_char[] = {'*', '\\', '/', '"', '?', ' '};
+      for (unsigned i = 0; i < sizeof(forbidden_char) && !fuzzer->stop_reason; i++)
+      {
+        field[0] = forbidden_char[i];
+        snprintf(fuzzer->current_test, TEST_NAME_LEN, "%s_weird_char='%c'", field_name, field[0]);
+        test_header(fuzzer);
+      }
+
+      // Test the field with a string that's not null-terminated
+      set_name(fuzzer, "not_terminated", field_name);
+      memset(field, 'a', size);
+      test_header(fuzzer);
+
+      // Test the field with a string of zeros
+      set_name(fuzzer, "fill_all", field_name);
+      sprintf(field, "%0*d" EXT, (int)(size - strlen(EXT) - 1), 0);
+      test_header(fuzzer);
+
+      // Test the field with non-ASCII characters (in this case, emojis)
+      set_name(fuzzer, "non_ascii", field_name);
+      strncpy(field, "😂 😎" EXT, size);
+      test_header(fuzzer);
+
+      // Test the field as a directory
+      set_name(fuzzer, "directory", field_name);
+      strncpy(field, "tests" EXT "/", size);
+      test_header(fuzzer);
+}
+
+/**
+ * This function tests the "mode" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments, 
+ * then test all possible values of the mode field.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ **/
+void test_mode(Fuzzer *fuzzer)
+{
+  // Initialize the header and the field for the mode
+  set_header(&header);
+  char *field = header.mode;
+
+  // Run generic tests on the mode field
+  generic_field_tests(fuzzer, "mode", field, MODE_LEN);
+
+  // Test all possible values of the mode field
+  for (unsigned i = 0; i < sizeof(POSSIBLE_MODES) / sizeof(POSSIBLE_MODES[0]) && !fuzzer->stop_reason; i++)
+  {
+    // Initialize the header and format the current mode value into the field
+    set_header(&header);
+    num_encode(field, MODE_LEN, POSSIBLE_MODES[i], NUM_OCTAL_NUL);
+
+    // Set the current test name to reflect the current mode value
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "mode='%s'", field);
+
+    // Run the header test with the current mode value
+    test_header(fuzzer);
+  }
+}
+
+/**
+ * This function tests the "uid" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ **/
+void test_uid(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the uid
+  set_header(&header);
+  char *field = header.uid;
+
+  // Run generic tests on the uid field
+  generic_field_tests(fuzzer, "uid", field, UID_LEN);
+}
+
+/**
+ * This function tests the "gid" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ **/
+void test_gid(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the gid
+  set_header(&header);
+  char *field = header.gid;
+
+  // Run generic tests on the gid field
+  generic_field_tests(fuzzer, "gid", field, GID_LEN);
+}
+
+/**
+ * 
+ * This function tests the "size" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments, and then
+ * runs a series of tests on various edge cases for the field.
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+**/
+void test_size(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the size
+  set_header(&header);
+  char *field = header.size;
+
+  // Run generic tests on the size field
+  generic_field_tests(fuzzer, "size", field, SIZE_LEN);
+
+  // Test various edge cases for the size field
+  // First, test a file with a size of 0 bytes
+  char buffer[] = "hello";
+  unsigned long len_buffer = strlen(buffer);
+  set_name(fuzzer, "0", "size");
+  set_size_header(&header, 0);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+
+  // Next, test a file with a size smaller than the actual size of the data
+  set_name(fuzzer, "too_small", "size");
+  set_size_header(&header, 2);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+
+  // Then, test a file with a size larger than the actual size of the data
+  set_name(fuzzer, "too_big", "size");
+  set_size_header(&header, 20);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+
+  // Test a file with a size that exceeds the maximum allowed value
+  set_name(fuzzer, "far_too_big", "size");
+  set_size_header(&header, END_LEN * 2);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+
+  // Test a file with a size that exceeds the maximum allowed value and has a long filename
+  set_name(fuzzer, "far_far_too_big", "size");
+  set_size_header(&header, END_LEN * 2);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+
+  // Test a file with a negative size, written as the two's complement of an int: 37777777776
+  set_name(fuzzer, "negative", "size");
+  num_encode(field, SIZE_LEN, -2, NUM_OCTAL_NUL);
+  write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer);
+  test_file_extractor(fuzzer);
+}
+
+/**
+ * This function tests the "mtime" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments, 
+ * and then tests it with several specific values.
+ * 
+ *@param[in]fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ **/
+void test_mtime(Fuzzer* fuzzer)
+{
+  // Set the tar header with default values
+  set_header(&header);
+
+  // Get the appropriate field to test (mtime)
+  char *field = header.mtime;
+  char field_name[] = "mtime";
+
+  // Call the generic_field_tests function to test the field with default values
+  generic_field_tests(fuzzer, field_name, field, MTIME_LEN);
+
+  // Test the field with the current time
+  set_name(fuzzer, "current", field_name);
+  num_encode(field, MTIME_LEN, time(NULL), NUM_OCTAL_NUL);
+  test_header(fuzzer);
+
+  // Test the field with a time 50 hours in the future
+  set_name(fuzzer, "later", field_name);
+  num_encode(field, MTIME_LEN, time(NULL) + 50 * 3600, NUM_OCTAL_NUL);
+  test_header(fuzzer);
+
+  // Test the field with a time 50 hours in the past
+  set_name(fuzzer, "sooner", field_name);
+  num_encode(field, MTIME_LEN, time(NULL) - 50 * 3600, NUM_OCTAL_NUL);
+  test_header(fuzzer);
+
+  // Test the field with a time far in the future
+  set_name(fuzzer, "far_future", field_name);
+  num_encode(field, MTIME_LEN, time(NULL) * 2, NUM_OCTAL_NUL);
+  test_header(fuzzer);
+}
+
+/**
+ * This function tests the "chksum" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ **/
+void test_chksum(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the chksum
+  set_header(&header);
+  char *field = header.chksum;
+
+  // Run generic tests on the gid field
+  generic_field_tests(fuzzer, "chksum", field, CHKSUM_LEN);
+
+  // Test case: checksum summing the bytes as signed chars, as historic tar implementations did.
+  // It only differs from the real one with bytes above 0x7f in the header.
+  set_header(&header);
+  set_name(fuzzer, "signed", "chksum");
+  strncpy(header.name, "😂😂😂", NAME_LEN);
+  checksum_encode(header.chksum, checksum_header_signed(&header));
+  test_header(fuzzer);
+}
+
+/**
+ * This function writes the boundary values of every numeric field of the header:
+ * the powers of 8 around each number of digits, the largest number of each octal form
+ * and the first one that does not fit, and the edges of the GNU base-256 encoding.
+ * The checksum has its own tests, see test_chksum().
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ **/
+void test_numeric(Fuzzer* fuzzer)
+{
+  for (unsigned i = 0; i < TAR_FIELDS_COUNT && !fuzzer->stop_reason; i++)
+  {
+    const tar_field *field = &TAR_FIELDS[i];
+    if (!field->numeric || field->offset == offsetof(tar_t, chksum))
+      continue;
+
+    num_iter iter;
+    num_boundary boundary;
+    num_iter_init(&iter, field->size);
+    while (!fuzzer->stop_reason && num_iter_next(&iter, &boundary))
+    {
+      set_header(&header);
+      set_name(fuzzer, boundary.name, field->name);
+      num_encode((char *)&header + field->offset, field->size, boundary.value, boundary.format);
+      test_header(fuzzer);
+    }
+  }
+}
+
+/**
+  * This function tests the `typeflag` field of the header struct
+  * by assigning it all possible values (0x00 to 0xFF) and testing the resulting header with each value.
+  * 
+  *@param[in]fuzzer a pointer to a Fuzzer object to be used for testing.
+  **/
+void test_typeflag(Fuzzer* fuzzer)
+{
+  // Initialize header struct to initial values
+  set_header(&header);
+
+  // Name of the field being tested
+  char field_name[] = "typeflag";
+
+  // String to hold the current test name
+  char name_current_test[30];
+
+  // Loop through each possible value for the typeflag field
+  for (unsigned i = 0; i < sizeof(TYPE_FLAG_VALUES)/sizeof(TYPE_FLAG_VALUES[0]) && !fuzzer->stop_reason; i++)
+  {
+      // Set the name of the current test to indicate the value of typeflag
+      sprintf(name_current_test, "value=%c", TYPE_FLAG_VALUES[i]);
+
+      // Set the typeflag field of the header struct to the current value of i
+      header.typeflag = TYPE_FLAG_VALUES[i];
+
+      // Set the name of the current test case to the value of typeflag
+      set_name(fuzzer, name_current_test, field_name);
+
+      // Test the header with the updated typeflag value
+      test_header(fuzzer);
+  }
+
+ /* 
+ // Iterate over all possible values of `typeflag`
+  for (unsigned i = 0; i < 0x100; i++)
+  {
+    // Set the name of the current test to indicate the value of `typeflag`
+    sprintf(name_current_test, "value=0x%02x", i);
+
+    // Set the `typeflag` field of the header struct to the current value of `i`
+    header.typeflag = (char)i;
+
+    // Set the name of the current test case to the value of `typeflag`
+    set_name(fuzzer, name_current_test, field_name);
+
+    // Test the header with the updated `typeflag` value
+    test_header(fuzzer);
+  }
+  */
+
+//generic_field_tests(fuzzer, "mode", field, MODE_LEN);
+}
+
+/**
+ * This function tests the "linkname" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ **/
+void test_linkname(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the linkname
+  set_header(&header);
+  char *field = header.linkname;
+
+  // Run generic tests on the linkname field
+  generic_field_tests(fuzzer, "linkname", field, LINKNAME_LEN);
+
+  // Test the linkname field for valid names
+  // This function tests the linkname for invalid characters and empty names
+  test_names(1, fuzzer);
+}
+
+/**
+ * This function tests the "magic" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ **/
+void test_magic(Fuzzer* fuzzer)
+{
+  // Initialize the header and the field for the magic field
+  set_header(&header);
+  char *field = header.magic;
+
+  // Run generic tests on the magic field
+  generic_field_tests(fuzzer, "magic", field, MAGIC_LEN);
+}
+
+/**
+ * This function tests the "version" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments, 
+ * then test all possible values for the digits of the version field.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ **/
+void test_version(Fuzzer* fuzzer)
+{
+  // Set up the header and field for the version test
+  set_header(&header);
+  char *field = header.version;
+  
+  // Run generic tests on the version field
+  generic_field_tests(fuzzer, "version", field, VERSION_LEN);
+
+  // Loop over all possible values for the version field (64 total)
+  for (unsigned i = 0; i < 64 && !fuzzer->stop_reason; i++)
+  {
+    // Set the version field to the current value of i
+    field[1] = i % 8 + '0';  // octal digit represented by the lower 3 bits
+    field[0] = i / 8 + '0';  // octal digit represented by the upper 3 bits
+    
+    // Format the current test case name using the current value of the version field
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "version=\'%c%c\'", field[0], field[1]);
+    
+    // Run the header test with the current version field value
+    test_header(fuzzer);
+  }
+}
+
+/**
+ * This function tests the "uname/gname" field of the header by calling
+ * the generic_field_tests function with the appropriate arguments.
+ * @param[in] gname  If is set to 0, the function tests the uname field.
+ *                   If is set to 1, the function tests the gname field.
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ **/
+void test_uname(Fuzzer* fuzzer, int gname)
+{
+  char *field = header.uname;  // Set the field pointer to the uname field
+  char field_name[] = "uname";  // Set the field name to "uname" by default
+  unsigned size = UNAME_LEN;  // Set the field size to the length of the uname field
+
+  if (!gname)  // If gname is 0, test the uname field
+  {
+    field = header.gname;  // Set the field pointer to the gname field
+    sprintf(field_name, "gname");  // Change the field name to "gname"
+    size = GNAME_LEN;  // Set the field size to the length of the gname field
+  }
+  
+  set_header(&header);  // Initialize the header
+  generic_field_tests(fuzzer, field_name, field, size);  // Run generic tests on the field
+}
+
+/**
+ * This function tests the behavior of the tar archive end-of-file (EOF) bytes.
+ * It sets up a tar header and writes it to a test file along with a buffer of
+ * data. Then it writes the specified number of EOF bytes to the end of the
+ * file and tests the extractor's behavior with and without a file.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * 
+ */
+void test_end_bytes(Fuzzer* fuzzer)
+{
+  char end_bytes[END_LEN * 2]; // buffer to hold the end-of-file bytes
+  memset(end_bytes, 0, END_LEN * 2); // initialize buffer to all zeroes
+
+  char buffer[] = "hello"; // data buffer to write to the test file
+  size_t len_buffer = strlen(buffer); // length of data buffer
+
+  set_header(&header); // initialize tar header
+  set_size_header(&header, strlen(buffer)); // set the size of the data in the header
+
+  int lengths[] = {END_LEN * 2, END_LEN, 512, 1, 0}; // array of different EOF byte lengths to test
+
+  // iterate through the different EOF byte lengths to test
+  for (unsigned i = 0; i < sizeof(lengths) / sizeof(int) && !fuzzer->stop_reason; i++)
+  {
+    // test with a file containing data
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "end_bytes(%d)_with_file", lengths[i]);
+    write_tar_fields(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, len_buffer, end_bytes, lengths[i]);
+    test_file_extractor(fuzzer);
+
+    // test without a file (empty file)
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "end_bytes(%d)_w-o_file", lengths[i]);
+    write_tar_fields(&fuzzer->archive_buffer, TEST_FILE, &header, "", 0, end_bytes, lengths[i]);
+    test_file_extractor(fuzzer);
+  }
+}
+
+/**
+ * This function generates various tar archive files with different types of entries, 
+ * including regular files, directories, and an empty archive. It also creates a 
+ * large file entry to test the handling of large files. After creating each archive, 
+ * the function tests the file extractor with the generated archive to ensure 
+ * that the extraction is successful.
+ * 
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options. 
+ * 
+**/
+void test_files(Fuzzer* fuzzer)
+{
+  const size_t N = 50;
+  tar_entry files[N]; // declare an array of 50 tar_entry structs
+  tar_entry *entries = &files[0]; // create a pointer to the first element of the array
+
+  // initialize each element of the array
+  for (size_t i = 0; i < N; i++)
+  {
+    set_header(&files[i].header); // set the header of the i-th file
+    files[i].content = NULL; // initialize the content of the i-th file to NULL
+    files[i].size = 0; // set the size of the i-th file to zero
+  }
+
+  // Create and write N files to the tar archive
+  snprintf(fuzzer->current_test, TEST_NAME_LEN, "%lu_files", N); // set the current test name
+
+  for (size_t i = 0; i < N; i++)
+  {
+    sprintf(files[i].header.name, "this_is_the_file_number_%lu" EXT, i); // set the name of the i-th file
+    files[i].content = arena_printf(&fuzzer->arena, &files[i].size, "file number %lu", i); // set the content and size of the i-th file
+  }
+
+  write_tar_entries(&fuzzer->archive_buffer, TEST_FILE, files, N); // write the tar archive to disk
+  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
+
+  // create a tar archive with 5 files having the same name
+  set_name(fuzzer, "same_name", "files"); // set the name of the current test
+  for (unsigned i = 0; i < 5; i++)
+  {
+    strncpy(files[i].header.name, "same_name" EXT, NAME_LEN); // set the name of the i-th file
+    files[i].content = arena_printf(&fuzzer->arena, &files[i].size, "file number %u", i); // set the content and size of the i-th file
+  }
+  write_tar_entries(&fuzzer->archive_buffer, TEST_FILE, files, 5); // write the tar archive to disk
+  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
+
+  // create a tar archive with a directory-like file
+  set_name(fuzzer, "dir_with_data", "files"); // set the name of the current test
+
+  strncpy(entries->header.name, "test" EXT "/", NAME_LEN); // set the name of the directory-like file
+  entries->content = "content of the directory like if it was a file"; // set the content and size of the directory-like file
+  entries->size = strlen(entries->content);
+  
+  write_tar_entries(&fuzzer->archive_buffer, TEST_FILE, files, 1); // write the tar archive to disk
+  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
+
+  // create an empty tar archive and test it
+  FILE *f = fopen(TEST_FILE, "wb"); // create an empty file
+  if (f)
+  {
+    fclose(f); // close the file
+    set_name(fuzzer, "empty_tar", "files"); // set the name of the current test
+    test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
+  }
+  
+  // The large file is not even allocated once a stop condition is reached
+  if (fuzzer->stop_reason)
+    return;
+
+  // Create and write a large file to the tar archive
+  set_name(fuzzer, "big_file", "files");
+  set_header(&entries->header); // Set the header of the entry to default values
+
+  size_t big = 50 * 1000 * 1000; // Size of the large file in bytes
+
+  char *content = arena_alloc(&fuzzer->arena, big); // Allocate the content of the large file in the arena of the test, released once the extractor ran.
+  if (content == NULL)
+    return;
+  memset(content, 'A', big); // Fill the allocated memory with the character 'A'. This is done to ensure that the file content is completely written to the allocated memory.
+  entries->content = content;
+  entries->size = big; // Set the size of the tar entry to the size of the large file in bytes.
+  
+  write_tar_entries(&fuzzer->archive_buffer, TEST_FILE, files, 1); // Write the tar entry entries containing the large file to the tar archive file TEST_FILE
+  test_file_extractor(fuzzer); // test the file extractor with the generated tar archive
+}
+
+// A record of a generated pax extended header, its value is a chunk repeated up to value_len bytes
+typedef struct
+{
+    const char *length;     // the length as written in the record, NULL for the real one
+    const char *key;
+    const char *chunk;
+    size_t value_len;
+    unsigned repeat;        // times the record is written, 0 for once
+} pax_spec;
+
+// An extended header generated by test_extended()
+typedef struct
+{
+    const char *name;
+    pax_spec records[EXTENDED_RECORDS];
+    size_t declared;        // size in the header, 0 for the real size of the records
+} pax_case;
+
+#define PAX_MB (1024 * 1024)
+#define PAX_VALUE(key, value) {NULL, key, value, sizeof(value) - 1, 0}
+#define PAX_FILL(key, chunk, size) {NULL, key, chunk, size, 0}
+
+static const pax_case PAX_CASES[] = {
+    {"path_300", {PAX_FILL("path", "d/", 300)}, 0},
+    {"path_4K", {PAX_FILL("path", "d/", 4096)}, 0},
+    {"path_1MB", {PAX_FILL("path", "d/", PAX_MB)}, 0},
+    {"path_16MB", {PAX_FILL("path", "d/", EXTENDED_HUGE)}, 0},
+    {"path_empty", {PAX_VALUE("path", "")}, 0},
+    {"path_dotdot", {PAX_VALUE("path", "../../../../../../tmp/escaped" EXT)}, 0},
+    {"linkpath_1MB", {PAX_FILL("linkpath", "l/", PAX_MB)}, 0},
+    {"size_huge", {PAX_VALUE("size", "99999999999999999999")}, 0},
+    {"size_max", {PAX_VALUE("size", "18446744073709551615")}, 0},
+    {"size_negative", {PAX_VALUE("size", "-1")}, 0},
+    {"size_1GB", {PAX_VALUE("size", "1073741824")}, 0},
+    {"size_not_number", {PAX_VALUE("size", "512x")}, 0},
+    {"uid_negative", {PAX_VALUE("uid", "-1"), PAX_VALUE("gid", "99999999999999999999")}, 0},
+    {"mtime_out_of_range", {PAX_VALUE("mtime", "1e400"), PAX_VALUE("atime", "-99999999999.999999999")}, 0},
+    {"comment_1MB", {PAX_FILL("comment", "A", PAX_MB)}, 0},
+    {"comment_16MB", {PAX_FILL("comment", "A", EXTENDED_HUGE)}, 0},
+    {"xattr_1MB", {PAX_FILL("SCHILY.xattr.user.fuzz", "A", PAX_MB)}, 0},
+    {"records_64K", {{NULL, "uid", "0", 1, 65536}}, 0},
+    {"paths_64K", {{NULL, "path", "p", 64, 65536}}, 0},
+    {"length_too_big", {{"999999999", "path", "long" EXT, 8, 0}}, 0},
+    {"length_too_small", {{"5", "path", "short" EXT, 9, 0}, PAX_VALUE("size", "0")}, 0},
+    {"length_zero", {{"0", "path", "zero" EXT, 8, 0}}, 0},
+    {"length_negative", {{"-1", "path", "negative" EXT, 12, 0}}, 0},
+    {"length_not_number", {{"abc", "path", "abc" EXT, 7, 0}}, 0},
+    {"length_overflow", {{"99999999999999999999999", "path", "overflow" EXT, 12, 0}}, 0},
+    {"length_no_key", {{NULL, "", "value", 5, 0}}, 0},
+    {"declared_1GB", {PAX_VALUE("path", "declared" EXT)}, 1024UL * PAX_MB},
+    {"declared_short", {PAX_FILL("path", "d/", 4096)}, 16},
+};
+
+// A long name or link name member generated by test_extended()
+typedef struct
+{
+    const char *name;
+    char typeflag;          // GNUTYPE_LONGNAME or GNUTYPE_LONGLINK
+    size_t len;             // length of the name
+    int terminated;         // the name is followed by a null, counted in the size
+    size_t declared;        // size in the header, 0 for the real size of the name
+    unsigned chain;         // long name members in a row
+    int follow;             // an entry follows the members
+} longname_case;
+
+static const longname_case LONGNAME_CASES[] = {
+    {"name_200", GNUTYPE_LONGNAME, 200, 1, 0, 1, 1},
+    {"name_4K", GNUTYPE_LONGNAME, 4096, 1, 0, 1, 1},
+    {"name_1MB", GNUTYPE_LONGNAME, PAX_MB, 1, 0, 1, 1},
+    {"name_16MB", GNUTYPE_LONGNAME, EXTENDED_HUGE, 1, 0, 1, 1},
+    {"name_no_null", GNUTYPE_LONGNAME, 200, 0, 0, 1, 1},
+    {"name_empty", GNUTYPE_LONGNAME, 0, 0, 0, 1, 1},
+    {"name_declared_1GB", GNUTYPE_LONGNAME, 200, 1, 1024UL * PAX_MB, 1, 1},
+    {"name_declared_short", GNUTYPE_LONGNAME, 4096, 1, 16, 1, 1},
+    {"name_chained", GNUTYPE_LONGNAME, 4096, 1, 0, 64, 1},
+    {"name_last", GNUTYPE_LONGNAME, 200, 1, 0, 1, 0},
+    {"link_200", GNUTYPE_LONGLINK, 200, 1, 0, 1, 1},
+    {"link_1MB", GNUTYPE_LONGLINK, PAX_MB, 1, 0, 1, 1},
+    {"link_16MB", GNUTYPE_LONGLINK, EXTENDED_HUGE, 1, 0, 1, 1},
+    {"link_no_null", GNUTYPE_LONGLINK, 200, 0, 0, 1, 1},
+    {"link_declared_1GB", GNUTYPE_LONGLINK, 200, 1, 1024UL * PAX_MB, 1, 1},
+    {"link_chained", GNUTYPE_LONGLINK, 4096, 1, 0, 64, 1},
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+/**
+ * Streams the entries following an extended header or a long name: a file with a short content,
+ * or a symbolic link when the member before it gave a link name.
+ *
+ * @param[in] stream the stream
+ * @param[in] count the number of entries
+ * @param[in] typeflag the type of the entries
+**/
+static void stream_followers(tar_stream *stream, unsigned count, char typeflag)
+{
+  char content[] = "hello";
+  for (unsigned i = 0; i < count; i++)
+  {
+    tar_t entry;
+    set_header(&entry);
+    snprintf(entry.name, NAME_LEN, "follower_%u" EXT, i);
+    entry.typeflag = typeflag;
+    if (typeflag == SYMTYPE)
+    {
+      strncpy(entry.linkname, "target" EXT, LINKNAME_LEN);
+      tar_stream_header(stream, &entry);
+      continue;
+    }
+    set_size_header(&entry, strlen(content));
+    tar_stream_header(stream, &entry);
+    tar_stream_append(stream, content, strlen(content));
+    tar_stream_pad(stream);
+  }
+}
+
+/**
+ * Streams an archive made of a pax extended header, local or global, and of the entries it applies to.
+ * The size of the records is known from their lengths before they are written, so that the
+ * header comes first and the records, which can be megabytes long, go to the file as they are
+ * made up without ever being in memory at once.
+ *
+ * @param[in] test the extended header
+ * @param[in] typeflag XHDTYPE or XGLTYPE
+ * @return 0 on success, -1 if the archive could not be written
+**/
+static int write_pax_archive(const pax_case *test, char typeflag)
+{
+  tar_stream stream;
+  if (tar_stream_open(&stream, TEST_FILE) == -1)
+    return -1;
+
+  size_t size = 0;
+  for (unsigned i = 0; i < EXTENDED_RECORDS && test->records[i].key; i++)
+  {
+    const pax_spec *r = &test->records[i];
+    size += pax_record_len(r->length, r->key, r->value_len) * (r->repeat ? r->repeat : 1);
+  }
+
+  tar_t member;
+  set_header(&member);
+  snprintf(member.name, NAME_LEN, typeflag == XGLTYPE ? "GlobalHead/%s" : "PaxHeader/%s", test->name);
+  member.typeflag = typeflag;
+  set_size_header(&member, test->declared ? test->declared : size);
+  tar_stream_header(&stream, &member);
+
+  for (unsigned i = 0; i < EXTENDED_RECORDS && test->records[i].key; i++)
+  {
+    const pax_spec *r = &test->records[i];
+    for (unsigned k = 0; k < (r->repeat ? r->repeat : 1); k++)
+      tar_stream_record(&stream, r->length, r->key, r->chunk, strlen(r->chunk), r->value_len);
+  }
+  tar_stream_pad(&stream);
+
+  // A global header applies to all the entries that follow, a local one to the next one only
+  stream_followers(&stream, typeflag == XGLTYPE ? 2 : 1, REGTYPE);
+  tar_stream_zeros(&stream, END_LEN);
+  return tar_stream_close(&stream);
+}
+
+/**
+ * Streams an archive made of GNU long name or long link name members and of the entry they name.
+ * Like the pax records, the names are written to the file as they are made up.
+ *
+ * @param[in] test the long name members
+ * @return 0 on success, -1 if the archive could not be written
+**/
+static int write_longname_archive(const longname_case *test)
+{
+  tar_stream stream;
+  if (tar_stream_open(&stream, TEST_FILE) == -1)
+    return -1;
+
+  size_t size = test->len + (test->terminated != 0);
+  for (unsigned i = 0; i < test->chain; i++)
+  {
+    tar_t member;
+    set_header(&member);
+    strncpy(member.name, GNU_LONGLINK_NAME, NAME_LEN);
+    member.typeflag = test->typeflag;
+    set_size_header(&member, test->declared ? test->declared : size);
+    tar_stream_header(&stream, &member);
+    tar_stream_fill(&stream, test->typeflag == GNUTYPE_LONGLINK ? "l/" : "d/", 2, test->len);
+    if (test->terminated)
+      tar_stream_zeros(&stream, 1);
+    tar_stream_pad(&stream);
+  }
+
+  stream_followers(&stream, test->follow != 0, test->typeflag == GNUTYPE_LONGLINK ? SYMTYPE : REGTYPE);
+  tar_stream_zeros(&stream, END_LEN);
+  return tar_stream_close(&stream);
+}
+
+/**
+ * This function tests the extended headers the typeflag tests only name: pax extended headers,
+ * local and global, with paths and sizes overriding the ones of the member, lengths of records
+ * that do not match them, and values of megabytes, then GNU long name and long link name members.
+ * The lengths in these headers come from the archive and extractors often allocate from them,
+ * which makes them the first place to look for memory blow-ups.
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+**/
+void test_extended(Fuzzer* fuzzer)
+{
+  static const char TYPEFLAGS[] = {XHDTYPE, XGLTYPE};
+  for (unsigned t = 0; t < COUNT(TYPEFLAGS); t++)
+  {
+    for (unsigned i = 0; i < COUNT(PAX_CASES) && !fuzzer->stop_reason; i++)
+    {
+      snprintf(fuzzer->current_test, TEST_NAME_LEN, "pax_%c_%s", TYPEFLAGS[t], PAX_CASES[i].name);
+      if (write_pax_archive(&PAX_CASES[i], TYPEFLAGS[t]) == 0)
+        test_file_extractor(fuzzer);
+    }
+  }
+
+  for (unsigned i = 0; i < COUNT(LONGNAME_CASES) && !fuzzer->stop_reason; i++)
+  {
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "gnu_%c_%s", LONGNAME_CASES[i].typeflag, LONGNAME_CASES[i].name);
+    if (write_longname_archive(&LONGNAME_CASES[i]) == 0)
+      test_file_extractor(fuzzer);
+  }
+}
+
+/**
+ * Runs the tar archives of a directory, so that the fuzzing starts from realistic inputs.
+ * Each archive is walked in place to check that it is one: files without any header
+ * whose checksum matches are skipped. In novelty mode, the seeds producing new responses
+ * enter the corpus like any other input.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] dir the directory of the seeds
+**/
+void test_seeds(Fuzzer* fuzzer, const char *dir)
+{
+  DIR *d = opendir(dir);
+  if (d == NULL)
+  {
+    printf("Cannot open the seeds directory \"%s\"\n", dir);
+    return;
+  }
+
+  unsigned seeds = 0, skipped = 0;
+  struct dirent *ent;
+  while ((ent = readdir(d)) != NULL && !fuzzer->stop_reason)
+  {
+    char path[PATH_MAX];
+    if (ent->d_name[0] == '.' || snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path))
+      continue;
+
+    tar_reader reader;
+    if (tar_open(&reader, path) == -1)
+      continue;
+
+    tar_view view;
+    unsigned valid = 0;
+    while (tar_next(&reader, &view))
+      valid += view.checksum != TAR_CHKSUM_BAD;
+
+    if (valid == 0)
+    {
+      skipped++;
+      tar_close(&reader);
+      continue;
+    }
+
+    // Written straight from the mapping
+    tar_buffer seed = {(char *)reader.data, reader.size, reader.size};
+    tar_buffer_flush(&seed, TEST_FILE);
+    tar_close(&reader);
+
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "seed_%.*s", TEST_NAME_LEN - 6, ent->d_name);
+    test_file_extractor(fuzzer);
+    seeds++;
+  }
+
+  closedir(d);
+  printf("\n%u seeds run from %s, %u files skipped\n", seeds, dir, skipped);
+}
+
+/**
+ * Writes an archive of count entries of content_size bytes each and tests the extractor with it.
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+ * @param[in] count: number of entries in the archive
+ * @param[in] content_size: size of the content of each entry
+ * @param[in] same_name: if set, all the entries have the same name
+**/
+static void test_memory_entries(Fuzzer *fuzzer, size_t count, size_t content_size, int same_name)
+{
+  // The entries and the content live in the arena of the test, the entries share the same content
+  tar_entry *entries = arena_alloc(&fuzzer->arena, count * sizeof(tar_entry));
+  char *content = arena_alloc(&fuzzer->arena, content_size);
+  if (entries == NULL || content == NULL)
+    return;
+  memset(content, 'A', content_size);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    set_header(&entries[i].header);
+    if (same_name)
+      strncpy(entries[i].header.name, "same_name" EXT, NAME_LEN);
+    else
+      sprintf(entries[i].header.name, "memory_file_%lu" EXT, i);
+
+    entries[i].content = content;
+    entries[i].size = content_size;
+  }
+
+  write_tar_entries(&fuzzer->archive_buffer, TEST_FILE, entries, count);
+  test_file_extractor(fuzzer);
+}
+
+/**
+ * Memory-footprint feedback loop, run in memory mode after the generators.
+ * Starting from the size edge cases of test_size() and the multi-entry archives of test_files(),
+ * each dimension of the archive (declared size, real size, number of entries, number of entries
+ * with the same name) keeps growing as long as the max RSS of the extractor grows with it, and is
+ * abandoned after MEMHOG_PATIENCE steps without a new high. Inputs setting a new overall high
+ * are saved by track_memory().
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+**/
+void test_memory(Fuzzer* fuzzer)
+{
+  char buffer[] = "hello";
+  int idle = 0;
+  long best = 0;
+
+  // Declared size far bigger than the data, starting from "far_too_big" (the field holds 11 octal digits)
+  for (unsigned long size = END_LEN * 2; size < (1UL << 33) && idle < MEMHOG_PATIENCE && !fuzzer->stop_reason; size *= 4)
+  {
+    set_header(&header);
+    set_size_header(&header, size);
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "memory_declared_%lu", size);
+    write_tar(&fuzzer->archive_buffer, TEST_FILE, &header, buffer, strlen(buffer));
+    test_file_extractor(fuzzer);
+    idle = fuzzer->last_rss > best ? 0 : idle + 1;
+    best = fuzzer->last_rss > best ? fuzzer->last_rss : best;
+  }
+
+  // Real size of a single file, up to a bit more than "big_file"
+  idle = 0;
+  best = 0;
+  for (size_t size = 4096; size <= 128 * 1000 * 1000 && idle < MEMHOG_PATIENCE && !fuzzer->stop_reason; size *= 2)
+  {
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "memory_content_%lu", size);
+    test_memory_entries(fuzzer, 1, size, 0);
+    idle = fuzzer->last_rss > best ? 0 : idle + 1;
+    best = fuzzer->last_rss > best ? fuzzer->last_rss : best;
+  }
+
+  // Number of files, starting from the 50 files of test_files()
+  idle = 0;
+  best = 0;
+  for (size_t count = 50; count <= 16384 && idle < MEMHOG_PATIENCE && !fuzzer->stop_reason; count *= 2)
+  {
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "memory_%lu_files", count);
+    test_memory_entries(fuzzer, count, 16, 0);
+    idle = fuzzer->last_rss > best ? 0 : idle + 1;
+    best = fuzzer->last_rss > best ? fuzzer->last_rss : best;
+  }
+
+  // Number of files with the same name, starting from the 5 files of test_files()
+  idle = 0;
+  best = 0;
+  for (size_t count = 5; count <= 16384 && idle < MEMHOG_PATIENCE && !fuzzer->stop_reason; count *= 2)
+  {
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "memory_%lu_same_name", count);
+    test_memory_entries(fuzzer, count, 16, 1);
+    idle = fuzzer->last_rss > best ? 0 : idle + 1;
+    best = fuzzer->last_rss > best ? fuzzer->last_rss : best;
+  }
+}
+
+// Shapes of the archives of the scaling tests
+typedef enum
+{
+    SCALE_FLAT,         // files in the root directory
+    SCALE_WIDE,         // files spread over SCALE_FANOUT directories
+    SCALE_DEEP,         // chains of directories as deep as the name and prefix fields allow
+    SCALE_OVERWRITE,    // files sharing SCALE_SAME_NAMES names, each one overwriting the previous one
+    SCALE_SHAPES
+} scale_shape;
+
+static const char *SCALE_NAMES[SCALE_SHAPES] = {"flat", "wide", "deep", "overwrite"};
+
+/**
+ * Streams an archive of a given shape to TEST_FILE. The names are made up entry by entry and
+ * the archive goes to the file through a buffer of fixed size, so the memory used does not
+ * depend on the number of entries.
+ *
+ * @param[in] shape the shape of the archive
+ * @param[in] count the number of entries
+ * @return the size of the archive, 0 if it could not be written
+**/
+static size_t write_scale_archive(scale_shape shape, unsigned long count)
+{
+  tar_stream stream;
+  if (tar_stream_open(&stream, TEST_FILE) == -1)
+    return 0;
+
+  tar_t entry;
+  set_header(&entry);
+  char path[NAME_LEN + 155 + 1];
+  for (unsigned long i = 0; i < count; i++)
+  {
+    int len = 0;
+    size_t size = 0;
+    entry.typeflag = REGTYPE;
+    switch (shape)
+    {
+    case SCALE_FLAT:
+      len = snprintf(path, sizeof(path), "f%07lu" EXT, i);
+      break;
+    case SCALE_WIDE:
+      // The directories first, then the files round-robin over them
+      if (i < SCALE_FANOUT)
+      {
+        entry.typeflag = DIRTYPE;
+        len = snprintf(path, sizeof(path), "d%04lu/", i);
+      }
+      else
+        len = snprintf(path, sizeof(path), "d%04lu/f%07lu" EXT, i % SCALE_FANOUT, i);
+      break;
+    case SCALE_DEEP:
+    {
+      // Each entry is one level deeper than the previous one, until the path is full
+      entry.typeflag = DIRTYPE;
+      len = snprintf(path, sizeof(path), "r%07lu/", i / SCALE_DEPTH);
+      for (unsigned long level = 0; level < i % SCALE_DEPTH; level++)
+      {
+        path[len++] = 'd';
+        path[len++] = '/';
+      }
+      break;
+    }
+    default:
+      len = snprintf(path, sizeof(path), "same_%02lu" EXT, i % SCALE_SAME_NAMES);
+      size = 1;
+      break;
+    }
+    set_path_header(&entry, path, len);
+    set_size_header(&entry, size);
+    tar_stream_header(&stream, &entry);
+    if (size)
+    {
+      char content = 'A' + i % 26;
+      tar_stream_append(&stream, &content, 1);
+      tar_stream_zeros(&stream, sizeof(tar_t) - 1);
+    }
+  }
+  tar_stream_zeros(&stream, END_LEN);
+
+  size_t written = stream.written + stream.buffer.size;
+  return tar_stream_close(&stream) == 0 ? written : 0;
+}
+
+/**
+ * Growth exponent of a measure between two numbers of entries: 1 when it grows like the number
+ * of entries, 2 when it grows like its square.
+**/
+static double growth_exponent(double from, double to, unsigned long from_count, unsigned long to_count)
+{
+  if (from <= 0 || to <= 0)
+    return 0;
+  return log(to / from) / log((double)to_count / from_count);
+}
+
+/**
+ * Scaling tests, the only tests of the scale mode. For each shape of archive (flat, wide, deep,
+ * overwrite), archives of SCALE_FIRST entries and SCALE_STEP times more each time, up to
+ * the --scale-max option, are streamed to the extractor. Its CPU time and its max RSS are
+ * recorded against the number of entries, and the growth exponents between two consecutive
+ * archives point out where it does not scale linearly.
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+**/
+void test_scale(Fuzzer* fuzzer)
+{
+  unsigned long max = fuzzer->options.scale_max ? fuzzer->options.scale_max : SCALE_MAX;
+  unsigned long counts[SCALE_SHAPES][SCALE_POINTS];
+  double times[SCALE_SHAPES][SCALE_POINTS];
+  long rss[SCALE_SHAPES][SCALE_POINTS];
+  unsigned points[SCALE_SHAPES] = {0};
+
+  for (unsigned shape = 0; shape < SCALE_SHAPES && !fuzzer->stop_reason; shape++)
+  {
+    for (unsigned long count = SCALE_FIRST; count <= max && points[shape] < SCALE_POINTS && !fuzzer->stop_reason; count *= SCALE_STEP)
+    {
+      snprintf(fuzzer->current_test, TEST_NAME_LEN, "scale_%s_%lu", SCALE_NAMES[shape], count);
+      size_t size = write_scale_archive(shape, count);
+      if (size == 0)
+      {
+        printf("The archive of %s could not be written\n", fuzzer->current_test);
+        break;
+      }
+      if (test_file_extractor(fuzzer) == -1)
+        break;
+
+      unsigned p = points[shape]++;
+      counts[shape][p] = count;
+      times[shape][p] = fuzzer->last_time;
+      rss[shape][p] = fuzzer->last_rss;
+      printf("Scale %-9s %8lu entries %9.1f MB: %8.3f s %8ld KB\n", SCALE_NAMES[shape], count,
+             size / 1e6, fuzzer->last_time, fuzzer->last_rss);
+    }
+  }
+
+  // The exponents between consecutive archives, the times too short to be measured are left out
+  printf("\n%-9s %8s %10s %10s %8s %8s\n", "shape", "entries", "time (s)", "RSS (KB)", "time^", "RSS^");
+  for (unsigned shape = 0; shape < SCALE_SHAPES; shape++)
+  {
+    for (unsigned p = 0; p < points[shape]; p++)
+    {
+      printf("%-9s %8lu %10.3f %10ld", SCALE_NAMES[shape], counts[shape][p], times[shape][p], rss[shape][p]);
+      if (p == 0)
+      {
+        printf("\n");
+        continue;
+      }
+      double time_exp = times[shape][p - 1] >= SCALE_MIN_TIME ?
+                        growth_exponent(times[shape][p - 1], times[shape][p], counts[shape][p - 1], counts[shape][p]) : 0;
+      double rss_exp = growth_exponent(rss[shape][p - 1], rss[shape][p], counts[shape][p - 1], counts[shape][p]);
+      printf(" %8.2f %8.2f", time_exp, rss_exp);
+      if (time_exp > SCALE_SUPERLINEAR || rss_exp > SCALE_SUPERLINEAR)
+        printf(KRED "  super-linear" KNRM);
+      printf("\n");
+    }
+  }
+}
+
+/**
+ * Tells whether a block of an archive is read as a header, by walking the headers before it.
+ * Only the mutated block changed, so the walk up to it is the one of the extractor.
+ *
+ * @param[in] data the archive
+ * @param[in] size the size of the archive
+ * @param[in] offset the offset of the block
+ * @return 1 if the block is a header, 0 if it is content or past the end of the archive
+**/
+static int is_header_at(const char *data, size_t size, size_t offset)
+{
+  tar_reader reader;
+  tar_view view;
+  int found = 0;
+  tar_open_memory(&reader, data, size);
+  while (!found && reader.offset <= offset && tar_next(&reader, &view))
+    found = view.offset == offset;
+  tar_close(&reader);
+  return found;
+}
+
+/**
+ * Novelty-driven mutation loop, run in novelty mode after the generators.
+ * Each iteration picks an input of the corpus, favouring the ones that produced new behaviour
+ * classes and that were not picked much yet, stacks a few mutations on its headers and its entries
+ * and tests it. The mutations are chosen by the scheduler from their past yield. The mutations of
+ * the entries rearrange the archive into the other of two buffers, see mutate_entries().
+ * The checksum of the mutated headers is fixed most of the time so that the mutations are not
+ * all rejected by the checksum verification, the content blocks are left as mutated.
+ *
+ * @param[in] fuzzer: A pointer to the Fuzzer struct containing the test case and options.
+**/
+void test_novelty(Fuzzer* fuzzer)
+{
+  tar_buffer current = {NULL, 0, 0}, next = {NULL, 0, 0};
+  entry_list entries;
+  memset(&entries, 0, sizeof(entries));
+
+  for (unsigned long i = 0; i < fuzzer->options.iterations && !fuzzer->stop_reason; i++)
+  {
+    novelty_input *input = novelty_pick(fuzzer->novelty);
+    if (input == NULL)
+      break;
+
+    current.size = 0;
+    tar_buffer_append(&current, input->data, input->size);
+
+    // Stack a few mutations chosen by the scheduler, fixing the checksum 3 times out of 4
+    mutation_op ops[HAVOC_STACK];
+    unsigned stack = 1 + rand() % HAVOC_STACK;
+    for (unsigned j = 0; j < stack; j++)
+    {
+      ops[j] = sched_pick_mutation(fuzzer);
+      if (ops[j] >= MUT_FIRST_ENTRY)
+      {
+        // The entries spliced in come from any input of the corpus
+        const novelty_input *other = &fuzzer->novelty->inputs[rand() % fuzzer->novelty->inputs_count];
+        next.size = 0;
+        mutate_entries(&entries, current.data, current.size, other->data, other->size, ops[j], &next);
+        tar_buffer swap = current;
+        current = next;
+        next = swap;
+        continue;
+      }
+      size_t offset = mutate_archive(current.data, current.size, ops[j]);
+      if (rand() % 4 && is_header_at(current.data, current.size, offset))
+        calculate_checksum((tar_t *)(current.data + offset));
+    }
+
+    snprintf(fuzzer->current_test, TEST_NAME_LEN, "novelty_%lu_%s", i, mutation_name(ops[stack - 1]));
+    write_raw_tar(&fuzzer->archive_buffer, TEST_FILE, current.data, current.size);
+
+    // The operators are rewarded for crashes and new responses
+    fuzzer->last_novelty = NOVELTY_NONE;
+    int rv = test_file_extractor(fuzzer);
+    sched_reward_mutations(fuzzer, ops, stack, rv == 1 || fuzzer->last_novelty != NOVELTY_NONE);
+  }
+
+  entry_list_free(&entries);
+  free(current.data);
+  free(next.data);
+}
+
+/** 
+ * init the path-planning struct
+ * 
+ * @param[in] options the command line options
+ * @param[out] fuzzer fuzzer main structure
+ **/
+Fuzzer* init_fuzzer(const Options *options){
+
+  Fuzzer *fuzzer;
+
+  fuzzer = (Fuzzer*) malloc(sizeof(Fuzzer));
+    
+    if (fuzzer == NULL)
+    {
+		printf("Struct not allocated \n");
+		exit(0);
+	  }
+
+    fuzzer->crashes_number = 0;
+    memset(fuzzer->oracle_crashes, 0, sizeof(fuzzer->oracle_crashes));
+    fuzzer->errors_number = 0;
+    fuzzer->no_out_number = 0;
+    fuzzer->oom_number = 0;
+    fuzzer->memhog_number = 0;
+    fuzzer->max_rss = 0;
+    fuzzer->last_rss = 0;
+    fuzzer->last_time = 0;
+    fuzzer->options = *options;
+    fuzzer->novelty = options->mode == MODE_NOVELTY ? novelty_init() : NULL;
+    fuzzer->last_novelty = NOVELTY_NONE;
+    fuzzer->sched = sched_init(options->stats_file);
+    fuzzer->execs = 0;
+    fuzzer->start_time = now_seconds();
+    fuzzer->first_crash_time = 0;
+    fuzzer->first_crash_execs = 0;
+    fuzzer->stop_reason = NULL;
+
+    // The extractor runs in a scratch directory, so it is given absolute paths
+    if (scratch_create(&fuzzer->scratch, 0) == -1)
+    {
+		printf("Scratch directory not created \n");
+		exit(0);
+	  }
+    if (getcwd(fuzzer->archive, PATH_MAX - sizeof(TEST_FILE) - 1) == NULL)
+    {
+		printf("Current directory too long \n");
+		exit(0);
+	  }
+    strcat(fuzzer->archive, "/" TEST_FILE);
+    fuzzer->exec.mem_limit = options->mem_limit;
+    fuzzer->exec.workdir = fuzzer->scratch.path;
+    fuzzer->exec.sandbox = NULL;
+    fuzzer->exec.timeout = 0;
+    fuzzer->exec.cpus = NULL;
+    fuzzer->cpu_lock = -1;
+    fuzzer->label = NULL;
+    fuzzer->peers = NULL;
+    fuzzer->peers_count = 0;
+    fuzzer->divergences_number = 0;
+    arena_init(&fuzzer->arena);
+    memset(&fuzzer->archive_buffer, 0, sizeof(tar_buffer));
+    fuzzer->library = NULL;
+    fuzzer->snapshot = NULL;
+    fuzzer->sync = NULL;
+    fuzzer->dict = NULL;
+    fuzzer->oom_checked = options->mem_limit ? calloc(OOM_CHECKED, sizeof(uint64_t)) : NULL;
+
+    // The inputs worth keeping are appended to the store, kept between runs
+    if (store_open(&fuzzer->saved, options->store_file, 1) == -1)
+    {
+		printf("Store \"%s\" not opened \n", options->store_file);
+		exit(0);
+	  }
+
+    // The zygote of the sandbox is started once for the whole run
+    if (options->sandbox)
+    {
+      if (sandbox_start(&fuzzer->box) == 0)
+        fuzzer->exec.sandbox = &fuzzer->box;
+      else
+        printf("User namespaces not available, running without sandbox \n");
+    }
+
+    
+    fuzzer->extractor_file = malloc(sizeof(char) * PATH_MAX); // allocate memory for the filename
+    if (fuzzer->extractor_file == NULL)
+    {
+		printf("Array not allocated \n");
+		exit(0);
+	  }
+    memset(fuzzer->extractor_file, 0, PATH_MAX); // initialize the memory to zero
+
+    fuzzer->current_test = malloc(sizeof(char) * TEST_NAME_LEN); // allocate memory for the filename
+    if (fuzzer->current_test == NULL)
+    {
+		printf("Array not allocated \n");
+		exit(0);
+	  }
+    memset(fuzzer->current_test, 0, TEST_NAME_LEN); // initialize the memory to zero
+  
+    return fuzzer;
+}
+
+/**
+ * close the fuzzer struct (memory released, scratch directories removed)
+ *
+ * \param[in] fuzzer fuzzer main structure
+**/
+void free_fuzzer(Fuzzer *fuzzer)
+{
+  if (fuzzer->novelty)
+    novelty_free(fuzzer->novelty);
+  free(fuzzer->sched);
+  store_close(&fuzzer->saved);
+  arena_free(&fuzzer->arena);
+  profile_use(NULL);
+  tar_buffer_free(&fuzzer->archive_buffer);
+  if (fuzzer->library)
+  {
+    harness_close(fuzzer->library);
+    free(fuzzer->library);
+  }
+  if (fuzzer->snapshot)
+  {
+    snapshot_close(fuzzer->snapshot);
+    free(fuzzer->snapshot);
+  }
+  if (fuzzer->sync)
+  {
+    sync_close(fuzzer->sync);
+    free(fuzzer->sync);
+  }
+  if (fuzzer->dict)
+  {
+    mutate_set_dictionary(NULL);
+    dict_free(fuzzer->dict);
+    free(fuzzer->dict);
+  }
+  if (fuzzer->exec.sandbox)
+    sandbox_stop(fuzzer->exec.sandbox);
+  if (fuzzer->cpu_lock != -1)
+    close(fuzzer->cpu_lock);
+
+  // The scratch directories are removed once nothing runs in them, on every way out of fuzz()
+  scratch_remove(&fuzzer->scratch);
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+    scratch_remove(&fuzzer->peers[i].scratch);
+  free(fuzzer->peers);
+  free(fuzzer->oom_checked);
+  free(fuzzer->extractor_file);
+  free(fuzzer->current_test);
+  free(fuzzer);
+}
+
+/**
+ * This function implements the main fuzzing process for evaluating an extractor.
+ * It performs a series of tests on the various fields of a tar header using a fuzzer,
+ * in the order given by the scheduler (see sched_run_families()).
+ * The tests include setting names, testing the mode, user ID, group ID, size, modification time,
+ * checksum, type flag, link name, magic number, version, and user/group names.
+ * Additionally, it tests the end-of-archive and file contents fields.
+ * After running the tests, it cleans up any extractor results and outprintf the number of tests passed,
+ * along with the number of errors and crashes detected by the fuzzer.
+ * 
+ * In memory mode, the memory feedback loop is run after the tests, and in novelty mode the novelty-driven mutation loop.
+ *
+ * With several extractors, the first one is the reference driving the feedback and the others
+ * are run on the same inputs at the same time, to find the inputs on which they disagree.
+ *
+ * @param[in] extractors the file paths of the extractors being tested
+ * @param[in] count the number of extractors, at most MAX_TARGETS
+ * @param[in] options the command line options
+ * 
+**/
+void fuzz(char *const extractors[], unsigned count, const Options *options)
+{
+  // Initialize a fuzzer struct to keep track of tests and errors.
+  Fuzzer *fuzzer;
+  fuzzer = init_fuzzer(options);
+
+  // Copy the absolute filename of the extractor file into the fuzzer struct, a bare name is looked up in the PATH.
+  const char *extractor = extractors[0];
+  if (strchr(extractor, '/') == NULL || realpath(extractor, fuzzer->extractor_file) == NULL)
+    strncpy(fuzzer->extractor_file, extractor, PATH_MAX - 1);
+  fuzzer->label = extractor;
+
+  // A library is opened once and called in a child kept between the executions
+  if (fuzzer->options.library)
+  {
+    fuzzer->library = malloc(sizeof(harness));
+    if (fuzzer->library == NULL)
+    {
+      printf("Struct not allocated \n");
+      exit(0);
+    }
+    if (harness_open(fuzzer->library, fuzzer->extractor_file, fuzzer->options.recycle) == -1)
+    {
+      free(fuzzer->library);
+      fuzzer->library = NULL;
+      free_fuzzer(fuzzer);
+      return;
+    }
+  }
+
+  // The extractor is started once under ptrace and rewound for each input
+  if (fuzzer->options.snapshot)
+  {
+    fuzzer->snapshot = malloc(sizeof(snapshot));
+    if (fuzzer->snapshot == NULL)
+    {
+      printf("Struct not allocated \n");
+      exit(0);
+    }
+    if (snapshot_open(fuzzer->snapshot, fuzzer->extractor_file, fuzzer->archive, &fuzzer->exec) == -1)
+    {
+      free(fuzzer->snapshot);
+      fuzzer->snapshot = NULL;
+      free_fuzzer(fuzzer);
+      return;
+    }
+  }
+
+  // The instances on the same host share what they find through the coordinator
+  if (fuzzer->options.sync_socket)
+  {
+    fuzzer->sync = malloc(sizeof(sync_client));
+    if (fuzzer->sync == NULL)
+    {
+      printf("Struct not allocated \n");
+      exit(0);
+    }
+    if (sync_connect(fuzzer->sync, fuzzer->options.sync_socket) == -1)
+    {
+      free(fuzzer->sync);
+      fuzzer->sync = NULL;
+      free_fuzzer(fuzzer);
+      return;
+    }
+  }
+
+  // The strings of the reference extractor are written in the fields by the mutations
+  if (fuzzer->options.dictionary)
+  {
+    fuzzer->dict = malloc(sizeof(dictionary));
+    if (fuzzer->dict == NULL)
+    {
+      printf("Struct not allocated \n");
+      exit(0);
+    }
+    if (dict_harvest(fuzzer->dict, fuzzer->extractor_file) == 0)
+      mutate_set_dictionary(fuzzer->dict);
+    else
+    {
+      printf("No dictionary can be harvested from \"%s\", the mutations go without it\n", fuzzer->label);
+      free(fuzzer->dict);
+      fuzzer->dict = NULL;
+    }
+  }
+
+  // The other extractors each get their own scratch directory
+  if (count > 1)
+  {
+    fuzzer->peers = calloc(count - 1, sizeof(Peer));
+    if (fuzzer->peers == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+    fuzzer->peers_count = count - 1;
+  }
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+  {
+    Peer *peer = &fuzzer->peers[i];
+    peer->label = extractors[i + 1];
+    if (strchr(peer->label, '/') == NULL || realpath(peer->label, peer->path) == NULL)
+      strncpy(peer->path, peer->label, PATH_MAX - 1);
+    if (scratch_create(&peer->scratch, i + 1) == -1)
+    {
+      printf("Cannot create the scratch directory of %s\n", peer->label);
+      exit(0);
+    }
+  }
+
+  // The fuzzer takes a core no other instance holds, and its extractors go with it: they are
+  // started by the launcher, which does not follow the affinity of the fuzzer
+  cpu_topology topology;
+  if (fuzzer->options.affinity && cpu_topology_read(&topology) == 0)
+  {
+    char cpus[64];
+    if (cpu_claim(&topology, cpu_lock_dir(), &fuzzer->cpus, &fuzzer->cpu_lock) == 0 && cpu_pin(&fuzzer->cpus) == 0)
+    {
+      fuzzer->exec.cpus = &fuzzer->cpus;
+      cpu_slot_format(&fuzzer->cpus, cpus, sizeof(cpus));
+      printf("Pinned to the CPUs %s\n", cpus);
+    }
+    else
+    {
+      if (fuzzer->cpu_lock != -1)
+        close(fuzzer->cpu_lock);
+      fuzzer->cpu_lock = -1;
+      printf("No core is free for the fuzzer, it is not pinned\n");
+    }
+    cpu_topology_free(&topology);
+  }
+
+  // The archives and the outputs go through io_uring when the kernel has it
+  if (fuzzer->options.io_uring && uring_init() == -1)
+    printf("io_uring is not available, the regular system calls are used\n");
+
+  // Print a message to indicate the beginning of the fuzzing process.
+  printf("Begin fuzzing...");
+
+  // Start the clock to measure the duration of the fuzzing process.
+  clock_t start = clock();
+  profile_init(&fuzzer->profile, fuzzer->options.profile);
+  profile_use(&fuzzer->profile);
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+    profile_init(&fuzzer->peers[i].profile, fuzzer->options.profile);
+
+  // Start from the seeds given by the user.
+  if (fuzzer->options.seeds_dir)
+    test_seeds(fuzzer, fuzzer->options.seeds_dir);
+
+  // Run the tests on the different fields in the header, the most promising first.
+  if (fuzzer->options.mode != MODE_SCALE)
+    sched_run_families(fuzzer);
+
+  // Measure how the extractor copes with huge archives
+  if (fuzzer->options.mode == MODE_SCALE)
+    test_scale(fuzzer);
+
+  // Grow the inputs that make the extractor use the most memory
+  if (fuzzer->options.mode == MODE_MEMORY)
+    test_memory(fuzzer);
+
+  // Mutate the inputs that made the extractor behave in new ways
+  if (fuzzer->options.mode == MODE_NOVELTY)
+    test_novelty(fuzzer);
+
+  // Keep what was learnt for the next runs
+  sched_save(fuzzer->sched, fuzzer->options.stats_file);
+
+  // Measure the total duration of the fuzzing process.
+  clock_t duration = clock() - start;
+
+  // Print a message to indicate that the extractor results are being cleaned up.
+  printf("Cleaning extractor results...");
+
+  // Remove the test file used during the fuzzing process, the scratch directories go with the fuzzer struct.
+  unlink(TEST_FILE);
+
+  // Print a summary of the results of the fuzzing process.
+  printf("\n%d tests passed in %.3f s:\n", fuzzer->errors_number + fuzzer->no_out_number + fuzzer->crashes_number + fuzzer->oom_number, (float)duration / CLOCKS_PER_SEC);
+  printf(KYEL "%d without output" KNRM "\n", fuzzer->no_out_number);
+  printf(KRED "%d errors" KNRM " catched by the extractor\n", fuzzer->errors_number);
+  printf(KGRN "%d crashes" KNRM " detected by the fuzzer", fuzzer->crashes_number);
+  for (unsigned i = 0; i < ORACLES_COUNT && fuzzer->crashes_number; i++)
+    printf("%s%u %s", i ? ", " : " (", fuzzer->oracle_crashes[i], ORACLES[i].name);
+  printf("%s\n", fuzzer->crashes_number ? ")" : "");
+  if (fuzzer->options.mem_limit)
+    printf(KMAG "%d over-allocations" KNRM " caught by the memory limit\n", fuzzer->oom_number);
+  printf("Max RSS of the extractor: %ld KB", fuzzer->max_rss);
+  if (fuzzer->options.mode == MODE_MEMORY)
+    printf(" (%d inputs kept in %s)", fuzzer->memhog_number, fuzzer->options.store_file);
+  printf("\n");
+  if (fuzzer->novelty)
+    novelty_report(fuzzer->novelty);
+  sched_report(fuzzer);
+  if (fuzzer->exec.sandbox)
+    sandbox_report(fuzzer->exec.sandbox);
+  report_peers(fuzzer);
+  if (fuzzer->library)
+    harness_report(fuzzer->library);
+  if (fuzzer->snapshot)
+    snapshot_report(fuzzer->snapshot);
+  if (fuzzer->sync)
+  {
+    sync_exchange(fuzzer->sync, fuzzer->novelty, 1);
+    sync_report(fuzzer->sync);
+  }
+  if (fuzzer->dict)
+    dict_report(fuzzer->dict);
+  uring_report(fuzzer->execs);
+  const profile_state *profiles[MAX_TARGETS] = {&fuzzer->profile};
+  for (unsigned i = 0; i < fuzzer->peers_count; i++)
+    profiles[i + 1] = &fuzzer->peers[i].profile;
+  profile_report(profiles, fuzzer->peers_count + 1, fuzzer->execs);
+
+  // Free up memory used by the fuzzer struct.
+  free_fuzzer(fuzzer);
+  uring_free();
+}
@@ -1,51 +1,170 @@
-#ifndef FUZZ_H
-#define FUZZ_H
-
-#define KNRM  "\x1B[0m"
-#define KRED  "\x1B[31m"
-#define KGRN  "\x1B[32m"
-#define KYEL  "\x1B[33m"
-#define KBLU  "\x1B[34m"
-#define KMAG  "\x1B[35m"
-#define KCYN  "\x1B[36m"
-#define KWHT  "\x1B[37m"
-
-#define EXT ".txt" //extension to put at the end of file to easily clean
-
-#define TEST_FILE "test.tar"
-#define CRASH_MSG "*** The program has crashed ***\n"
-#define LEN_CRASH_MSG strlen(CRASH_MSG) + 1
-
-typedef struct
-{
-    int errors_number;
-    int no_out_number;
-    int crashes_number;
-    char *extractor_file;
-    char *current_test;
-} Fuzzer;
-
-
-int test_file_extractor(Fuzzer* fuzzer);
-void test_header(Fuzzer *fuzzer);
-void set_name(Fuzzer* fuzzer, const char *name, const char *field_name);
-void generic_field_tests(Fuzzer* fuzzer, const char *field_name, char *field, unsigned size);
-void test_names(int linkname, Fuzzer *fuzzer);
-void test_mode(Fuzzer *fuzzer);
-void test_uid(Fuzzer* fuzzer);
-void test_gid(Fuzzer* fuzzer);
-void test_size(Fuzzer* fuzzer);
-void test_mtime(Fuzzer* fuzzer);
-void test_chksum(Fuzzer* fuzzer);
-void test_typeflag(Fuzzer* fuzzer);
-void test_linkname(Fuzzer* fuzzer);
-void test_magic(Fuzzer* fuzzer);
-void test_version(Fuzzer* fuzzer);
-void test_uname(Fuzzer* fuzzer, int gname);
-void test_end_bytes(Fuzzer* fuzzer);
-void test_files(Fuzzer* fuzzer);
-Fuzzer* init_fuzzer();
-void free_fuzzer(Fuzzer *fuzzer);
-void fuzz(const char* extractor);
-
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include "novelty.h"
+#include "exec.h"
+#include "scratch.h"
+#include "sandbox.h"
+#include "store.h"
+#include "arena.h"
+#include "profile.h"
+#include "harness.h"
+#include "snapshot.h"
+#include "uring.h"
+#include "sync.h"
+#include "dict.h"
+#include "oracle.h"
+#include "cpu.h"
+#include "tar.h"
+
+#define KNRM  "\x1B[0m"
+#define KRED  "\x1B[31m"
+#define KGRN  "\x1B[32m"
+#define KYEL  "\x1B[33m"
+#define KBLU  "\x1B[34m"
+#define KMAG  "\x1B[35m"
+#define KCYN  "\x1B[36m"
+#define KWHT  "\x1B[37m"
+
+#define EXT ".txt" //extension to put at the end of file to easily clean
+
+#define TEST_FILE "test.tar"
+
+#define TEST_NAME_LEN (NAME_LEN / 2) // size of the name of the current test, null included
+
+#define MAX_TARGETS 8 // maximum number of extractors compared in differential mode
+
+#define OOM_CHECKED 1024 // responses remembered as not caused by the memory limit, see is_over_allocation()
+
+#define MEMHOG_PATIENCE 3 // number of steps without a new max RSS before a memory feedback loop gives up
+
+#define EXTENDED_RECORDS 4          // records of a generated pax extended header at most
+#define EXTENDED_HUGE (16 * 1024 * 1024) // biggest value of a generated pax record or GNU long name
+
+#define SCALE_FIRST 1000            // entries of the smallest archive of the scaling tests
+#define SCALE_STEP 4                // growth of the number of entries from one scaling test to the next
+#define SCALE_MAX (1000 * 1024)     // default entries of the biggest archive
+#define SCALE_POINTS 16             // scaling tests of a shape at most
+#define SCALE_FANOUT 1024           // directories of the fan-out archives
+#define SCALE_SAME_NAMES 16         // names shared by the entries of the overwrite archives
+#define SCALE_DEPTH ((NAME_LEN - 1 + 155 - 10) / 2) // levels of "d/" under a root of 9 characters fitting in prefix and name
+#define SCALE_SUPERLINEAR 1.3       // growth exponent of the time or the RSS of the extractor reported as super-linear
+#define SCALE_MIN_TIME 0.05         // runs shorter than this, in seconds, are too noisy to compute a growth exponent
+
+typedef enum
+{
+    MODE_GENERATION, // run each generator once
+    MODE_MEMORY,     // run the generators then grow the inputs using the max RSS of the extractor as feedback
+    MODE_NOVELTY,    // run the generators then mutate the inputs that produced new responses of the extractor
+    MODE_SCALE,      // only stream archives of growing numbers of entries and report how the extractor scales
+} fuzz_mode;
+
+typedef struct
+{
+    fuzz_mode mode;
+    size_t mem_limit;  // RLIMIT_AS of the extractor in bytes, 0 for no limit
+    int page_faults;   // print the page faults with each new max RSS
+    unsigned long iterations; // number of mutated inputs tested by the random modes
+    unsigned max_crashes;     // stop after this number of crashes, 0 for no limit
+    unsigned long exec_budget; // stop after this number of executions, 0 for no limit
+    double time_budget;       // stop after this number of seconds, 0 for no limit
+    const char *stats_file;   // statistics of the families and mutations kept between runs
+    int sandbox;              // run the extractor in user and mount namespaces with a private tmpfs
+    const char *seeds_dir;    // directory of archives run before the generators, NULL for none
+    const char *store_file;   // store keeping the crashes and the other inputs worth keeping
+    int profile;              // time the stages of each execution and report where the time goes
+    int library;              // the extractor is a library called in process through its extract() entry point
+    unsigned recycle;         // calls served by a child of the library before it is replaced, 0 for the default
+    int snapshot;             // run the extractor under ptrace, rewound to the open of the archive for each input
+    int io_uring;             // write the archives and read the outputs through io_uring
+    const char *sync_socket;  // socket of the coordinator shared with the other instances, NULL for none
+    int dictionary;           // mutate the fields with the strings harvested from the extractor
+    unsigned long scale_max;  // entries of the biggest archive of the scaling tests, 0 for SCALE_MAX
+    int affinity;             // pin the fuzzer and its extractors to the core it starts on
+} Options;
+
+// Other extractor run on the same inputs as the reference one in differential mode
+typedef struct
+{
+    const char *label;      // path given on the command line
+    char path[PATH_MAX];    // absolute path of the extractor
+    scratch_dir scratch;    // directory it runs in
+    profile_state profile;  // stages of its runs, the waits shared with the other extractors go to the fuzzer
+    int no_out_number;
+    int errors_number;
+    int crashes_number;
+} Peer;
+
+typedef struct
+{
+    int errors_number;
+    int no_out_number;
+    int crashes_number;
+    unsigned oracle_crashes[ORACLES_COUNT]; // crashes found by each oracle
+    int oom_number;     // over-allocations caught by the memory limit
+    int memhog_number;  // inputs that set a new max RSS
+    long max_rss;       // highest max RSS of the extractor in KB
+    long last_rss;      // max RSS of the last run of the extractor in KB
+    double last_time;   // CPU time of the last run of the extractor in seconds
+    char *extractor_file;
+    char *current_test;
+    Options options;
+    novelty_state *novelty; // response classes and corpus of the novelty mode, NULL in the other modes
+    int last_novelty;       // novelty of the last response, see novelty.h
+    struct sched_state *sched; // statistics used to schedule the families and mutations
+    unsigned long execs;    // number of executions of the extractor
+    double start_time;      // wall-clock time of the beginning of the fuzzing
+    double first_crash_time;
+    unsigned long first_crash_execs;
+    const char *stop_reason; // why the fuzzing stopped early, NULL while it goes on
+    scratch_dir scratch;    // directory the extractor runs in
+    char archive[PATH_MAX]; // absolute path of TEST_FILE, given to the extractor
+    exec_options exec;      // how the extractor is run
+    cpu_slot cpus;          // CPUs the fuzzer is pinned to, given to its extractors through exec.cpus
+    int cpu_lock;           // descriptor holding the lock of the core of the fuzzer, -1 when not pinned
+    sandbox box;            // namespaces the extractor runs in when the sandbox is enabled
+    const char *label;      // path of the reference extractor given on the command line
+    Peer *peers;            // extractors compared with the reference one, NULL if there is only one
+    unsigned peers_count;
+    int divergences_number; // inputs on which the extractors did not behave the same
+    store saved;            // inputs kept: crashes, over-allocations, new max RSS, divergences
+    arena arena;            // memory of the archive of the current test, reset before each execution
+    tar_buffer archive_buffer; // the archives are built in it before being written, kept from one archive to the next
+    profile_state profile;  // stages of the executions of the reference extractor and of the fuzzer itself
+    harness *library;       // the extractor called in process, NULL when it runs as a program
+    snapshot *snapshot;     // the extractor rewound for each input, NULL when it is executed for each one
+    sync_client *sync;      // the connection to the other instances, NULL when running alone
+    dictionary *dict;       // tokens of the extractor written by the mutations, NULL without dictionary
+    uint64_t *oom_checked;  // buckets of the responses that are not caused by the memory limit, NULL without limit
+} Fuzzer;
+
+
+int test_file_extractor(Fuzzer* fuzzer);
+void test_header(Fuzzer *fuzzer);
+void set_name(Fuzzer* fuzzer, const char *name, const char *field_name);
+void generic_field_tests(Fuzzer* fuzzer, const char *field_name, char *field, unsigned size);
+void test_names(int linkname, Fuzzer *fuzzer);
+void test_mode(Fuzzer *fuzzer);
+void test_uid(Fuzzer* fuzzer);
+void test_gid(Fuzzer* fuzzer);
+void test_size(Fuzzer* fuzzer);
+void test_mtime(Fuzzer* fuzzer);
+void test_chksum(Fuzzer* fuzzer);
+void test_numeric(Fuzzer* fuzzer);
+void test_typeflag(Fuzzer* fuzzer);
+void test_linkname(Fuzzer* fuzzer);
+void test_magic(Fuzzer* fuzzer);
+void test_version(Fuzzer* fuzzer);
+void test_uname(Fuzzer* fuzzer, int gname);
+void test_end_bytes(Fuzzer* fuzzer);
+void test_files(Fuzzer* fuzzer);
+void test_extended(Fuzzer* fuzzer);
+void test_seeds(Fuzzer* fuzzer, const char *dir);
+void test_memory(Fuzzer* fuzzer);
+void test_novelty(Fuzzer* fuzzer);
+void test_scale(Fuzzer* fuzzer);
+Fuzzer* init_fuzzer(const Options *options);
+void free_fuzzer(Fuzzer *fuzzer);
+void fuzz(char *const extractors[], unsigned count, const Options *options);
+
 #endif
\ No newline at end of file
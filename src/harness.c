@@ -0,0 +1,427 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "fuzzer.h"
+#include "harness.h"
+#include "profile.h"
+
+// What the child answers after each call
+typedef struct
+{
+    int32_t ret;        // value returned by the entry point
+    int32_t unused;
+    int64_t max_rss;    // growth of the RSS of the child during the call at its peak, in KB
+    int64_t rss;        // RSS of the child after the call in KB
+} harness_reply;
+
+/**
+ * Opens an extractor library and the memory shared with the children. The library is opened
+ * in the fuzzer, so that each child only has to be forked to be ready.
+ *
+ * @param[out] h the harness
+ * @param[in] library path of the library
+ * @param[in] recycle number of calls served by a child before it is replaced, 0 for the default
+ * @return 0 on success, -1 if the library or its entry point cannot be loaded
+**/
+int harness_open(harness *h, const char *library, unsigned recycle)
+{
+  memset(h, 0, sizeof(harness));
+  h->command_fd = h->reply_fd = h->output_fd = -1;
+  h->recycle = recycle ? recycle : HARNESS_RECYCLE;
+
+  h->library = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+  if (h->library == NULL)
+  {
+    printf("The library \"%s\" cannot be loaded: %s\n", library, dlerror());
+    return -1;
+  }
+  h->entry = (harness_entry)dlsym(h->library, HARNESS_SYMBOL);
+  if (h->entry == NULL)
+  {
+    printf("The library \"%s\" has no " HARNESS_SYMBOL "() entry point\n", library);
+    dlclose(h->library);
+    return -1;
+  }
+
+  h->input = mmap(NULL, HARNESS_MAX_INPUT, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (h->input == MAP_FAILED)
+  {
+    printf("Memory not mapped \n");
+    dlclose(h->library);
+    return -1;
+  }
+
+  // A child dying before it reads its command must not kill the fuzzer
+  signal(SIGPIPE, SIG_IGN);
+  return 0;
+}
+
+/**
+ * Reads a size in KB from /proc/self/status, like "VmRSS:".
+ *
+ * @return the size, 0 if it cannot be read
+**/
+static long status_kb(const char *field)
+{
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL)
+    return 0;
+  char line[256];
+  long kb = 0;
+  size_t len = strlen(field);
+  while (fgets(line, sizeof(line), f))
+  {
+    if (strncmp(line, field, len) == 0)
+    {
+      kb = strtol(line + len, NULL, 10);
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+/**
+ * Resets the peak RSS of the child, VmHWM, to its current RSS.
+ *
+ * @return 1 on success, 0 if the kernel cannot reset it
+**/
+static int reset_peak_rss(void)
+{
+  int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if (fd == -1)
+    return 0;
+  int reset = write(fd, "5", 1) == 1;
+  close(fd);
+  return reset;
+}
+
+/**
+ * Serves the calls of the fuzzer until it closes the command pipe: for each size read from it,
+ * the entry point is called on the shared input and its result is written back.
+ * The child is forked from the fuzzer, whose pages it maps and whose high-water mark its ru_maxrss
+ * starts from, so the memory of a call is measured as the growth of its RSS: the peak is reset
+ * before the call, or the growth of ru_maxrss is used when the kernel cannot reset it.
+**/
+static void harness_child(harness *h, const exec_options *options, int output)
+{
+  dup2(output, STDOUT_FILENO);
+  dup2(output, STDERR_FILENO);
+  close(output);
+  signal(SIGPIPE, SIG_DFL);
+
+  if (options && options->workdir && chdir(options->workdir) == -1)
+    _exit(1);
+  if (options && options->mem_limit)
+  {
+    struct rlimit limit = {options->mem_limit, options->mem_limit};
+    setrlimit(RLIMIT_AS, &limit);
+  }
+
+  uint64_t size;
+  while (read(h->command_fd, &size, sizeof(size)) == sizeof(size))
+  {
+    harness_reply reply;
+    memset(&reply, 0, sizeof(reply));
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long before = status_kb("VmRSS:");
+    long max_before = usage.ru_maxrss;
+    int reset = reset_peak_rss();
+
+    reply.ret = h->entry(h->input, size);
+    fflush(stdout);
+    fflush(stderr);
+
+    getrusage(RUSAGE_SELF, &usage);
+    reply.rss = status_kb("VmRSS:");
+    reply.max_rss = reset ? status_kb("VmHWM:") - before : usage.ru_maxrss - max_before;
+    if (reply.max_rss < 0)
+      reply.max_rss = 0;
+    if (write(h->reply_fd, &reply, sizeof(reply)) != sizeof(reply))
+      break;
+  }
+  _exit(0);
+}
+
+/**
+ * Forks a child serving the calls, with a pipe for the commands, one for the replies
+ * and one for its output.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int harness_spawn(harness *h, const exec_options *options)
+{
+  int command[2], reply[2], output[2];
+  if (pipe2(command, O_CLOEXEC) == -1)
+    return -1;
+  if (pipe2(reply, O_CLOEXEC) == -1)
+  {
+    close(command[0]);
+    close(command[1]);
+    return -1;
+  }
+  if (pipe2(output, O_CLOEXEC) == -1)
+  {
+    close(command[0]);
+    close(command[1]);
+    close(reply[0]);
+    close(reply[1]);
+    return -1;
+  }
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == -1)
+  {
+    printf("Error forking the harness!");
+    for (int i = 0; i < 2; i++)
+    {
+      close(command[i]);
+      close(reply[i]);
+      close(output[i]);
+    }
+    return -1;
+  }
+
+  if (pid == 0)
+  {
+    close(command[1]);
+    close(reply[0]);
+    close(output[0]);
+    h->command_fd = command[0];
+    h->reply_fd = reply[1];
+    harness_child(h, options, output[1]);
+  }
+
+  close(command[0]);
+  close(reply[1]);
+  close(output[1]);
+  h->pid = pid;
+  h->command_fd = command[1];
+  h->reply_fd = reply[0];
+  h->output_fd = output[0];
+  fcntl(h->output_fd, F_SETFL, O_NONBLOCK);
+  h->calls = 0;
+  h->base_rss = 0;
+  h->children++;
+  return 0;
+}
+
+/**
+ * Stops the child: it leaves when the command pipe is closed, or is killed when it misbehaved.
+ *
+ * @param[in] h the harness
+ * @param[in] kill_it 1 to kill the child rather than asking it to leave
+ * @param[out] status the wait status of the child, may be NULL
+ * @param[out] usage the resource usage of the child, may be NULL
+**/
+static void harness_stop(harness *h, int kill_it, int *status, struct rusage *usage)
+{
+  if (h->pid == 0)
+    return;
+  if (kill_it)
+    kill(h->pid, SIGKILL);
+  close(h->command_fd);
+
+  int wstatus = 0;
+  struct rusage ru;
+  while (wait4(h->pid, &wstatus, 0, &ru) == -1 && errno == EINTR)
+    ;
+  if (status)
+    *status = wstatus;
+  if (usage)
+    *usage = ru;
+
+  close(h->reply_fd);
+  close(h->output_fd);
+  h->command_fd = h->reply_fd = h->output_fd = -1;
+  h->pid = 0;
+}
+
+/**
+ * Reads what the child wrote so far, keeping the beginning of the output.
+**/
+static void harness_drain(int fd, exec_result *result)
+{
+  char drain[OUTPUT_LEN];
+  for (;;)
+  {
+    ssize_t n;
+    if (result->output_len < OUTPUT_LEN - 1)
+      n = read(fd, result->output + result->output_len, OUTPUT_LEN - 1 - result->output_len);
+    else
+      n = read(fd, drain, sizeof(drain));
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    if (result->output_len < OUTPUT_LEN - 1)
+      result->output_len += n;
+  }
+  result->output[result->output_len] = '\0';
+}
+
+/**
+ * Calls the entry point of the library on an archive, in the child kept alive between the calls.
+ * The results look like the ones of exec_target(): the exit status is the value returned by the
+ * entry point, and a child killed by a signal keeps its wait status, so that the oracles report the
+ * signal and the sanitizer output it printed as they do for the extractor run as a program.
+ * The child is replaced after a crash, a timeout, a growth of its RSS beyond HARNESS_LEAK_KB,
+ * or once it served the number of calls given to harness_open(). The max RSS is the growth of
+ * the RSS of the child during the call, see harness_child(). An input bigger than the shared
+ * memory is not run.
+ *
+ * @param[in] h the harness
+ * @param[in] archive path of the archive, read into the shared memory
+ * @param[in] options the executor options (memory limit, working directory, timeout), can be NULL
+ * @param[out] result the status, the max RSS and the beginning of the output
+ * @return 0 on success, -1 if the call could not be made or the input is too big
+**/
+int harness_run(harness *h, const char *archive, const exec_options *options, exec_result *result)
+{
+  result->status = 0;
+  result->output_len = 0;
+  result->output[0] = '\0';
+  result->timed_out = 0;
+  memset(&result->usage, 0, sizeof(result->usage));
+
+  // The input goes to the shared memory, the child reads it in place
+  uint64_t start = profile_start();
+  int fd = open(archive, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size > HARNESS_MAX_INPUT)
+  {
+    if (h->too_big++ == 0)
+      printf("The inputs bigger than %d MB are not given to the library, they are skipped\n", HARNESS_MAX_INPUT / (1024 * 1024));
+    close(fd);
+    return -1;
+  }
+  uint64_t size = 0;
+  ssize_t n;
+  while (size < HARNESS_MAX_INPUT && (n = read(fd, h->input + size, HARNESS_MAX_INPUT - size)) != 0)
+  {
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n == -1)
+      break;
+    size += n;
+  }
+  close(fd);
+
+  if (h->pid == 0 && harness_spawn(h, options) == -1)
+    return -1;
+  profile_stop(PHASE_SPAWN, start);
+
+  start = profile_start();
+  if (write(h->command_fd, &size, sizeof(size)) != sizeof(size))
+  {
+    harness_stop(h, 1, NULL, NULL);
+    return -1;
+  }
+
+  // Wait for the reply, reading the output meanwhile so that the child never blocks on it
+  double deadline = options && options->timeout > 0 ? now_seconds() + options->timeout : 0;
+  harness_reply reply;
+  size_t got = 0;
+  int died = 0;
+  while (got < sizeof(reply))
+  {
+    struct pollfd fds[2] = {{h->reply_fd, POLLIN, 0}, {h->output_fd, POLLIN, 0}};
+    int wait = -1;
+    if (deadline)
+    {
+      double left = deadline - now_seconds();
+      wait = left > 0 ? (int)(left * 1000) + 1 : 0;
+    }
+    int ready = poll(fds, 2, wait);
+    if (ready == -1 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+    {
+      result->timed_out = ready == 0;
+      died = 1;
+      break;
+    }
+    if (fds[1].revents)
+      harness_drain(h->output_fd, result);
+    if (fds[0].revents)
+    {
+      n = read(h->reply_fd, (char *)&reply + got, sizeof(reply) - got);
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+      {
+        died = 1;
+        break;
+      }
+      got += n;
+    }
+  }
+  harness_drain(h->output_fd, result);
+
+  if (died)
+  {
+    // The child is replaced, the signal that killed it is left to the oracles
+    harness_stop(h, 1, &result->status, &result->usage);
+    h->recycled++;
+    profile_stop(PHASE_WAIT, start);
+    return 0;
+  }
+
+  result->status = (reply.ret & 0xff) << 8;
+  result->usage.ru_maxrss = reply.max_rss;
+  h->calls++;
+  if (h->calls == 1)
+    h->base_rss = reply.rss;
+  else if (reply.rss - h->base_rss > HARNESS_LEAK_KB)
+  {
+    harness_stop(h, 0, NULL, NULL);
+    h->recycled++;
+  }
+  if (h->pid && h->calls >= h->recycle)
+    harness_stop(h, 0, NULL, NULL);
+  profile_stop(PHASE_WAIT, start);
+  return 0;
+}
+
+/**
+ * Prints the number of children used by the harness.
+ *
+ * @param[in] h the harness
+**/
+void harness_report(const harness *h)
+{
+  printf("In-process harness: %lu children, %lu replaced after a crash, a leak or a timeout\n", h->children, h->recycled);
+  if (h->too_big)
+    printf("%lu inputs bigger than %d MB skipped\n", h->too_big, HARNESS_MAX_INPUT / (1024 * 1024));
+}
+
+/**
+ * Stops the child and closes the library.
+ *
+ * @param[in] h the harness
+**/
+void harness_close(harness *h)
+{
+  harness_stop(h, 0, NULL, NULL);
+  if (h->input && h->input != MAP_FAILED)
+    munmap(h->input, HARNESS_MAX_INPUT);
+  if (h->library)
+    dlclose(h->library);
+  memset(h, 0, sizeof(harness));
+}
@@ -0,0 +1,41 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "exec.h"
+
+#define HARNESS_SYMBOL "extract"            // entry point looked up in the library
+#define HARNESS_RECYCLE 1000                // default number of calls served by a child before it is replaced
+#define HARNESS_MAX_INPUT (64 * 1024 * 1024) // size of the memory shared with the child, bigger inputs are not run
+#define HARNESS_LEAK_KB (64 * 1024)         // growth of the RSS of a child that makes it replaced
+
+// Entry point of an extractor built as a library: the archive, its size, and the exit status of the CLI
+typedef int (*harness_entry)(const uint8_t *data, size_t size);
+
+// Extractor library called in a forked child, kept alive between the calls
+typedef struct
+{
+    void *library;          // handle of the library, opened once in the fuzzer
+    harness_entry entry;
+    unsigned recycle;       // number of calls before the child is replaced
+    pid_t pid;              // the child, 0 when there is none
+    int command_fd;         // the fuzzer writes the size of each input to it
+    int reply_fd;           // the child writes the result of each call to it
+    int output_fd;          // stdout and stderr of the child
+    unsigned calls;         // calls served by the current child
+    long base_rss;          // RSS of the child after its first call in KB, its growth tells the leaks
+    uint8_t *input;         // memory shared with the children, holding the input
+    unsigned long children; // number of children started
+    unsigned long recycled; // children replaced after a crash, a leak or a timeout
+    unsigned long too_big;  // inputs bigger than HARNESS_MAX_INPUT, not run
+} harness;
+
+int harness_open(harness *h, const char *library, unsigned recycle);
+int harness_run(harness *h, const char *archive, const exec_options *options, exec_result *result);
+void harness_report(const harness *h);
+void harness_close(harness *h);
+
+#endif
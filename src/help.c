@@ -1,5 +1,9 @@
 #include <stdio.h>
 #include <string.h>
+#include <sys/wait.h>
+
+#include "checksum.h"
+#include "oracle.h"
 
 struct tar_t
 {                              /* byte offset */
@@ -24,11 +28,12 @@ struct tar_t
 
 /**
  * Launches another executable given as argument,
- * parses its output and check whether or not it matches "*** The program has crashed ***".
+ * parses its output and its exit status and asks the oracles of the fuzzer whether it crashed:
+ * "*** The program has crashed ***", a sanitizer report or a fault signal.
  * @param the path to the executable
  * @return -1 if the executable cannot be launched,
- *          0 if it is launched but does not print "*** The program has crashed ***",
- *          1 if it is launched and prints "*** The program has crashed ***".
+ *          0 if it is launched and does not crash,
+ *          1 if it is launched and crashes.
  *
  * BONUS (for fun, no additional marks) without modifying this code,
  * compile it and use the executable to restart our computer.
@@ -41,8 +46,9 @@ int main(int argc, char* argv[])
     char cmd[51];
     strncpy(cmd, argv[1], 25);
     cmd[26] = '\0';
-    strncat(cmd, " archive.tar", 25);
-    char buf[33];
+    strncat(cmd, " archive.tar 2>&1", 25);
+    char buf[ORACLE_SCAN_LEN];
+    size_t len = 0;
     FILE *fp;
 
     if ((fp = popen(cmd, "r")) == NULL) {
@@ -50,22 +56,37 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    if(fgets(buf, 33, fp) == NULL) {
-        printf("No output\n");
-        goto finally;
+    // The beginning of the output is judged, the rest is read so that the command can end
+    size_t n;
+    char chunk[512];
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        size_t keep = n < sizeof(buf) - len ? n : sizeof(buf) - len;
+        memcpy(buf + len, chunk, keep);
+        len += keep;
     }
-    if(strncmp(buf, "*** The program has crashed ***\n", 33)) {
+
+    int status = pclose(fp);
+    if(status == -1) {
+        printf("Command not found\n");
+        return -1;
+    }
+
+    // The shell reports a command killed by a signal as an exit code of 128 + the signal
+    if(WIFEXITED(status) && WEXITSTATUS(status) > 128)
+        status = WEXITSTATUS(status) - 128;
+
+    oracle_result verdict;
+    switch(oracle_judge(buf, len, status, &verdict)) {
+    case VERDICT_NO_OUTPUT:
+        printf("No output\n");
+        break;
+    case VERDICT_ERROR:
         printf("Not the crash message\n");
-        goto finally;
-    } else {
-        printf("Crash message\n");
+        break;
+    default:
+        printf("Crash message (%s: %s)\n", verdict.oracle, verdict.detail);
         rv = 1;
-        goto finally;
-    }
-    finally:
-    if(pclose(fp) == -1) {
-        printf("Command not found\n");
-        rv = -1;
+        break;
     }
     return rv;
 }
@@ -76,19 +97,10 @@ int main(int argc, char* argv[])
  * @return the value of the checksum
  */
 unsigned int calculate_checksum(struct tar_t* entry){
-    // use spaces for the checksum bytes while calculating the checksum
-    memset(entry->chksum, ' ', 8);
-
-    // sum of entire metadata
-    unsigned int check = 0;
-    unsigned char* raw = (unsigned char*) entry;
-    for(int i = 0; i < 512; i++){
-        check += raw[i];
-    }
-
-    snprintf(entry->chksum, sizeof(entry->chksum), "%06o0", check);
+    // the chksum field is counted as spaces by the sum
+    unsigned int check = checksum_header(entry);
 
-    entry->chksum[6] = '\0';
-    entry->chksum[7] = ' ';
+    // six octal digits, a null and a space
+    checksum_encode(entry->chksum, check);
     return check;
 }
\ No newline at end of file
@@ -1,45 +1,343 @@
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <time.h>
-
-#include "tar.h"
-#include "fuzzer.h"
-
-/**
- * The main function of the generation-based fuzzer.
- * It checks the command line arguments, verifies that the extractor file exists, and then calls the fuzz function.
- * @param[in] argc The number of command line arguments.
- * @param[in] argv An array of strings containing the command line arguments.
- * @param[out] 0 if the fuzzer ran successfully, -1 otherwise.
-**/
-int main(int argc, char *argv[])
-{
-  // Check if the correct number of arguments was provided
-  if (argc < 2)
-  {
-    printf("You have to write the name of the file of the extractor after the fuzzer executable. Like this:\n");
-    printf("./fuzzer ./<path-to-extractor>");
-    return -1;
-  }
-
-  printf("\n--- Starting the following generation-based fuzzer ---\n");
-  printf("%s\n", argv[1]);
-
-  // Check if the extractor file exists
-  FILE *fuzzer_test = fopen(argv[1], "rb");
-  if (!fuzzer_test)
-  {
-  printf("The extractor \"%s\" doesn't exist\n", argv[1]);
-  return -1;
-  }
-  fclose(fuzzer_test);
-
-  // Seed the random number generator
-  srand(time(NULL));
-
-  // Call the fuzz function with the provided extractor file
-  fuzz(argv[1]);
-
-  return 0;
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "tar.h"
+#include "fuzzer.h"
+#include "sched.h"
+#include "replay.h"
+
+/**
+ * Prints how to use the fuzzer.
+**/
+static void usage(void)
+{
+  printf("You have to write the name of the file of the extractor after the fuzzer executable. Like this:\n");
+  printf("./fuzzer [options] ./<path-to-extractor> [./<other-extractor>...]\n");
+  printf("With several extractors, each input is run on all of them and the ones they disagree on are kept in the store\n");
+  printf("Options:\n");
+  printf("  -m <mode>  fuzzing mode: \"gen\" (default) runs each generator once,\n");
+  printf("             \"mem\" also grows the inputs using the max RSS of the extractor as feedback,\n");
+  printf("             \"novelty\" also mutates the inputs that produced new responses of the extractor,\n");
+  printf("             \"scale\" only streams archives of %d to --scale-max entries (flat, wide, deep and\n", SCALE_FIRST);
+  printf("             overwritten) and reports the CPU time and the max RSS of the extractor against their size\n");
+  printf("  -l <MB>    limit the address space of the extractor (RLIMIT_AS) to report over-allocations\n");
+  printf("  -p         print the page faults of the extractor with each new max RSS\n");
+  printf("  -n <N>     number of mutated inputs tested in novelty mode (default 10000)\n");
+  printf("  -c <N>     stop after N crashes\n");
+  printf("  -e <N>     stop after N executions of the extractor\n");
+  printf("  -t <s>     stop after s seconds\n");
+  printf("  -s <file>  statistics used to order the tests, kept between runs (default " STATS_FILE ")\n");
+  printf("  -z         run the extractor in a user and mount namespace sandbox with a private tmpfs\n");
+  printf("  -i <dir>   run the tar archives of a directory first, as seeds of the novelty corpus\n");
+  printf("  -o <file>  store keeping the crashes and the other inputs found, across runs (default " STORE_FILE ")\n");
+  printf("  -x <n|all> export the input n of the store, or all of them, as <kind>_<n>_<test>.tar and exit\n");
+  printf("  -P, --profile        time the stages of each execution (generation, write, spawn, wait,\n");
+  printf("                       classification) and report where the time goes, summed over the extractors\n");
+  printf("                       compared and over the workers when replaying or distilling\n");
+  printf("  -L, --library        the extractor is a shared library exporting int " HARNESS_SYMBOL "(const uint8_t *, size_t),\n");
+  printf("                       called in a forked child instead of starting a process for each input\n");
+  printf("  -R, --recycle <N>    calls served by a child of the library before it is replaced (default %d)\n", HARNESS_RECYCLE);
+  printf("  -S, --snapshot       run the extractor once under ptrace and rewind it to the open of the archive\n");
+  printf("                       for each input instead of starting it again (x86_64)\n");
+  printf("  -U, --io-uring       write the archives and read the outputs of the extractors through io_uring,\n");
+  printf("                       with the regular system calls on the kernels without it\n");
+  printf("  -y, --sync <socket>  share the crashes, behaviour classes and corpus with the other instances\n");
+  printf("                       connected to the coordinator listening on the socket\n");
+  printf("  -Y, --coordinator <socket>  run the coordinator of the instances of the host on the socket\n");
+  printf("                       until interrupted, then exit\n");
+  printf("  -D, --dictionary     harvest the strings of the read-only data of the extractor (magic values,\n");
+  printf("                       keywords, field names) and write them in the fields in novelty mode\n");
+  printf("  -A, --affinity       pin the fuzzer and its extractors to a core no other instance holds, or each worker\n");
+  printf("                       and its extractors to a core of its own when replaying or distilling\n");
+  printf("  -M, --scale-max <N>  entries of the biggest archive of the scale mode (default %d)\n", SCALE_MAX);
+  printf("  -O, --oracles <list> oracles deciding what a crash is, separated by commas (default all):\n");
+  printf("                       \"message\" the crash message of the extractor, \"sanitizer\" a sanitizer\n");
+  printf("                       report or exit code, \"signal\" a fault signal (SIGSEGV, SIGABRT...)\n");
+  printf("  -r, --replay <file>  run the crashes of a store against the extractor and report the fixed,\n");
+  printf("                       still crashing and flaky ones, then exit\n");
+  printf("  -C, --cmin <file>    run the inputs of a store again and keep the smallest and fastest input\n");
+  printf("                       of each response class and crash bucket, then exit\n");
+  printf("  -k, --rechecks <N>   runs of each crash when replaying (default %d)\n", REPLAY_RECHECKS);
+  printf("  -j, --jobs <N>       extractors running at once when replaying or distilling (default: number of CPUs),\n");
+  printf("                       \"auto\" to raise or lower it while running to the peak execs/s\n");
+  printf("  -T, --timeout <s>    time given to each run when replaying or distilling (default %g)\n", REPLAY_TIMEOUT);
+}
+
+/**
+ * Exports inputs of a store as tar files named <kind>_<n>_<test>.tar in the current directory.
+ *
+ * @param[in] path the path of the store
+ * @param[in] which the number of the input, or "all"
+ * @return 0 on success, -1 otherwise
+**/
+static int export_inputs(const char *path, const char *which)
+{
+  store s;
+  if (store_open(&s, path, 0) == -1)
+  {
+    printf("The store \"%s\" doesn't exist\n", path);
+    return -1;
+  }
+
+  size_t first = 0, last = s.count;
+  if (strcmp(which, "all") != 0)
+  {
+    first = strtoul(which, NULL, 10);
+    last = first + 1;
+    if (first >= s.count)
+    {
+      printf("The store \"%s\" only has %zu inputs\n", path, s.count);
+      store_close(&s);
+      return -1;
+    }
+  }
+
+  for (size_t i = first; i < last; i++)
+  {
+    char name[STORE_TEST_LEN + 32];
+    snprintf(name, sizeof(name), "%s_%03zu_%s.tar", store_kind_name(s.records[i].kind), i, s.records[i].test);
+    if (store_export(&s, i, name) == -1)
+      printf("Input %zu of \"%s\" cannot be exported\n", i, path);
+  }
+
+  printf("%zu inputs exported from %s\n", last - first, path);
+  store_close(&s);
+  return 0;
+}
+
+/**
+ * The main function of the generation-based fuzzer.
+ * It checks the command line arguments, verifies that the extractor file exists, and then calls the fuzz function.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv An array of strings containing the command line arguments.
+ * @param[out] 0 if the fuzzer ran successfully, -1 otherwise.
+**/
+int main(int argc, char *argv[])
+{
+  Options options = {.mode = MODE_GENERATION, .iterations = 10000, .stats_file = STATS_FILE, .store_file = STORE_FILE};
+  const char *export = NULL;
+  const char *coordinator = NULL;
+  replay_options replaying = {.rechecks = REPLAY_RECHECKS, .timeout = REPLAY_TIMEOUT};
+  int distilling = 0;
+
+  // The extractors are started by a process as small as the fuzzer is now, so that their max RSS is their own
+  if (exec_launcher_start() == -1)
+    printf("The launcher could not be started, the extractors are forked from the fuzzer\n");
+  static const struct option long_options[] = {
+      {"replay", required_argument, NULL, 'r'},
+      {"cmin", required_argument, NULL, 'C'},
+      {"rechecks", required_argument, NULL, 'k'},
+      {"jobs", required_argument, NULL, 'j'},
+      {"timeout", required_argument, NULL, 'T'},
+      {"profile", no_argument, NULL, 'P'},
+      {"library", no_argument, NULL, 'L'},
+      {"recycle", required_argument, NULL, 'R'},
+      {"snapshot", no_argument, NULL, 'S'},
+      {"io-uring", no_argument, NULL, 'U'},
+      {"sync", required_argument, NULL, 'y'},
+      {"coordinator", required_argument, NULL, 'Y'},
+      {"dictionary", no_argument, NULL, 'D'},
+      {"oracles", required_argument, NULL, 'O'},
+      {"scale-max", required_argument, NULL, 'M'},
+      {"affinity", no_argument, NULL, 'A'},
+      {NULL, 0, NULL, 0}};
+
+  // Parse the options given before the extractor
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:l:pn:c:e:t:s:zi:o:x:r:C:k:j:T:PLR:SUy:Y:DO:M:A", long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'm':
+      if (strcmp(optarg, "gen") == 0)
+        options.mode = MODE_GENERATION;
+      else if (strcmp(optarg, "mem") == 0)
+        options.mode = MODE_MEMORY;
+      else if (strcmp(optarg, "novelty") == 0)
+        options.mode = MODE_NOVELTY;
+      else if (strcmp(optarg, "scale") == 0)
+        options.mode = MODE_SCALE;
+      else
+      {
+        printf("Unknown mode \"%s\"\n", optarg);
+        usage();
+        return -1;
+      }
+      break;
+    case 'l':
+      options.mem_limit = strtoul(optarg, NULL, 10) * 1024 * 1024;
+      break;
+    case 'p':
+      options.page_faults = 1;
+      break;
+    case 'n':
+      options.iterations = strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      options.max_crashes = strtoul(optarg, NULL, 10);
+      break;
+    case 'e':
+      options.exec_budget = strtoul(optarg, NULL, 10);
+      break;
+    case 't':
+      options.time_budget = strtod(optarg, NULL);
+      break;
+    case 's':
+      options.stats_file = optarg;
+      break;
+    case 'z':
+      options.sandbox = 1;
+      break;
+    case 'i':
+      options.seeds_dir = optarg;
+      break;
+    case 'o':
+      options.store_file = optarg;
+      break;
+    case 'x':
+      export = optarg;
+      break;
+    case 'r':
+      replaying.store_file = optarg;
+      break;
+    case 'C':
+      replaying.store_file = optarg;
+      distilling = 1;
+      break;
+    case 'k':
+      replaying.rechecks = strtoul(optarg, NULL, 10);
+      break;
+    case 'j':
+      replaying.adaptive = strcmp(optarg, "auto") == 0;
+      replaying.jobs = strtoul(optarg, NULL, 10);
+      break;
+    case 'T':
+      replaying.timeout = strtod(optarg, NULL);
+      break;
+    case 'P':
+      options.profile = 1;
+      replaying.profile = 1;
+      break;
+    case 'L':
+      options.library = 1;
+      break;
+    case 'R':
+      options.recycle = strtoul(optarg, NULL, 10);
+      break;
+    case 'S':
+      options.snapshot = 1;
+      break;
+    case 'U':
+      options.io_uring = 1;
+      break;
+    case 'y':
+      options.sync_socket = optarg;
+      break;
+    case 'Y':
+      coordinator = optarg;
+      break;
+    case 'D':
+      options.dictionary = 1;
+      break;
+    case 'M':
+      options.scale_max = strtoul(optarg, NULL, 10);
+      break;
+    case 'A':
+      options.affinity = 1;
+      replaying.affinity = 1;
+      break;
+    case 'O':
+      if (oracle_enable(optarg) == -1)
+      {
+        usage();
+        return -1;
+      }
+      break;
+    default:
+      usage();
+      return -1;
+    }
+  }
+
+  // The coordinator serves the instances and does not fuzz
+  if (coordinator)
+    return sync_coordinator(coordinator);
+
+  // Exporting inputs of the store does not need an extractor
+  if (export)
+    return export_inputs(options.store_file, export);
+
+  // Check if the correct number of arguments was provided
+  if (optind >= argc)
+  {
+    usage();
+    return -1;
+  }
+  unsigned count = argc - optind;
+  if (count > MAX_TARGETS)
+  {
+    printf("At most %d extractors can be compared\n", MAX_TARGETS);
+    return -1;
+  }
+
+  // The library runs alone and outside of the sandbox
+  if (options.library && (count > 1 || options.sandbox))
+  {
+    printf("A library is called in process, without other extractors nor sandbox\n");
+    return -1;
+  }
+
+  // Only the mutations of the novelty mode write the tokens of the dictionary
+  if (options.dictionary && options.mode != MODE_NOVELTY)
+  {
+    printf("The dictionary is only used by the mutations of the novelty mode\n");
+    return -1;
+  }
+
+  // The snapshot is taken of a single extractor, traced from the fuzzer
+  if (options.snapshot && (count > 1 || options.sandbox || options.library))
+  {
+    printf("The snapshot executor runs a single program, without other extractors, sandbox nor library\n");
+    return -1;
+  }
+
+  // Replaying or distilling a store runs a single extractor and does not fuzz
+  if (replaying.store_file)
+  {
+    if (count != 1)
+    {
+      printf("A store is replayed against a single extractor\n");
+      return -1;
+    }
+    replaying.mem_limit = options.mem_limit;
+    return distilling ? distill(argv[optind], &replaying) : replay(argv[optind], &replaying);
+  }
+
+  printf("\n--- Starting the following generation-based fuzzer ---\n");
+  for (int i = optind; i < argc; i++)
+  {
+    const char *extractor = argv[i];
+    printf("%s\n", extractor);
+
+    // Check if the extractor file exists
+    FILE *fuzzer_test = fopen(extractor, "rb");
+    if (!fuzzer_test)
+    {
+    printf("The extractor \"%s\" doesn't exist\n", extractor);
+    return -1;
+    }
+    fclose(fuzzer_test);
+  }
+
+  // Seed the random number generator
+  srand(time(NULL));
+
+  // Call the fuzz function with the provided extractor files, the first one is the reference
+  fuzz(argv + optind, count, &options);
+
+  return 0;
 }
\ No newline at end of file
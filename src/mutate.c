@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "tar.h"
+#include "mutate.h"
+#include "numeric.h"
+
+static const char *MUTATION_NAMES[MUT_COUNT] = {
+    "bit_flip",
+    "random_byte",
+    "interesting",
+    "field_fill",
+    "field_number",
+    "field_copy",
+    "dict_token",
+    "entry_duplicate",
+    "entry_swap",
+    "entry_delete",
+    "entry_splice",
+    "entry_extended",
+    "entry_desync",
+    "entry_truncate",
+};
+
+// Characters that are likely to change how a field is parsed
+static const char INTERESTING_CHARS[] = {0, 1, 10, 127, (char)128, (char)255, ' ', '/', '.', '*', '0', '7', '8', '9', '-', '+'};
+
+// Numbers written in the numeric fields
+static const char *EDGE_NUMBERS[] = {"", "0", "1", "-1", "7", "8", "0777", "07777777", "77777777777", "100000000000", " 1 ", "1e9", "0x10"};
+
+// Tokens of the extractor written by MUT_DICT_TOKEN, NULL when there is no dictionary
+static const dictionary *tokens = NULL;
+
+/**
+ * Sets the dictionary used by MUT_DICT_TOKEN. Without it, the mutation is not available.
+ *
+ * @param[in] d the dictionary, kept by the caller, NULL for none
+**/
+void mutate_set_dictionary(const dictionary *d)
+{
+  tokens = d;
+}
+
+/**
+ * Tells whether a mutation can be applied, MUT_DICT_TOKEN needing a dictionary with tokens.
+ *
+ * @param[in] op the mutation
+ * @return 1 if the mutation can be applied, 0 otherwise
+**/
+int mutation_available(mutation_op op)
+{
+  return op != MUT_DICT_TOKEN || dict_pick(tokens) != NULL;
+}
+
+/**
+ * Gives the name of a mutation, used to name the tests.
+ *
+ * @param[in] op the mutation
+ * @return the name of the mutation
+**/
+const char *mutation_name(mutation_op op)
+{
+  return op < MUT_COUNT ? MUTATION_NAMES[op] : "unknown";
+}
+
+/**
+ * Applies a mutation to one of the headers of an archive. The header is a block of the
+ * archive picked at random, so the content blocks get mutated as well from time to time.
+ *
+ * @param[in,out] data the archive
+ * @param[in] size the size of the archive, at least one block
+ * @param[in] op the mutation to apply, the mutations of the entries are left to mutate_entries()
+ * @return the offset of the mutated block, so that its checksum can be fixed when it is a header
+**/
+size_t mutate_archive(char *data, size_t size, mutation_op op)
+{
+  size_t blocks = size / sizeof(tar_t);
+  if (blocks == 0)
+    return 0;
+
+  size_t offset = (rand() % blocks) * sizeof(tar_t);
+  char *block = data + offset;
+  const tar_field *field = &TAR_FIELDS[rand() % TAR_FIELDS_COUNT];
+  char *start = block + field->offset;
+
+  switch (op)
+  {
+  case MUT_BIT_FLIP:
+    block[rand() % sizeof(tar_t)] ^= 1 << (rand() % 8);
+    break;
+  case MUT_RANDOM_BYTE:
+    block[rand() % sizeof(tar_t)] = rand() % 256;
+    break;
+  case MUT_DICT_TOKEN:
+  {
+    // Half of the time at the start of the field, where most comparisons look, the token is cut
+    // at the end of the field and terminated when there is room left
+    const dict_token *token = dict_pick(tokens);
+    if (token == NULL)
+      break;
+    size_t at = rand() % 2 ? 0 : (rand() % ((field->size + DICT_ALIGN - 1) / DICT_ALIGN)) * DICT_ALIGN;
+    size_t len = token->len < field->size - at ? token->len : field->size - at;
+    memcpy(start + at, token->text, len);
+    if (at + len < field->size)
+      start[at + len] = '\0';
+    break;
+  }
+  case MUT_INTERESTING:
+    start[0] = INTERESTING_CHARS[rand() % sizeof(INTERESTING_CHARS)];
+    break;
+  case MUT_FIELD_FILL:
+    memset(start, INTERESTING_CHARS[rand() % sizeof(INTERESTING_CHARS)], field->size);
+    break;
+  case MUT_FIELD_NUMBER:
+  {
+    // Only the numeric fields, the number is cut if it does not fit
+    while (!field->numeric)
+      field = &TAR_FIELDS[rand() % TAR_FIELDS_COUNT];
+    start = block + field->offset;
+
+    // Half of the time a boundary value of the field, encoded
+    num_boundary boundary;
+    if (rand() % 2 && num_boundary_at(field->size, rand() % NUM_BOUNDARIES(field->size), &boundary) == 0)
+    {
+      num_encode(start, field->size, boundary.value, boundary.format);
+      break;
+    }
+
+    const char *number = EDGE_NUMBERS[rand() % (sizeof(EDGE_NUMBERS) / sizeof(EDGE_NUMBERS[0]))];
+    size_t len = strlen(number) < field->size ? strlen(number) : field->size;
+    memset(start, 0, field->size);
+    memcpy(start, number, len);
+    break;
+  }
+  case MUT_FIELD_COPY:
+  {
+    const tar_field *src = &TAR_FIELDS[rand() % TAR_FIELDS_COUNT];
+    size_t len = src->size < field->size ? src->size : field->size;
+    memmove(start, block + src->offset, len);
+    break;
+  }
+  default:
+    break;
+  }
+
+  return offset;
+}
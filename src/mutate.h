@@ -0,0 +1,37 @@
+#ifndef MUTATE_H
+#define MUTATE_H
+
+#include <stddef.h>
+
+#include "dict.h"
+
+#define HAVOC_STACK 4 // maximum number of mutations applied to an input at once
+#define DICT_ALIGN 4  // a token is written at a multiple of this offset in its field
+
+typedef enum
+{
+    MUT_BIT_FLIP,       // flip a bit of a header
+    MUT_RANDOM_BYTE,    // set a byte of a header to a random value
+    MUT_INTERESTING,    // set the first byte of a field to an interesting character
+    MUT_FIELD_FILL,     // fill a field with the same character, without terminating null
+    MUT_FIELD_NUMBER,   // write an edge number in a numeric field
+    MUT_FIELD_COPY,     // copy a field over another one
+    MUT_DICT_TOKEN,     // write a token of the dictionary of the extractor at an aligned offset of a field
+    MUT_ENTRY_DUPLICATE, // duplicate an entry of the archive, see mutate_entries()
+    MUT_ENTRY_SWAP,     // swap two entries
+    MUT_ENTRY_DELETE,   // delete an entry
+    MUT_ENTRY_SPLICE,   // insert a few entries of another input of the corpus
+    MUT_ENTRY_EXTENDED, // insert a pax extended header in front of an entry
+    MUT_ENTRY_DESYNC,   // change the size field of an entry without changing its content
+    MUT_ENTRY_TRUNCATE, // cut the archive at a block boundary
+    MUT_COUNT
+} mutation_op;
+
+#define MUT_FIRST_ENTRY MUT_ENTRY_DUPLICATE // the mutations from this one on change the entries, not the headers
+
+int mutation_available(mutation_op op);
+const char *mutation_name(mutation_op op);
+void mutate_set_dictionary(const dictionary *d);
+size_t mutate_archive(char *data, size_t size, mutation_op op);
+
+#endif
@@ -0,0 +1,431 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <sys/wait.h>
+
+#include "fuzzer.h"
+#include "novelty.h"
+
+/**
+ * Allocates an empty novelty state.
+ *
+ * @return the novelty state, exits if it cannot be allocated
+**/
+novelty_state *novelty_init(void)
+{
+  novelty_state *state = calloc(1, sizeof(novelty_state));
+  if (state == NULL)
+  {
+    printf("Struct not allocated \n");
+    exit(0);
+  }
+  return state;
+}
+
+/**
+ * Releases the novelty state and the inputs of its corpus.
+ *
+ * @param[in] state the novelty state
+**/
+void novelty_free(novelty_state *state)
+{
+  for (size_t i = 0; i < state->inputs_count; i++)
+    free(state->inputs[i].data);
+  free(state->inputs);
+  free(state->classes);
+  free(state->combos);
+  free(state);
+}
+
+/**
+ * 64-bit FNV-1a hash of a buffer.
+ *
+ * @param[in] data the buffer to hash
+ * @param[in] size the size of the buffer
+ * @return the hash
+**/
+uint64_t hash_bytes(const void *data, size_t size)
+{
+  const unsigned char *bytes = data;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/**
+ * Appends a string to the normalized line if it fits.
+**/
+static void append(char *out, size_t out_size, size_t *o, const char *str)
+{
+  size_t len = strlen(str);
+  if (*o + len + 1 > out_size)
+    len = out_size - *o - 1;
+  memcpy(out + *o, str, len);
+  *o += len;
+}
+
+/**
+ * Normalizes a line of output of the extractor so that messages that only differ by the names
+ * and numbers taken from the archive end up in the same class:
+ * quoted strings become <s>, words containing a '/' or a '.' become <path>,
+ * runs of digits become # and non printable characters become ?.
+ *
+ * @param[in] line the line to normalize, without the newline
+ * @param[in] len the length of the line
+ * @param[out] out the normalized line, null terminated
+ * @param[in] out_size the size of out
+ * @return the length of the normalized line
+**/
+size_t normalize_line(const char *line, size_t len, char *out, size_t out_size)
+{
+  size_t o = 0;
+  size_t i = 0;
+
+  while (i < len && o + 1 < out_size)
+  {
+    unsigned char c = line[i];
+
+    // Quoted strings are names taken from the archive
+    if (c == '\'' || c == '"')
+    {
+      const char *close = memchr(line + i + 1, c, len - i - 1);
+      if (close)
+      {
+        append(out, out_size, &o, "<s>");
+        i = close - line + 1;
+        continue;
+      }
+    }
+
+    // A word containing a '/' or a '.' is a path, the punctuation after it is kept
+    if (!isspace(c) && (i == 0 || isspace((unsigned char)line[i - 1])))
+    {
+      size_t end = i;
+      int path = 0;
+      while (end < len && !isspace((unsigned char)line[end]))
+      {
+        if (line[end] == '/' || line[end] == '.')
+          path = 1;
+        end++;
+      }
+
+      size_t word_end = end;
+      while (word_end > i && strchr(":,;", line[word_end - 1]))
+        word_end--;
+
+      if (path && word_end > i)
+      {
+        append(out, out_size, &o, "<path>");
+        i = word_end;
+        continue;
+      }
+    }
+
+    // Runs of digits are sizes, modes, dates...
+    if (isdigit(c))
+    {
+      append(out, out_size, &o, "#");
+      while (i < len && isdigit((unsigned char)line[i]))
+        i++;
+      continue;
+    }
+
+    out[o++] = isprint(c) ? c : '?';
+    i++;
+  }
+
+  out[o] = '\0';
+  return o;
+}
+
+/**
+ * Finds a class by its hash, or adds it with the given text.
+ *
+ * @param[in] state the novelty state
+ * @param[in] hash the hash of the normalized line
+ * @param[in] text the normalized line
+ * @param[out] added set to 1 if the class is new
+ * @return the class
+**/
+static response_class *get_class(novelty_state *state, uint64_t hash, const char *text, int *added)
+{
+  for (size_t i = 0; i < state->classes_count; i++)
+  {
+    if (state->classes[i].hash == hash)
+      return &state->classes[i];
+  }
+
+  if (state->classes_count == state->classes_cap)
+  {
+    state->classes_cap = state->classes_cap ? state->classes_cap * 2 : 16;
+    state->classes = realloc(state->classes, state->classes_cap * sizeof(response_class));
+    if (state->classes == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+
+  response_class *class = &state->classes[state->classes_count++];
+  class->hash = hash;
+  class->count = 0;
+  strncpy(class->text, text, NOVELTY_LINE_LEN - 1);
+  class->text[NOVELTY_LINE_LEN - 1] = '\0';
+  *added = 1;
+  return class;
+}
+
+/**
+ * Compares two hashes, used to sort the classes of a response.
+**/
+static int compare_hash(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Splits the first lines of the output of the extractor into behaviour classes.
+ * A response is made of the classes of its first NOVELTY_LINES lines, plus a class for the signal
+ * that killed the extractor, its exit code when it is not 0, or a class for the lack of output.
+ *
+ * @param[in] output the output of the extractor, null terminated
+ * @param[in] status the wait status of the extractor
+ * @param[out] hashes the hashes of the classes
+ * @param[out] texts the normalized lines of the classes
+ * @return the number of classes
+**/
+static size_t split_response(const char *output, int status, uint64_t hashes[NOVELTY_CLASSES], char texts[NOVELTY_CLASSES][NOVELTY_LINE_LEN])
+{
+  size_t count = 0;
+
+  // Classes of the first lines
+  const char *line = output;
+  while (*line && count < NOVELTY_LINES)
+  {
+    const char *end = strchr(line, '\n');
+    size_t len = end ? (size_t)(end - line) : strlen(line);
+
+    normalize_line(line, len, texts[count], NOVELTY_LINE_LEN);
+    hashes[count] = hash_bytes(texts[count], strlen(texts[count]));
+    count++;
+
+    if (!end)
+      break;
+    line = end + 1;
+  }
+
+  // Class of the way the extractor ended when it says nothing about it
+  char *text = texts[count];
+  if (WIFSIGNALED(status))
+    snprintf(text, NOVELTY_LINE_LEN, "<killed by signal %d>", WTERMSIG(status));
+  else if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+    snprintf(text, NOVELTY_LINE_LEN, "<exit code %d>", WEXITSTATUS(status));
+  else if (count == 0)
+    snprintf(text, NOVELTY_LINE_LEN, "<no output>");
+  else
+    text[0] = '\0';
+
+  if (text[0])
+  {
+    hashes[count] = hash_bytes(text, strlen(text));
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Hashes the combination of the classes of a response, which is the sorted set of the classes.
+ *
+ * @param[in,out] hashes the hashes of the classes, sorted and deduplicated in place
+ * @param[in] count the number of classes
+ * @return the hash of the combination
+**/
+static uint64_t combine_classes(uint64_t hashes[], size_t count)
+{
+  qsort(hashes, count, sizeof(uint64_t), compare_hash);
+  size_t unique = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (unique == 0 || hashes[unique - 1] != hashes[i])
+      hashes[unique++] = hashes[i];
+  }
+  return hash_bytes(hashes, unique * sizeof(uint64_t));
+}
+
+/**
+ * Gives the bucket of a response: the hash of the combination of its classes, without recording them.
+ * Two responses that only differ by the names and numbers taken from the archive fall in the same bucket.
+ *
+ * @param[in] output the output of the extractor, null terminated
+ * @param[in] status the wait status of the extractor
+ * @return the bucket
+**/
+uint64_t novelty_bucket(const char *output, int status)
+{
+  uint64_t hashes[NOVELTY_CLASSES];
+  char texts[NOVELTY_CLASSES][NOVELTY_LINE_LEN];
+  size_t count = split_response(output, status, hashes, texts);
+  return combine_classes(hashes, count);
+}
+
+/**
+ * Splits the first lines of the output of the extractor into behaviour classes and records them.
+ * The max RSS of the extractor, by power of two, is a class of its own: an input that makes the
+ * extractor use far more memory is a novelty even when the extractor says the same thing.
+ * It is left out of novelty_bucket(), a crash does not change with the memory used.
+ *
+ * @param[in] state the novelty state
+ * @param[in] output the output of the extractor, null terminated
+ * @param[in] status the wait status of the extractor
+ * @param[in] max_rss the max RSS of the extractor in KB, 0 if unknown
+ * @return NOVELTY_CLASS if a class was never seen, NOVELTY_COMBO if the combination of classes
+ *         was never seen, NOVELTY_NONE otherwise
+ * @see split_response
+**/
+int novelty_classify(novelty_state *state, const char *output, int status, long max_rss)
+{
+  uint64_t hashes[NOVELTY_CLASSES];
+  char texts[NOVELTY_CLASSES][NOVELTY_LINE_LEN];
+  int added = 0;
+
+  size_t count = split_response(output, status, hashes, texts);
+  if (max_rss > 0)
+  {
+    int bucket = 0;
+    while (max_rss >>= 1)
+      bucket++;
+    snprintf(texts[count], NOVELTY_LINE_LEN, "<max RSS of 2^%d KB>", bucket);
+    hashes[count] = hash_bytes(texts[count], strlen(texts[count]));
+    count++;
+  }
+  for (size_t i = 0; i < count; i++)
+    get_class(state, hashes[i], texts[i], &added)->count++;
+
+  uint64_t combo = combine_classes(hashes, count);
+  for (size_t i = 0; i < state->combos_count; i++)
+  {
+    if (state->combos[i] == combo)
+      return added ? NOVELTY_CLASS : NOVELTY_NONE;
+  }
+
+  if (state->combos_count == state->combos_cap)
+  {
+    state->combos_cap = state->combos_cap ? state->combos_cap * 2 : 16;
+    state->combos = realloc(state->combos, state->combos_cap * sizeof(uint64_t));
+    if (state->combos == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+  state->combos[state->combos_count++] = combo;
+
+  return added ? NOVELTY_CLASS : NOVELTY_COMBO;
+}
+
+/**
+ * Adds a copy of an input to the corpus.
+ *
+ * @param[in] state the novelty state
+ * @param[in] data the archive
+ * @param[in] size the size of the archive
+ * @param[in] score the initial priority of the input
+**/
+void novelty_add_input(novelty_state *state, const char *data, size_t size, unsigned score)
+{
+  if (size > NOVELTY_MAX_INPUT || size == 0)
+    return;
+
+  if (state->inputs_count == state->inputs_cap)
+  {
+    state->inputs_cap = state->inputs_cap ? state->inputs_cap * 2 : 64;
+    state->inputs = realloc(state->inputs, state->inputs_cap * sizeof(novelty_input));
+    if (state->inputs == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+
+  novelty_input *input = &state->inputs[state->inputs_count];
+  input->data = malloc(size);
+  if (input->data == NULL)
+    return;
+  memcpy(input->data, data, size);
+  input->size = size;
+  input->score = score;
+  input->picked = 0;
+
+  state->inputs_count++;
+  state->total_score += score;
+}
+
+/**
+ * Marks a behaviour class found by another instance as known, so that meeting it is not a novelty.
+ *
+ * @param[in] state the novelty state
+ * @param[in] hash the hash of the class
+ * @param[in] text the normalized line of the class, not null terminated
+ * @param[in] len the length of the line, cut to NOVELTY_LINE_LEN - 1
+**/
+void novelty_learn_class(novelty_state *state, uint64_t hash, const char *text, size_t len)
+{
+  char line[NOVELTY_LINE_LEN];
+  if (len > NOVELTY_LINE_LEN - 1)
+    len = NOVELTY_LINE_LEN - 1;
+  memcpy(line, text, len);
+  line[len] = '\0';
+  int added = 0;
+  get_class(state, hash, line, &added);
+}
+
+/**
+ * Picks an input of the corpus at random, weighted by its score.
+ * The score of the picked input is halved so that the other inputs get their turn,
+ * but never drops to 0.
+ *
+ * @param[in] state the novelty state
+ * @return the picked input, NULL if the corpus is empty
+**/
+novelty_input *novelty_pick(novelty_state *state)
+{
+  if (state->total_score == 0)
+    return NULL;
+
+  unsigned r = rand() % state->total_score;
+  novelty_input *input = &state->inputs[state->inputs_count - 1];
+  for (size_t i = 0; i < state->inputs_count; i++)
+  {
+    if (r < state->inputs[i].score)
+    {
+      input = &state->inputs[i];
+      break;
+    }
+    r -= state->inputs[i].score;
+  }
+
+  input->picked++;
+  unsigned decayed = input->score > 1 ? input->score / 2 : 1;
+  state->total_score -= input->score - decayed;
+  input->score = decayed;
+  return input;
+}
+
+/**
+ * Prints the behaviour classes found, with the number of responses containing each of them.
+ *
+ * @param[in] state the novelty state
+**/
+void novelty_report(const novelty_state *state)
+{
+  printf(KCYN "%lu behaviour classes" KNRM " in %lu combinations, %lu inputs in the corpus\n",
+         state->classes_count, state->combos_count, state->inputs_count);
+  for (size_t i = 0; i < state->classes_count; i++)
+    printf("  %6u  %s\n", state->classes[i].count, state->classes[i].text);
+}
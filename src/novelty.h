@@ -0,0 +1,57 @@
+#ifndef NOVELTY_H
+#define NOVELTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NOVELTY_LINES 3                 // number of output lines used to classify a response
+#define NOVELTY_LINE_LEN 128            // maximum length of a normalized line
+#define NOVELTY_MAX_INPUT (1 << 20)     // inputs bigger than this are not kept in the corpus
+#define NOVELTY_CLASSES (NOVELTY_LINES + 2) // classes of a response: its lines, how it ended and its RSS bucket
+
+// What a response brought compared to the previous ones
+#define NOVELTY_NONE 0  // only known classes, in a known combination
+#define NOVELTY_COMBO 1 // known classes in a new combination
+#define NOVELTY_CLASS 2 // at least one new class
+
+#define NOVELTY_SCORE_COMBO 2   // initial score of an input producing a new combination
+#define NOVELTY_SCORE_CLASS 8   // initial score of an input producing a new class
+
+typedef struct
+{
+    uint64_t hash;                  // hash of the normalized line
+    char text[NOVELTY_LINE_LEN];    // normalized line, as an example of the class
+    unsigned count;                 // number of responses containing this class
+} response_class;
+
+typedef struct
+{
+    char *data;         // the archive
+    size_t size;        // size of the archive
+    unsigned score;     // priority of the input for mutation, decays each time it is picked
+    unsigned picked;    // number of times the input was picked
+} novelty_input;
+
+typedef struct
+{
+    response_class *classes;
+    size_t classes_count, classes_cap;
+    uint64_t *combos;               // hashes of the sets of classes seen in a single response
+    size_t combos_count, combos_cap;
+    novelty_input *inputs;          // corpus of the inputs that brought something new
+    size_t inputs_count, inputs_cap;
+    unsigned total_score;
+} novelty_state;
+
+novelty_state *novelty_init(void);
+void novelty_free(novelty_state *state);
+uint64_t hash_bytes(const void *data, size_t size);
+size_t normalize_line(const char *line, size_t len, char *out, size_t out_size);
+uint64_t novelty_bucket(const char *output, int status);
+int novelty_classify(novelty_state *state, const char *output, int status, long max_rss);
+void novelty_add_input(novelty_state *state, const char *data, size_t size, unsigned score);
+void novelty_learn_class(novelty_state *state, uint64_t hash, const char *text, size_t len);
+novelty_input *novelty_pick(novelty_state *state);
+void novelty_report(const novelty_state *state);
+
+#endif
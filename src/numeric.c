@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "numeric.h"
+
+// Number of boundary values that do not depend on the size of the field
+#define FIXED_BOUNDARIES 12
+
+/**
+ * Writes a number in a numeric field of the header, without going through printf.
+ * A number that does not fit is still written, cut to its low digits (or bytes in base-256),
+ * which is the overflow form some writers produce. Negative numbers never fit in octal and
+ * are written as the two's complement of a 32-bit int cut to the field, as printf("%o") writes
+ * them: -2 is 37777777776 in a 12-byte field.
+ *
+ * @param[out] field the field
+ * @param[in] size the size of the field
+ * @param[in] value the number
+ * @param[in] format how the number is written
+ * @return 0 if the number fits, -1 if it was cut
+**/
+int num_encode(char *field, size_t size, int64_t value, num_format format)
+{
+  if (size == 0)
+    return -1;
+
+  if (format == NUM_BASE256)
+  {
+    // Bytes from the end, the sign extends to the first byte, which gets the high bit
+    int64_t v = value;
+    for (size_t i = size - 1; i > 0; i--)
+    {
+      field[i] = (char)(v & 0xff);
+      v = (int64_t)((uint64_t)v >> 8 | (v < 0 ? 0xffULL << 56 : 0));
+    }
+    field[0] = value < 0 ? (char)0xff : (char)0x80;
+    return v == 0 || v == -1 ? 0 : -1;
+  }
+
+  // Octal digits from the end, zero padded
+  size_t digits = format == NUM_OCTAL_FULL ? size : size - 1;
+  uint64_t v = value < 0 ? (uint32_t)value : (uint64_t)value;
+  for (size_t i = digits; i > 0; i--)
+  {
+    field[i - 1] = '0' + (v & 7);
+    v >>= 3;
+  }
+  if (format == NUM_OCTAL_NUL)
+    field[size - 1] = '\0';
+  else if (format == NUM_OCTAL_SPACE)
+    field[size - 1] = ' ';
+
+  return v == 0 && value >= 0 ? 0 : -1;
+}
+
+/**
+ * Reads a numeric field the way a lenient tar does: base-256 when the high bit of the first byte
+ * is set, octal otherwise, skipping the leading spaces and stopping at a null or a space.
+ * An empty field reads as 0.
+ *
+ * @param[in] field the field
+ * @param[in] size the size of the field
+ * @param[out] value the number
+ * @return 0 on success, -1 if the field holds something else than a number or the number does not fit
+**/
+int num_decode(const char *field, size_t size, int64_t *value)
+{
+  if (size == 0)
+    return -1;
+
+  if (field[0] & 0x80)
+  {
+    // The bit after the marker is the sign
+    int64_t v = (field[0] & 0x40) ? -1 : 0;
+    v = (int64_t)((uint64_t)v << 6 | (field[0] & 0x3f));
+    for (size_t i = 1; i < size; i++)
+    {
+      if (v > INT64_MAX >> 8 || v < INT64_MIN >> 8)
+        return -1;
+      v = (int64_t)((uint64_t)v << 8 | (unsigned char)field[i]);
+    }
+    *value = v;
+    return 0;
+  }
+
+  size_t i = 0;
+  while (i < size && field[i] == ' ')
+    i++;
+
+  uint64_t v = 0;
+  for (; i < size && field[i] != '\0' && field[i] != ' '; i++)
+  {
+    if (field[i] < '0' || field[i] > '7' || v > (uint64_t)INT64_MAX >> 3)
+      return -1;
+    v = v << 3 | (field[i] - '0');
+  }
+
+  *value = (int64_t)v;
+  return 0;
+}
+
+/**
+ * Gives a boundary value of a field of a given size. With d the number of octal digits
+ * of the usual form (size - 1), they are 0, 1, 8^n - 1 and 8^n for n < d, the largest number
+ * of each octal form and the first one that does not fit, and the edges of base-256,
+ * negative numbers included.
+ *
+ * @param[in] size the size of the field
+ * @param[in] index the index of the boundary value, from 0
+ * @param[out] boundary the boundary value
+ * @return 0 on success, -1 if there are no more boundary values
+**/
+int num_boundary_at(size_t size, unsigned index, num_boundary *boundary)
+{
+  static char name[32];
+  unsigned digits = size - 1;
+  unsigned bits = 8 * digits < 63 ? 8 * digits : 63;
+
+  if (size < 2 || size > 20)
+    return -1;
+
+  // The powers of 8 that fit in the usual form
+  if (index < 2 * (digits - 1))
+  {
+    unsigned n = index / 2 + 1;
+    int last = index % 2 == 0;
+    snprintf(name, sizeof(name), last ? "8^%u-1" : "8^%u", n);
+    boundary->name = name;
+    boundary->value = ((int64_t)1 << (3 * n)) - last;
+    boundary->format = NUM_OCTAL_NUL;
+    return 0;
+  }
+  index -= 2 * (digits - 1);
+
+  int64_t octal_max = ((int64_t)1 << (3 * digits)) - 1;
+  int64_t full_max = ((int64_t)1 << (3 * size)) - 1;
+  int64_t base256_max = bits == 63 ? INT64_MAX : ((int64_t)1 << bits) - 1;
+  const num_boundary fixed[FIXED_BOUNDARIES] = {
+      {"zero", 0, NUM_OCTAL_NUL},
+      {"one", 1, NUM_OCTAL_NUL},
+      {"max_octal", octal_max, NUM_OCTAL_NUL},
+      {"max_octal_space", octal_max, NUM_OCTAL_SPACE},
+      {"min_unterminated", octal_max + 1, NUM_OCTAL_FULL},
+      {"max_unterminated", full_max, NUM_OCTAL_FULL},
+      {"negative_octal", -2, NUM_OCTAL_NUL},
+      {"zero_base256", 0, NUM_BASE256},
+      {"min_base256", octal_max + 1, NUM_BASE256},
+      {"max_base256", base256_max, NUM_BASE256},
+      {"negative_base256", -1, NUM_BASE256},
+      {"min_negative_base256", -base256_max - 1, NUM_BASE256},
+  };
+
+  if (index >= FIXED_BOUNDARIES)
+    return -1;
+  *boundary = fixed[index];
+  return 0;
+}
+
+/**
+ * Starts enumerating the boundary values of a field.
+ *
+ * @param[out] iter the iterator
+ * @param[in] size the size of the field
+**/
+void num_iter_init(num_iter *iter, size_t size)
+{
+  iter->size = size;
+  iter->index = 0;
+}
+
+/**
+ * Gives the next boundary value of a field. The name of the value stays valid until the next call.
+ *
+ * @param[in,out] iter the iterator
+ * @param[out] boundary the boundary value
+ * @return 1 if there was one, 0 when all of them were given
+**/
+int num_iter_next(num_iter *iter, num_boundary *boundary)
+{
+  if (num_boundary_at(iter->size, iter->index, boundary) == -1)
+    return 0;
+  iter->index++;
+  return 1;
+}
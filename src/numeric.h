@@ -0,0 +1,39 @@
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How a number is written in a numeric field of the header
+typedef enum
+{
+    NUM_OCTAL_NUL,      // zero padded octal digits followed by a null, the usual ustar form
+    NUM_OCTAL_SPACE,    // zero padded octal digits followed by a space, as old tars wrote them
+    NUM_OCTAL_FULL,     // octal digits over the whole field without terminator, one more digit
+    NUM_BASE256,        // GNU base-256: big-endian two's complement with the high bit of the first byte set
+} num_format;
+
+#define NUM_BOUNDARIES(size) (2 * (size) + 8) // number of boundary values of a field of this size
+
+// A boundary value of a field, with the form it is written in
+typedef struct
+{
+    const char *name;   // used to name the tests
+    int64_t value;
+    num_format format;
+} num_boundary;
+
+// Enumerates the boundary values of a field of a given size
+typedef struct
+{
+    size_t size;
+    unsigned index;
+} num_iter;
+
+int num_encode(char *field, size_t size, int64_t value, num_format format);
+int num_decode(const char *field, size_t size, int64_t *value);
+void num_iter_init(num_iter *iter, size_t size);
+int num_iter_next(num_iter *iter, num_boundary *boundary);
+int num_boundary_at(size_t size, unsigned index, num_boundary *boundary);
+
+#endif
@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "oracle.h"
+
+static int oracle_message(const char *output, size_t len, int status, oracle_result *result);
+static int oracle_sanitizer(const char *output, size_t len, int status, oracle_result *result);
+static int oracle_signal(const char *output, size_t len, int status, oracle_result *result);
+
+// The oracles, asked in this order: the first one finding a crash gives its description
+const oracle ORACLES[ORACLES_COUNT] = {
+    {"message", oracle_message},
+    {"sanitizer", oracle_sanitizer},
+    {"signal", oracle_signal},
+};
+
+static const char *VERDICT_NAMES[VERDICTS_COUNT] = {"no output", "error", "crash"};
+
+// Oracles asked by oracle_judge(), one bit per oracle
+static unsigned enabled = ORACLES_ALL;
+
+// Signals raised by the faults of a program, the other ones are sent to it
+static const struct
+{
+  int number;
+  const char *name;
+} CRASH_SIGNALS[] = {
+    {SIGSEGV, "SIGSEGV"}, {SIGBUS, "SIGBUS"}, {SIGILL, "SIGILL"}, {SIGFPE, "SIGFPE"},
+    {SIGABRT, "SIGABRT"}, {SIGTRAP, "SIGTRAP"}, {SIGSYS, "SIGSYS"},
+};
+
+// Beginning of the reports of the sanitizers, and the exit codes they use by default
+static const struct
+{
+  const char *header;
+  const char *name;
+  int exit_code;    // 0 when the sanitizer exits with the common code 1
+} SANITIZERS[] = {
+    {"ERROR: AddressSanitizer: ", "AddressSanitizer", 0},
+    {"ERROR: HWAddressSanitizer: ", "HWAddressSanitizer", 0},
+    {"ERROR: LeakSanitizer: ", "LeakSanitizer", 23},
+    {"WARNING: MemorySanitizer: ", "MemorySanitizer", 77},
+    {"WARNING: ThreadSanitizer: ", "ThreadSanitizer", 66},
+    {"runtime error: ", "UndefinedBehaviorSanitizer", 0},
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+/**
+ * The crash message the extractor prints itself when it crashes, at the beginning of its output.
+**/
+static int oracle_message(const char *output, size_t len, int status, oracle_result *result)
+{
+  (void)status;
+  size_t crash_len = strlen(CRASH_MSG);
+  if (len < crash_len || strncmp(output, CRASH_MSG, crash_len) != 0)
+    return 0;
+  snprintf(result->detail, ORACLE_DETAIL_LEN, "crash message");
+  return 1;
+}
+
+/**
+ * A report of a sanitizer in the first ORACLE_SCAN_LEN bytes of the output, described by the kind
+ * of error it names. Without report, the exit codes that only a sanitizer uses by default.
+**/
+static int oracle_sanitizer(const char *output, size_t len, int status, oracle_result *result)
+{
+  size_t scan = len < ORACLE_SCAN_LEN ? len : ORACLE_SCAN_LEN;
+  for (size_t i = 0; i < COUNT(SANITIZERS); i++)
+  {
+    size_t header_len = strlen(SANITIZERS[i].header);
+    const char *report = memmem(output, scan, SANITIZERS[i].header, header_len);
+    if (report == NULL)
+      continue;
+
+    // The kind of error is the rest of the line, cut to the first words
+    const char *kind = report + header_len, *end = kind;
+    while (end < output + scan && *end != '\n' && *end != '\0' && *end != '(' && end - kind < ORACLE_DETAIL_LEN)
+      end++;
+    while (end > kind && end[-1] == ' ')
+      end--;
+    snprintf(result->detail, ORACLE_DETAIL_LEN, "%s: %.*s", SANITIZERS[i].name, (int)(end - kind), kind);
+    return 1;
+  }
+
+  for (size_t i = 0; i < COUNT(SANITIZERS) && WIFEXITED(status); i++)
+  {
+    if (SANITIZERS[i].exit_code && WEXITSTATUS(status) == SANITIZERS[i].exit_code)
+    {
+      snprintf(result->detail, ORACLE_DETAIL_LEN, "%s: exit code %d", SANITIZERS[i].name, SANITIZERS[i].exit_code);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * The extractor was killed by a signal raised by a fault. SIGKILL and the like are sent by
+ * the fuzzer on timeouts or by the kernel when memory runs out, they are not crashes.
+**/
+static int oracle_signal(const char *output, size_t len, int status, oracle_result *result)
+{
+  (void)output;
+  (void)len;
+  if (!WIFSIGNALED(status))
+    return 0;
+  for (size_t i = 0; i < COUNT(CRASH_SIGNALS); i++)
+  {
+    if (CRASH_SIGNALS[i].number == WTERMSIG(status))
+    {
+      snprintf(result->detail, ORACLE_DETAIL_LEN, "%s%s", CRASH_SIGNALS[i].name, result->core ? ", core dumped" : "");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Chooses the oracles asked by oracle_judge(), all of them by default.
+ *
+ * @param[in] names names of the oracles separated by commas, "all" for all of them
+ * @return 0 on success, -1 if a name is unknown, the oracles are then left as they were
+**/
+int oracle_enable(const char *names)
+{
+  unsigned mask = 0;
+  const char *name = names;
+  while (*name)
+  {
+    size_t len = strcspn(name, ",");
+    unsigned found = 0;
+    if (len == 3 && strncmp(name, "all", 3) == 0)
+      found = ORACLES_ALL;
+    for (unsigned i = 0; i < ORACLES_COUNT && !found; i++)
+    {
+      if (strlen(ORACLES[i].name) == len && strncmp(name, ORACLES[i].name, len) == 0)
+        found = 1u << i;
+    }
+    if (!found)
+    {
+      printf("Unknown oracle \"%.*s\", the oracles are:", (int)len, name);
+      for (unsigned i = 0; i < ORACLES_COUNT; i++)
+        printf(" %s", ORACLES[i].name);
+      printf("\n");
+      return -1;
+    }
+    mask |= found;
+    name += len + (name[len] == ',');
+  }
+  if (mask == 0)
+    return -1;
+  enabled = mask;
+  return 0;
+}
+
+/**
+ * Gives the verdict on a run of an extractor from its output and its wait status.
+ * The enabled oracles are asked in turn whether the run is a crash. Otherwise the run is an error
+ * when the extractor printed something, even if it was killed, and a run without output otherwise.
+ *
+ * @param[in] output the beginning of the output of the extractor
+ * @param[in] len the length of the output
+ * @param[in] status the wait status of the extractor
+ * @param[out] result the verdict, which oracle gave it, and the signal that killed the extractor
+ * @return the verdict
+**/
+oracle_verdict oracle_judge(const char *output, size_t len, int status, oracle_result *result)
+{
+  memset(result, 0, sizeof(oracle_result));
+  if (WIFSIGNALED(status))
+  {
+    result->signal = WTERMSIG(status);
+    result->core = WCOREDUMP(status) != 0;
+  }
+
+  for (unsigned i = 0; i < ORACLES_COUNT; i++)
+  {
+    if ((enabled & (1u << i)) && ORACLES[i].check(output, len, status, result))
+    {
+      result->oracle = ORACLES[i].name;
+      result->verdict = VERDICT_CRASH;
+      return result->verdict;
+    }
+  }
+  result->verdict = len ? VERDICT_ERROR : VERDICT_NO_OUTPUT;
+  return result->verdict;
+}
+
+/**
+ * Gives the name of a verdict, used in the reports.
+ *
+ * @param[in] verdict the verdict
+ * @return the name of the verdict
+**/
+const char *oracle_verdict_name(oracle_verdict verdict)
+{
+  return verdict < VERDICTS_COUNT ? VERDICT_NAMES[verdict] : "unknown";
+}
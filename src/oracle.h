@@ -0,0 +1,48 @@
+#ifndef ORACLE_H
+#define ORACLE_H
+
+#include <stddef.h>
+
+#define CRASH_MSG "*** The program has crashed ***\n"
+#define LEN_CRASH_MSG strlen(CRASH_MSG) + 1
+
+#define ORACLE_SCAN_LEN 4096    // bytes of the output searched for a sanitizer report
+#define ORACLE_DETAIL_LEN 64    // size of the description of a crash, null included
+#define ORACLES_COUNT 3
+#define ORACLES_ALL ((1u << ORACLES_COUNT) - 1)
+
+// What an extractor did with an input
+typedef enum
+{
+    VERDICT_NO_OUTPUT,  // it printed nothing and was not killed
+    VERDICT_ERROR,      // it printed something that is not a crash, most likely an error message
+    VERDICT_CRASH,      // an oracle found a crash
+    VERDICTS_COUNT
+} oracle_verdict;
+
+// The verdict on a run and what it is based on
+typedef struct
+{
+    oracle_verdict verdict;
+    const char *oracle;             // name of the oracle that found the crash, NULL for the other verdicts
+    int signal;                     // signal that killed the extractor, 0 if it exited
+    int core;                       // the extractor dumped a core
+    char detail[ORACLE_DETAIL_LEN]; // the crash: the signal, the kind of the sanitizer report...
+} oracle_result;
+
+// An oracle looks at the output and the wait status of a run, and fills the result if it finds a crash
+typedef int (*oracle_check)(const char *output, size_t len, int status, oracle_result *result);
+
+typedef struct
+{
+    const char *name;
+    oracle_check check;
+} oracle;
+
+extern const oracle ORACLES[ORACLES_COUNT];
+
+int oracle_enable(const char *names);
+oracle_verdict oracle_judge(const char *output, size_t len, int status, oracle_result *result);
+const char *oracle_verdict_name(oracle_verdict verdict);
+
+#endif
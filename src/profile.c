@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+// Stages counted before any worker is set up, disabled
+static profile_state profile_none;
+profile_state *profile = &profile_none;
+
+#ifdef PROFILE_USDT
+unsigned short fuzzy_phase_semaphore __attribute__((section(".probes")));
+#endif
+
+static const char *PHASE_NAMES[PHASES] = {"generate", "write", "spawn", "wait", "classify"};
+
+static double profile_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Resets the timers of a worker. When the profiling is disabled, the timers cost a branch.
+ *
+ * @param[out] state the timers of the worker
+ * @param[in] enabled 1 to time the stages of the executions
+**/
+void profile_init(profile_state *state, int enabled)
+{
+  memset(state, 0, sizeof(profile_state));
+  state->enabled = enabled;
+  state->start_ticks = profile_ticks();
+  state->start_time = profile_seconds();
+}
+
+/**
+ * Counts the next stages for a worker, until another one is used.
+ *
+ * @param[in] state the timers of the worker, initialized by profile_init(), NULL to stop counting
+ *                  before the timers are released
+**/
+void profile_use(profile_state *state)
+{
+  profile = state ? state : &profile_none;
+}
+
+/**
+ * Marks the start of an execution: the time since the end of the previous one, except the
+ * other stages timed in between (writing the archive), went into building the archive.
+**/
+void profile_generated(void)
+{
+  if (!profile->enabled && !PROFILE_TRACED())
+    return;
+  uint64_t now = profile_ticks();
+  if (profile->mark)
+  {
+    uint64_t ticks = now - profile->mark;
+    ticks = ticks > profile->nested ? ticks - profile->nested : 0;
+    if (profile->enabled)
+    {
+      profile->ticks[PHASE_GENERATE] += ticks;
+      profile->count[PHASE_GENERATE]++;
+    }
+    PROFILE_PROBE(PHASE_GENERATE, ticks);
+  }
+  profile->nested = 0;
+}
+
+/**
+ * Marks the end of an execution, the generation of the next archive starts.
+**/
+void profile_executed(void)
+{
+  if (!profile->enabled && !PROFILE_TRACED())
+    return;
+  profile->mark = profile_ticks();
+  profile->nested = 0;
+}
+
+/**
+ * Prints where the time of each execution went, summed over the workers. The ticks are converted
+ * with the frequency measured over the whole run of the first worker, so the timestamp counter
+ * needs no calibration.
+ *
+ * @param[in] states the timers of the workers, the first one started first
+ * @param[in] count the number of workers
+ * @param[in] execs the number of executions
+**/
+void profile_report(const profile_state *states[], unsigned count, unsigned long execs)
+{
+  if (count == 0 || !states[0]->enabled || execs == 0)
+    return;
+
+  double elapsed = profile_seconds() - states[0]->start_time;
+  double hz = elapsed > 0 ? (profile_ticks() - states[0]->start_ticks) / elapsed : 1e9;
+  profile_state sum;
+  memset(&sum, 0, sizeof(sum));
+  for (unsigned w = 0; w < count; w++)
+  {
+    for (int i = 0; i < PHASES; i++)
+    {
+      sum.ticks[i] += states[w]->ticks[i];
+      sum.count[i] += states[w]->count[i];
+    }
+  }
+  uint64_t total = 0;
+  for (int i = 0; i < PHASES; i++)
+    total += sum.ticks[i];
+  if (total == 0)
+    return;
+
+  printf("\nProfile of %lu executions (%.2f GHz ticks, %.3f s elapsed):\n", execs, hz / 1e9, elapsed);
+  printf("%-10s %12s %10s %10s %7s\n", "phase", "total ms", "count", "us/exec", "share");
+  for (int i = 0; i < PHASES; i++)
+    printf("%-10s %12.3f %10llu %10.2f %6.1f%%\n", PHASE_NAMES[i], sum.ticks[i] / hz * 1e3,
+           (unsigned long long)sum.count[i], sum.ticks[i] / hz * 1e6 / execs, 100.0 * sum.ticks[i] / total);
+  printf("%-10s %12.3f %10s %10.2f\n", "total", total / hz * 1e3, "", total / hz * 1e6 / execs);
+#ifdef PROFILE_USDT
+  printf("USDT probe fuzzy:phase enabled (arg0: phase, arg1: ticks)\n");
+#endif
+}
@@ -0,0 +1,107 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Static tracepoints for perf and bpftrace, only when the systemtap headers are installed:
+// bpftrace -e 'usdt:./fuzzer:fuzzy:phase { @[arg0] = hist(arg1); }'
+// The probe has a semaphore, set by the tracer while it is attached, so the stages are timed
+// for the probe even without --profile.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define PROFILE_USDT 1
+#endif
+#endif
+
+#ifdef PROFILE_USDT
+extern unsigned short fuzzy_phase_semaphore;
+#define PROFILE_PROBE(p, ticks) DTRACE_PROBE2(fuzzy, phase, p, ticks)
+#define PROFILE_TRACED() __builtin_expect(fuzzy_phase_semaphore != 0, 0)
+#else
+#define PROFILE_PROBE(p, ticks) ((void)(p), (void)(ticks))
+#define PROFILE_TRACED() 0
+#endif
+
+// Stages of an execution of the extractor
+typedef enum
+{
+    PHASE_GENERATE,     // building the archive, from the end of the previous execution
+    PHASE_WRITE,        // writing the archive to the file given to the extractor
+    PHASE_SPAWN,        // forking and executing the extractor
+    PHASE_WAIT,         // waiting for the output and the exit of the extractor (the whole run in the sandbox)
+    PHASE_CLASSIFY,     // classifying the response, keeping the input, the statistics
+    PHASES
+} profile_phase;
+
+// Time spent in each stage by a worker (the fuzzer, a peer, a worker of the replay pool),
+// in ticks of the timestamp counter
+typedef struct
+{
+    int enabled;
+    uint64_t ticks[PHASES];
+    uint64_t count[PHASES];
+    uint64_t mark;          // end of the last execution, start of the generation of the next one
+    uint64_t nested;        // ticks of the other stages since the mark, not counted as generation
+    uint64_t start_ticks;   // to convert the ticks into seconds
+    double start_time;
+} profile_state;
+
+extern profile_state *profile; // the worker the stages are counted for, see profile_use()
+
+/**
+ * Reads the timestamp counter, or the monotonic clock in nanoseconds without one.
+**/
+static inline uint64_t profile_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Starts timing a stage.
+ *
+ * @return the start of the stage, 0 when the profiling is disabled and no tracer is attached
+**/
+static inline uint64_t profile_start(void)
+{
+  return profile->enabled || PROFILE_TRACED() ? profile_ticks() : 0;
+}
+
+/**
+ * Ends the timing of a stage started by profile_start(), counts it for the current worker
+ * and fires the probe.
+**/
+static inline void profile_stop(profile_phase phase, uint64_t start)
+{
+  if (!start)
+    return;
+  uint64_t ticks = profile_ticks() - start;
+  if (profile->enabled)
+  {
+    profile->ticks[phase] += ticks;
+    profile->count[phase]++;
+    profile->nested += ticks;
+  }
+  PROFILE_PROBE(phase, ticks);
+}
+
+void profile_init(profile_state *state, int enabled);
+void profile_use(profile_state *state);
+void profile_generated(void);
+void profile_executed(void);
+void profile_report(const profile_state *states[], unsigned count, unsigned long execs);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+#include "checksum.h"
+#include "numeric.h"
+
+/**
+ * Maps an archive in memory to walk its entries in place. Nothing is read on the heap,
+ * so archives of any size can be opened.
+ *
+ * @param[out] reader the reader
+ * @param[in] filename path of the archive
+ * @return 0 on success, -1 if the file cannot be opened or mapped
+**/
+int tar_open(tar_reader *reader, const char *filename)
+{
+  memset(reader, 0, sizeof(tar_reader));
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+  {
+    close(fd);
+    return -1;
+  }
+
+  // The mapping stays valid once the file is closed
+  reader->size = st.st_size;
+  if (reader->size)
+  {
+    void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      close(fd);
+      return -1;
+    }
+    madvise(data, reader->size, MADV_SEQUENTIAL);
+    reader->data = data;
+  }
+
+  close(fd);
+  return 0;
+}
+
+/**
+ * Walks an archive already in memory, which stays owned by the caller.
+ *
+ * @param[out] reader the reader
+ * @param[in] data the archive
+ * @param[in] size size of the archive
+**/
+void tar_open_memory(tar_reader *reader, const char *data, size_t size)
+{
+  memset(reader, 0, sizeof(tar_reader));
+  reader->data = size ? data : NULL;
+  reader->size = size;
+  reader->borrowed = 1;
+}
+
+/**
+ * Tells whether a block only holds null bytes, which marks the end of the archive.
+**/
+static int is_zero_block(const char *block)
+{
+  static const char zeros[sizeof(tar_t)];
+  return memcmp(block, zeros, sizeof(tar_t)) == 0;
+}
+
+/**
+ * Gives the next entry of the archive. Malformed headers are given too, the caller decides
+ * what to do with them: a size that cannot be read counts as 0 and a content running past
+ * the end of the archive is cut.
+ *
+ * @param[in,out] reader the reader
+ * @param[out] view the entry, valid until the reader is closed
+ * @return 1 if there was an entry, 0 at the end of the archive
+**/
+int tar_next(tar_reader *reader, tar_view *view)
+{
+  if (reader->offset + sizeof(tar_t) > reader->size)
+    return 0;
+
+  const char *block = reader->data + reader->offset;
+  if (is_zero_block(block))
+    return 0;
+
+  view->header = (const tar_t *)block;
+  view->offset = reader->offset;
+
+  // The checksum field is read like the other numbers, the sums are computed in one pass
+  int64_t stored;
+  view->checksum = TAR_CHKSUM_BAD;
+  if (num_decode(view->header->chksum, CHKSUM_LEN, &stored) == 0)
+  {
+    unsigned sum;
+    int signed_sum;
+    checksum_headers(block, 1, &sum, &signed_sum);
+    if (stored == sum)
+      view->checksum = TAR_CHKSUM_OK;
+    else if (stored == signed_sum)
+      view->checksum = TAR_CHKSUM_SIGNED;
+  }
+  if (view->checksum == TAR_CHKSUM_BAD)
+    reader->bad_checksums++;
+
+  if (num_decode(view->header->size, SIZE_LEN, &view->declared_size) == -1 || view->declared_size < 0)
+    view->declared_size = -1;
+
+  // The content follows the header, padded to a whole number of blocks
+  size_t start = reader->offset + sizeof(tar_t);
+  size_t available = reader->size - start;
+  size_t size = view->declared_size > 0 ? (size_t)view->declared_size : 0;
+  view->content = reader->data + start;
+  view->size = size < available ? size : available;
+
+  size_t padded = (view->size + sizeof(tar_t) - 1) / sizeof(tar_t) * sizeof(tar_t);
+  reader->offset = start + (padded < available ? padded : available);
+  reader->entries++;
+  return 1;
+}
+
+/**
+ * Unmaps the archive.
+ *
+ * @param[in] reader the reader
+**/
+void tar_close(tar_reader *reader)
+{
+  if (reader->data && !reader->borrowed)
+    munmap((void *)reader->data, reader->size);
+  reader->data = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tar.h"
+
+// How the checksum of a header matched
+#define TAR_CHKSUM_BAD 0        // neither checksum matches the chksum field
+#define TAR_CHKSUM_OK 1         // the checksum matches
+#define TAR_CHKSUM_SIGNED 2     // only the signed-char checksum of historic tars matches
+
+// An entry of an archive, pointing into the mapping of the archive
+typedef struct
+{
+    const tar_t *header;    // the header, in the mapping
+    const char *content;    // the content, in the mapping
+    size_t size;            // size of the content, cut to the end of the archive
+    int64_t declared_size;  // size written in the header, -1 if the field cannot be read
+    size_t offset;          // offset of the header in the archive
+    int checksum;           // TAR_CHKSUM_*
+} tar_view;
+
+// An archive mapped in memory and walked in place
+typedef struct
+{
+    const char *data;       // the mapping, NULL for an empty file
+    size_t size;            // size of the archive
+    size_t offset;          // offset of the next header
+    unsigned entries;       // number of entries read so far
+    unsigned bad_checksums; // entries whose checksum did not match
+    int borrowed;           // the data belongs to the caller, tar_close() leaves it alone
+} tar_reader;
+
+int tar_open(tar_reader *reader, const char *filename);
+void tar_open_memory(tar_reader *reader, const char *data, size_t size);
+int tar_next(tar_reader *reader, tar_view *view);
+void tar_close(tar_reader *reader);
+
+#endif
@@ -0,0 +1,547 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "fuzzer.h"
+#include "replay.h"
+#include "cpu.h"
+
+// A slot running one extractor at a time
+typedef struct
+{
+    scratch_dir scratch;        // directory the extractor runs in
+    char input[PATH_MAX];       // the input being replayed, outside of the scratch directory
+    cpu_slot cpus;              // CPUs its extractors are pinned to, none without affinity
+    profile_state profile;      // stages of the runs it started
+} replay_worker;
+
+// Workers running the inputs of a store, shared by the replay and the distillation
+typedef struct
+{
+    char extractor[PATH_MAX];   // absolute path of the extractor, the workers run in other directories
+    unsigned jobs;              // number of workers
+    int adaptive;               // only control.limit workers run at once
+    concurrency control;        // number of workers running at once when it follows the execs/s
+    scratch_dir work;           // directory holding the inputs of the workers
+    replay_worker *workers;
+    exec_result *results;       // result of the run of each worker
+    exec_options exec;
+    int aborted;                // an input could not be run, the inputs not started yet were left out
+    profile_state profile;      // the waits, shared by the workers
+    int *locks;                 // descriptors holding the locks of the cores of the workers, see cpu_claim()
+    unsigned locks_count;
+} replay_pool;
+
+// Called with the result of each run, job being the index of the input in the list given to pool_run()
+typedef void (*replay_callback)(size_t job, const exec_result *result, void *data);
+
+/**
+ * Creates the workers and their scratch directories, and claims their cores with affinity.
+ *
+ * @param[out] pool the pool
+ * @param[in] extractor path of the extractor
+ * @param[in] options the replay options
+ * @return 0 on success, -1 if the extractor doesn't exist
+**/
+static int pool_init(replay_pool *pool, const char *extractor, const replay_options *options)
+{
+  if (access(extractor, X_OK) == -1)
+  {
+    printf("The extractor \"%s\" doesn't exist\n", extractor);
+    return -1;
+  }
+  if (strchr(extractor, '/') == NULL || realpath(extractor, pool->extractor) == NULL)
+    snprintf(pool->extractor, sizeof(pool->extractor), "%s", extractor);
+
+  // When the number of extractors follows the execs/s, it starts at the number of CPUs and has room to grow
+  unsigned cpus = cpu_count();
+  unsigned jobs = options->jobs ? options->jobs : options->adaptive ? cpus * REPLAY_ADAPTIVE_JOBS : cpus;
+  if (jobs == 0)
+    jobs = 1;
+  if (jobs > REPLAY_MAX_JOBS)
+    jobs = REPLAY_MAX_JOBS;
+  pool->jobs = jobs;
+  pool->adaptive = options->adaptive;
+  concurrency_init(&pool->control, cpus, jobs);
+
+  pool->workers = calloc(jobs, sizeof(replay_worker));
+  pool->results = malloc(jobs * sizeof(exec_result));
+  if (pool->workers == NULL || pool->results == NULL)
+  {
+    printf("Array not allocated \n");
+    exit(0);
+  }
+
+  // The inputs are written in a scratch directory, each worker extracts in its own one
+  if (scratch_create(&pool->work, 0) == -1)
+  {
+    printf("Scratch directory not created \n");
+    exit(0);
+  }
+  for (unsigned w = 0; w < jobs; w++)
+  {
+    if (scratch_create(&pool->workers[w].scratch, w + 1) == -1)
+    {
+      printf("Scratch directory not created \n");
+      exit(0);
+    }
+    snprintf(pool->workers[w].input, PATH_MAX, "%.*s/input_%u.tar", PATH_MAX - 32, pool->work.path, w);
+  }
+
+  // Each worker gets a core, or a hardware thread when there are more workers than cores. The
+  // cores are claimed like the fuzzer does, so that the instances of the host keep apart
+  pool->locks = NULL;
+  pool->locks_count = 0;
+  cpu_topology topology;
+  if (options->affinity && cpu_topology_read(&topology) == 0)
+  {
+    cpu_topology claimed = {malloc(topology.count * sizeof(cpu_slot)), malloc(topology.count * sizeof(int)), 0, 0};
+    pool->locks = malloc(topology.count * sizeof(int));
+    if (claimed.cores == NULL || claimed.first == NULL || pool->locks == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+    while (claimed.count < jobs && claimed.count < topology.count &&
+           cpu_claim(&topology, cpu_lock_dir(), &claimed.cores[claimed.count], &pool->locks[claimed.count]) == 0)
+    {
+      claimed.first[claimed.count] = claimed.cores[claimed.count].cpus[0];
+      claimed.threads += claimed.cores[claimed.count].count;
+      claimed.count++;
+    }
+    pool->locks_count = claimed.count;
+
+    if (claimed.count == 0)
+      printf("No core is free for the workers, they are not pinned\n");
+    else
+    {
+      for (unsigned w = 0; w < jobs; w++)
+        cpu_assign(&claimed, w, jobs, &pool->workers[w].cpus);
+      printf("Workers pinned to %s of %u cores (%u CPUs)\n", jobs <= claimed.count ? "cores" : "hardware threads",
+             claimed.count, claimed.threads);
+    }
+    free(claimed.cores);
+    free(claimed.first);
+    cpu_topology_free(&topology);
+  }
+  else if (options->affinity)
+    printf("The topology of the CPUs is unknown, the workers are not pinned\n");
+
+  exec_options exec = {options->mem_limit, NULL, NULL, options->timeout, NULL};
+  pool->exec = exec;
+
+  profile_init(&pool->profile, options->profile);
+  for (unsigned w = 0; w < jobs; w++)
+    profile_init(&pool->workers[w].profile, options->profile);
+  return 0;
+}
+
+/**
+ * Runs inputs of a store on the workers, round after round: the inputs are started in order, all
+ * of them before the second run of the first one. A worker starts the next input as soon as its
+ * extractor is done, so a slow input only holds its own worker. When the number of extractors
+ * running at once follows the execs/s, only the first workers the controller allows start new
+ * inputs, see concurrency_update().
+ * An input that cannot be written or an extractor that cannot be started aborts the pool: no other
+ * input is started, the extractors already running are waited for, and pool->aborted is set.
+ * The writes, the starts and the classifications are profiled for each worker, the waits for the pool.
+ *
+ * @param[in,out] pool the pool
+ * @param[in] s the store, opened for reading
+ * @param[in] records the indexes of the inputs in the store
+ * @param[in] count the number of inputs
+ * @param[in] rounds the number of runs of each input
+ * @param[in] callback called with the result of each run
+ * @param[in] data given to the callback
+ * @return the number of runs
+**/
+static unsigned long pool_run(replay_pool *pool, const store *s, const size_t records[], size_t count,
+                              unsigned rounds, replay_callback callback, void *data)
+{
+  exec_proc procs[REPLAY_MAX_JOBS];
+  size_t jobs[REPLAY_MAX_JOBS]; // the input run by each worker
+  unsigned long execs = 0;
+  for (unsigned w = 0; w < pool->jobs; w++)
+    procs[w].pid = -1;
+  pool->aborted = 0;
+
+  size_t total = count * rounds, next = 0;
+  for (;;)
+  {
+    // The idle workers allowed to run start the next inputs
+    unsigned width = pool->adaptive ? pool->control.limit : pool->jobs;
+    for (unsigned w = 0; w < width && next < total; w++)
+    {
+      if (procs[w].pid != -1)
+        continue;
+      size_t job = next++ % count;
+      pool->exec.workdir = pool->workers[w].scratch.path;
+      pool->exec.cpus = pool->workers[w].cpus.count ? &pool->workers[w].cpus : NULL;
+      profile_use(&pool->workers[w].profile);
+      uint64_t start = profile_start();
+      int exported = store_export(s, records[job], pool->workers[w].input);
+      profile_stop(PHASE_WRITE, start);
+      if (exported == -1 || exec_spawn(pool->extractor, pool->workers[w].input, &pool->exec, &procs[w]) == -1)
+      {
+        printf("\nThe input %zu could not be run, the inputs not started yet are left out\n", records[job]);
+        pool->aborted = 1;
+        next = total;
+        break;
+      }
+      exec_result_reset(&pool->results[w]);
+      jobs[w] = job;
+    }
+
+    profile_use(&pool->profile);
+    int w = exec_wait_any(procs, pool->results, pool->jobs);
+    if (w == -1)
+    {
+      if (next >= total)
+        break;
+      continue;
+    }
+    profile_use(&pool->workers[w].profile);
+    uint64_t start = profile_start();
+    callback(jobs[w], &pool->results[w], data);
+    profile_stop(PHASE_CLASSIFY, start);
+    execs++;
+    scratch_clean(&pool->workers[w].scratch);
+    if (pool->adaptive)
+      concurrency_update(&pool->control, 1);
+  }
+  return execs;
+}
+
+/**
+ * Reports where the time of the runs went, summed over the workers, and where the number
+ * of extractors running at once settled, when it follows the execs/s.
+ *
+ * @param[in] pool the pool
+ * @param[in] execs the number of runs
+**/
+static void pool_report(const replay_pool *pool, unsigned long execs)
+{
+  const profile_state *profiles[REPLAY_MAX_JOBS + 1] = {&pool->profile};
+  for (unsigned w = 0; w < pool->jobs; w++)
+    profiles[w + 1] = &pool->workers[w].profile;
+  profile_report(profiles, pool->jobs + 1, execs);
+
+  if (!pool->adaptive)
+    return;
+  printf("Extractors running at once: %u at the end, best %.1f execs/s with %u (%u changes, at most %u)\n",
+         pool->control.limit, pool->control.best_rate, pool->control.best_limit, pool->control.changes, pool->jobs);
+}
+
+/**
+ * Removes the scratch directories of the workers and releases their cores.
+ *
+ * @param[in] pool the pool
+**/
+static void pool_free(replay_pool *pool)
+{
+  profile_use(NULL);
+  for (unsigned w = 0; w < pool->jobs; w++)
+    scratch_remove(&pool->workers[w].scratch);
+  scratch_remove(&pool->work);
+  for (unsigned c = 0; c < pool->locks_count; c++)
+    close(pool->locks[c]);
+  free(pool->locks);
+  free(pool->results);
+  free(pool->workers);
+}
+
+// What the runs of the replay found for each crash
+typedef struct
+{
+    unsigned *counts;   // number of runs that crashed
+    unsigned *hangs;    // number of runs that ran out of time
+    unsigned *runs;     // number of runs done, fewer than asked when the pool was aborted
+    unsigned long timeouts;
+} replay_tally;
+
+static void tally_run(size_t job, const exec_result *result, void *data)
+{
+  replay_tally *tally = data;
+  tally->runs[job]++;
+  tally->timeouts += result->timed_out;
+  tally->hangs[job] += result->timed_out;
+  oracle_result verdict;
+  if (oracle_judge(result->output, result->output_len, result->status, &verdict) == VERDICT_CRASH)
+    tally->counts[job]++;
+}
+
+/**
+ * Prints the crashes of a category of the replay report.
+**/
+static void report_crashes(const store *s, const size_t crashes[], const unsigned counts[], size_t count,
+                           unsigned rechecks, unsigned min, unsigned max, const char *title)
+{
+  printf("%s:\n", title);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (counts[i] < min || counts[i] > max)
+      continue;
+    const store_record *record = &s->records[crashes[i]];
+    if (counts[i] > rechecks + 1)
+      printf("  %6zu  %-48s not replayed bucket %016llx\n", crashes[i], record->test,
+             (unsigned long long)record->bucket);
+    else if (counts[i] > rechecks)
+      printf("  %6zu  %-48s timed out    bucket %016llx\n", crashes[i], record->test,
+             (unsigned long long)record->bucket);
+    else
+      printf("  %6zu  %-48s %u/%u crashes  bucket %016llx\n", crashes[i], record->test, counts[i], rechecks,
+             (unsigned long long)record->bucket);
+  }
+}
+
+/**
+ * Runs every crash of a store against an extractor, several at once, each of them several times.
+ * A crash is fixed when it never reproduces, still crashing when it always does, flaky otherwise,
+ * and timed out when it never reproduces but the extractor ran out of time. A crash that did not get
+ * all its runs, because an input could not be run, is not replayed rather than judged on fewer runs.
+ *
+ * @param[in] extractor path of the extractor
+ * @param[in] options the replay options
+ * @return 0 if the replay ran, -1 otherwise or if some crashes could not be replayed
+**/
+int replay(const char *extractor, const replay_options *options)
+{
+  replay_pool pool;
+  if (pool_init(&pool, extractor, options) == -1)
+    return -1;
+
+  store s;
+  if (store_open(&s, options->store_file, 0) == -1)
+  {
+    printf("The store \"%s\" doesn't exist\n", options->store_file);
+    pool_free(&pool);
+    return -1;
+  }
+
+  // The crashes of the store, the other inputs are not replayed
+  size_t *crashes = calloc(s.count + 1, sizeof(size_t));
+  replay_tally tally = {calloc(s.count + 1, sizeof(unsigned)), calloc(s.count + 1, sizeof(unsigned)),
+                        calloc(s.count + 1, sizeof(unsigned)), 0};
+  if (crashes == NULL || tally.counts == NULL || tally.hangs == NULL || tally.runs == NULL)
+  {
+    printf("Array not allocated \n");
+    exit(0);
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < s.count; i++)
+  {
+    if (s.records[i].kind == STORE_CRASH)
+      crashes[count++] = i;
+  }
+  unsigned rechecks = options->rechecks ? options->rechecks : 1;
+
+  printf("Replaying %zu crashes of %s, %u runs each on %u workers...\n", count, options->store_file, rechecks,
+         pool.adaptive ? pool.control.limit : pool.jobs);
+  double start = now_seconds();
+  unsigned long execs = pool_run(&pool, &s, crashes, count, rechecks, tally_run, &tally);
+  double duration = now_seconds() - start;
+
+  // Verdicts, an input that never crashed but ran out of time is not fixed
+  unsigned *counts = tally.counts;
+  size_t fixed = 0, still = 0, flaky = 0, hanging = 0, skipped = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (tally.runs[i] < rechecks)
+    {
+      skipped++;
+      counts[i] = rechecks + 2;
+    }
+    else if (counts[i] == 0 && tally.hangs[i])
+    {
+      hanging++;
+      counts[i] = rechecks + 1;
+    }
+    else if (counts[i] == 0)
+      fixed++;
+    else if (counts[i] >= rechecks)
+      still++;
+    else
+      flaky++;
+  }
+
+  if (fixed)
+    report_crashes(&s, crashes, counts, count, rechecks, 0, 0, KGRN "Fixed" KNRM);
+  if (flaky)
+    report_crashes(&s, crashes, counts, count, rechecks, 1, rechecks - 1, KYEL "Flaky" KNRM);
+  if (hanging)
+    report_crashes(&s, crashes, counts, count, rechecks, rechecks + 1, rechecks + 1, "Timed out");
+  if (skipped)
+    report_crashes(&s, crashes, counts, count, rechecks, rechecks + 2, rechecks + 2, KRED "Not replayed" KNRM);
+
+  printf("\n%zu crashes replayed in %.3f s (%.1f execs/s, %lu timeouts):\n", count, duration,
+         duration > 0 ? execs / duration : 0, tally.timeouts);
+  pool_report(&pool, execs);
+  printf(KRED "%zu still crashing" KNRM "\n", still);
+  printf(KGRN "%zu fixed" KNRM "\n", fixed);
+  printf(KYEL "%zu flaky" KNRM "\n", flaky);
+  printf("%zu timed out\n", hanging);
+  if (skipped)
+    printf(KRED "%zu not replayed" KNRM "\n", skipped);
+
+  pool_free(&pool);
+  free(crashes);
+  free(tally.counts);
+  free(tally.hangs);
+  free(tally.runs);
+  store_close(&s);
+  return pool.aborted ? -1 : 0;
+}
+
+// An input of the store with the behaviour it showed when distilling
+typedef struct
+{
+    uint64_t key;       // kind of the input and response of the extractor, the behaviour to keep
+    uint64_t bucket;    // response of the extractor, see novelty_bucket()
+    uint64_t size;      // size of the input
+    double time;        // CPU time of the extractor on the input
+    size_t record;      // index of the input in the store
+} distill_input;
+
+static void distill_run(size_t job, const exec_result *result, void *data)
+{
+  distill_input *input = &((distill_input *)data)[job];
+  input->bucket = novelty_bucket(result->output, result->status);
+  input->time = result->usage.ru_utime.tv_sec + result->usage.ru_utime.tv_usec / 1e6 +
+                result->usage.ru_stime.tv_sec + result->usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * Orders the inputs by behaviour, then the smallest first, then the fastest first.
+**/
+static int compare_inputs(const void *a, const void *b)
+{
+  const distill_input *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  if (x->size != y->size)
+    return x->size < y->size ? -1 : 1;
+  if (x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return x->record < y->record ? -1 : x->record > y->record;
+}
+
+/**
+ * Distills a store to the smallest set of inputs showing all the behaviours of the extractor.
+ * Every input is run again, and a behaviour is the reason the input was kept with the response
+ * class of the extractor (the crash bucket for the crashes). For each behaviour, the smallest
+ * input is kept, and the fastest one among inputs of the same size.
+ * The distilled store is written next to the original one, synced, then renamed over it, so an
+ * interrupted distillation leaves either the original store or the distilled one, see store_replace().
+ * A store whose inputs could not all be run is left untouched.
+ *
+ * @param[in] extractor path of the extractor
+ * @param[in] options the replay options, the store is the one distilled
+ * @return 0 if the store was distilled, -1 otherwise
+**/
+int distill(const char *extractor, const replay_options *options)
+{
+  replay_pool pool;
+  if (pool_init(&pool, extractor, options) == -1)
+    return -1;
+
+  store s;
+  if (store_open(&s, options->store_file, 0) == -1)
+  {
+    printf("The store \"%s\" doesn't exist\n", options->store_file);
+    pool_free(&pool);
+    return -1;
+  }
+
+  size_t count = s.count;
+  size_t *records = malloc((count + 1) * sizeof(size_t));
+  distill_input *inputs = calloc(count + 1, sizeof(distill_input));
+  if (records == NULL || inputs == NULL)
+  {
+    printf("Array not allocated \n");
+    exit(0);
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    records[i] = i;
+    inputs[i].record = i;
+    inputs[i].size = s.records[i].size;
+  }
+
+  printf("Distilling the %zu inputs of %s on %u workers...\n", count, options->store_file,
+         pool.adaptive ? pool.control.limit : pool.jobs);
+  double start = now_seconds();
+  unsigned long execs = pool_run(&pool, &s, records, count, 1, distill_run, inputs);
+  double duration = now_seconds() - start;
+  pool_report(&pool, execs);
+  pool_free(&pool);
+  if (pool.aborted)
+  {
+    printf("The store \"%s\" was not distilled, it is left untouched\n", options->store_file);
+    store_close(&s);
+    free(records);
+    free(inputs);
+    return -1;
+  }
+
+  // The behaviour of an input is its response with the reason it was kept
+  for (size_t i = 0; i < count; i++)
+    inputs[i].key = inputs[i].bucket ^ ((s.records[i].kind + 1) * 0x9e3779b97f4a7c15ULL);
+  qsort(inputs, count, sizeof(distill_input), compare_inputs);
+
+  char tmp[PATH_MAX], tmp_index[PATH_MAX];
+  snprintf(tmp, sizeof(tmp), "%.*s" STORE_NEW_EXT, PATH_MAX - 16, options->store_file);
+  snprintf(tmp_index, sizeof(tmp_index), "%.*s" STORE_INDEX_EXT, PATH_MAX - 8, tmp);
+  unlink(tmp);
+  unlink(tmp_index);
+
+  store out;
+  if (store_open(&out, tmp, 1) == -1)
+  {
+    printf("The store \"%s\" cannot be created\n", tmp);
+    store_close(&s);
+    free(records);
+    free(inputs);
+    return -1;
+  }
+
+  // The first input of each behaviour is the one kept
+  size_t kept = 0, failed = 0;
+  uint64_t size_before = 0, size_after = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    size_before += inputs[i].size;
+    if (i > 0 && inputs[i].key == inputs[i - 1].key)
+      continue;
+    const store_record *record = &s.records[inputs[i].record];
+    const char *data = store_data(&s, inputs[i].record);
+    if (data == NULL || store_add(&out, data, record->size, record->kind, inputs[i].bucket, record->test) == -1)
+    {
+      failed++;
+      continue;
+    }
+    kept++;
+    size_after += record->size;
+  }
+
+  int ok = failed == 0 && fsync(out.log_fd) == 0 && fsync(out.index_fd) == 0;
+  store_close(&out);
+  store_close(&s);
+  free(records);
+  free(inputs);
+  int replaced = ok ? store_replace(options->store_file) : -1;
+  if (replaced == -1)
+  {
+    printf("The store \"%s\" was not distilled, it is left untouched\n", options->store_file);
+    unlink(tmp);
+    unlink(tmp_index);
+    return -1;
+  }
+  if (replaced == 1)
+    printf("The index of the store \"%s\" is put in place at its next opening\n", options->store_file);
+
+  printf("%lu inputs run in %.3f s (%.1f execs/s)\n", execs, duration, duration > 0 ? execs / duration : 0);
+  printf(KGRN "%zu of %zu inputs kept" KNRM ", %llu bytes instead of %llu\n", kept, count,
+         (unsigned long long)size_after, (unsigned long long)size_before);
+  return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+
+#define REPLAY_RECHECKS 3       // default number of runs of each input
+#define REPLAY_TIMEOUT 5.0      // default time given to each run in seconds
+#define REPLAY_MAX_JOBS 64      // maximum number of extractors running at once
+#define REPLAY_ADAPTIVE_JOBS 2  // extractors running at once per CPU at most when the number follows the execs/s
+
+typedef struct
+{
+    const char *store_file; // store holding the crashes to replay, or the inputs to distill
+    unsigned rechecks;      // number of runs of each input, to tell the flaky crashes
+    unsigned jobs;          // number of extractors running at once, 0 for the number of CPUs
+    double timeout;         // time given to each run in seconds
+    size_t mem_limit;       // RLIMIT_AS of the extractor in bytes, 0 for no limit
+    int adaptive;           // the number of extractors running at once follows the execs/s, jobs is the most
+    int affinity;           // pin each worker and its extractors to a core, or a hardware thread
+    int profile;            // time the stages of the runs, summed over the workers in the report
+} replay_options;
+
+int replay(const char *extractor, const replay_options *options);
+int distill(const char *extractor, const replay_options *options);
+
+#endif
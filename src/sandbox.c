@@ -0,0 +1,430 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/statvfs.h>
+#include <sys/wait.h>
+
+#include <poll.h>
+#include <sys/syscall.h>
+
+#include "fuzzer.h"
+#include "sandbox.h"
+#include "cpu.h"
+
+typedef struct
+{
+    char extractor[PATH_MAX];
+    char archive[PATH_MAX];
+    char workdir[PATH_MAX];
+    size_t mem_limit;
+    double timeout;         // the child is killed after this number of seconds
+    cpu_slot cpus;          // CPUs the child is pinned to, none to keep the ones of the zygote
+} sandbox_request;
+
+typedef struct
+{
+    int ok;                 // 0 if the child could not be started
+    int timed_out;          // the child was killed because it ran out of time
+    int status;
+    struct rusage usage;
+    double setup_time;
+} sandbox_response;
+
+/**
+ * Writes a file of /proc, used to set up the id mappings of the user namespace.
+**/
+static int write_proc(const char *path, const char *content)
+{
+  int fd = open(path, O_WRONLY);
+  if (fd == -1)
+    return -1;
+  ssize_t n = write(fd, content, strlen(content));
+  close(fd);
+  return n == (ssize_t)strlen(content) ? 0 : -1;
+}
+
+/**
+ * Turns every mount of the namespace read-only, except the pseudo file systems.
+ * The flags locked by the user namespace (nosuid, nodev, noexec...) have to be kept.
+ * This is best effort: a mount that cannot be remounted stays as it is.
+**/
+static void remount_read_only(void)
+{
+  FILE *f = fopen("/proc/self/mountinfo", "r");
+  if (!f)
+    return;
+
+  char line[PATH_MAX * 2];
+  while (fgets(line, sizeof(line), f))
+  {
+    // <id> <parent> <major:minor> <root> <mount point> ...
+    char mount_point[PATH_MAX];
+    if (sscanf(line, "%*s %*s %*s %*s %4095s", mount_point) != 1)
+      continue;
+    if (strncmp(mount_point, "/proc", 5) == 0 || strncmp(mount_point, "/sys", 4) == 0 || strncmp(mount_point, "/dev", 4) == 0)
+      continue;
+
+    struct statvfs st;
+    if (statvfs(mount_point, &st) == -1)
+      continue;
+
+    unsigned long flags = MS_REMOUNT | MS_BIND | MS_RDONLY;
+    if (st.f_flag & ST_NOSUID)
+      flags |= MS_NOSUID;
+    if (st.f_flag & ST_NODEV)
+      flags |= MS_NODEV;
+    if (st.f_flag & ST_NOEXEC)
+      flags |= MS_NOEXEC;
+    if (st.f_flag & ST_NOATIME)
+      flags |= MS_NOATIME;
+    if (st.f_flag & ST_NODIRATIME)
+      flags |= MS_NODIRATIME;
+    if (st.f_flag & ST_RELATIME)
+      flags |= MS_RELATIME;
+    mount(NULL, mount_point, NULL, flags, NULL);
+  }
+
+  fclose(f);
+}
+
+/**
+ * Enters a new user and mount namespace in which the current user is root,
+ * and makes the whole file system read-only. Done once by the zygote.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int enter_namespaces(void)
+{
+  uid_t uid = getuid();
+  gid_t gid = getgid();
+
+  if (unshare(CLONE_NEWUSER | CLONE_NEWNS) == -1)
+    return -1;
+
+  char map[64];
+  snprintf(map, sizeof(map), "0 %u 1", uid);
+  if (write_proc("/proc/self/uid_map", map) == -1)
+    return -1;
+  write_proc("/proc/self/setgroups", "deny");
+  snprintf(map, sizeof(map), "0 %u 1", gid);
+  if (write_proc("/proc/self/gid_map", map) == -1)
+    return -1;
+
+  // The mounts done here must not propagate back to the host
+  if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) == -1)
+    return -1;
+
+  remount_read_only();
+  return 0;
+}
+
+/**
+ * Code of a child forked by the zygote: gets its own mount namespace with a fresh tmpfs
+ * as working directory, applies the resource limits, pins itself to its CPUs and replaces
+ * itself with the extractor.
+ * Everything the extractor writes is in the tmpfs and vanishes with the namespace.
+**/
+static void sandbox_child(const sandbox_request *request, int out)
+{
+  if (unshare(CLONE_NEWNS) == -1)
+    _exit(127);
+  if (mount("tmpfs", request->workdir, "tmpfs", MS_NOSUID | MS_NODEV, SANDBOX_TMPFS_OPTIONS) == -1)
+    _exit(127);
+  if (chdir(request->workdir) == -1)
+    _exit(127);
+
+  dup2(out, STDOUT_FILENO);
+  dup2(out, STDERR_FILENO);
+  close(out);
+
+  struct rlimit limit = {SANDBOX_FSIZE, SANDBOX_FSIZE};
+  setrlimit(RLIMIT_FSIZE, &limit);
+  limit.rlim_cur = limit.rlim_max = SANDBOX_CPU;
+  setrlimit(RLIMIT_CPU, &limit);
+  limit.rlim_cur = limit.rlim_max = 0;
+  setrlimit(RLIMIT_CORE, &limit);
+  if (request->mem_limit)
+  {
+    limit.rlim_cur = limit.rlim_max = request->mem_limit;
+    setrlimit(RLIMIT_AS, &limit);
+  }
+  if (request->cpus.count)
+    cpu_pin(&request->cpus);
+
+  char *argv[] = {(char *)request->extractor, (char *)request->archive, NULL};
+  execvp(request->extractor, argv);
+  _exit(127);
+}
+
+/**
+ * Waits for a child of the zygote and kills it at its deadline, as exec_wait_all() does for the
+ * children of the fuzzer. The exit is waited for on a pidfd, or polled every EXEC_REAP_POLL
+ * milliseconds on the kernels without pidfd_open().
+ *
+ * @param[in] pid the child
+ * @param[in] timeout the time given to the child in seconds
+ * @param[out] response the status, the resource usage, and whether the child ran out of time
+**/
+static void wait_child(pid_t pid, double timeout, sandbox_response *response)
+{
+  double deadline = now_seconds() + timeout;
+  int pidfd = syscall(EXEC_PIDFD_OPEN, pid, 0);
+  pid_t reaped;
+  while ((reaped = wait4(pid, &response->status, deadline > 0 ? WNOHANG : 0, &response->usage)) != pid)
+  {
+    if (reaped == -1 && errno != EINTR)
+      break;
+    if (reaped != 0)
+      continue;
+
+    double left = deadline - now_seconds();
+    if (left <= 0)
+    {
+      kill(pid, SIGKILL);
+      response->timed_out = 1;
+      deadline = 0;
+      continue;
+    }
+    struct pollfd pfd = {pidfd, POLLIN, 0};
+    poll(&pfd, pidfd == -1 ? 0 : 1, pidfd == -1 ? EXEC_REAP_POLL : (int)(left * 1000) + 1);
+  }
+  if (pidfd != -1)
+    close(pidfd);
+}
+
+/**
+ * Main loop of the zygote: for each request, forks a child with the output descriptor
+ * received along with the request, waits for it until its deadline and sends back its status
+ * and resource usage.
+ * Stops when the fuzzer closes the socket.
+**/
+static void zygote_loop(int sock)
+{
+  for (;;)
+  {
+    sandbox_request request;
+    int out = -1;
+
+    // The write end of the output pipe comes as ancillary data
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(sock, &msg, 0);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n != sizeof(request))
+      _exit(0);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy(&out, CMSG_DATA(cmsg), sizeof(int));
+
+    sandbox_response response = {0};
+    int ready[2];
+    double start = now_seconds();
+
+    if (out != -1 && pipe2(ready, O_CLOEXEC) == 0)
+    {
+      pid_t pid = fork();
+      if (pid == 0)
+      {
+        close(sock);
+        close(ready[0]);
+        sandbox_child(&request, out);
+      }
+      close(ready[1]);
+
+      if (pid > 0)
+      {
+        // The pipe is closed by the execve() of the child, which ends the setup
+        char c;
+        while (read(ready[0], &c, 1) == -1 && errno == EINTR)
+          ;
+        response.setup_time = now_seconds() - start;
+
+        close(out);
+        out = -1;
+        wait_child(pid, request.timeout, &response);
+        response.ok = 1;
+      }
+      close(ready[0]);
+    }
+
+    if (out != -1)
+      close(out);
+    if (send(sock, &response, sizeof(response), 0) != sizeof(response))
+      _exit(0);
+  }
+}
+
+/**
+ * Code of the zygote: enters the namespaces, tells the fuzzer whether it could, then serves its requests.
+**/
+static void zygote_main(int sock)
+{
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  char ok = enter_namespaces() == 0;
+  if (send(sock, &ok, 1, 0) != 1 || !ok)
+    _exit(0);
+  zygote_loop(sock);
+  _exit(0);
+}
+
+/**
+ * Starts the zygote, which enters the namespaces once so that each execution only pays
+ * for a fork, a mount namespace and a tmpfs. The zygote is started by the launcher, so that
+ * the children it forks do not carry the pages of the fuzzer, see exec_launcher_start().
+ *
+ * @param[out] box the sandbox
+ * @return 0 on success, -1 if the namespaces are not available
+**/
+int sandbox_start(sandbox *box)
+{
+  int socks[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks) == -1)
+    return -1;
+
+  memset(box, 0, sizeof(sandbox));
+  box->zygote = exec_launch_call(zygote_main, socks[1]);
+  if (box->zygote == -1)
+  {
+    fflush(stdout);
+    box->zygote = fork();
+    if (box->zygote == 0)
+    {
+      close(socks[0]);
+      zygote_main(socks[1]);
+    }
+  }
+  close(socks[1]);
+  if (box->zygote == -1)
+  {
+    close(socks[0]);
+    return -1;
+  }
+  box->sock = socks[0];
+
+  char ok = 0;
+  if (recv(box->sock, &ok, 1, 0) != 1 || !ok)
+  {
+    sandbox_stop(box);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Stops the zygote.
+ *
+ * @param[in] box the sandbox
+**/
+void sandbox_stop(sandbox *box)
+{
+  // A zygote started by the launcher is not a child of the fuzzer, it leaves once the socket is closed
+  close(box->sock);
+  waitpid(box->zygote, NULL, 0);
+}
+
+/**
+ * Runs the extractor on an archive in the sandbox. The zygote kills it after the timeout of the
+ * options, or SANDBOX_TIMEOUT without one, and the output is read until then.
+ *
+ * @param[in] box the sandbox
+ * @param[in] extractor absolute path of the extractor
+ * @param[in] archive absolute path of the archive, outside of the working directory
+ * @param[in] options the executor options, the working directory is where the tmpfs is mounted, the child
+ *                    is pinned to the CPUs
+ * @param[out] result the status, resource usage and beginning of the output of the child
+ * @return 0 on success, -1 if the child could not be started
+**/
+int sandbox_exec(sandbox *box, const char *extractor, const char *archive, const exec_options *options, exec_result *result)
+{
+  double start = now_seconds();
+
+  sandbox_request request;
+  memset(&request, 0, sizeof(request));
+  strncpy(request.extractor, extractor, PATH_MAX - 1);
+  strncpy(request.archive, archive, PATH_MAX - 1);
+  strncpy(request.workdir, options->workdir ? options->workdir : "/tmp", PATH_MAX - 1);
+  request.mem_limit = options->mem_limit;
+  request.timeout = options->timeout > 0 ? options->timeout : SANDBOX_TIMEOUT;
+  if (options->cpus)
+    request.cpus = *options->cpus;
+
+  int fds[2];
+  if (pipe(fds) == -1)
+  {
+    printf("Error opening pipe!");
+    return -1;
+  }
+
+  // Send the request with the write end of the pipe
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {&request, sizeof(request)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fds[1], sizeof(int));
+
+  ssize_t sent = sendmsg(box->sock, &msg, 0);
+  close(fds[1]);
+  if (sent != sizeof(request))
+  {
+    close(fds[0]);
+    printf("Sandbox not responding");
+    return -1;
+  }
+
+  exec_read_output(fds[0], result, start + request.timeout + SANDBOX_GRACE);
+  close(fds[0]);
+
+  sandbox_response response;
+  if (recv(box->sock, &response, sizeof(response), 0) != sizeof(response) || !response.ok)
+  {
+    printf("Sandbox not responding");
+    return -1;
+  }
+
+  result->status = response.status;
+  result->usage = response.usage;
+  result->timed_out = response.timed_out;
+
+  box->execs++;
+  box->setup_time += response.setup_time;
+  box->exec_time += now_seconds() - start;
+  return 0;
+}
+
+/**
+ * Prints what the sandbox costs for each execution.
+ *
+ * @param[in] box the sandbox
+**/
+void sandbox_report(const sandbox *box)
+{
+  if (box->execs == 0)
+    return;
+  printf("Sandbox: %.1f us of setup per exec (fork, mount namespace, tmpfs) out of %.1f us per exec\n",
+         box->setup_time / box->execs * 1e6, box->exec_time / box->execs * 1e6);
+}
@@ -0,0 +1,28 @@
+#ifndef SANDBOX_H
+#define SANDBOX_H
+
+#include <sys/types.h>
+
+#include "exec.h"
+
+#define SANDBOX_TMPFS_OPTIONS "size=64m,mode=0700" // private working directory of each child
+#define SANDBOX_FSIZE (64 * 1024 * 1024)           // RLIMIT_FSIZE of the child in bytes
+#define SANDBOX_CPU 10                             // RLIMIT_CPU of the child in seconds
+#define SANDBOX_TIMEOUT 10                         // wall-clock seconds of the child when the executor gives no timeout
+#define SANDBOX_GRACE 1                            // seconds the fuzzer goes on reading after the deadline, while the zygote kills the child
+
+typedef struct sandbox
+{
+    pid_t zygote;       // process owning the namespaces, forks the children
+    int sock;           // socket to send the requests to the zygote
+    unsigned long execs;
+    double setup_time;  // time from the request to the execve() of the child, summed over the executions
+    double exec_time;   // time of the whole executions, summed
+} sandbox;
+
+int sandbox_start(sandbox *box);
+void sandbox_stop(sandbox *box);
+int sandbox_exec(sandbox *box, const char *extractor, const char *archive, const exec_options *options, exec_result *result);
+void sandbox_report(const sandbox *box);
+
+#endif
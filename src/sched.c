@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+#include "fuzzer.h"
+#include "sched.h"
+#include "exec.h"
+
+static void family_names(Fuzzer *fuzzer) { test_names(0, fuzzer); }
+static void family_gname(Fuzzer *fuzzer) { test_uname(fuzzer, 0); }
+static void family_uname(Fuzzer *fuzzer) { test_uname(fuzzer, 1); }
+
+// The generator families, in the order they are run when nothing is known about them
+const test_family FAMILIES[FAMILIES_COUNT] = {
+    {"name", family_names},
+    {"mode", test_mode},
+    {"uid", test_uid},
+    {"gid", test_gid},
+    {"size", test_size},
+    {"mtime", test_mtime},
+    {"chksum", test_chksum},
+    {"numeric", test_numeric},
+    {"typeflag", test_typeflag},
+    {"linkname", test_linkname},
+    {"magic", test_magic},
+    {"version", test_version},
+    {"gname", family_gname},
+    {"uname", family_uname},
+    {"end_bytes", test_end_bytes},
+    {"files", test_files},
+    {"extended", test_extended},
+};
+
+/**
+ * Allocates the scheduler state and loads the statistics of the previous runs.
+ * A missing stats file means that nothing is known yet.
+ *
+ * @param[in] stats_file path of the stats file
+ * @return the scheduler state, exits if it cannot be allocated
+**/
+sched_state *sched_init(const char *stats_file)
+{
+  sched_state *state = calloc(1, sizeof(sched_state));
+  if (state == NULL)
+  {
+    printf("Struct not allocated \n");
+    exit(0);
+  }
+
+  FILE *f = fopen(stats_file, "r");
+  if (!f)
+    return state;
+
+  // One line per arm: <family|op> <name> <runs> <execs> <rewards> <seconds>
+  char kind[16], name[64];
+  arm_stats values;
+  while (fscanf(f, "%15s %63s %lu %lu %lu %lf", kind, name, &values.runs, &values.execs, &values.rewards, &values.seconds) == 6)
+  {
+    for (unsigned i = 0; i < FAMILIES_COUNT && strcmp(kind, "family") == 0; i++)
+    {
+      if (strcmp(FAMILIES[i].name, name) == 0)
+        state->families[i] = values;
+    }
+    for (unsigned i = 0; i < MUT_COUNT && strcmp(kind, "op") == 0; i++)
+    {
+      if (strcmp(mutation_name(i), name) == 0)
+        state->ops[i] = values;
+    }
+  }
+
+  fclose(f);
+  return state;
+}
+
+/**
+ * Saves the statistics so that the next runs start from them.
+ *
+ * @param[in] state the scheduler state
+ * @param[in] stats_file path of the stats file
+**/
+void sched_save(const sched_state *state, const char *stats_file)
+{
+  FILE *f = fopen(stats_file, "w");
+  if (!f)
+  {
+    printf("Could not write to file");
+    return;
+  }
+
+  for (unsigned i = 0; i < FAMILIES_COUNT; i++)
+  {
+    const arm_stats *a = &state->families[i];
+    fprintf(f, "family %s %lu %lu %lu %f\n", FAMILIES[i].name, a->runs, a->execs, a->rewards, a->seconds);
+  }
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+  {
+    const arm_stats *a = &state->ops[i];
+    fprintf(f, "op %s %lu %lu %lu %f\n", mutation_name(i), a->runs, a->execs, a->rewards, a->seconds);
+  }
+
+  fclose(f);
+}
+
+/**
+ * Upper confidence bound of an arm (UCB1). The arms never tried come first.
+ *
+ * @param[in] value the normalized reward of the arm, between 0 and 1
+ * @param[in] runs the number of times the arm was tried
+ * @param[in] total_runs the number of times all the arms were tried
+ * @return the score of the arm
+**/
+static double ucb(double value, unsigned long runs, unsigned long total_runs)
+{
+  if (runs == 0)
+    return DBL_MAX;
+  return value + UCB_EXPLORATION * sqrt(log((double)total_runs) / runs);
+}
+
+/**
+ * Runs the generator families, the most promising first.
+ * A family is scored by its crash yield per second over the previous runs, normalized by the
+ * best family, plus the UCB exploration term, so that cheap families that crash often come
+ * first while the others still get a chance to move up. The families never run keep their order.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+**/
+void sched_run_families(Fuzzer *fuzzer)
+{
+  sched_state *state = fuzzer->sched;
+  unsigned order[FAMILIES_COUNT];
+  double score[FAMILIES_COUNT];
+
+  // Best crash yield to normalize the yields
+  unsigned long total_runs = 0;
+  double best_yield = 0;
+  for (unsigned i = 0; i < FAMILIES_COUNT; i++)
+  {
+    arm_stats *a = &state->families[i];
+    total_runs += a->runs;
+    if (a->seconds > 0 && a->rewards / a->seconds > best_yield)
+      best_yield = a->rewards / a->seconds;
+  }
+
+  // Score the families and sort them, keeping the table order for equal scores
+  for (unsigned i = 0; i < FAMILIES_COUNT; i++)
+  {
+    arm_stats *a = &state->families[i];
+    double yield = best_yield > 0 && a->seconds > 0 ? a->rewards / a->seconds / best_yield : 0;
+    score[i] = ucb(yield, a->runs, total_runs);
+
+    unsigned j = i;
+    while (j > 0 && score[order[j - 1]] < score[i])
+    {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  if (total_runs)
+  {
+    printf("\nFamilies order:");
+    for (unsigned i = 0; i < FAMILIES_COUNT; i++)
+      printf(" %s", FAMILIES[order[i]].name);
+    printf("\n");
+  }
+
+  for (unsigned i = 0; i < FAMILIES_COUNT && !fuzzer->stop_reason; i++)
+  {
+    arm_stats *a = &state->families[order[i]];
+    unsigned long execs = fuzzer->execs;
+    int crashes = fuzzer->crashes_number;
+    double start = now_seconds();
+
+    FAMILIES[order[i]].run(fuzzer);
+
+    a->runs++;
+    a->execs += fuzzer->execs - execs;
+    a->rewards += fuzzer->crashes_number - crashes;
+    a->seconds += now_seconds() - start;
+  }
+}
+
+/**
+ * Picks the mutation operator to apply with UCB1, the reward of an operator being the rate
+ * of crashes and new responses it led to. The operators that cannot be applied, like
+ * MUT_DICT_TOKEN without a dictionary, are left out.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @return the mutation operator
+**/
+mutation_op sched_pick_mutation(Fuzzer *fuzzer)
+{
+  sched_state *state = fuzzer->sched;
+  unsigned long total_runs = 0;
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+    if (mutation_available(i))
+      total_runs += state->ops[i].runs;
+
+  mutation_op best = 0;
+  double best_score = -1;
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+  {
+    if (!mutation_available(i))
+      continue;
+    arm_stats *a = &state->ops[i];
+    double value = a->runs ? (double)a->rewards / a->runs : 0;
+    double score = ucb(value, a->runs, total_runs);
+    if (score > best_score)
+    {
+      best_score = score;
+      best = i;
+    }
+  }
+
+  state->ops[best].runs++;
+  return best;
+}
+
+/**
+ * Gives the outcome of an execution to the operators that produced its input.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+ * @param[in] ops the operators applied to the input
+ * @param[in] count the number of operators
+ * @param[in] reward whether the execution crashed or produced a new response
+**/
+void sched_reward_mutations(Fuzzer *fuzzer, const mutation_op *ops, unsigned count, int reward)
+{
+  for (unsigned i = 0; i < count; i++)
+  {
+    fuzzer->sched->ops[ops[i]].execs++;
+    if (reward)
+      fuzzer->sched->ops[ops[i]].rewards++;
+  }
+}
+
+/**
+ * Checks the stop conditions after an execution: number of crashes, exec budget and time budget.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+**/
+void sched_update_stop(Fuzzer *fuzzer)
+{
+  const Options *o = &fuzzer->options;
+
+  if (o->max_crashes && (unsigned)fuzzer->crashes_number >= o->max_crashes)
+    fuzzer->stop_reason = "crash count reached";
+  else if (o->exec_budget && fuzzer->execs >= o->exec_budget)
+    fuzzer->stop_reason = "exec budget exhausted";
+  else if (o->time_budget > 0 && now_seconds() - fuzzer->start_time >= o->time_budget)
+    fuzzer->stop_reason = "time budget exhausted";
+}
+
+/**
+ * Prints the time to first crash and why the run stopped early, if it did.
+ *
+ * @param[in] fuzzer A pointer to the Fuzzer struct containing the fuzzer's state and statistics.
+**/
+void sched_report(const Fuzzer *fuzzer)
+{
+  if (fuzzer->crashes_number)
+    printf("First crash after %lu execs in %.3f s\n", fuzzer->first_crash_execs, fuzzer->first_crash_time - fuzzer->start_time);
+  else
+    printf("No crash after %lu execs\n", fuzzer->execs);
+
+  if (fuzzer->stop_reason)
+    printf("Stopped early: %s\n", fuzzer->stop_reason);
+}
@@ -0,0 +1,44 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "fuzzer.h"
+#include "mutate.h"
+
+#define STATS_FILE "fuzzy_stats.dat" // default file keeping the statistics between runs
+#define UCB_EXPLORATION 1.4         // weight of the exploration term of the bandit
+
+typedef void (*family_fn)(Fuzzer *fuzzer);
+
+typedef struct
+{
+    const char *name;
+    family_fn run;
+} test_family;
+
+typedef struct
+{
+    unsigned long runs;       // number of times the family or operator was used
+    unsigned long execs;      // number of executions of the extractor
+    unsigned long rewards;    // crashes for a family, crashes or new responses for an operator
+    double seconds;           // time spent running the family
+} arm_stats;
+
+#define FAMILIES_COUNT 17
+
+typedef struct sched_state
+{
+    arm_stats families[FAMILIES_COUNT];
+    arm_stats ops[MUT_COUNT];
+} sched_state;
+
+extern const test_family FAMILIES[FAMILIES_COUNT];
+
+sched_state *sched_init(const char *stats_file);
+void sched_save(const sched_state *state, const char *stats_file);
+void sched_run_families(Fuzzer *fuzzer);
+mutation_op sched_pick_mutation(Fuzzer *fuzzer);
+void sched_reward_mutations(Fuzzer *fuzzer, const mutation_op *ops, unsigned count, int reward);
+void sched_update_stop(Fuzzer *fuzzer);
+void sched_report(const Fuzzer *fuzzer);
+
+#endif
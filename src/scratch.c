@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "scratch.h"
+
+/**
+ * Creates a scratch directory of the current process in the current directory.
+ * The extractor is run inside it, so that the files it extracts stay out of the way
+ * and can be removed after each execution.
+ *
+ * @param[out] scratch the scratch directory
+ * @param[in] worker number of the worker using it, each extractor running at the same time needs its own
+ * @return 0 on success, -1 otherwise
+**/
+int scratch_create(scratch_dir *scratch, unsigned worker)
+{
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return -1;
+
+  if (snprintf(scratch->path, sizeof(scratch->path), "%s/" SCRATCH_PREFIX "%d_%u", cwd, getpid(), worker) >= (int)sizeof(scratch->path))
+    return -1;
+
+  if (mkdir(scratch->path, 0700) == -1)
+  {
+    printf("Could not make directory %s\n", scratch->path);
+    return -1;
+  }
+
+  scratch->fd = open(scratch->path, O_RDONLY | O_DIRECTORY);
+  if (scratch->fd == -1)
+  {
+    rmdir(scratch->path);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Removes every entry of a directory, recursing into the sub-directories.
+ * Symbolic links are removed, never followed.
+ *
+ * @param[in] dirfd descriptor of the directory, left open
+**/
+static void clean_dir(int dirfd)
+{
+  // fdopendir() takes ownership of the descriptor, the copy shares the position of the original
+  int fd = dup(dirfd);
+  if (fd == -1)
+    return;
+  DIR *dir = fdopendir(fd);
+  if (dir == NULL)
+  {
+    close(fd);
+    return;
+  }
+  rewinddir(dir);
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    // Most entries are regular files, the directories are only found when unlinking fails
+    if (entry->d_type != DT_DIR && unlinkat(dirfd, entry->d_name, 0) == 0)
+      continue;
+
+    struct stat st;
+    if (fstatat(dirfd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISDIR(st.st_mode))
+      continue;
+
+    // The mode of the directory comes from the archive, make sure it can be emptied
+    fchmodat(dirfd, entry->d_name, 0700, 0);
+    int sub = openat(dirfd, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (sub != -1)
+    {
+      clean_dir(sub);
+      close(sub);
+    }
+    unlinkat(dirfd, entry->d_name, AT_REMOVEDIR);
+  }
+
+  closedir(dir);
+}
+
+/**
+ * Removes what the last execution of the extractor created in the scratch directory.
+ * The directory only holds the output of one execution, so this stays cheap
+ * however long the fuzzing goes on.
+ *
+ * @param[in] scratch the scratch directory
+**/
+void scratch_clean(scratch_dir *scratch)
+{
+  clean_dir(scratch->fd);
+}
+
+/**
+ * Empties and removes the scratch directory.
+ *
+ * @param[in] scratch the scratch directory
+**/
+void scratch_remove(scratch_dir *scratch)
+{
+  clean_dir(scratch->fd);
+  close(scratch->fd);
+  rmdir(scratch->path);
+}
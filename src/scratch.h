@@ -0,0 +1,18 @@
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include <limits.h>
+
+#define SCRATCH_PREFIX "fuzzy_scratch_" // scratch directories are named after this prefix, the pid and the number of the worker
+
+typedef struct
+{
+    char path[PATH_MAX];    // absolute path of the scratch directory
+    int fd;                 // descriptor of the directory, used by the *at() calls
+} scratch_dir;
+
+int scratch_create(scratch_dir *scratch, unsigned worker);
+void scratch_clean(scratch_dir *scratch);
+void scratch_remove(scratch_dir *scratch);
+
+#endif
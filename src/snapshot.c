@@ -0,0 +1,868 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "fuzzer.h"
+#include "profile.h"
+#include "snapshot.h"
+
+#define PAGE 4096
+#define SYSCALL_STOP (SIGTRAP | 0x80)
+
+/**
+ * Tells whether the kernel tracks the pages written since /proc/<pid>/clear_refs was reset,
+ * by writing a page of the fuzzer itself.
+**/
+static int soft_dirty_supported(void)
+{
+  static volatile char page[2 * PAGE];
+  volatile char *p = (volatile char *)(((uintptr_t)page + PAGE - 1) & ~(uintptr_t)(PAGE - 1));
+  p[0] = 0;
+
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd == -1)
+    return 0;
+  int cleared = write(fd, "4", 1) == 1;
+  close(fd);
+  if (!cleared)
+    return 0;
+
+  p[0] = 1;
+  uint64_t entry = 0;
+  fd = open("/proc/self/pagemap", O_RDONLY);
+  if (fd == -1)
+    return 0;
+  ssize_t n = pread(fd, &entry, sizeof(entry), ((uintptr_t)p / PAGE) * sizeof(entry));
+  close(fd);
+  return n == sizeof(entry) && (entry >> 55 & 1);
+}
+
+#if defined(__x86_64__)
+
+/**
+ * Waits for the next stop of the extractor, until the deadline if there is one.
+ * SIGCHLD is blocked by snapshot_run(), so that it can be waited for with a timeout.
+ *
+ * @return 0 on a stop or an exit, -1 on timeout or error
+**/
+static int wait_stop(snapshot *s, int *status, double deadline)
+{
+  for (;;)
+  {
+    pid_t pid = waitpid(s->pid, status, deadline ? WNOHANG | __WALL : __WALL);
+    if (pid == s->pid)
+      return 0;
+    if (pid == -1 && errno != EINTR)
+      return -1;
+    if (pid != 0)
+      continue;
+
+    double left = deadline - now_seconds();
+    if (left <= 0)
+      return -1;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    struct timespec wait = {(time_t)left, (long)((left - (time_t)left) * 1e9)};
+    sigtimedwait(&set, NULL, &wait);
+  }
+}
+
+/**
+ * Tells whether the extractor is stopped at the entry of a system call, rather than at its exit.
+ *
+ * @param[out] nr the number of the system call
+**/
+static int syscall_entry(pid_t pid, long *nr)
+{
+  struct __ptrace_syscall_info info;
+  if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) <= 0 || info.op != PTRACE_SYSCALL_INFO_ENTRY)
+    return 0;
+  *nr = info.entry.nr;
+  return 1;
+}
+
+/**
+ * Makes the extractor run a system call, from a stop at the entry of another one, and comes back
+ * to a stop at the entry of a system call. The syscall instruction just run is used again.
+ *
+ * @return the value returned by the system call, -1 if the extractor did not stop as expected
+**/
+static long inject(snapshot *s, long nr, long a1, long a2, long a3, long a4, long a5, long a6)
+{
+  struct user_regs_struct regs;
+  if (ptrace(PTRACE_GETREGS, s->pid, NULL, &regs) == -1)
+    return -1;
+  regs.orig_rax = nr;
+  regs.rdi = a1;
+  regs.rsi = a2;
+  regs.rdx = a3;
+  regs.r10 = a4;
+  regs.r8 = a5;
+  regs.r9 = a6;
+
+  int status;
+  if (ptrace(PTRACE_SETREGS, s->pid, NULL, &regs) == -1 || ptrace(PTRACE_SYSCALL, s->pid, NULL, NULL) == -1 ||
+      wait_stop(s, &status, 0) == -1 || !WIFSTOPPED(status) || WSTOPSIG(status) != SYSCALL_STOP ||
+      ptrace(PTRACE_GETREGS, s->pid, NULL, &regs) == -1)
+    return -1;
+  long rv = regs.rax;
+
+  // Back before the syscall instruction, to stop at its entry again
+  regs.rip -= 2;
+  regs.rax = nr;
+  if (ptrace(PTRACE_SETREGS, s->pid, NULL, &regs) == -1 || ptrace(PTRACE_SYSCALL, s->pid, NULL, NULL) == -1 ||
+      wait_stop(s, &status, 0) == -1 || !WIFSTOPPED(status) || WSTOPSIG(status) != SYSCALL_STOP)
+    return -1;
+  return rv;
+}
+
+/**
+ * Reads the mappings of the extractor.
+ *
+ * @param[out] regions the mappings, to be freed by the caller
+ * @return the number of mappings, -1 on error
+**/
+static int read_maps(pid_t pid, snapshot_region **regions)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return -1;
+
+  int count = 0, cap = 64;
+  *regions = malloc(cap * sizeof(snapshot_region));
+  char line[PATH_MAX + 128];
+  while (*regions && fgets(line, sizeof(line), f))
+  {
+    if (count == cap)
+    {
+      cap *= 2;
+      snapshot_region *grown = realloc(*regions, cap * sizeof(snapshot_region));
+      if (grown == NULL)
+        break;
+      *regions = grown;
+    }
+    snapshot_region *r = &(*regions)[count];
+    memset(r, 0, sizeof(*r));
+    unsigned long start, end;
+    if (sscanf(line, "%lx-%lx %4s", &start, &end, r->perms) != 3)
+      continue;
+    r->start = start;
+    r->end = end;
+    r->special = strstr(line, "[stack]") || strstr(line, "[vdso]") || strstr(line, "[vvar]") || strstr(line, "[vsyscall]");
+    count++;
+  }
+  fclose(f);
+  if (*regions == NULL)
+    return -1;
+  return count;
+}
+
+/**
+ * Reads the descriptors open in the extractor.
+ *
+ * @return the number of descriptors, at most max
+**/
+static unsigned read_fds(pid_t pid, int fds[], unsigned max)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return 0;
+  unsigned count = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL && count < max)
+  {
+    if (ent->d_name[0] != '.')
+      fds[count++] = atoi(ent->d_name);
+  }
+  closedir(dir);
+  return count;
+}
+
+/**
+ * Copies memory from or to the extractor through /proc/<pid>/mem.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int copy_memory(pid_t pid, uintptr_t address, char *data, size_t size, int to_child)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+  int fd = open(path, to_child ? O_WRONLY : O_RDONLY);
+  if (fd == -1)
+    return -1;
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t n = to_child ? pwrite(fd, data + done, size - done, address + done) : pread(fd, data + done, size - done, address + done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  close(fd);
+  return done == size ? 0 : -1;
+}
+
+/**
+ * Reads the signals the extractor catches and the ones it ignores.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int read_signals(pid_t pid, uint64_t *caught, uint64_t *ignored)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/status", pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return -1;
+  char line[256];
+  int found = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    if (sscanf(line, "SigIgn: %" SCNx64, ignored) == 1 || sscanf(line, "SigCgt: %" SCNx64, caught) == 1)
+      found++;
+  }
+  fclose(f);
+  return found == 2 ? 0 : -1;
+}
+
+/**
+ * Saves the actions of the signals the extractor catches or ignores. They go through the scratch
+ * memory of the extractor, whose content is put back after.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int save_signals(snapshot *s)
+{
+  if (read_signals(s->pid, &s->caught, &s->ignored) == -1)
+    return -1;
+  snapshot_action saved;
+  if (copy_memory(s->pid, s->scratch, (char *)&saved, sizeof(saved), 0) == -1)
+    return -1;
+
+  // The signals left at their default action keep a null action, which is SIG_DFL
+  memset(s->actions, 0, sizeof(s->actions));
+  int rv = 0;
+  for (int sig = 1; sig <= SNAPSHOT_SIGNALS && rv == 0; sig++)
+  {
+    uint64_t bit = 1ULL << (sig - 1);
+    if (!((s->caught | s->ignored) & bit))
+      continue;
+    if (inject(s, SYS_rt_sigaction, sig, 0, s->scratch, sizeof(uint64_t), 0, 0) != 0 ||
+        copy_memory(s->pid, s->scratch, (char *)&s->actions[sig - 1], sizeof(snapshot_action), 0) == -1)
+      rv = -1;
+  }
+  if (copy_memory(s->pid, s->scratch, (char *)&saved, sizeof(saved), 1) == -1)
+    rv = -1;
+  return rv;
+}
+
+/**
+ * Puts back the actions of the signals caught or ignored at the snapshot or now, before the memory
+ * is restored. Every one of them is set again, since a handler replaced by another one leaves the
+ * signal caught: /proc/<pid>/status cannot tell that it changed.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int restore_signals(snapshot *s)
+{
+  uint64_t caught, ignored;
+  if (read_signals(s->pid, &caught, &ignored) == -1)
+    return -1;
+  uint64_t handled = caught | ignored | s->caught | s->ignored;
+  for (int sig = 1; sig <= SNAPSHOT_SIGNALS && handled; sig++)
+  {
+    uint64_t bit = 1ULL << (sig - 1);
+    if (!(handled & bit))
+      continue;
+    handled &= ~bit;
+    if (sig == SIGKILL || sig == SIGSTOP)
+      continue;
+    if (copy_memory(s->pid, s->scratch, (char *)&s->actions[sig - 1], sizeof(snapshot_action), 1) == -1 ||
+        inject(s, SYS_rt_sigaction, sig, s->scratch, 0, sizeof(uint64_t), 0, 0) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * Reads the peak RSS of the extractor since it was last reset by clear_refs().
+ *
+ * @return the peak RSS in KB, 0 if it cannot be read
+**/
+static long peak_rss(pid_t pid)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/status", pid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return 0;
+  char line[256];
+  long rss = 0;
+  while (fgets(line, sizeof(line), f) && sscanf(line, "VmHWM: %ld", &rss) != 1)
+    ;
+  fclose(f);
+  return rss;
+}
+
+/**
+ * Writes to /proc/<pid>/clear_refs of the extractor: "4" resets the tracking of the written pages,
+ * "5" the peak RSS.
+**/
+static void clear_refs(pid_t pid, const char *what)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/clear_refs", pid);
+  int fd = open(path, O_WRONLY);
+  if (fd == -1)
+    return;
+  if (write(fd, what, 1) != 1)
+    printf("Could not write to %s\n", path);
+  close(fd);
+}
+
+/**
+ * Takes the snapshot of the extractor, stopped at the entry of the open of the archive: its registers,
+ * its signals, the end of its heap, the content of its writable mappings and its descriptors.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int take_snapshot(snapshot *s)
+{
+  // The snapshot of the previous extractor, if it was started again
+  for (unsigned i = 0; i < s->regions_count; i++)
+    free(s->regions[i].data);
+  free(s->regions);
+  s->regions = NULL;
+  s->regions_count = 0;
+  s->scratch = 0;
+
+  if (ptrace(PTRACE_GETREGS, s->pid, NULL, &s->regs) == -1 || ptrace(PTRACE_GETFPREGS, s->pid, NULL, &s->fpregs) == -1 ||
+      ptrace(PTRACE_GETSIGMASK, s->pid, sizeof(s->sigmask), &s->sigmask) == -1)
+    return -1;
+
+  // The end of the heap, asked to the extractor itself
+  long brk = inject(s, SYS_brk, 0, 0, 0, 0, 0, 0);
+  if (brk == -1)
+    return -1;
+  s->brk = brk;
+
+  int count = read_maps(s->pid, &s->regions);
+  if (count == -1)
+    return -1;
+  s->regions_count = count;
+
+  // The actions of the signals go through the first writable mapping, before its content is saved
+  for (unsigned i = 0; i < s->regions_count && s->scratch == 0; i++)
+  {
+    if (s->regions[i].perms[1] == 'w' && !s->regions[i].special)
+      s->scratch = s->regions[i].start;
+  }
+  if (s->scratch == 0 || save_signals(s) == -1 || ptrace(PTRACE_SETREGS, s->pid, NULL, &s->regs) == -1)
+    return -1;
+  for (unsigned i = 0; i < s->regions_count; i++)
+  {
+    snapshot_region *r = &s->regions[i];
+    if (r->perms[1] != 'w')
+      continue;
+    r->data = malloc(r->end - r->start);
+    if (r->data == NULL || copy_memory(s->pid, r->start, r->data, r->end - r->start, 0) == -1)
+    {
+      free(r->data);
+      r->data = NULL;
+    }
+  }
+
+  s->fds_count = read_fds(s->pid, s->fds, SNAPSHOT_MAX_FDS);
+  if (s->soft_dirty)
+    clear_refs(s->pid, "4");
+  clear_refs(s->pid, "5");
+  return 0;
+}
+
+/**
+ * Starts the extractor under ptrace and runs it until it opens the archive, where the snapshot is taken.
+ * It is given the timeout of the executor options to get there, or SNAPSHOT_START_TIMEOUT without one.
+ *
+ * @return 0 on success, -1 if the extractor exited, ran out of time (result->timed_out is set)
+ *         or did something else before opening the archive
+**/
+static int start_extractor(snapshot *s, exec_result *result)
+{
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1)
+    return -1;
+  fcntl(fds[0], F_SETPIPE_SZ, SNAPSHOT_PIPE_SIZE);
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == -1)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0)
+  {
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    if (s->options.workdir && chdir(s->options.workdir) == -1)
+      _exit(127);
+    if (s->options.mem_limit)
+    {
+      struct rlimit limit = {s->options.mem_limit, s->options.mem_limit};
+      setrlimit(RLIMIT_AS, &limit);
+    }
+    ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+    raise(SIGSTOP);
+    execl(s->extractor, s->extractor, s->archive, (char *)NULL);
+    _exit(127);
+  }
+  close(fds[1]);
+  s->pid = pid;
+  s->output_fd = fds[0];
+  fcntl(s->output_fd, F_SETFL, O_NONBLOCK);
+  s->starts++;
+
+  double deadline = now_seconds() + (s->options.timeout > 0 ? s->options.timeout : SNAPSHOT_START_TIMEOUT);
+  int status;
+  if (wait_stop(s, &status, deadline) == -1 || !WIFSTOPPED(status) ||
+      ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL | PTRACE_O_TRACEEXEC) == -1)
+    return -1;
+
+  int sig = 0;
+  for (;;)
+  {
+    if (ptrace(PTRACE_SYSCALL, pid, NULL, sig) == -1)
+      return -1;
+    if (wait_stop(s, &status, deadline) == -1)
+    {
+      result->timed_out = now_seconds() >= deadline;
+      return -1;
+    }
+    sig = 0;
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      // The extractor ran to the end without opening the archive, the result is still a result
+      result->status = status;
+      s->pid = 0;
+      return -1;
+    }
+    if (WSTOPSIG(status) != SYSCALL_STOP)
+    {
+      if (status >> 16 == 0)
+        sig = WSTOPSIG(status);
+      continue;
+    }
+
+    long nr;
+    if (syscall_entry(pid, &nr) && (nr == SYS_openat || nr == SYS_open))
+    {
+      struct user_regs_struct regs;
+      ptrace(PTRACE_GETREGS, pid, NULL, &regs);
+      unsigned long long arg = nr == SYS_openat ? regs.rsi : regs.rdi;
+      if (arg)
+      {
+        char path[PATH_MAX];
+        struct iovec local = {path, sizeof(path) - 1}, remote = {(void *)arg, sizeof(path) - 1};
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n > 0)
+        {
+          path[n] = '\0';
+          if (strcmp(path, s->archive) == 0)
+            return take_snapshot(s);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Rewinds the extractor, stopped at the entry of a system call, to the snapshot: the descriptors
+ * opened since are closed, the heap and the mappings are put back, then the actions of the signals,
+ * the memory written since, the blocked signals and the registers. The extractor is left at the entry of the open of the archive.
+ *
+ * @return 0 on success, -1 if the extractor cannot be rewound
+**/
+static int restore(snapshot *s)
+{
+  // Descriptors opened since the snapshot
+  int fds[SNAPSHOT_MAX_FDS];
+  unsigned count = read_fds(s->pid, fds, SNAPSHOT_MAX_FDS);
+  for (unsigned i = 0; i < count; i++)
+  {
+    unsigned j = 0;
+    while (j < s->fds_count && s->fds[j] != fds[i])
+      j++;
+    if (j == s->fds_count && inject(s, SYS_close, fds[i], 0, 0, 0, 0, 0) == -1)
+      return -1;
+  }
+
+  if (inject(s, SYS_brk, s->brk, 0, 0, 0, 0, 0) == -1)
+    return -1;
+
+  // Mappings created or changed since the snapshot are removed, the missing ones are mapped again
+  snapshot_region *now;
+  int now_count = read_maps(s->pid, &now);
+  if (now_count == -1)
+    return -1;
+  int rv = 0;
+  for (int i = 0; i < now_count && rv == 0; i++)
+  {
+    // The stack grown since the snapshot is emptied, as in a new process
+    if (now[i].special && strstr(now[i].perms, "w"))
+    {
+      for (unsigned j = 0; j < s->regions_count; j++)
+      {
+        snapshot_region *r = &s->regions[j];
+        if (r->special && r->end == now[i].end && now[i].start < r->start &&
+            inject(s, SYS_madvise, now[i].start, r->start - now[i].start, MADV_DONTNEED, 0, 0, 0) != 0)
+          rv = -1;
+      }
+    }
+    if (now[i].special)
+      continue;
+    unsigned j = 0;
+    while (j < s->regions_count && (s->regions[j].start != now[i].start || s->regions[j].end != now[i].end ||
+                                    strcmp(s->regions[j].perms, now[i].perms) != 0))
+      j++;
+    if (j == s->regions_count && inject(s, SYS_munmap, now[i].start, now[i].end - now[i].start, 0, 0, 0, 0) != 0)
+      rv = -1;
+  }
+  for (unsigned j = 0; j < s->regions_count && rv == 0; j++)
+  {
+    snapshot_region *r = &s->regions[j];
+    if (r->special)
+      continue;
+    int i = 0;
+    while (i < now_count && (now[i].start != r->start || now[i].end != r->end || strcmp(now[i].perms, r->perms) != 0))
+      i++;
+    if (i < now_count)
+      continue;
+
+    // Only the mappings whose content was saved can be mapped again
+    if (r->data == NULL)
+      rv = -1;
+    else if (inject(s, SYS_mmap, r->start, r->end - r->start, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != (long)r->start)
+      rv = -1;
+    else
+    {
+      int prot = (r->perms[0] == 'r' ? PROT_READ : 0) | (r->perms[1] == 'w' ? PROT_WRITE : 0) | (r->perms[2] == 'x' ? PROT_EXEC : 0);
+      if (copy_memory(s->pid, r->start, r->data, r->end - r->start, 1) == -1 ||
+          inject(s, SYS_mprotect, r->start, r->end - r->start, prot, 0, 0, 0) != 0)
+        rv = -1;
+    }
+  }
+  free(now);
+  if (rv == -1 || restore_signals(s) == -1)
+    return -1;
+
+  // The memory written since the snapshot, all of it when the kernel does not track the written pages
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/pagemap", s->pid);
+  int pagemap = s->soft_dirty ? open(path, O_RDONLY) : -1;
+  for (unsigned j = 0; j < s->regions_count; j++)
+  {
+    snapshot_region *r = &s->regions[j];
+    if (r->data == NULL)
+      continue;
+    size_t pages = (r->end - r->start) / PAGE;
+    uint64_t entries[64];
+    for (size_t p = 0; p < pages;)
+    {
+      size_t run = pages - p < 64 ? pages - p : 64;
+      if (pagemap == -1 || pread(pagemap, entries, run * sizeof(uint64_t), (r->start / PAGE + p) * sizeof(uint64_t)) != (ssize_t)(run * sizeof(uint64_t)))
+      {
+        for (size_t k = 0; k < run; k++)
+          entries[k] = 1ULL << 55;
+      }
+      for (size_t k = 0; k < run;)
+      {
+        if (!(entries[k] >> 55 & 1))
+        {
+          k++;
+          continue;
+        }
+        size_t first = k;
+        while (k < run && (entries[k] >> 55 & 1))
+          k++;
+        size_t offset = (p + first) * PAGE, size = (k - first) * PAGE;
+        if (copy_memory(s->pid, r->start + offset, r->data + offset, size, 1) == -1)
+          rv = -1;
+        s->restored_bytes += size;
+      }
+      p += run;
+    }
+  }
+  if (pagemap != -1)
+    close(pagemap);
+  if (s->soft_dirty)
+    clear_refs(s->pid, "4");
+  clear_refs(s->pid, "5");
+
+  if (rv == -1 || ptrace(PTRACE_SETSIGMASK, s->pid, sizeof(s->sigmask), &s->sigmask) == -1 ||
+      ptrace(PTRACE_SETFPREGS, s->pid, NULL, &s->fpregs) == -1 || ptrace(PTRACE_SETREGS, s->pid, NULL, &s->regs) == -1)
+    return -1;
+  s->restores++;
+  return 0;
+}
+
+/**
+ * Kills the extractor, it is started again by the next run.
+**/
+static void kill_extractor(snapshot *s)
+{
+  if (s->pid == 0)
+    return;
+  kill(s->pid, SIGKILL);
+  int status;
+  while (waitpid(s->pid, &status, __WALL) == -1 && errno == EINTR)
+    ;
+  s->pid = 0;
+}
+
+/**
+ * Reads what the extractor wrote so far, keeping the beginning of the output.
+**/
+static void drain_output(int fd, exec_result *result)
+{
+  char drain[OUTPUT_LEN];
+  for (;;)
+  {
+    ssize_t n;
+    if (result->output_len < OUTPUT_LEN - 1)
+      n = read(fd, result->output + result->output_len, OUTPUT_LEN - 1 - result->output_len);
+    else
+      n = read(fd, drain, sizeof(drain));
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    if (result->output_len < OUTPUT_LEN - 1)
+      result->output_len += n;
+  }
+  result->output[result->output_len] = '\0';
+}
+
+/**
+ * Runs the extractor from the snapshot until it exits, then rewinds it for the next input.
+ *
+ * @return 0 on success, -1 if the extractor misbehaved and has to be run without snapshot
+**/
+static int run_from_snapshot(snapshot *s, exec_result *result)
+{
+  double deadline = s->options.timeout > 0 ? now_seconds() + s->options.timeout : 0;
+  int status, sig = 0;
+  for (;;)
+  {
+    if (ptrace(PTRACE_SYSCALL, s->pid, NULL, sig) == -1)
+      return -1;
+    sig = 0;
+    if (wait_stop(s, &status, deadline) == -1)
+    {
+      // Out of time, the extractor is started again for the next input
+      drain_output(s->output_fd, result);
+      kill_extractor(s);
+      result->timed_out = 1;
+      result->status = SIGKILL;
+      return 0;
+    }
+    drain_output(s->output_fd, result);
+
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+    {
+      // Killed by a signal, the snapshot is lost with the process
+      result->status = status;
+      s->pid = 0;
+      return 0;
+    }
+    if (WSTOPSIG(status) != SYSCALL_STOP)
+    {
+      if (status >> 16 == 0)
+        sig = WSTOPSIG(status);
+      continue;
+    }
+
+    long nr;
+    if (!syscall_entry(s->pid, &nr))
+      continue;
+    struct user_regs_struct regs;
+    switch (nr)
+    {
+    case SYS_exit_group:
+    case SYS_exit:
+      // The end of the run: the exit status is taken, and the extractor goes back to the snapshot instead
+      if (ptrace(PTRACE_GETREGS, s->pid, NULL, &regs) == -1)
+        return -1;
+      result->status = (regs.rdi & 0xff) << 8;
+      result->usage.ru_maxrss = peak_rss(s->pid);
+      drain_output(s->output_fd, result);
+      if (restore(s) == -1)
+        kill_extractor(s);
+      return 0;
+    case SYS_clone:
+    case SYS_fork:
+    case SYS_vfork:
+    case SYS_execve:
+#ifdef SYS_clone3
+    case SYS_clone3:
+#endif
+      // Other processes and threads cannot be rewound
+      return -1;
+    }
+  }
+}
+
+/**
+ * Prepares the ptrace executor: the extractor is started by the first run.
+ *
+ * @param[out] s the executor
+ * @param[in] extractor absolute path of the extractor
+ * @param[in] archive absolute path of the archive, the snapshot is taken when the extractor opens it
+ * @param[in] options the executor options (memory limit, working directory, timeout)
+ * @return 0 on success, -1 if the architecture is not supported
+**/
+int snapshot_open(snapshot *s, const char *extractor, const char *archive, const exec_options *options)
+{
+  memset(s, 0, sizeof(snapshot));
+  s->output_fd = -1;
+  snprintf(s->extractor, sizeof(s->extractor), "%s", extractor);
+  snprintf(s->archive, sizeof(s->archive), "%s", archive);
+  s->options = *options;
+  s->options.sandbox = NULL;
+  s->soft_dirty = soft_dirty_supported();
+  return 0;
+}
+
+/**
+ * Runs the extractor on the archive, from the snapshot when there is one. The first run, and the runs
+ * after a crash or a timeout, start the extractor and take the snapshot when it opens the archive.
+ * An extractor that starts other processes or threads is run with exec_target() from then on.
+ *
+ * @param[in] s the executor
+ * @param[out] result the status, the max RSS and the beginning of the output, the CPU time is not measured
+ * @return 0 on success, -1 if the extractor could not be run
+**/
+int snapshot_run(snapshot *s, exec_result *result)
+{
+  if (s->broken)
+    return exec_target(s->extractor, s->archive, &s->options, result);
+
+  result->status = 0;
+  result->output_len = 0;
+  result->output[0] = '\0';
+  result->timed_out = 0;
+  memset(&result->usage, 0, sizeof(result->usage));
+
+  // SIGCHLD is waited for with a timeout
+  uint64_t start = profile_start();
+  sigset_t set, old;
+  sigemptyset(&set);
+  sigaddset(&set, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &set, &old);
+
+  int rv = 0;
+  if (s->pid == 0)
+  {
+    if (s->output_fd != -1)
+      close(s->output_fd);
+    s->output_fd = -1;
+    if (start_extractor(s, result) == -1)
+    {
+      // The extractor never opened the archive, its output is the result of the run, as is running out of time
+      if (s->output_fd != -1)
+        drain_output(s->output_fd, result);
+      kill_extractor(s);
+      rv = s->starts > 1 || result->status || result->timed_out ? 0 : -1;
+      sigprocmask(SIG_SETMASK, &old, NULL);
+      if (rv == -1)
+      {
+        printf("The extractor never opened %s, running it without snapshot\n", s->archive);
+        s->broken = 1;
+        return exec_target(s->extractor, s->archive, &s->options, result);
+      }
+      profile_stop(PHASE_WAIT, start);
+      return 0;
+    }
+  }
+
+  if (run_from_snapshot(s, result) == -1)
+  {
+    kill_extractor(s);
+    printf("The extractor cannot be rewound, running it without snapshot\n");
+    s->broken = 1;
+    rv = exec_target(s->extractor, s->archive, &s->options, result);
+  }
+  sigprocmask(SIG_SETMASK, &old, NULL);
+  profile_stop(PHASE_WAIT, start);
+  return rv;
+}
+
+#else
+
+int snapshot_open(snapshot *s, const char *extractor, const char *archive, const exec_options *options)
+{
+  (void)extractor;
+  (void)archive;
+  (void)options;
+  memset(s, 0, sizeof(snapshot));
+  printf("The ptrace executor is only available on x86_64\n");
+  return -1;
+}
+
+int snapshot_run(snapshot *s, exec_result *result)
+{
+  return exec_target(s->extractor, s->archive, &s->options, result);
+}
+
+#endif
+
+/**
+ * Prints how the runs of the extractor were started.
+ *
+ * @param[in] s the executor
+**/
+void snapshot_report(const snapshot *s)
+{
+  printf("Snapshot executor: %lu runs from the snapshot, %lu from the start, %.1f KB restored per run (%s)%s\n",
+         s->restores, s->starts, s->restores ? s->restored_bytes / 1024.0 / s->restores : 0,
+         s->soft_dirty ? "written pages" : "all writable pages", s->broken ? ", gave up" : "");
+}
+
+/**
+ * Kills the extractor and frees the snapshot.
+ *
+ * @param[in] s the executor
+**/
+void snapshot_close(snapshot *s)
+{
+#if defined(__x86_64__)
+  kill_extractor(s);
+#endif
+  if (s->output_fd != -1)
+    close(s->output_fd);
+  for (unsigned i = 0; i < s->regions_count; i++)
+    free(s->regions[i].data);
+  free(s->regions);
+  memset(s, 0, sizeof(snapshot));
+  s->output_fd = -1;
+}
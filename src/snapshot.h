@@ -0,0 +1,66 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/user.h>
+
+#include "exec.h"
+
+#define SNAPSHOT_MAX_FDS 256     // descriptors of the extractor remembered at the snapshot
+#define SNAPSHOT_PIPE_SIZE (1024 * 1024) // size of the pipe of the output, the extractor must not block on it
+#define SNAPSHOT_SIGNALS 64
+#define SNAPSHOT_START_TIMEOUT 10 // seconds the extractor has to open the archive when the executor gives no timeout
+
+// The action of a signal as the rt_sigaction() system call sees it
+typedef struct
+{
+    uint64_t handler;
+    uint64_t flags;
+    uint64_t restorer;
+    uint64_t mask;
+} snapshot_action;
+
+// A mapping of the extractor at the snapshot
+typedef struct
+{
+    uintptr_t start, end;
+    char perms[5];      // as in /proc/<pid>/maps
+    char *data;         // content at the snapshot, NULL for the mappings that cannot be written
+    int special;        // [stack], [vdso], [vvar] or [vsyscall]: never unmapped nor remapped
+} snapshot_region;
+
+// Extractor started once under ptrace, stopped when it opens the archive and rewound there for each input
+typedef struct
+{
+    char extractor[PATH_MAX];
+    char archive[PATH_MAX];     // the archive opened by the extractor, rewritten before each run
+    exec_options options;
+    pid_t pid;                  // the extractor, 0 when it has to be started again
+    int output_fd;              // stdout and stderr of the extractor
+    struct user_regs_struct regs;       // registers at the entry of the open of the archive
+    struct user_fpregs_struct fpregs;
+    uint64_t sigmask;           // blocked signals, a handler leaving through exit() never unblocks its signal
+    uint64_t caught, ignored;   // signals with a handler and ignored signals, as in /proc/<pid>/status
+    snapshot_action actions[SNAPSHOT_SIGNALS]; // actions of these signals, a handler set with signal() is reset when called
+    uintptr_t scratch;          // writable memory of the extractor used to pass the actions, restored after
+    snapshot_region *regions;   // mappings at the snapshot
+    unsigned regions_count;
+    uintptr_t brk;              // end of the heap at the snapshot
+    int fds[SNAPSHOT_MAX_FDS];  // descriptors open at the snapshot
+    unsigned fds_count;
+    int soft_dirty;             // the kernel tracks the written pages, only them are restored
+    int broken;                 // the extractor cannot be rewound, it is run from the start instead
+    unsigned long restores;     // runs started from the snapshot
+    unsigned long starts;       // runs started from the beginning of the extractor
+    unsigned long long restored_bytes;
+} snapshot;
+
+int snapshot_open(snapshot *s, const char *extractor, const char *archive, const exec_options *options);
+int snapshot_run(snapshot *s, exec_result *result);
+void snapshot_report(const snapshot *s);
+void snapshot_close(snapshot *s);
+
+#endif
@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "store.h"
+#include "novelty.h"
+
+static const char *KIND_NAMES[STORE_KINDS] = {"success", "oom", "memhog", "diff"};
+
+/**
+ * Gives the name of a kind of input, used as prefix of the exported files.
+ *
+ * @param[in] kind the kind
+ * @return the name of the kind
+**/
+const char *store_kind_name(store_kind kind)
+{
+  return kind < STORE_KINDS ? KIND_NAMES[kind] : "unknown";
+}
+
+/**
+ * Key of an input in the deduplication table: the same input kept for two reasons is kept twice.
+**/
+static uint64_t store_key(uint64_t hash, uint32_t kind)
+{
+  uint64_t key = hash ^ (kind * 0x9e3779b97f4a7c15ULL);
+  return key ? key : 1;
+}
+
+/**
+ * Looks for a key in the deduplication table, adding it if it is not there and it is asked to.
+ * The table uses open addressing and is kept at most half full.
+ *
+ * @param[in] add the key is added when it is not there
+ * @return 1 if the key was already there, 0 otherwise
+**/
+static int store_seen(store *s, uint64_t key, int add)
+{
+  if (add && 2 * (s->keys_count + 1) > s->keys_cap)
+  {
+    size_t cap = s->keys_cap ? s->keys_cap * 2 : 1024;
+    uint64_t *keys = calloc(cap, sizeof(uint64_t));
+    if (keys == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+    for (size_t i = 0; i < s->keys_cap; i++)
+    {
+      if (s->keys[i] == 0)
+        continue;
+      size_t j = s->keys[i] & (cap - 1);
+      while (keys[j])
+        j = (j + 1) & (cap - 1);
+      keys[j] = s->keys[i];
+    }
+    free(s->keys);
+    s->keys = keys;
+    s->keys_cap = cap;
+  }
+
+  if (s->keys_cap == 0)
+    return 0;
+  size_t j = key & (s->keys_cap - 1);
+  while (s->keys[j])
+  {
+    if (s->keys[j] == key)
+      return 1;
+    j = (j + 1) & (s->keys_cap - 1);
+  }
+  if (add)
+  {
+    s->keys[j] = key;
+    s->keys_count++;
+  }
+  return 0;
+}
+
+/**
+ * Maps a whole file read-only.
+ *
+ * @return the mapping, NULL if the file is empty or cannot be mapped
+**/
+static const void *map_file(int fd, size_t *size)
+{
+  struct stat st;
+  *size = 0;
+  if (fstat(fd, &st) == -1 || st.st_size == 0)
+    return NULL;
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return NULL;
+  *size = st.st_size;
+  return data;
+}
+
+/**
+ * Tells whether the prefix in front of an input of the log is the one of its record.
+**/
+static int prefix_matches(const store_prefix *prefix, const store_record *record)
+{
+  return prefix->magic == STORE_MAGIC && prefix->kind == record->kind && prefix->size == record->size;
+}
+
+/**
+ * Cuts back the files of a store opened for appending to the last complete input. A store_add()
+ * interrupted in the middle leaves a partial record at the end of the index, or an input at the
+ * end of the log without its record, or a record whose input was not fully written: the records
+ * are checked from the last one against the prefix of their input, and what follows the last
+ * good one is cut from both files.
+ *
+ * @param[in,out] s the store, count being the number of complete records of the index
+ * @param[in] records the mapping of the index
+ * @param[in] log_fd the log
+ * @param[in] index_fd the index
+ * @return 1 if the files were cut, 0 if they were complete, -1 on error
+**/
+static int store_recover(store *s, const store_record *records, int log_fd, int index_fd)
+{
+  struct stat st;
+  if (fstat(log_fd, &st) == -1)
+    return -1;
+
+  uint64_t log_end = 0;
+  while (s->count > 0)
+  {
+    const store_record *last = &records[s->count - 1];
+    store_prefix prefix;
+    if (last->offset >= sizeof(prefix) && last->offset <= (uint64_t)st.st_size &&
+        last->size <= (uint64_t)st.st_size - last->offset &&
+        pread(log_fd, &prefix, sizeof(prefix), last->offset - sizeof(prefix)) == sizeof(prefix) &&
+        prefix_matches(&prefix, last))
+    {
+      log_end = last->offset + last->size;
+      break;
+    }
+    s->count--;
+  }
+
+  size_t index_end = s->count * sizeof(store_record);
+  if (index_end == s->index_size && log_end == (uint64_t)st.st_size)
+  {
+    s->log_size = st.st_size;
+    return 0;
+  }
+  if (ftruncate(index_fd, index_end) == -1 || ftruncate(log_fd, log_end) == -1)
+    return -1;
+  s->log_size = log_end;
+  return 1;
+}
+
+/**
+ * Syncs the directory holding a file, so that a rename of the file is on the disk.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int sync_dir(const char *path)
+{
+  char dir[PATH_MAX];
+  const char *slash = strrchr(path, '/');
+  if (slash == NULL)
+    snprintf(dir, sizeof(dir), ".");
+  else
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash == path ? 1 : slash - path), path);
+
+  int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  int rv = fsync(fd);
+  close(fd);
+  return rv;
+}
+
+/**
+ * Replaces a store by the one written and synced next to it, at path + STORE_NEW_EXT. The two files
+ * cannot be renamed at once, so the rename of the log is the point where the new store is committed:
+ * before it the old store is whole, after it the new index left next to the store is put in place,
+ * here or by the next store_open(), see finish_replace().
+ *
+ * @param[in] path the path of the log of the store replaced
+ * @return 0 on success, 1 if the new index is left for the next opening, -1 if the old store is untouched
+**/
+int store_replace(const char *path)
+{
+  char log[PATH_MAX], index[PATH_MAX], new_index[PATH_MAX];
+  if (snprintf(log, sizeof(log), "%s" STORE_NEW_EXT, path) >= (int)sizeof(log) ||
+      snprintf(index, sizeof(index), "%s" STORE_INDEX_EXT, path) >= (int)sizeof(index) ||
+      snprintf(new_index, sizeof(new_index), "%s" STORE_INDEX_EXT, log) >= (int)sizeof(new_index))
+    return -1;
+
+  // The new files must be in the directory before the commit
+  if (sync_dir(path) == -1 || rename(log, path) == -1)
+    return -1;
+  sync_dir(path);
+
+  // Someone opening the store in between may have put the index in place already
+  if (rename(new_index, index) == -1 && errno != ENOENT)
+    return 1;
+  sync_dir(path);
+  return 0;
+}
+
+/**
+ * Completes a store_replace() interrupted after its commit: the new log is in place and the new index
+ * is still next to it. When both new files are there the replacement was not committed, they are
+ * left to the process writing them.
+**/
+static void finish_replace(const char *path, const char *index)
+{
+  char log[PATH_MAX], new_index[PATH_MAX];
+  if (snprintf(log, sizeof(log), "%s" STORE_NEW_EXT, path) >= (int)sizeof(log) ||
+      snprintf(new_index, sizeof(new_index), "%s" STORE_INDEX_EXT, log) >= (int)sizeof(new_index))
+    return;
+  if (access(new_index, F_OK) == 0 && access(log, F_OK) == -1 && rename(new_index, index) == 0)
+    sync_dir(path);
+}
+
+/**
+ * Opens a store: the log of the inputs at path and its index at path + STORE_INDEX_EXT.
+ * For appending, the files are created if needed, cut back to their last complete input, see
+ * store_recover(), and the index is read once to know the inputs already kept. For reading, both files are mapped and the records are read in place.
+ *
+ * @param[out] s the store
+ * @param[in] path the path of the log
+ * @param[in] append 1 to add inputs, 0 to read them
+ * @return 0 on success, -1 otherwise
+**/
+int store_open(store *s, const char *path, int append)
+{
+  memset(s, 0, sizeof(store));
+  s->log_fd = s->index_fd = -1;
+
+  char index[PATH_MAX];
+  if (snprintf(index, sizeof(index), "%s" STORE_INDEX_EXT, path) >= (int)sizeof(index))
+    return -1;
+  finish_replace(path, index);
+
+  int flags = append ? O_RDWR | O_CREAT | O_APPEND : O_RDONLY;
+  int log_fd = open(path, flags, 0644);
+  int index_fd = open(index, flags, 0644);
+  if (log_fd == -1 || index_fd == -1)
+  {
+    if (log_fd != -1)
+      close(log_fd);
+    if (index_fd != -1)
+      close(index_fd);
+    return -1;
+  }
+
+  const store_record *records = map_file(index_fd, &s->index_size);
+  s->count = s->index_size / sizeof(store_record);
+
+  if (append)
+  {
+    int recovered = store_recover(s, records, log_fd, index_fd);
+    if (recovered == 1)
+      printf("The store \"%s\" was cut back to its last complete input\n", path);
+
+    // Only the keys are needed to add inputs
+    for (size_t i = 0; i < s->count; i++)
+      store_seen(s, store_key(records[i].hash, records[i].kind), 1);
+    if (records)
+      munmap((void *)records, s->index_size);
+    if (recovered == -1)
+    {
+      close(log_fd);
+      close(index_fd);
+      store_close(s);
+      return -1;
+    }
+
+    s->index_size = s->count * sizeof(store_record);
+    s->log_fd = log_fd;
+    s->index_fd = index_fd;
+    return 0;
+  }
+
+  s->records = records;
+  s->log = map_file(log_fd, &s->log_size);
+  close(log_fd);
+  close(index_fd);
+  return 0;
+}
+
+/**
+ * Cuts back the files of a store after a failed write to the inputs added before it.
+ * If they cannot be cut the store stops taking inputs, rather than adding them out of line.
+**/
+static void store_cut_back(store *s)
+{
+  if (ftruncate(s->index_fd, s->count * sizeof(store_record)) == 0 && ftruncate(s->log_fd, s->log_size) == 0)
+    return;
+  close(s->log_fd);
+  s->log_fd = -1;
+}
+
+/**
+ * Appends an input to the store, unless the same input was already kept for the same reason.
+ * The input goes to the log with its length in front, then its record goes to the index.
+ * A write that fails is cut back from the files, so the next inputs stay aligned.
+ *
+ * @param[in] s the store, opened for appending
+ * @param[in] data the input
+ * @param[in] size the size of the input
+ * @param[in] kind why the input is kept
+ * @param[in] bucket the hash of the response of the extractor
+ * @param[in] test the test that produced the input, cut to STORE_TEST_LEN - 1
+ * @return 1 if the input was added, 0 if it was already there, -1 on error
+**/
+int store_add(store *s, const char *data, size_t size, store_kind kind, uint64_t bucket, const char *test)
+{
+  if (s->log_fd == -1)
+    return -1;
+
+  // The key is only added once the input is in both files, a failed write leaves it out
+  uint64_t hash = hash_bytes(data, size);
+  if (store_seen(s, store_key(hash, kind), 0))
+    return 0;
+
+  store_prefix prefix = {STORE_MAGIC, kind, size};
+  struct iovec iov[2] = {{&prefix, sizeof(prefix)}, {(void *)data, size}};
+  if (writev(s->log_fd, iov, 2) != (ssize_t)(sizeof(prefix) + size))
+  {
+    printf("Could not write to the store\n");
+    store_cut_back(s);
+    return -1;
+  }
+
+  store_record record;
+  memset(&record, 0, sizeof(record));
+  record.hash = hash;
+  record.bucket = bucket;
+  record.offset = s->log_size + sizeof(prefix);
+  record.size = size;
+  record.timestamp = time(NULL);
+  record.kind = kind;
+  strncpy(record.test, test, STORE_TEST_LEN - 1);
+
+  if (write(s->index_fd, &record, sizeof(record)) != sizeof(record))
+  {
+    printf("Could not write to the store\n");
+    store_cut_back(s);
+    return -1;
+  }
+
+  store_seen(s, store_key(hash, kind), 1);
+  s->log_size += sizeof(prefix) + size;
+  s->count++;
+  return 1;
+}
+
+/**
+ * Gives an input of a store opened for reading, in the mapping of the log.
+ *
+ * @param[in] s the store
+ * @param[in] i the index of the input
+ * @return the input, NULL if its record points outside of the log or not after the prefix of its input
+**/
+const char *store_data(const store *s, size_t i)
+{
+  const store_record *record = &s->records[i];
+  store_prefix prefix;
+  if (record->offset < sizeof(prefix) || record->offset > s->log_size || record->size > s->log_size - record->offset)
+    return NULL;
+  memcpy(&prefix, s->log + record->offset - sizeof(prefix), sizeof(prefix));
+  if (!prefix_matches(&prefix, record))
+    return NULL;
+  return s->log + record->offset;
+}
+
+/**
+ * Writes an input of a store opened for reading to a file, straight from the mapping of the store.
+ * The input is copied as stored: it is not walked with the tar reader, most crashes are not
+ * valid archives and the replay must run exactly the bytes that crashed.
+ *
+ * @param[in] s the store
+ * @param[in] i the index of the input
+ * @param[in] filename the file to write
+ * @return 0 on success, -1 otherwise
+**/
+int store_export(const store *s, size_t i, const char *filename)
+{
+  const char *data = store_data(s, i);
+  if (data == NULL)
+    return -1;
+
+  FILE *f = fopen(filename, "wb");
+  if (!f)
+    return -1;
+  size_t size = s->records[i].size;
+  size_t written = size ? fwrite(data, size, 1, f) : 1;
+  fclose(f);
+  return written == 1 ? 0 : -1;
+}
+
+/**
+ * Closes a store.
+ *
+ * @param[in] s the store
+**/
+void store_close(store *s)
+{
+  if (s->log_fd != -1)
+    close(s->log_fd);
+  if (s->index_fd != -1)
+    close(s->index_fd);
+  if (s->records)
+    munmap((void *)s->records, s->index_size);
+  if (s->log)
+    munmap((void *)s->log, s->log_size);
+  free(s->keys);
+  memset(s, 0, sizeof(store));
+  s->log_fd = s->index_fd = -1;
+}
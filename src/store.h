@@ -0,0 +1,64 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORE_FILE "fuzzy.store"    // default store, the index is next to it with STORE_INDEX_EXT
+#define STORE_INDEX_EXT ".idx"
+#define STORE_NEW_EXT ".new"        // store written next to the one it replaces, see store_replace()
+#define STORE_MAGIC 0x5a5a5546      // first bytes of each record of the log
+#define STORE_TEST_LEN 48           // maximum length of the test id kept in the index, null included
+
+// Why an input was kept
+typedef enum
+{
+    STORE_CRASH,    // an oracle found a crash of the extractor
+    STORE_OOM,      // the extractor went over the memory limit
+    STORE_MEMHOG,   // the extractor reached a new max RSS
+    STORE_DIFF,     // the extractors did not behave the same
+    STORE_KINDS
+} store_kind;
+
+// Prefix of each record of the log
+typedef struct
+{
+    uint32_t magic;
+    uint32_t kind;
+    uint64_t size;      // number of bytes of the input following the prefix
+} store_prefix;
+
+// Entry of the index, the index is an array of them
+typedef struct
+{
+    uint64_t hash;      // hash of the input
+    uint64_t bucket;    // hash of the response of the extractor, see novelty_bucket()
+    uint64_t offset;    // offset of the input in the log, after its prefix
+    uint64_t size;      // size of the input
+    int64_t timestamp;  // when the input was kept
+    uint32_t kind;      // store_kind
+    char test[STORE_TEST_LEN]; // the test that produced the input
+} store_record;
+
+typedef struct
+{
+    int log_fd;                     // the log, opened for appending, -1 when read-only
+    int index_fd;
+    const store_record *records;    // mapping of the index, NULL when opened for appending
+    size_t count;                   // number of records
+    size_t index_size;              // size of the mapping of the index
+    const char *log;                // mapping of the log, NULL when opened for appending
+    size_t log_size;
+    uint64_t *keys;                 // hashes of the inputs already kept, for the deduplication
+    size_t keys_count, keys_cap;
+} store;
+
+int store_open(store *s, const char *path, int append);
+int store_add(store *s, const char *data, size_t size, store_kind kind, uint64_t bucket, const char *test);
+const char *store_data(const store *s, size_t i);
+int store_export(const store *s, size_t i, const char *filename);
+int store_replace(const char *path);
+const char *store_kind_name(store_kind kind);
+void store_close(store *s);
+
+#endif
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "structure.h"
+#include "reader.h"
+#include "numeric.h"
+
+/**
+ * Inserts a run of blocks among the spans of the list.
+ *
+ * @param[in] list the list
+ * @param[in] at the position of the new span, at most list->count
+ * @param[in] data the blocks
+ * @param[in] size the size of the blocks
+**/
+static void insert_span(entry_list *list, size_t at, const char *data, size_t size)
+{
+  if (list->count == list->cap)
+  {
+    list->cap = list->cap ? list->cap * 2 : 256;
+    list->spans = realloc(list->spans, list->cap * sizeof(tar_span));
+    if (list->spans == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+  memmove(&list->spans[at + 1], &list->spans[at], (list->count - at) * sizeof(tar_span));
+  list->spans[at].data = data;
+  list->spans[at].size = size;
+  list->count++;
+}
+
+/**
+ * Removes a span of the list.
+**/
+static void remove_span(entry_list *list, size_t at)
+{
+  memmove(&list->spans[at], &list->spans[at + 1], (list->count - at - 1) * sizeof(tar_span));
+  list->count--;
+}
+
+/**
+ * Appends the entries of an archive to the list, each one as its header and its padded content.
+ * The archive is walked in place, nothing is copied.
+ *
+ * @param[in] list the list
+ * @param[in] data the archive
+ * @param[in] size the size of the archive
+ * @param[out] tail the size of what follows the last entry (the end of the archive), NULL if not needed
+ * @return the number of entries appended
+**/
+static size_t index_entries(entry_list *list, const char *data, size_t size, size_t *tail)
+{
+  tar_reader reader;
+  tar_view view;
+  size_t count = 0;
+  tar_open_memory(&reader, data, size);
+  while (tar_next(&reader, &view))
+  {
+    insert_span(list, list->count, data + view.offset, reader.offset - view.offset);
+    count++;
+  }
+  if (tail)
+    *tail = size - reader.offset;
+  tar_close(&reader);
+  return count;
+}
+
+/**
+ * Writes a pax extended header in the blocks of the list, with a record meant for the entry
+ * it is put in front of: a long path or link path, a size that does not match, a length
+ * that does not match its record, or a time out of range.
+ *
+ * @param[in] list the list, whose extra blocks receive the header and its records
+ * @param[in] entry the header of the entry that follows
+ * @return the size of the header and its padded records
+**/
+static size_t write_extended(entry_list *list, const tar_t *entry)
+{
+  char value[2 * NAME_LEN + 155];
+  char *records = list->extra + sizeof(tar_t);
+  size_t capacity = sizeof(list->extra) - sizeof(tar_t), len = 0;
+
+  // A path longer than the name and prefix fields together, built from the name of the entry
+  size_t name_len = strnlen(entry->name, NAME_LEN), value_len = 0;
+  while (value_len + name_len + 1 < sizeof(value))
+  {
+    memcpy(value + value_len, name_len ? entry->name : "d", name_len ? name_len : 1);
+    value_len += name_len ? name_len : 1;
+    value[value_len++] = '/';
+  }
+  value[value_len - 1] = 'f';
+
+  switch (rand() % 5)
+  {
+  case 0:
+    len = pax_record(records, capacity, "path", value, value_len);
+    break;
+  case 1:
+    len = pax_record(records, capacity, "linkpath", value, value_len);
+    break;
+  case 2:
+  {
+    static const char *SIZES[] = {"0", "1", "99999999999999999999", "-1", "18446744073709551615", "512x"};
+    const char *size = SIZES[rand() % (sizeof(SIZES) / sizeof(SIZES[0]))];
+    len = pax_record(records, capacity, "size", size, strlen(size));
+    break;
+  }
+  case 3:
+    // The length of the record goes past the end of the records, or stops before its end
+    len = snprintf(records, capacity, "%d path=%.*s\n", rand() % 2 ? 999999 : 5, (int)name_len, entry->name);
+    break;
+  default:
+    len = pax_record(records, capacity, "mtime", "1e400", 5);
+    break;
+  }
+  if (len > capacity)
+    len = 0;
+
+  tar_t header;
+  set_header(&header);
+  snprintf(header.name, NAME_LEN, "PaxHeader/%.*s", NAME_LEN - 11, entry->name);
+  header.typeflag = XHDTYPE;
+  set_size_header(&header, len);
+  calculate_checksum(&header);
+  memcpy(list->extra, &header, sizeof(tar_t));
+
+  size_t padded = (len + sizeof(tar_t) - 1) / sizeof(tar_t) * sizeof(tar_t);
+  memset(records + len, 0, padded - len);
+  return sizeof(tar_t) + padded;
+}
+
+/**
+ * Rewrites the size field of an entry without touching its content, in the extra blocks of the list.
+ * The new size is close to the real one (off by one, one block more), far from it, or 0.
+ *
+ * @param[in] list the list
+ * @param[in] entry the header of the entry
+ * @return the rewritten header
+**/
+static const char *write_desync(entry_list *list, const tar_t *entry)
+{
+  tar_t header;
+  memcpy(&header, entry, sizeof(tar_t));
+
+  int64_t size = 0;
+  if (num_decode(header.size, SIZE_LEN, &size) == -1 || size < 0)
+    size = 0;
+  switch (rand() % 6)
+  {
+  case 0:
+    size = 0;
+    break;
+  case 1:
+    size += 1;
+    break;
+  case 2:
+    size = size ? size - 1 : 1;
+    break;
+  case 3:
+    size += sizeof(tar_t);
+    break;
+  case 4:
+    size = size * 2 + END_LEN;
+    break;
+  default:
+    size = 077777777777LL;
+    break;
+  }
+  set_size_header(&header, size);
+  calculate_checksum(&header);
+  memcpy(list->extra, &header, sizeof(tar_t));
+  return list->extra;
+}
+
+/**
+ * Applies a structural mutation to an archive: its entries are duplicated, swapped, deleted,
+ * taken from another input, preceded by a pax extended header or given a size that does not
+ * match their content, or the archive is cut at a block boundary.
+ * The archive is not rebuilt: its entries become runs of blocks pointing into the input,
+ * only the blocks written by the mutation are new, and the runs are copied to the output
+ * by tar_buffer_spans(), which copies the runs still in sequence at once.
+ *
+ * @param[in] list the list of the entries, reused from one mutation to the next
+ * @param[in] data the archive
+ * @param[in] size the size of the archive
+ * @param[in] other another input of the corpus, source of the spliced entries
+ * @param[in] other_size the size of the other input
+ * @param[in] op the mutation, one of the MUT_ENTRY_* mutations
+ * @param[out] out the buffer receiving the mutated archive, appended to
+**/
+void mutate_entries(entry_list *list, const char *data, size_t size, const char *other, size_t other_size,
+                    mutation_op op, tar_buffer *out)
+{
+  list->count = 0;
+  size_t tail = 0;
+  size_t entries = index_entries(list, data, size, &tail);
+  size_t start = out->size;
+
+  if (entries > 0)
+  {
+    size_t i = rand() % entries;
+    switch (op)
+    {
+    case MUT_ENTRY_DUPLICATE:
+      insert_span(list, rand() % (entries + 1), list->spans[i].data, list->spans[i].size);
+      break;
+    case MUT_ENTRY_SWAP:
+    {
+      size_t j = rand() % entries;
+      tar_span swap = list->spans[i];
+      list->spans[i] = list->spans[j];
+      list->spans[j] = swap;
+      break;
+    }
+    case MUT_ENTRY_DELETE:
+      remove_span(list, i);
+      break;
+    case MUT_ENTRY_SPLICE:
+    {
+      // A few consecutive entries of the other input, inserted at the same place
+      size_t donors = index_entries(list, other, other_size, NULL);
+      if (donors == 0)
+        break;
+      size_t first = rand() % donors;
+      size_t count = 1 + rand() % (donors - first < STRUCTURE_SPLICE ? donors - first : STRUCTURE_SPLICE);
+      tar_span run[STRUCTURE_SPLICE];
+      memcpy(run, &list->spans[entries + first], count * sizeof(tar_span));
+      list->count = entries;
+      size_t at = rand() % (entries + 1);
+      for (size_t k = 0; k < count; k++)
+        insert_span(list, at + k, run[k].data, run[k].size);
+      break;
+    }
+    case MUT_ENTRY_EXTENDED:
+      insert_span(list, i, list->extra, write_extended(list, (const tar_t *)list->spans[i].data));
+      break;
+    case MUT_ENTRY_DESYNC:
+    {
+      // The rewritten header, then the content still in the input
+      tar_span entry = list->spans[i];
+      list->spans[i].data = write_desync(list, (const tar_t *)entry.data);
+      list->spans[i].size = sizeof(tar_t);
+      if (entry.size > sizeof(tar_t))
+        insert_span(list, i + 1, entry.data + sizeof(tar_t), entry.size - sizeof(tar_t));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  // What followed the entries: the end of the archive, or garbage
+  if (tail)
+    insert_span(list, list->count, data + size - tail, tail);
+  tar_buffer_spans(out, list->spans, list->count);
+
+  // The archive is cut at a block boundary, inside an entry or between two
+  if (op == MUT_ENTRY_TRUNCATE)
+  {
+    size_t blocks = (out->size - start) / sizeof(tar_t);
+    out->size = start + (blocks ? rand() % blocks : 0) * sizeof(tar_t);
+  }
+}
+
+/**
+ * Releases the spans of a list.
+ *
+ * @param[in] list the list
+**/
+void entry_list_free(entry_list *list)
+{
+  free(list->spans);
+  memset(list, 0, sizeof(entry_list));
+}
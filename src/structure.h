@@ -0,0 +1,24 @@
+#ifndef STRUCTURE_H
+#define STRUCTURE_H
+
+#include <stddef.h>
+
+#include "tar.h"
+#include "mutate.h"
+
+#define STRUCTURE_SPLICE 8          // most entries taken from another input at once
+#define STRUCTURE_EXTRA_BLOCKS 4    // blocks written by a mutation: a rewritten header, or a pax header and its records
+
+// The entries of an archive being rearranged, as runs of blocks of the original archives
+typedef struct
+{
+    tar_span *spans;    // the entries, header and padded content, then what follows the last one
+    size_t count, cap;
+    char extra[STRUCTURE_EXTRA_BLOCKS * sizeof(tar_t)]; // blocks written by the mutation, some spans point into it
+} entry_list;
+
+void mutate_entries(entry_list *list, const char *data, size_t size, const char *other, size_t other_size,
+                    mutation_op op, tar_buffer *out);
+void entry_list_free(entry_list *list);
+
+#endif
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Byte that makes the stub crash when it appears in the first header of the archive
+#define CRASH_MARKER '\xff'
+
+/**
+ * Entry point of the stub built as a library, called in process by the harness of the fuzzer.
+ * It looks at the first header of the archive only.
+ *
+ * @param[in] data the archive
+ * @param[in] size the size of the archive
+ * @return 1 on a crash, 0 otherwise
+**/
+int extract(const uint8_t *data, size_t size)
+{
+  if (size > 512)
+    size = 512;
+  if (size > 0 && memchr(data, CRASH_MARKER, size))
+  {
+    printf("*** The program has crashed ***\n");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Trivial extractor used by the benchmarks to measure the overhead of the fuzzer itself.
+ * It reads the first header of the archive and exits at once, without output,
+ * unless the header contains CRASH_MARKER, in which case it behaves like a crashing extractor.
+ *
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv the path of the archive
+ * @param[out] 1 on a crash, 0 otherwise.
+**/
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+    return 0;
+
+  int fd = open(argv[1], O_RDONLY);
+  if (fd == -1)
+    return 0;
+
+  uint8_t header[512];
+  ssize_t n = read(fd, header, sizeof(header));
+  close(fd);
+
+  return extract(header, n > 0 ? n : 0);
+}
@@ -0,0 +1,674 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "sync.h"
+#include "exec.h"
+
+// An item kept by the coordinator
+typedef struct
+{
+    sync_item item;
+    char *data;         // NULL for the items without data
+    unsigned origin;    // the client that published it, never sent back to it
+} sync_entry;
+
+static volatile sig_atomic_t coordinator_stop;
+
+/**
+ * Gives the key of an item in the tables of seen items: the same hash can be a class and an input.
+**/
+static uint64_t sync_key(uint64_t hash, uint32_t kind)
+{
+  uint64_t key = hash ^ ((kind + 1) * 0x9e3779b97f4a7c15ULL);
+  return key ? key : 1;
+}
+
+/**
+ * Tells whether a key is in a table.
+**/
+static int keys_find(const sync_keys *t, uint64_t key)
+{
+  if (t->cap == 0)
+    return 0;
+  size_t j = key & (t->cap - 1);
+  while (t->keys[j])
+  {
+    if (t->keys[j] == key)
+      return 1;
+    j = (j + 1) & (t->cap - 1);
+  }
+  return 0;
+}
+
+/**
+ * Adds a key to a table, growing it to keep it at most half full.
+ *
+ * @return 1 if the key was already there, 0 if it was added
+**/
+static int keys_add(sync_keys *t, uint64_t key)
+{
+  if (keys_find(t, key))
+    return 1;
+  if (2 * (t->count + 1) > t->cap)
+  {
+    size_t cap = t->cap ? t->cap * 2 : 1024;
+    uint64_t *keys = calloc(cap, sizeof(uint64_t));
+    if (keys == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+    for (size_t i = 0; i < t->cap; i++)
+    {
+      if (t->keys[i] == 0)
+        continue;
+      size_t j = t->keys[i] & (cap - 1);
+      while (keys[j])
+        j = (j + 1) & (cap - 1);
+      keys[j] = t->keys[i];
+    }
+    free(t->keys);
+    t->keys = keys;
+    t->cap = cap;
+  }
+
+  size_t j = key & (t->cap - 1);
+  while (t->keys[j])
+    j = (j + 1) & (t->cap - 1);
+  t->keys[j] = key;
+  t->count++;
+  return 0;
+}
+
+/**
+ * Sends a whole buffer on the socket, without SIGPIPE if the other side left.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int send_all(int fd, const void *data, size_t size)
+{
+  const char *p = data;
+  while (size)
+  {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+/**
+ * Receives a whole buffer from the socket, within SYNC_IO_TIMEOUT_MS.
+ *
+ * @return 0 on success, -1 otherwise
+**/
+static int recv_all(int fd, void *data, size_t size)
+{
+  char *p = data;
+  while (size)
+  {
+    ssize_t n = recv(fd, p, size, 0);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    size -= n;
+  }
+  return 0;
+}
+
+/**
+ * Sends the prefix of a message.
+**/
+static int send_header(int fd, uint32_t type, uint64_t count, uint64_t cursor)
+{
+  sync_header header = {SYNC_MAGIC, type, count, cursor};
+  return send_all(fd, &header, sizeof(header));
+}
+
+/**
+ * Receives the prefix of a message, checking its magic and its number of items.
+**/
+static int recv_header(int fd, sync_header *header)
+{
+  if (recv_all(fd, header, sizeof(*header)) == -1 || header->magic != SYNC_MAGIC || header->count > SYNC_BATCH)
+    return -1;
+  return 0;
+}
+
+/**
+ * Sets the timeouts of the sends and the receives of a connection, so that a stuck peer is dropped.
+ * The coordinator serves one request at a time and the instances exchange between two executions,
+ * so a stuck peer holds the others for SYNC_IO_TIMEOUT_MS at most.
+**/
+static void set_timeouts(int fd)
+{
+  struct timeval tv = {SYNC_IO_TIMEOUT_MS / 1000, (SYNC_IO_TIMEOUT_MS % 1000) * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * Fills the address of a socket, checking the length of its path.
+ *
+ * @return 0 on success, -1 if the path is too long
+**/
+static int socket_address(const char *path, struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path))
+  {
+    printf("The path of the socket \"%s\" is too long\n", path);
+    return -1;
+  }
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/**
+ * Connects to the coordinator.
+ *
+ * @return the connection, -1 if the coordinator is not there
+**/
+static int connect_socket(const char *path)
+{
+  struct sockaddr_un addr;
+  if (socket_address(path, &addr) == -1)
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+  {
+    close(fd);
+    return -1;
+  }
+  set_timeouts(fd);
+  return fd;
+}
+
+/**
+ * Prepares the connection of an instance to the coordinator. The coordinator is reached at
+ * the first exchange, and again at the next ones if it is not there yet or went away.
+ *
+ * @param[out] c the connection
+ * @param[in] path path of the socket of the coordinator
+ * @return 0 on success, -1 if the path is too long
+**/
+int sync_connect(sync_client *c, const char *path)
+{
+  memset(c, 0, sizeof(sync_client));
+  c->fd = -1;
+  struct sockaddr_un addr;
+  if (socket_address(path, &addr) == -1)
+    return -1;
+  strcpy(c->path, path);
+  return 0;
+}
+
+/**
+ * Queues an item found by the instance, to be offered at the next exchange. Items already
+ * offered or received from the coordinator are not queued again.
+ *
+ * @param[in] c the connection
+ * @param[in] kind what the item is
+ * @param[in] hash hash of the input or of the class
+ * @param[in] bucket crash bucket of a crashing input
+ * @param[in] data the input, NULL for a class; inputs bigger than NOVELTY_MAX_INPUT are shared without it
+ * @param[in] size size of the input
+**/
+void sync_add(sync_client *c, sync_kind kind, uint64_t hash, uint64_t bucket, const char *data, size_t size)
+{
+  if (keys_add(&c->seen, sync_key(hash, kind)))
+    return;
+
+  if (c->pending_count == c->pending_cap)
+  {
+    c->pending_cap = c->pending_cap ? c->pending_cap * 2 : 64;
+    c->pending = realloc(c->pending, c->pending_cap * sizeof(sync_pending));
+    if (c->pending == NULL)
+    {
+      printf("Array not allocated \n");
+      exit(0);
+    }
+  }
+
+  sync_pending *p = &c->pending[c->pending_count++];
+  memset(p, 0, sizeof(*p));
+  p->item.hash = hash;
+  p->item.bucket = bucket;
+  p->item.kind = kind;
+  if (data && size && size <= NOVELTY_MAX_INPUT && (p->data = malloc(size)) != NULL)
+  {
+    memcpy(p->data, data, size);
+    p->item.size = size;
+  }
+}
+
+/**
+ * Tells whether a crash bucket was already found by another instance.
+ *
+ * @param[in] c the connection
+ * @param[in] bucket the crash bucket, see novelty_bucket()
+ * @return 1 if the bucket is known, 0 otherwise
+**/
+int sync_known_crash(const sync_client *c, uint64_t bucket)
+{
+  return keys_find(&c->buckets, sync_key(bucket, SYNC_CRASH));
+}
+
+/**
+ * Offers the queued items to the coordinator by batches: their hashes first, then the data
+ * of the ones it does not have. No batch is started after the deadline.
+ *
+ * @param[in] c the connection
+ * @param[in] deadline time after which the items left stay queued for the next exchange, 0 for none
+ * @return 0 on success, -1 if the connection failed, the items not offered stay queued
+**/
+static int sync_offer(sync_client *c, double deadline)
+{
+  size_t done = 0;
+  int rv = 0;
+  while (done < c->pending_count && (deadline == 0 || now_seconds() < deadline))
+  {
+    size_t n = c->pending_count - done < SYNC_BATCH ? c->pending_count - done : SYNC_BATCH;
+    sync_item items[SYNC_BATCH];
+    uint8_t wanted[SYNC_BATCH];
+    for (size_t i = 0; i < n; i++)
+      items[i] = c->pending[done + i].item;
+
+    sync_header header;
+    if (send_header(c->fd, SYNC_OFFER, n, 0) == -1 || send_all(c->fd, items, n * sizeof(sync_item)) == -1 ||
+        recv_header(c->fd, &header) == -1 || header.count != n || recv_all(c->fd, wanted, n) == -1)
+    {
+      rv = -1;
+      break;
+    }
+    for (size_t i = 0; i < n && rv == 0; i++)
+    {
+      if (wanted[i] && items[i].size && send_all(c->fd, c->pending[done + i].data, items[i].size) == -1)
+        rv = -1;
+      c->sent += wanted[i] && items[i].size;
+    }
+    if (rv == -1)
+      break;
+    for (size_t i = 0; i < n; i++)
+      free(c->pending[done + i].data);
+    done += n;
+  }
+
+  memmove(c->pending, c->pending + done, (c->pending_count - done) * sizeof(sync_pending));
+  c->pending_count -= done;
+  return rv;
+}
+
+/**
+ * Pulls the items found by the other instances since the last pull: their hashes first, then the
+ * data this instance does not have, only in novelty mode: the inputs join the corpus and the classes
+ * become known to the novelty state with their line. The crash buckets become known to
+ * sync_known_crash(). No batch is started after the deadline, the cursor keeps the place.
+ *
+ * @param[in] c the connection
+ * @param[in] novelty the novelty state, NULL outside of the novelty mode
+ * @param[in] deadline time after which the items left are pulled at the next exchange, 0 for none
+ * @return 0 on success, -1 if the connection failed
+**/
+static int sync_pull(sync_client *c, novelty_state *novelty, double deadline)
+{
+  while (deadline == 0 || now_seconds() < deadline)
+  {
+    sync_header header;
+    sync_item items[SYNC_BATCH];
+    uint8_t wanted[SYNC_BATCH];
+    if (send_header(c->fd, SYNC_PULL, 0, c->cursor) == -1 || recv_header(c->fd, &header) == -1 ||
+        recv_all(c->fd, items, header.count * sizeof(sync_item)) == -1)
+      return -1;
+
+    size_t n = header.count;
+    for (size_t i = 0; i < n; i++)
+    {
+      wanted[i] = novelty && items[i].size && items[i].size <= NOVELTY_MAX_INPUT &&
+                  !keys_find(&c->seen, sync_key(items[i].hash, items[i].kind));
+    }
+    if (send_header(c->fd, SYNC_PULL, n, c->cursor) == -1 || send_all(c->fd, wanted, n) == -1)
+      return -1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      int seen = keys_add(&c->seen, sync_key(items[i].hash, items[i].kind));
+      if (items[i].kind == SYNC_CRASH)
+        keys_add(&c->buckets, sync_key(items[i].bucket, SYNC_CRASH));
+      if (items[i].kind == SYNC_CLASS && novelty && !seen && !wanted[i])
+        novelty_learn_class(novelty, items[i].hash, "", 0);
+      if (!wanted[i])
+        continue;
+
+      char *data = malloc(items[i].size);
+      if (data == NULL)
+      {
+        printf("Array not allocated \n");
+        exit(0);
+      }
+      if (recv_all(c->fd, data, items[i].size) == -1)
+      {
+        free(data);
+        return -1;
+      }
+      if (items[i].kind == SYNC_CLASS)
+        novelty_learn_class(novelty, items[i].hash, data, items[i].size);
+      else
+      {
+        novelty_add_input(novelty, data, items[i].size, NOVELTY_SCORE_COMBO);
+        c->received++;
+      }
+      free(data);
+    }
+
+    c->cursor = header.cursor;
+    if (n < SYNC_BATCH)
+      return 0;
+  }
+  return 0;
+}
+
+/**
+ * Exchanges with the coordinator, at most every SYNC_INTERVAL: the new classes of the novelty state
+ * and the queued items are offered, then the items of the other instances are pulled. The exchange
+ * happens between two executions, so it stops starting batches after SYNC_EXCHANGE_TIME and goes
+ * on at the next one. A new connection pulls from the start: the coordinator may be a new one,
+ * whose items are not the ones the cursor counted, and the items already seen are not sent again.
+ *
+ * @param[in] c the connection
+ * @param[in] novelty the novelty state, NULL outside of the novelty mode
+ * @param[in] force 1 to exchange now, at the end of the run
+**/
+void sync_exchange(sync_client *c, novelty_state *novelty, int force)
+{
+  double now = now_seconds();
+  if (!force && now < c->next)
+    return;
+  c->next = now + SYNC_INTERVAL;
+
+  if (novelty)
+  {
+    for (size_t i = c->classes_published; i < novelty->classes_count; i++)
+      sync_add(c, SYNC_CLASS, novelty->classes[i].hash, 0, novelty->classes[i].text, strlen(novelty->classes[i].text));
+    c->classes_published = novelty->classes_count;
+  }
+
+  if (c->fd == -1)
+  {
+    if ((c->fd = connect_socket(c->path)) == -1)
+      return;
+    c->cursor = 0;
+  }
+  double deadline = force ? 0 : now + SYNC_EXCHANGE_TIME;
+  if (sync_offer(c, deadline) == -1 || sync_pull(c, novelty, deadline) == -1)
+  {
+    close(c->fd);
+    c->fd = -1;
+  }
+}
+
+/**
+ * Prints what the instance shared with the others.
+ *
+ * @param[in] c the connection
+**/
+void sync_report(const sync_client *c)
+{
+  printf("Sync with %s: %lu inputs sent, %lu received, %lu crashes already found elsewhere%s\n", c->path, c->sent,
+         c->received, c->known_crashes, c->fd == -1 ? " (not connected)" : "");
+}
+
+/**
+ * Closes the connection and frees the queued items.
+ *
+ * @param[in] c the connection
+**/
+void sync_close(sync_client *c)
+{
+  if (c->fd != -1)
+    close(c->fd);
+  for (size_t i = 0; i < c->pending_count; i++)
+    free(c->pending[i].data);
+  free(c->pending);
+  free(c->seen.keys);
+  free(c->buckets.keys);
+  memset(c, 0, sizeof(sync_client));
+  c->fd = -1;
+}
+
+static void coordinator_signal(int sig)
+{
+  (void)sig;
+  coordinator_stop = 1;
+}
+
+/**
+ * Serves an offer: the items the coordinator does not have are wanted, and kept with their data.
+ *
+ * @return 0 on success, -1 if the client has to be dropped
+**/
+static int serve_offer(int fd, const sync_header *header, unsigned origin, sync_entry **entries, size_t *count,
+                       size_t *cap, sync_keys *keys)
+{
+  size_t n = header->count;
+  sync_item items[SYNC_BATCH];
+  uint8_t wanted[SYNC_BATCH];
+  if (recv_all(fd, items, n * sizeof(sync_item)) == -1)
+    return -1;
+  for (size_t i = 0; i < n; i++)
+    wanted[i] = items[i].kind < SYNC_KINDS && items[i].size <= NOVELTY_MAX_INPUT && !keys_find(keys, sync_key(items[i].hash, items[i].kind));
+  if (send_header(fd, SYNC_OFFER, n, 0) == -1 || send_all(fd, wanted, n) == -1)
+    return -1;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!wanted[i])
+      continue;
+    char *data = NULL;
+    if (items[i].size)
+    {
+      data = malloc(items[i].size);
+      if (data == NULL)
+      {
+        printf("Array not allocated \n");
+        exit(0);
+      }
+      if (recv_all(fd, data, items[i].size) == -1)
+      {
+        free(data);
+        return -1;
+      }
+    }
+
+    // The same item offered twice in a batch is kept once
+    if (keys_add(keys, sync_key(items[i].hash, items[i].kind)))
+    {
+      free(data);
+      continue;
+    }
+    if (*count == *cap)
+    {
+      *cap = *cap ? *cap * 2 : 1024;
+      *entries = realloc(*entries, *cap * sizeof(sync_entry));
+      if (*entries == NULL)
+      {
+        printf("Array not allocated \n");
+        exit(0);
+      }
+    }
+    sync_entry *e = &(*entries)[(*count)++];
+    e->item = items[i];
+    e->data = data;
+    e->origin = origin;
+  }
+  return 0;
+}
+
+/**
+ * Serves a pull: the hashes of the next items published by the other clients, then the data
+ * of the ones the client wants. A cursor past the items comes from before a restart of the coordinator.
+ *
+ * @return 0 on success, -1 if the client has to be dropped
+**/
+static int serve_pull(int fd, const sync_header *header, unsigned origin, const sync_entry *entries, size_t count)
+{
+  size_t picked[SYNC_BATCH];
+  sync_item items[SYNC_BATCH];
+  size_t n = 0, i = header->cursor <= count ? header->cursor : 0;
+  for (; i < count && n < SYNC_BATCH; i++)
+  {
+    if (entries[i].origin == origin)
+      continue;
+    picked[n] = i;
+    items[n++] = entries[i].item;
+  }
+
+  sync_header answer;
+  uint8_t wanted[SYNC_BATCH];
+  if (send_header(fd, SYNC_PULL, n, i) == -1 || send_all(fd, items, n * sizeof(sync_item)) == -1 ||
+      recv_header(fd, &answer) == -1 || answer.count != n || recv_all(fd, wanted, n) == -1)
+    return -1;
+  for (size_t k = 0; k < n; k++)
+  {
+    const sync_entry *e = &entries[picked[k]];
+    if (wanted[k] && e->data && send_all(fd, e->data, e->item.size) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * Runs the coordinator of the instances fuzzing on the same host, until SIGINT or SIGTERM.
+ * It keeps every item published by an instance and hands it to the others when they pull.
+ *
+ * @param[in] path path of the socket, replaced if it is left by a coordinator that is gone
+ * @return 0 on success, -1 if the socket cannot be set up
+**/
+int sync_coordinator(const char *path)
+{
+  struct sockaddr_un addr;
+  if (socket_address(path, &addr) == -1)
+    return -1;
+
+  // A socket nobody listens on is a leftover
+  int other = connect_socket(path);
+  if (other != -1)
+  {
+    close(other);
+    printf("A coordinator is already listening on %s\n", path);
+    return -1;
+  }
+  struct stat st;
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener == -1 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(listener, SYNC_MAX_CLIENTS) == -1)
+  {
+    printf("The socket %s cannot be set up: %s\n", path, strerror(errno));
+    if (listener != -1)
+      close(listener);
+    return -1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = coordinator_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  printf("Coordinator listening on %s\n", path);
+  fflush(stdout);
+
+  sync_entry *entries = NULL;
+  size_t count = 0, cap = 0;
+  sync_keys keys = {NULL, 0, 0};
+  struct pollfd fds[SYNC_MAX_CLIENTS + 1];
+  unsigned origins[SYNC_MAX_CLIENTS + 1];
+  unsigned clients = 0, next_origin = 1;
+  unsigned long instances = 0;
+  fds[0].fd = listener;
+  fds[0].events = POLLIN;
+
+  while (!coordinator_stop)
+  {
+    if (poll(fds, clients + 1, -1) == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    // Each client is served one request at a time, its messages come whole
+    for (unsigned i = clients; i >= 1; i--)
+    {
+      if (fds[i].revents == 0)
+        continue;
+      sync_header header;
+      int rv = -1;
+      if (!(fds[i].revents & POLLIN) || recv_header(fds[i].fd, &header) == -1)
+        rv = -1;
+      else if (header.type == SYNC_OFFER)
+        rv = serve_offer(fds[i].fd, &header, origins[i], &entries, &count, &cap, &keys);
+      else if (header.type == SYNC_PULL)
+        rv = serve_pull(fds[i].fd, &header, origins[i], entries, count);
+      if (rv == -1)
+      {
+        close(fds[i].fd);
+        fds[i] = fds[clients];
+        origins[i] = origins[clients];
+        clients--;
+      }
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+      if (fd != -1 && clients == SYNC_MAX_CLIENTS)
+        close(fd);
+      else if (fd != -1)
+      {
+        set_timeouts(fd);
+        clients++;
+        fds[clients].fd = fd;
+        fds[clients].events = POLLIN;
+        fds[clients].revents = 0;
+        origins[clients] = next_origin++;
+        instances++;
+      }
+    }
+  }
+
+  unsigned long kinds[SYNC_KINDS] = {0};
+  for (size_t i = 0; i < count; i++)
+    kinds[entries[i].item.kind]++;
+  printf("Coordinator: %zu items from %lu connections (%lu classes, %lu inputs, %lu crashes)\n", count, instances,
+         kinds[SYNC_CLASS], kinds[SYNC_INPUT], kinds[SYNC_CRASH]);
+
+  for (unsigned i = 1; i <= clients; i++)
+    close(fds[i].fd);
+  close(listener);
+  unlink(path);
+  for (size_t i = 0; i < count; i++)
+    free(entries[i].data);
+  free(entries);
+  free(keys.keys);
+  return 0;
+}
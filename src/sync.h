@@ -0,0 +1,87 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "novelty.h"
+
+#define SYNC_MAGIC 0x434e5953       // first bytes of each message
+#define SYNC_INTERVAL 1.0           // seconds between two exchanges of an instance with the coordinator
+#define SYNC_BATCH 256              // items offered or pulled in one exchange
+#define SYNC_IO_TIMEOUT_MS 500      // milliseconds a peer can take to send the rest of a message
+#define SYNC_EXCHANGE_TIME 0.05     // seconds an instance goes on exchanging batches before going back to its executions
+#define SYNC_MAX_CLIENTS 64
+
+// What an instance shares
+typedef enum
+{
+    SYNC_CLASS,     // a behaviour class of the novelty mode, with its normalized line as data
+    SYNC_INPUT,     // an input of the novelty corpus
+    SYNC_CRASH,     // a crashing input, with its crash bucket
+    SYNC_KINDS
+} sync_kind;
+
+typedef enum
+{
+    SYNC_OFFER,     // client: items it found, the coordinator answers with the ones it wants
+    SYNC_PULL,      // client: the items found by the others since its cursor
+} sync_request;
+
+// Prefix of each message
+typedef struct
+{
+    uint32_t magic;
+    uint32_t type;      // sync_request for the requests of the clients
+    uint64_t count;     // number of items, or of wanted flags, following the prefix
+    uint64_t cursor;    // position in the items of the coordinator, for the pulls
+} sync_header;
+
+// An item as it is offered: its data, if it has some, is only sent when the other side wants it
+typedef struct
+{
+    uint64_t hash;      // hash of the input or of the class
+    uint64_t bucket;    // crash bucket of a crashing input, see novelty_bucket()
+    uint32_t kind;      // sync_kind
+    uint32_t unused;
+    uint64_t size;      // size of the data
+} sync_item;
+
+// Hashes already seen, open addressing kept at most half full
+typedef struct
+{
+    uint64_t *keys;
+    size_t count, cap;
+} sync_keys;
+
+// An item waiting to be offered by an instance
+typedef struct
+{
+    sync_item item;
+    char *data;
+} sync_pending;
+
+// The connection of an instance to the coordinator
+typedef struct
+{
+    char path[108];             // path of the socket of the coordinator
+    int fd;                     // -1 when not connected
+    double next;                // time of the next exchange
+    uint64_t cursor;            // items of the coordinator already pulled
+    sync_keys seen;             // items published or pulled, never offered again
+    sync_keys buckets;          // crash buckets found by the other instances
+    sync_pending *pending;      // items found since the last exchange
+    size_t pending_count, pending_cap;
+    size_t classes_published;   // classes of the novelty state already offered
+    unsigned long sent, received, known_crashes;
+} sync_client;
+
+int sync_connect(sync_client *c, const char *path);
+void sync_add(sync_client *c, sync_kind kind, uint64_t hash, uint64_t bucket, const char *data, size_t size);
+int sync_known_crash(const sync_client *c, uint64_t bucket);
+void sync_exchange(sync_client *c, novelty_state *novelty, int force);
+void sync_report(const sync_client *c);
+void sync_close(sync_client *c);
+int sync_coordinator(const char *path);
+
+#endif
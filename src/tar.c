@@ -1,251 +1,660 @@
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-
-#include "fuzzer.h"
-#include "tar.h"
-
-/**
- * Computes the checksum for a tar header and encode it on the header
- * @param entry: The tar header
- * @return the value of the checksum
- */
-unsigned int calculate_checksum(tar_t* entry){
-    // use spaces for the checksum bytes while calculating the checksum
-    memset(entry->chksum, ' ', 8);
-
-    // sum of entire metadata
-    unsigned int check = 0;
-    unsigned char* raw = (unsigned char*) entry;
-    for(int i = 0; i < 512; i++){
-        check += raw[i];
-    }
-
-    snprintf(entry->chksum, sizeof(entry->chksum), "%06o0", check);
-
-    entry->chksum[6] = '\0';
-    entry->chksum[7] = ' ';
-    return check;
-}
-
-/**
- * Sets the size field in the tar header to the given size 
- * @param[in] header A pointer to the tar header structure.
- * @param[in] size size of the header we want
- **/
-void set_size_header(tar_t *header, size_t size)
-{
-  /* 
-    The size field in the tar header is a null-padded octal string representation
-    of the file size, stored in 11 bytes with the last byte being a null byte. 
-    Here we use sprintf to convert the given size to a null-padded octal string 
-    with the appropriate number of digits (SIZE_LEN - 1) and store it in the 
-    header's size field. 
-  */
-  sprintf(header->size, "%0*lo", SIZE_LEN - 1, size);
-}
-
-/**
- * Function to set the tar header with some arbitrary values on the required fields.
- * @param[in] header A pointer to the tar header structure.
-**/
-void set_header(tar_t *header)
-{
-  // Set all the fields of the header to zero.
-  memset(header, 0, sizeof(tar_t));
-
-  // Set the name field to a randomly generated string with the EXT extension.
-  sprintf(header->name, "name_%06u" EXT, rand() % 1000000);
-
-  // Set the file mode to 777 permision:(owner:rwx; group:rwx; others:rwx).
-  sprintf(header->mode, "0000777");
-
-  // Set the user ID and group ID to 1000.
-  // The owner and group of the file contained in the archive are both daemon.
-  sprintf(header->uid, "0001000");
-  sprintf(header->gid, "0001000");
-
-  // Set the size field to 0.
-  set_size_header(header, 0);
-
-  // Set the modification time to 0.
-  sprintf(header->mtime, "0");
-
-  // Set the checksum field to DO_CHKSUM to signal that the write functions below will compute the checksum.
-  sprintf(header->chksum, DO_CHKSUM);
-
-  // Set the type flag to REGTYPE for a regular file.
-  header->typeflag = REGTYPE;
-
-  // Set the magic field to TMAGIC. 
-  // Specifies the format of the tar archive.
-  sprintf(header->magic, TMAGIC);
-
-  // Set the version field to TVERSION.
-  memcpy(header->version, TVERSION, VERSION_LEN);
-
-  // Set the user and group name to "user".
-  sprintf(header->uname, "user");
-  sprintf(header->gname, "user");
-
-  // Set the device major and minor numbers to 0.
-  // Convention to indicate that the file is not associated with any particular device.
-  sprintf(header->devmajor, "0000000");
-  sprintf(header->devminor, "0000000");
-}
-
-/**
- * Writes a tar header without content to a tar archive.
- *
- * @param[in] filename The filename of the tar archive.
- * @param[in] header   The tar header to write to the archive.
- * 
- * @see write_tar
-**/
-void write_empty_tar(const char *filename, tar_t *header)
-{
-  // Call write_tar() with an empty content and a size of 0.
-  write_tar(filename, header, "", 0);
-}
-
-/**
- *  Writes a tar_t and the content of a file in a tar archive.
- * 
- *  @param[in] filename: path of the tar archive
- *  @param[in] header: tar_t structure representing the file to be added to the archive
- *  @param[in] buffer: content of the file to be added to the archive
- *  @param[in] size: size of the file to be added to the archive
- * 
- *  The function first initializes an array of END_LEN bytes called end_bytes with zeros.
- *  It then calls the write_tar_fields function to write the file header, content, and end bytes
- *  to the tar archive. The end_bytes array is used to ensure that the archive has a size that
- *  is a multiple of the tar block size.
- *  @see write_tar_fields
-**/
-void write_tar(const char *filename, tar_t *header, const char *buffer, size_t size) {
-  char end_bytes[END_LEN];
-  memset(end_bytes, 0, END_LEN);
-
-  write_tar_fields(filename, header, buffer, size, end_bytes, END_LEN);
-}
-
-/**
- * Writes a tar header to a file, computing the checksum if it is set to DO_CHKSUM
- *
- * @param f: the file to write the header to
- * @param header: the header to write
- */
-void write_tar_header(FILE *file, tar_t *header)
-{
-  // If the checksum is set to DO_CHKSUM, calculate it before writing the header to the file
-  if (strncmp(DO_CHKSUM, header->chksum, CHKSUM_LEN) == 0)
-  {
-    // Save the old checksum so it can be restored after computing the new checksum
-    char old_checksum[CHKSUM_LEN];
-    strncpy(old_checksum, header->chksum, CHKSUM_LEN);
-
-    // Compute the new checksum
-    calculate_checksum(header);
-
-    // Write the header with the new checksum to the file
-    fwrite(header, sizeof(tar_t), 1, file);
-
-    // Restore the old checksum value in the header 
-    // to maintain the consistency of the header's data
-    strncpy(header->chksum, old_checksum, CHKSUM_LEN);
-    return;
-  }
-
-  // If the checksum is not set to DO_CHKSUM, write the header to the file without computing the checksum
-  fwrite(header, sizeof(tar_t), 1, file);
-}
-
-/**
-  * Writes the tar_t header of a file followed by the file content and end bytes to an archive file.
-  * 
-  * @param[in] filename: path of the archive file to write to.
-  * @param[in] header: pointer to the tar_t struct representing the file header.
-  * @param[in] buffer: pointer to the buffer holding the file content.
-  * @param[in] size: size of the file content in bytes.
-  * @param[in] end_bytes: pointer to the buffer holding the end bytes to be added after the file content.
-  * @param[in] end_size: size of the end bytes buffer in bytes.
-  * 
-  * @see write_tar_header
-**/
-void write_tar_fields(const char *filename, tar_t *header, const char *buffer, size_t size, const char *end_bytes, size_t end_size)
-{
-  // open the archive file in binary write mode
-  FILE *file = fopen(filename, "wb");
-  if (!file)
-  {
-    printf("Could not write to file");
-    return;
-  }
-
-  // write the file header to the archive file
-  write_tar_header(file, header);
-
-  // write the file content to the archive file
-  fwrite(buffer, size, 1, file);
-
-  // write the end bytes to the archive file
-  fwrite(end_bytes, end_size, 1, file);
-
-  // close the archive file
-  fclose(file);
-}
-
-/**
- * Write a number of tar entries defined by the variable count in a file. 
- * It uses the field size in entries to set the field size in the header
- * Also adds the appropriate number of null bytes at the end.
- * This function frees the pointer of each entries[].content
- *
- * @param[in] filename: path of the tar archive to write to
- * @param[in] entries: array of tar_entry structs representing the entries to write
- * @param[in] count: number of entries in the entries array
- */
-void write_tar_entries(const char *filename, tar_entry entries[], size_t count)
-{
-  // Open the file for writing in binary mode
-  FILE *f = fopen(filename, "wb");
-  if (!f)
-  {
-    printf("Could not write to file");
-    return;
-  }
-
-  // Loop through each entry in the array and write its header and content
-  for (size_t i = 0; i < count; i++)
-  {
-    tar_entry *e = &entries[i];
-    // Set the size field in the header to the size of the content
-    set_size_header(&e->header, e->size);
-    // Write the header to the file, computing the checksum if necessary
-    write_tar_header(f, &e->header);
-
-    // Write the content of the entry to the file
-    fwrite(e->content, e->size, 1, f);
-    // Free the content pointer, since we no longer need it
-    if (e->content)
-    {
-      free(e->content);
-    }
-
-    // Compute the number of null bytes needed to pad the content to a multiple of 512 bytes
-    unsigned size_padding = 512 - (e->size % 512);
-    char padding[size_padding];
-
-    memset(padding, 0, size_padding);
-    // Write the null bytes to the file as padding
-    fwrite(padding, size_padding, 1, f);
-  }
-
-  // Write the end-of-archive null bytes to the file
-  char end_bytes[END_LEN];
-  memset(end_bytes, 0, END_LEN);
-  fwrite(end_bytes, END_LEN, 1, f);
-
-  // Close the file
-  fclose(f);
-}
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fuzzer.h"
+#include "tar.h"
+#include "checksum.h"
+#include "numeric.h"
+#include "uring.h"
+
+
+const tar_field TAR_FIELDS[TAR_FIELDS_COUNT] = {
+    {"name", offsetof(tar_t, name), NAME_LEN, 0},
+    {"mode", offsetof(tar_t, mode), MODE_LEN, 1},
+    {"uid", offsetof(tar_t, uid), UID_LEN, 1},
+    {"gid", offsetof(tar_t, gid), GID_LEN, 1},
+    {"size", offsetof(tar_t, size), SIZE_LEN, 1},
+    {"mtime", offsetof(tar_t, mtime), MTIME_LEN, 1},
+    {"chksum", offsetof(tar_t, chksum), CHKSUM_LEN, 1},
+    {"typeflag", offsetof(tar_t, typeflag), 1, 0},
+    {"linkname", offsetof(tar_t, linkname), LINKNAME_LEN, 0},
+    {"magic", offsetof(tar_t, magic), MAGIC_LEN, 0},
+    {"version", offsetof(tar_t, version), VERSION_LEN, 0},
+    {"uname", offsetof(tar_t, uname), UNAME_LEN, 0},
+    {"gname", offsetof(tar_t, gname), GNAME_LEN, 0},
+    {"devmajor", offsetof(tar_t, devmajor), 8, 1},
+    {"devminor", offsetof(tar_t, devminor), 8, 1},
+    {"prefix", offsetof(tar_t, prefix), 155, 0},
+};
+
+/**
+ * Computes the checksum for a tar header and encode it on the header
+ * @param entry: The tar header
+ * @return the value of the checksum
+ * @see checksum_header
+ */
+unsigned int calculate_checksum(tar_t* entry){
+    // the chksum field is counted as spaces by the sum
+    unsigned int check = checksum_header(entry);
+
+    // six octal digits, a null and a space
+    checksum_encode(entry->chksum, check);
+    return check;
+}
+
+/**
+ * Sets the size field in the tar header to the given size 
+ * @param[in] header A pointer to the tar header structure.
+ * @param[in] size size of the header we want
+ **/
+void set_size_header(tar_t *header, size_t size)
+{
+  /* 
+    The size field in the tar header is a null-padded octal string representation
+    of the file size, stored in 11 bytes with the last byte being a null byte. 
+    A size that needs more digits is written in base-256, as GNU tar does.
+  */
+  if (num_encode(header->size, SIZE_LEN, size, NUM_OCTAL_NUL) == -1)
+    num_encode(header->size, SIZE_LEN, size, NUM_BASE256);
+}
+
+/**
+ * Writes a path in a header, in the name field if it fits, otherwise split at a '/' between
+ * the prefix and the name fields as ustar does. The name stays null terminated.
+ *
+ * @param[out] header the header
+ * @param[in] path the path, at most 255 characters
+ * @param[in] len the length of the path
+**/
+void set_path_header(tar_t *header, const char *path, size_t len)
+{
+  memset(header->name, 0, NAME_LEN);
+  memset(header->prefix, 0, sizeof(header->prefix));
+  if (len < NAME_LEN)
+  {
+    memcpy(header->name, path, len);
+    return;
+  }
+
+  // The first '/' leaving less than NAME_LEN characters after it
+  size_t split = len - NAME_LEN;
+  while (split < len && path[split] != '/')
+    split++;
+  if (split > sizeof(header->prefix))
+    split = sizeof(header->prefix);
+  memcpy(header->prefix, path, split);
+  size_t rest = len - split - (path[split] == '/');
+  memcpy(header->name, path + len - rest, rest < NAME_LEN ? rest : NAME_LEN - 1);
+}
+
+/**
+ * Function to set the tar header with some arbitrary values on the required fields.
+ * @param[in] header A pointer to the tar header structure.
+**/
+void set_header(tar_t *header)
+{
+  // Set all the fields of the header to zero.
+  memset(header, 0, sizeof(tar_t));
+
+  // Set the name field to a randomly generated string with the EXT extension.
+  sprintf(header->name, "name_%06u" EXT, rand() % 1000000);
+
+  // Set the file mode to 777 permision:(owner:rwx; group:rwx; others:rwx).
+  num_encode(header->mode, MODE_LEN, 0777, NUM_OCTAL_NUL);
+
+  // Set the user ID and group ID to 1000.
+  // The owner and group of the file contained in the archive are both daemon.
+  num_encode(header->uid, UID_LEN, 01000, NUM_OCTAL_NUL);
+  num_encode(header->gid, GID_LEN, 01000, NUM_OCTAL_NUL);
+
+  // Set the size field to 0.
+  set_size_header(header, 0);
+
+  // Set the modification time to 0.
+  num_encode(header->mtime, MTIME_LEN, 0, NUM_OCTAL_NUL);
+
+  // Set the checksum field to DO_CHKSUM to signal that the write functions below will compute the checksum.
+  memcpy(header->chksum, DO_CHKSUM, sizeof(DO_CHKSUM));
+
+  // Set the type flag to REGTYPE for a regular file.
+  header->typeflag = REGTYPE;
+
+  // Set the magic field to TMAGIC. 
+  // Specifies the format of the tar archive.
+  memcpy(header->magic, TMAGIC, sizeof(TMAGIC));
+
+  // Set the version field to TVERSION.
+  memcpy(header->version, TVERSION, VERSION_LEN);
+
+  // Set the user and group name to "user".
+  memcpy(header->uname, "user", sizeof("user"));
+  memcpy(header->gname, "user", sizeof("user"));
+
+  // Set the device major and minor numbers to 0.
+  // Convention to indicate that the file is not associated with any particular device.
+  num_encode(header->devmajor, sizeof(header->devmajor), 0, NUM_OCTAL_NUL);
+  num_encode(header->devminor, sizeof(header->devminor), 0, NUM_OCTAL_NUL);
+}
+
+/**
+ * Writes a tar header without content to a tar archive.
+ *
+ * @param[in] archive  The buffer the archive is built in.
+ * @param[in] filename The filename of the tar archive.
+ * @param[in] header   The tar header to write to the archive.
+ * 
+ * @see write_tar
+**/
+void write_empty_tar(tar_buffer *archive, const char *filename, tar_t *header)
+{
+  // Call write_tar() with an empty content and a size of 0.
+  write_tar(archive, filename, header, "", 0);
+}
+
+/**
+ *  Writes a tar_t and the content of a file in a tar archive.
+ * 
+ *  @param[in] archive: buffer the archive is built in
+ *  @param[in] filename: path of the tar archive
+ *  @param[in] header: tar_t structure representing the file to be added to the archive
+ *  @param[in] buffer: content of the file to be added to the archive
+ *  @param[in] size: size of the file to be added to the archive
+ * 
+ *  The function first initializes an array of END_LEN bytes called end_bytes with zeros.
+ *  It then calls the write_tar_fields function to write the file header, content, and end bytes
+ *  to the tar archive. The end_bytes array is used to ensure that the archive has a size that
+ *  is a multiple of the tar block size.
+ *  @see write_tar_fields
+**/
+void write_tar(tar_buffer *archive, const char *filename, tar_t *header, const char *buffer, size_t size) {
+  char end_bytes[END_LEN];
+  memset(end_bytes, 0, END_LEN);
+
+  write_tar_fields(archive, filename, header, buffer, size, end_bytes, END_LEN);
+}
+
+/**
+ * Makes room in the archive buffer, growing it geometrically.
+ *
+ * @param[in] buffer: the archive buffer
+ * @param[in] size: number of bytes that will be appended
+ * @return 0 on success, -1 if the memory cannot be allocated
+ */
+static int tar_buffer_reserve(tar_buffer *buffer, size_t size)
+{
+  if (buffer->size + size <= buffer->capacity)
+    return 0;
+
+  size_t capacity = buffer->capacity ? buffer->capacity : 4 * sizeof(tar_t);
+  while (capacity < buffer->size + size)
+    capacity *= 2;
+
+  char *data = realloc(buffer->data, capacity);
+  if (data == NULL)
+  {
+    printf("Array not allocated \n");
+    return -1;
+  }
+  buffer->data = data;
+  buffer->capacity = capacity;
+  return 0;
+}
+
+/**
+ * Appends bytes at the end of the archive buffer.
+ *
+ * @param[in] buffer: the archive buffer
+ * @param[in] data: the bytes to append
+ * @param[in] size: number of bytes
+ */
+void tar_buffer_append(tar_buffer *buffer, const void *data, size_t size)
+{
+  if (size == 0 || tar_buffer_reserve(buffer, size) == -1)
+    return;
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+}
+
+/**
+ * Appends null bytes at the end of the archive buffer (padding and end of archive).
+ *
+ * @param[in] buffer: the archive buffer
+ * @param[in] size: number of null bytes
+ */
+void tar_buffer_zeros(tar_buffer *buffer, size_t size)
+{
+  if (size == 0 || tar_buffer_reserve(buffer, size) == -1)
+    return;
+  memset(buffer->data + buffer->size, 0, size);
+  buffer->size += size;
+}
+
+/**
+ * Writes the archive buffer to a file at once, through the ring when uring_init() set it up.
+ *
+ * @param[in] buffer: the archive buffer
+ * @param[in] filename: path of the tar archive to write to
+ * @return 0 on success, -1 otherwise
+ */
+int tar_buffer_flush(const tar_buffer *buffer, const char *filename)
+{
+  uint64_t start = profile_start();
+  if (uring.enabled)
+  {
+    int rv = uring_write_file(filename, buffer->data, buffer->size, buffer->capacity);
+    profile_stop(PHASE_WRITE, start);
+    return rv;
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (!f)
+  {
+    printf("Could not write to file");
+    return -1;
+  }
+
+  size_t written = buffer->size ? fwrite(buffer->data, buffer->size, 1, f) : 1;
+  fclose(f);
+  profile_stop(PHASE_WRITE, start);
+  return written == 1 ? 0 : -1;
+}
+
+/**
+ * Writes the archive built by the write functions. The buffer is kept for the next archive,
+ * unless a big archive made it grow past TAR_BUFFER_KEEP: it is then released, so the memory
+ * of a single big archive is not held for the rest of the campaign.
+ *
+ * @param[in] archive: the buffer the archive was built in
+ * @param[in] filename: path of the tar archive to write to
+ */
+static void flush_archive(tar_buffer *archive, const char *filename)
+{
+  tar_buffer_flush(archive, filename);
+  if (archive->capacity > TAR_BUFFER_KEEP)
+    tar_buffer_free(archive);
+}
+
+/**
+ * Releases the memory of an archive buffer, which can be used again afterwards.
+ *
+ * @param[in] buffer: the archive buffer
+ */
+void tar_buffer_free(tar_buffer *buffer)
+{
+  uring_forget(buffer->data);
+  free(buffer->data);
+  memset(buffer, 0, sizeof(tar_buffer));
+}
+
+/**
+ * Appends a tar header to an archive buffer, computing the checksum if it is set to DO_CHKSUM
+ *
+ * @param buffer: the archive buffer to write the header to
+ * @param header: the header to write
+ */
+void write_tar_header(tar_buffer *buffer, tar_t *header)
+{
+  // If the checksum is set to DO_CHKSUM, calculate it before writing the header to the file
+  if (strncmp(DO_CHKSUM, header->chksum, CHKSUM_LEN) == 0)
+  {
+    // Save the old checksum so it can be restored after computing the new checksum
+    char old_checksum[CHKSUM_LEN];
+    strncpy(old_checksum, header->chksum, CHKSUM_LEN);
+
+    // Compute the new checksum
+    calculate_checksum(header);
+
+    // Write the header with the new checksum to the archive
+    tar_buffer_append(buffer, header, sizeof(tar_t));
+
+    // Restore the old checksum value in the header 
+    // to maintain the consistency of the header's data
+    strncpy(header->chksum, old_checksum, CHKSUM_LEN);
+    return;
+  }
+
+  // If the checksum is not set to DO_CHKSUM, write the header to the archive without computing the checksum
+  tar_buffer_append(buffer, header, sizeof(tar_t));
+}
+
+/**
+  * Writes the tar_t header of a file followed by the file content and end bytes to an archive file.
+  * The archive is built in memory and written at once.
+  * 
+  * @param[in] archive: buffer the archive is built in.
+  * @param[in] filename: path of the archive file to write to.
+  * @param[in] header: pointer to the tar_t struct representing the file header.
+  * @param[in] buffer: pointer to the buffer holding the file content.
+  * @param[in] size: size of the file content in bytes.
+  * @param[in] end_bytes: pointer to the buffer holding the end bytes to be added after the file content.
+  * @param[in] end_size: size of the end bytes buffer in bytes.
+  * 
+  * @see write_tar_header
+**/
+void write_tar_fields(tar_buffer *archive, const char *filename, tar_t *header, const char *buffer, size_t size, const char *end_bytes, size_t end_size)
+{
+  archive->size = 0;
+
+  // write the file header to the archive
+  write_tar_header(archive, header);
+
+  // write the file content to the archive
+  tar_buffer_append(archive, buffer, size);
+
+  // write the end bytes to the archive
+  tar_buffer_append(archive, end_bytes, end_size);
+
+  // write the archive file
+  flush_archive(archive, filename);
+}
+
+/**
+ * Write a number of tar entries defined by the variable count in a file. 
+ * It uses the field size in entries to set the field size in the header
+ * Also adds the appropriate number of null bytes at the end.
+ * The archive is built in memory and written at once.
+ * The contents are only read, they stay owned by the caller (usually the arena of the test).
+ *
+ * @param[in] archive: buffer the archive is built in
+ * @param[in] filename: path of the tar archive to write to
+ * @param[in] entries: array of tar_entry structs representing the entries to write
+ * @param[in] count: number of entries in the entries array
+ */
+void write_tar_entries(tar_buffer *archive, const char *filename, tar_entry entries[], size_t count)
+{
+  archive->size = 0;
+
+  // Loop through each entry in the array and write its header and content
+  for (size_t i = 0; i < count; i++)
+  {
+    tar_entry *e = &entries[i];
+    // Set the size field in the header to the size of the content
+    set_size_header(&e->header, e->size);
+    // Write the header to the archive, computing the checksum if necessary
+    write_tar_header(archive, &e->header);
+
+    // Write the content of the entry to the archive
+    tar_buffer_append(archive, e->content, e->size);
+
+    // Compute the number of null bytes needed to pad the content to a multiple of 512 bytes
+    unsigned size_padding = 512 - (e->size % 512);
+
+    // Write the null bytes to the archive as padding
+    tar_buffer_zeros(archive, size_padding);
+  }
+
+  // Write the end-of-archive null bytes to the archive
+  tar_buffer_zeros(archive, END_LEN);
+
+  // Write the archive file
+  flush_archive(archive, filename);
+}
+
+
+/**
+ * Writes an archive already built in memory, used by the mutators.
+ *
+ * @param[in] archive: buffer the archive is copied to, to be written through the ring
+ * @param[in] filename: path of the tar archive to write to
+ * @param[in] data: the archive
+ * @param[in] size: size of the archive
+ */
+void write_raw_tar(tar_buffer *archive, const char *filename, const char *data, size_t size)
+{
+  archive->size = 0;
+  tar_buffer_append(archive, data, size);
+  flush_archive(archive, filename);
+}
+
+/**
+ * Appends runs of blocks taken from other archives to an archive buffer. The runs that follow
+ * each other in their archive are copied at once, so rearranging a few entries of a big archive
+ * costs a few copies instead of rebuilding every header.
+ *
+ * @param[in] buffer: the archive buffer
+ * @param[in] spans: the runs of blocks, in the order of the new archive
+ * @param[in] count: number of runs
+ */
+void tar_buffer_spans(tar_buffer *buffer, const tar_span spans[], size_t count)
+{
+  size_t i = 0;
+  while (i < count)
+  {
+    const char *start = spans[i].data;
+    size_t size = spans[i].size;
+    for (i++; i < count && spans[i].data == start + size; i++)
+      size += spans[i].size;
+    tar_buffer_append(buffer, start, size);
+  }
+}
+
+/**
+ * Formats a pax extended header record, "<length> <key>=<value>\n", where the length counts
+ * the whole record, its own digits included.
+ *
+ * @param[out] out: the record, not null terminated, only written if it fits
+ * @param[in] capacity: size of out
+ * @param[in] key: the keyword
+ * @param[in] value: the value, which can hold any byte
+ * @param[in] value_len: length of the value
+ * @return the length of the record, written or not
+ */
+size_t pax_record(char *out, size_t capacity, const char *key, const char *value, size_t value_len)
+{
+  size_t len = pax_record_len(NULL, key, value_len);
+  if (len > capacity)
+    return len;
+  int prefix = snprintf(out, capacity, "%zu %s=", len, key);
+  memcpy(out + prefix, value, value_len);
+  out[len - 1] = '\n';
+  return len;
+}
+
+/**
+ * Length of a pax record "<length> <key>=<value>\n". The real length counts its own digits.
+ *
+ * @param[in] length: the length as written in the record, NULL for the real one
+ * @param[in] key: the keyword
+ * @param[in] value_len: length of the value
+ * @return the length of the record
+ */
+size_t pax_record_len(const char *length, const char *key, size_t value_len)
+{
+  size_t len = strlen(key) + value_len + 3;
+  if (length)
+    return len + strlen(length);
+  for (size_t digits = 1, power = 10; ; digits++, power *= 10)
+  {
+    if (len + digits < power)
+      return len + digits;
+  }
+}
+
+/**
+ * Opens an archive to stream it, the file is truncated.
+ *
+ * @param[out] stream: the stream
+ * @param[in] filename: path of the archive
+ * @return 0 on success, -1 if the file cannot be opened or the buffer allocated
+ */
+int tar_stream_open(tar_stream *stream, const char *filename)
+{
+  memset(stream, 0, sizeof(tar_stream));
+  stream->buffer.data = malloc(TAR_STREAM_BUFFER);
+  if (stream->buffer.data == NULL)
+  {
+    printf("Array not allocated \n");
+    return -1;
+  }
+  stream->buffer.capacity = TAR_STREAM_BUFFER;
+
+  // The ring keeps the archive open and no longer knows its size once it is written here
+  uring.archive_size = (size_t)-1;
+  stream->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (stream->fd == -1)
+  {
+    printf("Could not write to file");
+    free(stream->buffer.data);
+    stream->buffer.data = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Writes bytes to the file of a stream, retrying the short writes.
+ */
+static void tar_stream_write(tar_stream *stream, const char *data, size_t size)
+{
+  while (size && !stream->error)
+  {
+    ssize_t n = write(stream->fd, data, size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+    {
+      stream->error = 1;
+      return;
+    }
+    data += n;
+    size -= n;
+    stream->written += n;
+  }
+}
+
+/**
+ * Appends bytes to a streamed archive. The buffer is written to the file when it is full,
+ * and bytes that would not fit in it at all are written directly.
+ *
+ * @param[in] stream: the stream
+ * @param[in] data: the bytes to append
+ * @param[in] size: number of bytes
+ */
+void tar_stream_append(tar_stream *stream, const void *data, size_t size)
+{
+  tar_buffer *buffer = &stream->buffer;
+  if (buffer->size + size > buffer->capacity)
+  {
+    tar_stream_write(stream, buffer->data, buffer->size);
+    buffer->size = 0;
+  }
+  if (size > buffer->capacity)
+  {
+    tar_stream_write(stream, data, size);
+    return;
+  }
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+}
+
+/**
+ * Appends null bytes to a streamed archive (padding and end of archive).
+ *
+ * @param[in] stream: the stream
+ * @param[in] size: number of null bytes
+ */
+void tar_stream_zeros(tar_stream *stream, size_t size)
+{
+  static const char zeros[END_LEN];
+  while (size)
+  {
+    size_t chunk = size < sizeof(zeros) ? size : sizeof(zeros);
+    tar_stream_append(stream, zeros, chunk);
+    size -= chunk;
+  }
+}
+
+/**
+ * Appends a chunk repeated up to a given size to a streamed archive, so that contents of any
+ * size can be generated without being built in memory.
+ *
+ * @param[in] stream: the stream
+ * @param[in] chunk: the bytes repeated
+ * @param[in] chunk_len: number of bytes of the chunk, not 0
+ * @param[in] size: number of bytes appended, the last chunk is cut
+ */
+void tar_stream_fill(tar_stream *stream, const char *chunk, size_t chunk_len, size_t size)
+{
+  while (size)
+  {
+    size_t n = size < chunk_len ? size : chunk_len;
+    tar_stream_append(stream, chunk, n);
+    size -= n;
+  }
+}
+
+/**
+ * Appends null bytes up to the end of the current block of a streamed archive.
+ *
+ * @param[in] stream: the stream
+ */
+void tar_stream_pad(tar_stream *stream)
+{
+  size_t offset = (stream->written + stream->buffer.size) % sizeof(tar_t);
+  if (offset)
+    tar_stream_zeros(stream, sizeof(tar_t) - offset);
+}
+
+/**
+ * Appends a pax record "<length> <key>=<value>\n" to a streamed archive, the value being
+ * a chunk repeated up to value_len bytes. See pax_record_len() for its length.
+ *
+ * @param[in] stream: the stream
+ * @param[in] length: the length as written in the record, NULL for the real one
+ * @param[in] key: the keyword
+ * @param[in] chunk: the bytes repeated in the value
+ * @param[in] chunk_len: number of bytes of the chunk
+ * @param[in] value_len: length of the value
+ */
+void tar_stream_record(tar_stream *stream, const char *length, const char *key, const char *chunk, size_t chunk_len, size_t value_len)
+{
+  char prefix[64];
+  int n = length ? snprintf(prefix, sizeof(prefix), "%s ", length)
+                 : snprintf(prefix, sizeof(prefix), "%zu ", pax_record_len(NULL, key, value_len));
+  tar_stream_append(stream, prefix, n);
+  tar_stream_append(stream, key, strlen(key));
+  tar_stream_append(stream, "=", 1);
+  if (chunk_len)
+    tar_stream_fill(stream, chunk, chunk_len, value_len);
+  tar_stream_append(stream, "\n", 1);
+}
+
+/**
+ * Appends a tar header to a streamed archive, computing the checksum if it is set to DO_CHKSUM.
+ * The header itself is left as it is.
+ *
+ * @param[in] stream: the stream
+ * @param[in] header: the header to write
+ */
+void tar_stream_header(tar_stream *stream, const tar_t *header)
+{
+  if (strncmp(DO_CHKSUM, header->chksum, CHKSUM_LEN) != 0)
+  {
+    tar_stream_append(stream, header, sizeof(tar_t));
+    return;
+  }
+  tar_t copy = *header;
+  calculate_checksum(&copy);
+  tar_stream_append(stream, &copy, sizeof(tar_t));
+}
+
+/**
+ * Writes what is left in the buffer of a streamed archive and closes its file.
+ *
+ * @param[in] stream: the stream
+ * @return 0 if the whole archive was written, -1 otherwise
+ */
+int tar_stream_close(tar_stream *stream)
+{
+  tar_stream_write(stream, stream->buffer.data, stream->buffer.size);
+  if (close(stream->fd) == -1)
+    stream->error = 1;
+  free(stream->buffer.data);
+  stream->buffer.data = NULL;
+  return stream->error ? -1 : 0;
+}
@@ -1,92 +1,154 @@
-#ifndef TAR_H
-#define TAR_H
-
-#define NAME_LEN 100
-#define MODE_LEN 8
-#define UID_LEN 8
-#define GID_LEN 8
-#define SIZE_LEN 12
-#define MTIME_LEN 12
-#define CHKSUM_LEN 8
-#define LINKNAME_LEN NAME_LEN
-#define MAGIC_LEN 6
-#define VERSION_LEN 2
-#define UNAME_LEN 32
-#define GNAME_LEN UNAME_LEN
-
-#define END_LEN 1024
-
-typedef struct
-{                                /* byte offset */
-    char name[NAME_LEN];         /*   0 */
-    char mode[MODE_LEN];         /* 100 */
-    char uid[UID_LEN];           /* 108 */
-    char gid[GID_LEN];           /* 116 */
-    char size[SIZE_LEN];         /* 124 */
-    char mtime[MTIME_LEN];       /* 136 */
-    char chksum[CHKSUM_LEN];     /* 148 */
-    char typeflag;               /* 156 */
-    char linkname[LINKNAME_LEN]; /* 157 */
-    char magic[MAGIC_LEN];       /* 257 */
-    char version[VERSION_LEN];   /* 263 */
-    char uname[UNAME_LEN];       /* 265 */
-    char gname[GNAME_LEN];       /* 297 */
-    char devmajor[8];            /* 329 */
-    char devminor[8];            /* 337 */
-    char prefix[155];            /* 345 */
-    char padding[12];            /* 500 */
-} tar_t;
-
-typedef struct
-{
-    tar_t header;
-    char *content;
-    size_t size;
-} tar_entry;
-
-
-/* Bits used in the mode field, values in octal.  */
-#define TSUID 04000   /* set UID on execution */
-#define TSGID 02000   /* set GID on execution */
-#define TSVTX 01000   /* reserved */
-                      /* file permissions */
-#define TUREAD 00400  /* read by owner */
-#define TUWRITE 00200 /* write by owner */
-#define TUEXEC 00100  /* execute/search by owner */
-#define TGREAD 00040  /* read by group */
-#define TGWRITE 00020 /* write by group */
-#define TGEXEC 00010  /* execute/search by group */
-#define TOREAD 00004  /* read by other */
-#define TOWRITE 00002 /* write by other */
-#define TOEXEC 00001  /* execute/search by other */
-
-#define TMAGIC   "ustar"        /* ustar and a null */
-#define TVERSION "00"           /* 00 and no null */
-
-/* Values used in typeflag field.  */
-#define REGTYPE  '0'            /* regular file */
-#define AREGTYPE '\0'           /* regular file */
-#define LNKTYPE  '1'            /* link */
-#define SYMTYPE  '2'            /* reserved */
-#define CHRTYPE  '3'            /* character special */
-#define BLKTYPE  '4'            /* block special */
-#define DIRTYPE  '5'            /* directory */
-#define FIFOTYPE '6'            /* FIFO special */
-#define CONTTYPE '7'            /* reserved */
-#define XHDTYPE  'x'            /* Extended header referring to the next file in the archive */
-#define XGLTYPE  'g'            /* Global extended header */
-
-// It's set to "docheck" to signal that the write functions will compute the checksum before writing it to the header. 
-// In other words, this value indicates that the checksum has not been computed yet and it needs to be calculated before 
-// writing the tar file.
-#define DO_CHKSUM "docheck" 
-
-unsigned int calculate_checksum(tar_t* entry);
-void set_size_header(tar_t *header, size_t size);
-void set_header(tar_t *header);
-void write_empty_tar(const char *filename, tar_t *header);
-void write_tar(const char *filename, tar_t *header, const char *buffer, size_t size);
-void write_tar_header(FILE *file, tar_t *header);
-void write_tar_fields(const char *filename, tar_t *header, const char *buffer, size_t size, const char *end_bytes, size_t end_size);
-void write_tar_entries(const char *filename, tar_entry entries[], size_t count);
+#ifndef TAR_H
+#define TAR_H
+
+#define NAME_LEN 100
+#define MODE_LEN 8
+#define UID_LEN 8
+#define GID_LEN 8
+#define SIZE_LEN 12
+#define MTIME_LEN 12
+#define CHKSUM_LEN 8
+#define LINKNAME_LEN NAME_LEN
+#define MAGIC_LEN 6
+#define VERSION_LEN 2
+#define UNAME_LEN 32
+#define GNAME_LEN UNAME_LEN
+
+#define END_LEN 1024
+
+typedef struct
+{                                /* byte offset */
+    char name[NAME_LEN];         /*   0 */
+    char mode[MODE_LEN];         /* 100 */
+    char uid[UID_LEN];           /* 108 */
+    char gid[GID_LEN];           /* 116 */
+    char size[SIZE_LEN];         /* 124 */
+    char mtime[MTIME_LEN];       /* 136 */
+    char chksum[CHKSUM_LEN];     /* 148 */
+    char typeflag;               /* 156 */
+    char linkname[LINKNAME_LEN]; /* 157 */
+    char magic[MAGIC_LEN];       /* 257 */
+    char version[VERSION_LEN];   /* 263 */
+    char uname[UNAME_LEN];       /* 265 */
+    char gname[GNAME_LEN];       /* 297 */
+    char devmajor[8];            /* 329 */
+    char devminor[8];            /* 337 */
+    char prefix[155];            /* 345 */
+    char padding[12];            /* 500 */
+} tar_t;
+
+typedef struct
+{
+    tar_t header;
+    const char *content;    // borrowed, write_tar_entries() does not free it
+    size_t size;
+} tar_entry;
+
+// Archive built in memory before being written at once
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} tar_buffer;
+
+#define TAR_STREAM_BUFFER (256 * 1024) // bytes of a streamed archive kept in memory before being written
+#define TAR_BUFFER_KEEP (4 * 1024 * 1024) // capacity of the archive buffer kept from one archive to the next
+
+// Archive written to its file while it is built, through a buffer of fixed size,
+// so that archives far bigger than the memory of the fuzzer can be generated
+typedef struct
+{
+    int fd;
+    tar_buffer buffer;  // blocks not written yet
+    size_t written;     // bytes already written to the file
+    int error;          // a write failed, the archive is incomplete
+} tar_stream;
+
+// Blocks of an archive already built, copied as such into the next one by the structural mutations
+typedef struct
+{
+    const char *data;
+    size_t size;
+} tar_span;
+
+// Position of a field in the header, used by the mutators
+typedef struct
+{
+    const char *name;
+    size_t offset;
+    size_t size;
+    int numeric;    // the field holds an octal number
+} tar_field;
+
+#define TAR_FIELDS_COUNT 16
+extern const tar_field TAR_FIELDS[TAR_FIELDS_COUNT];
+
+
+/* Bits used in the mode field, values in octal.  */
+#define TSUID 04000   /* set UID on execution */
+#define TSGID 02000   /* set GID on execution */
+#define TSVTX 01000   /* reserved */
+                      /* file permissions */
+#define TUREAD 00400  /* read by owner */
+#define TUWRITE 00200 /* write by owner */
+#define TUEXEC 00100  /* execute/search by owner */
+#define TGREAD 00040  /* read by group */
+#define TGWRITE 00020 /* write by group */
+#define TGEXEC 00010  /* execute/search by group */
+#define TOREAD 00004  /* read by other */
+#define TOWRITE 00002 /* write by other */
+#define TOEXEC 00001  /* execute/search by other */
+
+#define TMAGIC   "ustar"        /* ustar and a null */
+#define TVERSION "00"           /* 00 and no null */
+
+/* Values used in typeflag field.  */
+#define REGTYPE  '0'            /* regular file */
+#define AREGTYPE '\0'           /* regular file */
+#define LNKTYPE  '1'            /* link */
+#define SYMTYPE  '2'            /* reserved */
+#define CHRTYPE  '3'            /* character special */
+#define BLKTYPE  '4'            /* block special */
+#define DIRTYPE  '5'            /* directory */
+#define FIFOTYPE '6'            /* FIFO special */
+#define CONTTYPE '7'            /* reserved */
+#define XHDTYPE  'x'            /* Extended header referring to the next file in the archive */
+#define XGLTYPE  'g'            /* Global extended header */
+
+/* GNU extensions to typeflag field.  */
+#define GNUTYPE_LONGLINK 'K'    /* Long link name of the next file in the archive */
+#define GNUTYPE_LONGNAME 'L'    /* Long name of the next file in the archive */
+#define GNU_LONGLINK_NAME "././@LongLink" /* name of the headers of the long names */
+
+// It's set to "docheck" to signal that the write functions will compute the checksum before writing it to the header. 
+// In other words, this value indicates that the checksum has not been computed yet and it needs to be calculated before 
+// writing the tar file.
+#define DO_CHKSUM "docheck" 
+
+unsigned int calculate_checksum(tar_t* entry);
+void set_size_header(tar_t *header, size_t size);
+void set_path_header(tar_t *header, const char *path, size_t len);
+void set_header(tar_t *header);
+void write_empty_tar(tar_buffer *archive, const char *filename, tar_t *header);
+void write_tar(tar_buffer *archive, const char *filename, tar_t *header, const char *buffer, size_t size);
+void tar_buffer_append(tar_buffer *buffer, const void *data, size_t size);
+void tar_buffer_zeros(tar_buffer *buffer, size_t size);
+int tar_buffer_flush(const tar_buffer *buffer, const char *filename);
+void tar_buffer_free(tar_buffer *buffer);
+void write_tar_header(tar_buffer *buffer, tar_t *header);
+void write_tar_fields(tar_buffer *archive, const char *filename, tar_t *header, const char *buffer, size_t size, const char *end_bytes, size_t end_size);
+void write_tar_entries(tar_buffer *archive, const char *filename, tar_entry entries[], size_t count);
+void write_raw_tar(tar_buffer *archive, const char *filename, const char *data, size_t size);
+void tar_buffer_spans(tar_buffer *buffer, const tar_span spans[], size_t count);
+int tar_stream_open(tar_stream *stream, const char *filename);
+void tar_stream_append(tar_stream *stream, const void *data, size_t size);
+void tar_stream_zeros(tar_stream *stream, size_t size);
+void tar_stream_fill(tar_stream *stream, const char *chunk, size_t chunk_len, size_t size);
+void tar_stream_pad(tar_stream *stream);
+void tar_stream_record(tar_stream *stream, const char *length, const char *key, const char *chunk, size_t chunk_len, size_t value_len);
+void tar_stream_header(tar_stream *stream, const tar_t *header);
+int tar_stream_close(tar_stream *stream);
+size_t pax_record_len(const char *length, const char *key, size_t value_len);
+size_t pax_record(char *out, size_t capacity, const char *key, const char *value, size_t value_len);
 #endif
\ No newline at end of file
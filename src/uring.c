@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "uring.h"
+
+#define URING_WRITE ((uint64_t)-1)      // user data of the write of the archive
+#define URING_TRUNCATE ((uint64_t)-2)   // user data of its truncation
+
+// Each thread sets up its own ring, the entries of one are never mixed with the I/O of another
+_Thread_local uring_state uring = {.fd = -1, .archive_fd = -1};
+
+/**
+ * Tells whether the ring can truncate a file, through IORING_REGISTER_PROBE.
+**/
+static int uring_probe_ftruncate(void)
+{
+  size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = calloc(1, size);
+  if (probe == NULL)
+    return 0;
+  int supported = syscall(__NR_io_uring_register, uring.fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                  probe->last_op >= URING_OP_FTRUNCATE && probe->ops_len > URING_OP_FTRUNCATE &&
+                  (probe->ops[URING_OP_FTRUNCATE].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  return supported;
+}
+
+/**
+ * Sets up the ring with io_uring_setup() and maps its queues. The waits with a timeout need
+ * IORING_FEAT_EXT_ARG (Linux 5.11), older kernels keep the regular system calls.
+ *
+ * @return 0 on success, -1 if io_uring is not available
+**/
+int uring_init(void)
+{
+  uring_free();
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+  if (fd == -1)
+    return -1;
+  if (!(params.features & IORING_FEAT_EXT_ARG))
+  {
+    close(fd);
+    return -1;
+  }
+  uring.fd = fd;
+  uring.entries = params.sq_entries;
+
+  // Both rings are in the same mapping on the kernels that have IORING_FEAT_EXT_ARG
+  uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  int single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && uring.cq_ring_size > uring.sq_ring_size)
+    uring.sq_ring_size = uring.cq_ring_size;
+  uring.sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (uring.sq_ring == MAP_FAILED)
+  {
+    uring.sq_ring = NULL;
+    uring_free();
+    return -1;
+  }
+  uring.cq_ring = single ? uring.sq_ring : mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  uring.sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (uring.cq_ring == MAP_FAILED || uring.sqes == MAP_FAILED)
+  {
+    if (uring.cq_ring == MAP_FAILED)
+      uring.cq_ring = NULL;
+    if (uring.sqes == MAP_FAILED)
+      uring.sqes = NULL;
+    uring_free();
+    return -1;
+  }
+
+  char *sq = uring.sq_ring, *cq = uring.cq_ring;
+  uring.sq_head = (unsigned *)(sq + params.sq_off.head);
+  uring.sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  uring.sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  uring.sq_array = (unsigned *)(sq + params.sq_off.array);
+  uring.cq_head = (unsigned *)(cq + params.cq_off.head);
+  uring.cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  uring.cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  uring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  uring.has_ftruncate = uring_probe_ftruncate();
+  uring.enabled = 1;
+  return 0;
+}
+
+/**
+ * Gives the next free entry of the submission queue, cleared. It is submitted by the next uring_submit_wait().
+ *
+ * @return the entry, NULL if the queue is full
+**/
+struct io_uring_sqe *uring_get_sqe(void)
+{
+  unsigned tail = *uring.sq_tail;
+  unsigned head = __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+  if (tail - head >= uring.entries)
+    return NULL;
+
+  unsigned index = tail & *uring.sq_mask;
+  struct io_uring_sqe *sqe = &uring.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  uring.sq_array[index] = index;
+  __atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  uring.pending++;
+  return sqe;
+}
+
+/**
+ * Submits the queued entries and waits for completions, in a single io_uring_enter().
+ *
+ * @param[in] wait number of completions to wait for, 0 to only submit
+ * @param[in] timeout longest wait in milliseconds, -1 for no limit, as for poll()
+ * @return 0 on success or timeout, -1 on error
+**/
+int uring_submit_wait(unsigned wait, int timeout)
+{
+  struct __kernel_timespec ts = {timeout / 1000, (timeout % 1000) * 1000000LL};
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  if (timeout >= 0)
+    arg.ts = (uintptr_t)&ts;
+
+  unsigned flags = IORING_ENTER_EXT_ARG | (wait ? IORING_ENTER_GETEVENTS : 0);
+  long submitted = syscall(__NR_io_uring_enter, uring.fd, uring.pending, wait, flags, &arg, sizeof(arg));
+  uring.enters++;
+  if (submitted >= 0)
+  {
+    uring.pending -= submitted < uring.pending ? submitted : uring.pending;
+    return 0;
+  }
+  return errno == ETIME || errno == EINTR ? 0 : -1;
+}
+
+/**
+ * Gives the oldest completion not seen yet, to be released with uring_seen().
+ *
+ * @return the completion, NULL if there is none
+**/
+struct io_uring_cqe *uring_peek(void)
+{
+  unsigned head = *uring.cq_head;
+  if (head == __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE))
+    return NULL;
+  return &uring.cqes[head & *uring.cq_mask];
+}
+
+/**
+ * Releases the completion given by uring_peek().
+**/
+void uring_seen(void)
+{
+  __atomic_store_n(uring.cq_head, *uring.cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Registers the archive buffer with the ring when it moved or grew, which only happens when
+ * a bigger archive is built. The write then uses the pages pinned once rather than at each write.
+**/
+static void uring_register(const void *data, size_t capacity)
+{
+  if (data == uring.registered && capacity == uring.registered_size)
+    return;
+  if (uring.fixed)
+    syscall(__NR_io_uring_register, uring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+  struct iovec iov = {(void *)data, capacity};
+  uring.fixed = capacity > 0 && syscall(__NR_io_uring_register, uring.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+  uring.registered = data;
+  uring.registered_size = capacity;
+}
+
+/**
+ * Unregisters a buffer about to be released, the registration would keep its pages pinned.
+ *
+ * @param[in] data the buffer
+**/
+void uring_forget(const void *data)
+{
+  if (data == NULL || data != uring.registered)
+    return;
+  if (uring.fixed)
+    syscall(__NR_io_uring_register, uring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+  uring.fixed = 0;
+  uring.registered = NULL;
+  uring.registered_size = 0;
+}
+
+/**
+ * Writes an archive through the ring: the file is kept open, overwritten from its start and
+ * truncated to the size of the archive. The write and the truncation are linked and submitted
+ * together, so an archive costs one system call instead of an open, a write and a close.
+ *
+ * @param[in] filename path of the archive
+ * @param[in] data the archive, in a buffer of capacity bytes
+ * @param[in] size size of the archive
+ * @param[in] capacity size of the buffer holding the archive, registered with the ring
+ * @return 0 on success, -1 otherwise
+**/
+int uring_write_file(const char *filename, const void *data, size_t size, size_t capacity)
+{
+  if (uring.archive_fd == -1 || strcmp(filename, uring.archive) != 0)
+  {
+    if (uring.archive_fd != -1)
+      close(uring.archive_fd);
+    uring.archive_fd = open(filename, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (uring.archive_fd == -1)
+      return -1;
+    snprintf(uring.archive, sizeof(uring.archive), "%s", filename);
+    uring.archive_size = (size_t)-1;
+  }
+  uring_register(data, capacity);
+
+  struct io_uring_sqe *sqe = uring_get_sqe();
+  if (sqe == NULL)
+    return -1;
+  sqe->opcode = uring.fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+  sqe->fd = uring.archive_fd;
+  sqe->addr = (uintptr_t)data;
+  sqe->len = size;
+  sqe->off = 0;
+  sqe->buf_index = 0;
+  sqe->user_data = URING_WRITE;
+  unsigned wait = 1;
+  if (uring.has_ftruncate)
+  {
+    struct io_uring_sqe *truncate = uring_get_sqe();
+    if (truncate)
+    {
+      sqe->flags |= IOSQE_IO_LINK;
+      truncate->opcode = URING_OP_FTRUNCATE;
+      truncate->fd = uring.archive_fd;
+      truncate->off = size;
+      truncate->user_data = URING_TRUNCATE;
+      wait = 2;
+    }
+  }
+
+  long written = -1;
+  int truncated = wait == 1 ? -1 : 0;
+  while (wait)
+  {
+    if (uring_submit_wait(wait, -1) == -1)
+      return -1;
+    // Only the completions of the write and its truncation are counted, a completion left by the
+    // reads of the outputs is not one of them
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek()) != NULL)
+    {
+      if (cqe->user_data == URING_WRITE)
+      {
+        written = cqe->res;
+        wait--;
+      }
+      else if (cqe->user_data == URING_TRUNCATE)
+      {
+        truncated = cqe->res;
+        wait--;
+      }
+      uring_seen();
+    }
+  }
+
+  // A short write is completed, and a failed truncation done with the system call
+  size_t done = written > 0 ? written : 0;
+  while (done < size)
+  {
+    ssize_t n = pwrite(uring.archive_fd, (const char *)data + done, size - done, done);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    done += n;
+  }
+  if ((truncated < 0 || written < 0) && size < uring.archive_size && ftruncate(uring.archive_fd, size) == -1)
+    return -1;
+  uring.archive_size = size;
+  uring.writes++;
+  return 0;
+}
+
+/**
+ * Prints the number of io_uring_enter() calls per execution.
+ *
+ * @param[in] execs number of executions of the extractor
+**/
+void uring_report(unsigned long execs)
+{
+  if (!uring.enabled)
+    return;
+  printf("io_uring: %lu archives written, %.2f io_uring_enter() per execution (%s)\n", uring.writes,
+         execs ? (double)uring.enters / execs : 0, uring.fixed ? "registered buffer" : "unregistered buffer");
+}
+
+/**
+ * Closes the archive and the ring.
+**/
+void uring_free(void)
+{
+  if (uring.archive_fd != -1)
+    close(uring.archive_fd);
+  if (uring.sqes)
+    munmap(uring.sqes, uring.entries * sizeof(struct io_uring_sqe));
+  if (uring.cq_ring && uring.cq_ring != uring.sq_ring)
+    munmap(uring.cq_ring, uring.cq_ring_size);
+  if (uring.sq_ring)
+    munmap(uring.sq_ring, uring.sq_ring_size);
+  if (uring.fd != -1)
+    close(uring.fd);
+  memset(&uring, 0, sizeof(uring));
+  uring.fd = uring.archive_fd = -1;
+}
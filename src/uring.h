@@ -0,0 +1,48 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES 64        // submission queue entries, enough for the archive and the output of every extractor
+#define URING_OP_FTRUNCATE 55   // IORING_OP_FTRUNCATE, from Linux 6.9, missing from older headers
+
+// io_uring set up with the raw system calls, used for the writes of the archive and the reads of the outputs
+typedef struct
+{
+    int enabled;            // the ring is set up, the I/O of the executions goes through it
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    unsigned pending;       // entries queued and not submitted yet
+    int has_ftruncate;      // the archive is truncated by the ring, after its write
+    int archive_fd;         // the archive, kept open between the writes
+    char archive[PATH_MAX];
+    size_t archive_size;    // size of the last archive written
+    const void *registered; // archive buffer last registered with the ring, written without pinning its pages each time
+    size_t registered_size;
+    int fixed;              // the registration succeeded
+    unsigned long enters;   // io_uring_enter() calls
+    unsigned long writes;   // archives written
+} uring_state;
+
+extern _Thread_local uring_state uring;
+
+int uring_init(void);
+struct io_uring_sqe *uring_get_sqe(void);
+int uring_submit_wait(unsigned wait, int timeout);
+struct io_uring_cqe *uring_peek(void);
+void uring_seen(void);
+void uring_forget(const void *data);
+int uring_write_file(const char *filename, const void *data, size_t size, size_t capacity);
+void uring_report(unsigned long execs);
+void uring_free(void);
+
+#endif
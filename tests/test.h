@@ -0,0 +1,47 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Checks made and failed by the test program, reported by test_end()
+static int test_checks, test_failures;
+
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        test_checks++;                                                     \
+        if (!(cond))                                                       \
+        {                                                                  \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                               \
+        }                                                                  \
+    } while (0)
+
+/**
+ * Moves to a fresh directory, so that the files written by the test do not mix with others.
+**/
+static inline void test_begin(void)
+{
+  char dir[] = "/tmp/fuzzy_test.XXXXXX";
+  if (mkdtemp(dir) == NULL || chdir(dir) == -1)
+  {
+    printf("Test directory not created \n");
+    exit(1);
+  }
+}
+
+/**
+ * Reports the checks of the test program.
+ *
+ * @param[in] name the name of the test program
+ * @return the exit status of the test program, 0 if every check passed
+**/
+static inline int test_end(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+  return test_failures ? 1 : 0;
+}
+
+#endif
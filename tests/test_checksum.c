@@ -0,0 +1,115 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "checksum.h"
+
+#define RANDOM_HEADERS 2000
+
+static const char *KERNEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+/**
+ * Sums a header byte by byte, with the chksum field counted as spaces: the checksums of tar.
+**/
+static void reference_sums(const unsigned char *header, unsigned *sum, int *signed_sum)
+{
+  *sum = 0;
+  *signed_sum = 0;
+  for (int i = 0; i < CHECKSUM_HEADER_LEN; i++)
+  {
+    int in_field = i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + CHECKSUM_LEN;
+    *sum += in_field ? ' ' : header[i];
+    *signed_sum += in_field ? ' ' : (signed char)header[i];
+  }
+}
+
+/**
+ * Checks the checksums of a header, alone and in a batch, against the reference.
+**/
+static void check_header(const unsigned char *header)
+{
+  unsigned sum, sums[1];
+  int signed_sum, signed_sums[1];
+  reference_sums(header, &sum, &signed_sum);
+  CHECK(checksum_header(header) == sum);
+  CHECK(checksum_header_signed(header) == signed_sum);
+  checksum_headers(header, 1, sums, signed_sums);
+  CHECK(sums[0] == sum && signed_sums[0] == signed_sum);
+}
+
+/**
+ * Checks the kernel in use on random headers and on the bytes that read differently as signed chars.
+**/
+static void check_kernel(void)
+{
+  unsigned char header[CHECKSUM_HEADER_LEN];
+
+  srand(1);
+  for (int n = 0; n < RANDOM_HEADERS; n++)
+  {
+    for (int i = 0; i < CHECKSUM_HEADER_LEN; i++)
+      header[i] = rand() & 0xff;
+    check_header(header);
+  }
+
+  // A header of a single byte, for each byte from 0x80 to 0xff
+  for (int byte = 0x80; byte <= 0xff; byte++)
+  {
+    memset(header, byte, sizeof(header));
+    check_header(header);
+  }
+
+  // The largest and the smallest sums, and a lone high byte at each end of the header
+  memset(header, 0, sizeof(header));
+  check_header(header);
+  header[0] = 0x80;
+  header[CHECKSUM_HEADER_LEN - 1] = 0xff;
+  check_header(header);
+  memset(header, 0x7f, sizeof(header));
+  check_header(header);
+
+  // Several headers in a row
+  unsigned char headers[3][CHECKSUM_HEADER_LEN];
+  unsigned sums[3];
+  int signed_sums[3];
+  for (int h = 0; h < 3; h++)
+    memset(headers[h], 0x7e + h, CHECKSUM_HEADER_LEN);
+  checksum_headers(headers, 3, sums, NULL);
+  checksum_headers(headers, 3, sums, signed_sums);
+  for (int h = 0; h < 3; h++)
+  {
+    unsigned sum;
+    int signed_sum;
+    reference_sums(headers[h], &sum, &signed_sum);
+    CHECK(sums[h] == sum && signed_sums[h] == signed_sum);
+  }
+}
+
+int main(void)
+{
+  // The kernel picked is the fastest the CPU runs, the scalar one always runs
+  const char *fastest = checksum_kernel();
+  CHECK(checksum_use_kernel("scalar"));
+  CHECK(!checksum_use_kernel("none"));
+
+  for (size_t k = 0; k < sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0]); k++)
+  {
+    if (!checksum_use_kernel(KERNEL_NAMES[k]))
+    {
+      printf("test_checksum: kernel %s not supported, skipped\n", KERNEL_NAMES[k]);
+      continue;
+    }
+    CHECK(strcmp(checksum_kernel(), KERNEL_NAMES[k]) == 0);
+    check_kernel();
+  }
+  CHECK(checksum_use_kernel(fastest));
+
+  // The field written by checksum_encode() is six octal digits, a null and a space
+  char field[CHECKSUM_LEN];
+  checksum_encode(field, 01234);
+  CHECK(memcmp(field, "001234\0 ", CHECKSUM_LEN) == 0);
+  checksum_encode(field, 0777777);
+  CHECK(memcmp(field, "777777\0 ", CHECKSUM_LEN) == 0);
+
+  return test_end("test_checksum");
+}
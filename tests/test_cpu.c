@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "cpu.h"
+
+/**
+ * Makes a topology from the threads of each core, a core ends with -1.
+**/
+static void make_topology(cpu_topology *t, cpu_slot cores[], int first[], const int *threads, unsigned count)
+{
+  memset(t, 0, sizeof(cpu_topology));
+  t->cores = cores;
+  t->first = first;
+  for (unsigned c = 0; c < count; c++)
+  {
+    memset(&cores[c], 0, sizeof(cpu_slot));
+    for (; *threads != -1; threads++)
+      cores[c].cpus[cores[c].count++] = *threads;
+    threads++;
+    first[c] = cores[c].cpus[0];
+    t->threads += cores[c].count;
+  }
+  t->count = count;
+}
+
+/**
+ * Gives the CPUs of a worker as a string.
+**/
+static const char *assigned(const cpu_topology *t, unsigned worker, unsigned workers)
+{
+  static char out[64];
+  cpu_slot slot;
+  cpu_assign(t, worker, workers, &slot);
+  cpu_slot_format(&slot, out, sizeof(out));
+  return out;
+}
+
+int main(void)
+{
+  test_begin();
+  cpu_topology t;
+  cpu_slot cores[4];
+  int first[4];
+
+  // Four cores of two hardware threads, numbered like Linux does: the siblings come after all the cores
+  make_topology(&t, cores, first, (const int[]){0, 4, -1, 1, 5, -1, 2, 6, -1, 3, 7, -1}, 4);
+
+  // No more workers than cores: a whole core each
+  CHECK(strcmp(assigned(&t, 0, 1), "0,4") == 0);
+  CHECK(strcmp(assigned(&t, 1, 4), "1,5") == 0);
+  CHECK(strcmp(assigned(&t, 3, 4), "3,7") == 0);
+
+  // More workers than cores: a thread each, the first threads of the cores handed out first
+  CHECK(strcmp(assigned(&t, 0, 8), "0") == 0);
+  CHECK(strcmp(assigned(&t, 3, 8), "3") == 0);
+  CHECK(strcmp(assigned(&t, 4, 8), "4") == 0);
+  CHECK(strcmp(assigned(&t, 7, 8), "7") == 0);
+  CHECK(strcmp(assigned(&t, 5, 5), "5") == 0);
+
+  // More workers than threads: they share the threads in turn
+  CHECK(strcmp(assigned(&t, 8, 12), "0") == 0);
+  CHECK(strcmp(assigned(&t, 11, 12), "3") == 0);
+
+  // Cores of different sizes, as when only some threads are allowed
+  make_topology(&t, cores, first, (const int[]){0, 2, -1, 1, -1}, 2);
+  CHECK(strcmp(assigned(&t, 0, 3), "0") == 0);
+  CHECK(strcmp(assigned(&t, 1, 3), "1") == 0);
+  CHECK(strcmp(assigned(&t, 2, 3), "2") == 0);
+
+  // Without topology nothing is assigned
+  memset(&t, 0, sizeof(t));
+  CHECK(strcmp(assigned(&t, 0, 1), "") == 0);
+
+  // The CPUs of the process, pinned or not
+  cpu_set_t allowed;
+  CHECK(sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && cpu_count() == (unsigned)CPU_COUNT(&allowed));
+
+  // The locks go to $XDG_RUNTIME_DIR when it is set
+  char dir[PATH_MAX];
+  CHECK(getcwd(dir, sizeof(dir)) != NULL);
+  CHECK(setenv("XDG_RUNTIME_DIR", dir, 1) == 0 && strcmp(cpu_lock_dir(), dir) == 0);
+  CHECK(unsetenv("XDG_RUNTIME_DIR") == 0 && strcmp(cpu_lock_dir(), CPU_LOCK_DIR) == 0);
+
+  // A core held by an instance is not claimed by another one until it is released, on cores the
+  // host doesn't have so that the search starts at the first one
+  make_topology(&t, cores, first, (const int[]){900, 904, -1, 901, 905, -1, 902, 906, -1}, 3);
+  cpu_slot slot[4];
+  int lock[4];
+  CHECK(cpu_claim(&t, dir, &slot[0], &lock[0]) == 0 && slot[0].cpus[0] == 900 && slot[0].count == 2);
+  CHECK(cpu_claim(&t, dir, &slot[1], &lock[1]) == 0 && slot[1].cpus[0] == 901);
+  CHECK(cpu_claim(&t, dir, &slot[2], &lock[2]) == 0 && slot[2].cpus[0] == 902);
+  CHECK(cpu_claim(&t, dir, &slot[3], &lock[3]) == -1);
+  close(lock[1]);
+  CHECK(cpu_claim(&t, dir, &slot[3], &lock[3]) == 0 && slot[3].cpus[0] == 901);
+
+  // The lock files are private to the user
+  struct stat info;
+  CHECK(stat("fuzzy_core_900.lock", &info) == 0 && (info.st_mode & 0777) == 0600);
+  for (unsigned i = 0; i < 4; i++)
+    if (i != 1)
+      close(lock[i]);
+
+  // A link in place of a lock file is not followed, its core is taken for held
+  CHECK(symlink("target", "fuzzy_core_900.lock.tmp") == 0 && rename("fuzzy_core_900.lock.tmp", "fuzzy_core_900.lock") == 0);
+  CHECK(cpu_claim(&t, dir, &slot[0], &lock[0]) == 0 && slot[0].cpus[0] == 901);
+  CHECK(access("target", F_OK) == -1);
+  close(lock[0]);
+
+  return test_end("test_cpu");
+}
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <elf.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "dict.h"
+#include "mutate.h"
+
+// Strings of the read-only data of the fake extractor, ended by their null byte
+static const char RODATA[] = "ustar\0Bad magic %s in header %d\0x\0\x01\x02nonprint\0";
+static const char DATA[] = "writable\0";
+static const char NAMES[] = "\0.rodata\0.data\0.shstrtab\0";
+
+/**
+ * Writes an ELF file of 64 bits with a .rodata, a .data and the table of the section names.
+ *
+ * @param[in] path the file
+ * @param[in] sections the number of section headers written, fewer than 4 to cut the table
+**/
+static void write_elf(const char *path, unsigned sections)
+{
+  unsigned char file[4096];
+  memset(file, 0, sizeof(file));
+  Elf64_Ehdr *ehdr = (Elf64_Ehdr *)file;
+  memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+  ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr->e_shentsize = sizeof(Elf64_Shdr);
+  ehdr->e_shnum = 4;
+  ehdr->e_shstrndx = 3;
+
+  size_t offset = sizeof(Elf64_Ehdr);
+  size_t rodata = offset, data = rodata + sizeof(RODATA), names = data + sizeof(DATA);
+  memcpy(file + rodata, RODATA, sizeof(RODATA));
+  memcpy(file + data, DATA, sizeof(DATA));
+  memcpy(file + names, NAMES, sizeof(NAMES));
+  ehdr->e_shoff = (names + sizeof(NAMES) + 7) & ~7;
+
+  Elf64_Shdr *shdr = (Elf64_Shdr *)(file + ehdr->e_shoff);
+  shdr[1] = (Elf64_Shdr){.sh_name = 1, .sh_type = SHT_PROGBITS, .sh_offset = rodata, .sh_size = sizeof(RODATA)};
+  shdr[2] = (Elf64_Shdr){.sh_name = 9, .sh_type = SHT_PROGBITS, .sh_offset = data, .sh_size = sizeof(DATA)};
+  shdr[3] = (Elf64_Shdr){.sh_name = 15, .sh_type = SHT_STRTAB, .sh_offset = names, .sh_size = sizeof(NAMES)};
+
+  FILE *f = fopen(path, "wb");
+  fwrite(file, ehdr->e_shoff + sections * sizeof(Elf64_Shdr), 1, f);
+  fclose(f);
+}
+
+/**
+ * Finds a token of the dictionary.
+ *
+ * @return the token, NULL if it is not there
+**/
+static const dict_token *find(const dictionary *d, const char *text)
+{
+  for (size_t i = 0; i < d->count; i++)
+    if (strcmp(d->tokens[i].text, text) == 0)
+      return &d->tokens[i];
+  return NULL;
+}
+
+int main(void)
+{
+  test_begin();
+  dictionary d;
+
+  // The strings of .rodata are kept, whole when they hold no conversion, by words otherwise
+  write_elf("extractor", 4);
+  CHECK(dict_harvest(&d, "extractor") == 0);
+  CHECK(d.sections == 1);
+  CHECK(find(&d, "ustar") && find(&d, "ustar")->score == DICT_LITERAL_SCORE);
+  CHECK(find(&d, "Bad magic %s in header %d") == NULL);
+  CHECK(find(&d, "magic") && find(&d, "magic")->score == DICT_WORD_SCORE);
+  CHECK(find(&d, "header") && find(&d, "in") && find(&d, "Bad"));
+  CHECK(find(&d, "s") == NULL && find(&d, "d") == NULL);
+  CHECK(find(&d, "x") == NULL);
+  CHECK(find(&d, "nonprint") && find(&d, "nonprint")->score == DICT_LITERAL_SCORE);
+  CHECK(find(&d, "writable") == NULL);
+  CHECK(d.count > 0 && d.tokens[0].score == DICT_LITERAL_SCORE);
+
+  // The dictionary token mutation is only picked with a dictionary
+  CHECK(!mutation_available(MUT_DICT_TOKEN));
+  mutate_set_dictionary(&d);
+  CHECK(mutation_available(MUT_DICT_TOKEN));
+  mutate_set_dictionary(NULL);
+  dict_free(&d);
+
+  // A table of sections going past the end of the file, or a file that is not ELF, is rejected
+  write_elf("cut", 2);
+  CHECK(dict_harvest(&d, "cut") == -1);
+  FILE *f = fopen("script", "w");
+  fputs("#!/bin/sh\nexit 0\n", f);
+  fclose(f);
+  CHECK(dict_harvest(&d, "script") == -1);
+  CHECK(dict_harvest(&d, "missing") == -1);
+
+  return test_end("test_dict");
+}
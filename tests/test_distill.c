@@ -0,0 +1,122 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "store.h"
+#include "replay.h"
+
+// Extractor answering after the first byte of the archive: a word, another one, or a failure
+static const char EXTRACTOR[] =
+    "#!/bin/sh\n"
+    "case $(head -c 1 \"$1\") in\n"
+    "  a) echo alpha ;;\n"
+    "  b) echo bravo ;;\n"
+    "  *) exit 3 ;;\n"
+    "esac\n";
+
+// The inputs of the store, the ones kept are the smallest of each behaviour
+static const struct
+{
+    char first;         // first byte, which decides the response of the extractor
+    size_t size;
+    store_kind kind;
+    int kept;
+} INPUTS[] = {
+    {'a', 11, STORE_CRASH, 0},  // same response and kind as a smaller input
+    {'a', 6, STORE_CRASH, 1},
+    {'b', 20, STORE_CRASH, 1},
+    {'a', 31, STORE_OOM, 1},    // same response as the first ones, kept for another reason
+    {'b', 25, STORE_CRASH, 0},
+    {'c', 40, STORE_MEMHOG, 0}, // an exit code is a response of its own
+    {'d', 15, STORE_MEMHOG, 1}, // the same exit code, smaller
+};
+#define INPUTS_COUNT (sizeof(INPUTS) / sizeof(INPUTS[0]))
+
+/**
+ * Builds the content of an input: its first byte, then a filler that differs from one input to the next.
+**/
+static void make_input(char *data, size_t i)
+{
+  memset(data, 'a' + i, INPUTS[i].size);
+  data[0] = INPUTS[i].first;
+}
+
+/**
+ * Tells which input of the list a stored input is, from its content.
+ *
+ * @return the index of the input, -1 if it is none of them
+**/
+static int find_input(const char *data, size_t size)
+{
+  char expected[64];
+  for (size_t i = 0; i < INPUTS_COUNT; i++)
+  {
+    make_input(expected, i);
+    if (size == INPUTS[i].size && memcmp(data, expected, size) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * Checks that the store holds the inputs kept by the distillation, each once, and nothing else.
+**/
+static void check_kept(const char *path)
+{
+  store s;
+  int seen[INPUTS_COUNT] = {0};
+  size_t expected = 0;
+  for (size_t i = 0; i < INPUTS_COUNT; i++)
+    expected += INPUTS[i].kept;
+
+  CHECK(store_open(&s, path, 0) == 0);
+  CHECK(s.count == expected);
+  for (size_t i = 0; i < s.count; i++)
+  {
+    const char *data = store_data(&s, i);
+    int input = data ? find_input(data, s.records[i].size) : -1;
+    CHECK(input != -1);
+    if (input == -1)
+      continue;
+    CHECK(INPUTS[input].kept && !seen[input] && s.records[i].kind == INPUTS[input].kind);
+    seen[input] = 1;
+  }
+  store_close(&s);
+}
+
+int main(void)
+{
+  test_begin();
+
+  int fd = open("extractor.sh", O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  CHECK(fd != -1 && write(fd, EXTRACTOR, sizeof(EXTRACTOR) - 1) == sizeof(EXTRACTOR) - 1);
+  close(fd);
+
+  store s;
+  CHECK(store_open(&s, "inputs.store", 1) == 0);
+  for (size_t i = 0; i < INPUTS_COUNT; i++)
+  {
+    char data[64];
+    make_input(data, i);
+    CHECK(store_add(&s, data, INPUTS[i].size, INPUTS[i].kind, 0, "distill") == 1);
+  }
+  store_close(&s);
+
+  // The smallest input of each behaviour is kept, the behaviour being the response with the kind
+  replay_options options = {"inputs.store", 1, 1, 5.0, 0, 0, 0};
+  CHECK(distill("./extractor.sh", &options) == 0);
+  check_kept("inputs.store");
+  CHECK(access("inputs.store" STORE_NEW_EXT, F_OK) == -1);
+
+  // A distilled store is distilled already
+  CHECK(distill("./extractor.sh", &options) == 0);
+  check_kept("inputs.store");
+
+  // Without the extractor, the store is left as it is
+  CHECK(distill("./missing.sh", &options) == -1);
+  check_kept("inputs.store");
+
+  return test_end("test_distill");
+}
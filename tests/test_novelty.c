@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "test.h"
+#include "novelty.h"
+
+#define EXITED(code) W_EXITCODE(code, 0)
+#define KILLED(sig) W_EXITCODE(0, sig)
+
+/**
+ * Tells whether the state has a class with this text.
+**/
+static int has_class(const novelty_state *state, const char *text)
+{
+  for (size_t i = 0; i < state->classes_count; i++)
+    if (strcmp(state->classes[i].text, text) == 0)
+      return 1;
+  return 0;
+}
+
+int main(void)
+{
+  char line[NOVELTY_LINE_LEN];
+
+  // The names and numbers taken from the archive are normalized away
+  const char *raw = "Cannot open 'name_1.txt' at /tmp/x/y.tar: size 1234";
+  normalize_line(raw, strlen(raw), line, sizeof(line));
+  CHECK(strcmp(line, "Cannot open <s> at <path>: size #") == 0);
+
+  novelty_state *state = novelty_init();
+
+  // A new output is a new class, the same one again or with other names is nothing new
+  CHECK(novelty_classify(state, "Error: bad size 12 for a.txt\n", EXITED(0), 0) == NOVELTY_CLASS);
+  CHECK(novelty_classify(state, "Error: bad size 12 for a.txt\n", EXITED(0), 0) == NOVELTY_NONE);
+  CHECK(novelty_classify(state, "Error: bad size 99 for dir/b.txt\n", EXITED(0), 0) == NOVELTY_NONE);
+  CHECK(has_class(state, "Error: bad size # for <path>"));
+
+  // A new exit code or a new signal is a new class
+  CHECK(novelty_classify(state, "Error: bad size 12 for a.txt\n", EXITED(2), 0) == NOVELTY_CLASS);
+  CHECK(has_class(state, "<exit code 2>"));
+  CHECK(novelty_classify(state, "Error: bad size 12 for a.txt\n", EXITED(2), 0) == NOVELTY_NONE);
+  CHECK(novelty_classify(state, "", KILLED(SIGSEGV), 0) == NOVELTY_CLASS);
+  CHECK(has_class(state, "<killed by signal 11>"));
+  CHECK(novelty_classify(state, "", EXITED(0), 0) == NOVELTY_CLASS);
+  CHECK(has_class(state, "<no output>"));
+
+  // Known classes in a new combination, in any order
+  CHECK(novelty_classify(state, "Unable to seek\n", EXITED(0), 0) == NOVELTY_CLASS);
+  CHECK(novelty_classify(state, "Unable to seek\nError: bad size 1 for c.txt\n", EXITED(0), 0) == NOVELTY_COMBO);
+  CHECK(novelty_classify(state, "Error: bad size 7 for c.txt\nUnable to seek\n", EXITED(0), 0) == NOVELTY_NONE);
+
+  // Only the first lines make the response
+  CHECK(novelty_classify(state, "Unable to seek\nUnable to seek\nUnable to seek\nsomething else\n", EXITED(0), 0) == NOVELTY_NONE);
+
+  // The max RSS counts by power of two
+  CHECK(novelty_classify(state, "Unable to seek\n", EXITED(0), 1000) == NOVELTY_CLASS);
+  CHECK(has_class(state, "<max RSS of 2^9 KB>"));
+  CHECK(novelty_classify(state, "Unable to seek\n", EXITED(0), 600) == NOVELTY_NONE);
+  CHECK(novelty_classify(state, "Unable to seek\n", EXITED(0), 5000) == NOVELTY_CLASS);
+  CHECK(novelty_classify(state, "Unable to seek\n", EXITED(0), 4100) == NOVELTY_NONE);
+
+  // The bucket follows the classes of the output and the end, not the memory
+  CHECK(novelty_bucket("Error: bad size 1 for a.txt\n", EXITED(0)) == novelty_bucket("Error: bad size 2 for b/c\n", EXITED(0)));
+  CHECK(novelty_bucket("Error: x\n", EXITED(0)) != novelty_bucket("Error: x\n", EXITED(1)));
+  CHECK(novelty_bucket("", KILLED(SIGSEGV)) != novelty_bucket("", KILLED(SIGABRT)));
+
+  // A class found by another instance is known, meeting it is only a new combination
+  normalize_line("Mod time differs", 16, line, sizeof(line));
+  novelty_learn_class(state, hash_bytes(line, strlen(line)), line, strlen(line));
+  CHECK(has_class(state, "Mod time differs"));
+  CHECK(novelty_classify(state, "Mod time differs\n", EXITED(0), 0) == NOVELTY_COMBO);
+
+  // The inputs are picked by score, the score of a picked input is halved down to 1
+  novelty_add_input(state, "input", 5, NOVELTY_SCORE_CLASS);
+  novelty_add_input(state, "", 0, NOVELTY_SCORE_CLASS);
+  CHECK(state->inputs_count == 1 && state->total_score == NOVELTY_SCORE_CLASS);
+  novelty_input *input = novelty_pick(state);
+  CHECK(input && input->score == NOVELTY_SCORE_CLASS / 2 && state->total_score == input->score);
+  for (int i = 0; i < 8; i++)
+    novelty_pick(state);
+  CHECK(input->score == 1 && input->picked == 9);
+
+  novelty_free(state);
+  return test_end("test_novelty");
+}
@@ -0,0 +1,100 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "test.h"
+#include "numeric.h"
+
+#define SIZE_FIELD 12  // size of the size and mtime fields
+#define MODE_FIELD 8   // size of the mode, uid, gid and chksum fields
+
+/**
+ * Writes a number in a field and checks that it reads back the same, and fits.
+**/
+static void check_round_trip(size_t size, int64_t value, num_format format)
+{
+  char field[SIZE_FIELD];
+  int64_t decoded = -12345;
+  CHECK(num_encode(field, size, value, format) == 0);
+  CHECK(num_decode(field, size, &decoded) == 0 && decoded == value);
+}
+
+/**
+ * Writes a number in a field and checks the bytes it gives.
+**/
+static void check_bytes(size_t size, int64_t value, num_format format, const char *bytes, int fits)
+{
+  char field[SIZE_FIELD];
+  CHECK(num_encode(field, size, value, format) == (fits ? 0 : -1));
+  CHECK(memcmp(field, bytes, size) == 0);
+}
+
+int main(void)
+{
+  int64_t value;
+
+  // Round trips of the octal forms, in both field sizes
+  const int64_t values[] = {0, 1, 7, 8, 0644, 511, 512, 01234567, 077777777};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+  {
+    check_round_trip(SIZE_FIELD, values[i], NUM_OCTAL_NUL);
+    check_round_trip(SIZE_FIELD, values[i], NUM_OCTAL_SPACE);
+    check_round_trip(SIZE_FIELD, values[i], NUM_OCTAL_FULL);
+    check_round_trip(SIZE_FIELD, values[i], NUM_BASE256);
+    if (values[i] <= 07777777)
+      check_round_trip(MODE_FIELD, values[i], NUM_OCTAL_NUL);
+  }
+
+  // The octal forms, byte for byte
+  check_bytes(MODE_FIELD, 0644, NUM_OCTAL_NUL, "0000644\0", 1);
+  check_bytes(MODE_FIELD, 0644, NUM_OCTAL_SPACE, "0000644 ", 1);
+  check_bytes(MODE_FIELD, 0644, NUM_OCTAL_FULL, "00000644", 1);
+
+  // The largest number of each octal form, and the first one that is cut to the field
+  check_round_trip(SIZE_FIELD, 077777777777, NUM_OCTAL_NUL);
+  check_bytes(SIZE_FIELD, 0100000000000, NUM_OCTAL_NUL, "00000000000\0", 0);
+  check_round_trip(SIZE_FIELD, 0777777777777, NUM_OCTAL_FULL);
+  check_bytes(SIZE_FIELD, 01000000000000, NUM_OCTAL_FULL, "000000000000", 0);
+  check_round_trip(MODE_FIELD, 07777777, NUM_OCTAL_NUL);
+  check_bytes(MODE_FIELD, 010000001, NUM_OCTAL_NUL, "0000001\0", 0);
+
+  // Past the octal forms, base-256 holds the number: a marker byte and big-endian bytes
+  check_round_trip(SIZE_FIELD, 0100000000000, NUM_BASE256);
+  check_bytes(SIZE_FIELD, 0100000000000, NUM_BASE256, "\x80\0\0\0\0\0\0\x02\0\0\0\0", 1);
+  check_round_trip(SIZE_FIELD, INT64_MAX, NUM_BASE256);
+  check_round_trip(MODE_FIELD, ((int64_t)1 << 56) - 1, NUM_BASE256);
+  check_bytes(MODE_FIELD, (int64_t)1 << 56, NUM_BASE256, "\x80\0\0\0\0\0\0\0", 0);
+
+  // Negative numbers are two's complement in base-256, and the two's complement of an int in octal
+  check_round_trip(SIZE_FIELD, -1, NUM_BASE256);
+  check_round_trip(SIZE_FIELD, -2, NUM_BASE256);
+  check_round_trip(SIZE_FIELD, INT64_MIN, NUM_BASE256);
+  check_round_trip(MODE_FIELD, -((int64_t)1 << 55), NUM_BASE256);
+  check_bytes(MODE_FIELD, -2, NUM_BASE256, "\xff\xff\xff\xff\xff\xff\xff\xfe", 1);
+  check_bytes(SIZE_FIELD, -2, NUM_OCTAL_NUL, "37777777776\0", 0);
+  check_bytes(MODE_FIELD, -2, NUM_OCTAL_NUL, "7777776\0", 0);
+
+  // Reading: leading spaces, a space or a null ends the number, anything else is not a number
+  CHECK(num_decode("   644 \0", MODE_FIELD, &value) == 0 && value == 0644);
+  CHECK(num_decode("\0\0\0\0\0\0\0\0", MODE_FIELD, &value) == 0 && value == 0);
+  CHECK(num_decode("0000648\0", MODE_FIELD, &value) == -1);
+  CHECK(num_decode("77777777777777777777777", 23, &value) == -1);
+
+  // Every boundary value of the size field is written as it says, and reads back when it fits
+  num_iter iter;
+  num_boundary boundary;
+  unsigned count = 0;
+  num_iter_init(&iter, SIZE_FIELD);
+  while (num_iter_next(&iter, &boundary))
+  {
+    char field[SIZE_FIELD];
+    count++;
+    if (num_encode(field, SIZE_FIELD, boundary.value, boundary.format) == 0)
+      CHECK(num_decode(field, SIZE_FIELD, &value) == 0 && value == boundary.value);
+    else
+      CHECK(boundary.value < 0 || boundary.value > 0777777777777);
+  }
+  CHECK(count <= NUM_BOUNDARIES(SIZE_FIELD));
+  CHECK(num_boundary_at(1, 0, &boundary) == -1);
+
+  return test_end("test_numeric");
+}
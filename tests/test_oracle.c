@@ -0,0 +1,67 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "test.h"
+#include "oracle.h"
+
+#define EXITED(code) W_EXITCODE(code, 0)
+#define KILLED(sig) W_EXITCODE(0, sig)
+
+/**
+ * Judges an output given as a string.
+**/
+static oracle_verdict judge(const char *output, int status, oracle_result *result)
+{
+  return oracle_judge(output, strlen(output), status, result);
+}
+
+int main(void)
+{
+  oracle_result r;
+
+  // Runs that are not crashes, with or without output
+  CHECK(judge("", EXITED(0), &r) == VERDICT_NO_OUTPUT && r.oracle == NULL);
+  CHECK(judge("Error: Bad magic\n", EXITED(1), &r) == VERDICT_ERROR);
+  CHECK(judge("", KILLED(SIGKILL), &r) == VERDICT_NO_OUTPUT && r.signal == SIGKILL);
+  CHECK(judge("partial output", KILLED(SIGTERM), &r) == VERDICT_ERROR);
+
+  // The crash message only counts at the beginning of the output
+  CHECK(judge(CRASH_MSG, EXITED(0), &r) == VERDICT_CRASH && strcmp(r.oracle, "message") == 0);
+  CHECK(judge("Error: x\n" CRASH_MSG, EXITED(0), &r) == VERDICT_ERROR);
+
+  // The reports of the sanitizers are described by the kind of error they name
+  CHECK(judge("==1==ERROR: AddressSanitizer: heap-buffer-overflow on address 0x1 (pc 0x2)\n", EXITED(1), &r) == VERDICT_CRASH);
+  CHECK(strcmp(r.oracle, "sanitizer") == 0);
+  CHECK(strcmp(r.detail, "AddressSanitizer: heap-buffer-overflow on address 0x1") == 0);
+  CHECK(judge("tar.c:12:3: runtime error: signed integer overflow\n", EXITED(0), &r) == VERDICT_CRASH);
+  CHECK(strcmp(r.detail, "UndefinedBehaviorSanitizer: signed integer overflow") == 0);
+  CHECK(judge("", EXITED(23), &r) == VERDICT_CRASH && strcmp(r.detail, "LeakSanitizer: exit code 23") == 0);
+  CHECK(judge("", EXITED(77), &r) == VERDICT_CRASH && strcmp(r.detail, "MemorySanitizer: exit code 77") == 0);
+
+  // The signals of a fault are crashes, with the core dump noted
+  CHECK(judge("", KILLED(SIGSEGV), &r) == VERDICT_CRASH && strcmp(r.oracle, "signal") == 0);
+  CHECK(strcmp(r.detail, "SIGSEGV") == 0 && r.signal == SIGSEGV && !r.core);
+  CHECK(judge("", KILLED(SIGABRT) | WCOREFLAG, &r) == VERDICT_CRASH && r.core);
+  CHECK(strcmp(r.detail, "SIGABRT, core dumped") == 0);
+
+  // The first oracle finding a crash gives its description
+  CHECK(judge(CRASH_MSG, KILLED(SIGSEGV), &r) == VERDICT_CRASH && strcmp(r.oracle, "message") == 0);
+
+  // Only the enabled oracles are asked, an unknown name leaves them as they were
+  CHECK(oracle_enable("signal") == 0);
+  CHECK(judge(CRASH_MSG, EXITED(0), &r) == VERDICT_ERROR);
+  CHECK(judge("", KILLED(SIGBUS), &r) == VERDICT_CRASH);
+  CHECK(oracle_enable("signal,bogus") == -1);
+  CHECK(judge(CRASH_MSG, EXITED(0), &r) == VERDICT_ERROR);
+  CHECK(oracle_enable("message,sanitizer") == 0);
+  CHECK(judge("", KILLED(SIGSEGV), &r) == VERDICT_NO_OUTPUT);
+  CHECK(oracle_enable("all") == 0);
+  CHECK(judge("", KILLED(SIGSEGV), &r) == VERDICT_CRASH);
+
+  CHECK(strcmp(oracle_verdict_name(VERDICT_ERROR), "error") == 0);
+  CHECK(strcmp(oracle_verdict_name(VERDICTS_COUNT), "unknown") == 0);
+
+  return test_end("test_oracle");
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "tar.h"
+#include "reader.h"
+#include "numeric.h"
+#include "checksum.h"
+
+#define BLOCK sizeof(tar_t)
+
+/**
+ * Appends a header with a name, a type and a declared size, and its checksum, to an archive.
+**/
+static void add_header(tar_buffer *archive, const char *name, char typeflag, size_t size)
+{
+  tar_t header;
+  set_header(&header);
+  memset(header.name, 0, NAME_LEN);
+  strncpy(header.name, name, NAME_LEN);
+  header.typeflag = typeflag;
+  set_size_header(&header, size);
+  write_tar_header(archive, &header);
+}
+
+/**
+ * Appends an entry and its content padded to whole blocks.
+**/
+static void add_entry(tar_buffer *archive, const char *name, char typeflag, const char *content, size_t size)
+{
+  add_header(archive, name, typeflag, size);
+  tar_buffer_append(archive, content, size);
+  if (size % BLOCK)
+    tar_buffer_zeros(archive, BLOCK - size % BLOCK);
+}
+
+/**
+ * Walks an archive in memory and gives the number of entries read.
+**/
+static unsigned count_entries(const char *data, size_t size)
+{
+  tar_reader reader;
+  tar_view view;
+  tar_open_memory(&reader, data, size);
+  while (tar_next(&reader, &view))
+    ;
+  tar_close(&reader);
+  return reader.entries;
+}
+
+int main(void)
+{
+  test_begin();
+  tar_buffer archive = {0};
+  tar_reader reader;
+  tar_view view;
+
+  // A well formed archive: each entry, its content, then the end-of-archive marker
+  add_entry(&archive, "a.txt", REGTYPE, "hello", 5);
+  add_entry(&archive, "dir/", DIRTYPE, NULL, 0);
+  add_entry(&archive, "b.txt", REGTYPE, "world!", 6);
+  size_t marker = archive.size;
+  tar_buffer_zeros(&archive, END_LEN);
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1);
+  CHECK(strcmp(view.header->name, "a.txt") == 0 && view.offset == 0);
+  CHECK(view.size == 5 && view.declared_size == 5 && memcmp(view.content, "hello", 5) == 0);
+  CHECK(view.checksum == TAR_CHKSUM_OK);
+  CHECK(tar_next(&reader, &view) == 1);
+  CHECK(view.header->typeflag == DIRTYPE && view.size == 0 && view.offset == 2 * BLOCK);
+  CHECK(tar_next(&reader, &view) == 1);
+  CHECK(strcmp(view.header->name, "b.txt") == 0 && view.offset == 3 * BLOCK);
+  CHECK(tar_next(&reader, &view) == 0 && tar_next(&reader, &view) == 0);
+  CHECK(reader.entries == 3 && reader.bad_checksums == 0);
+  tar_close(&reader);
+
+  // The end-of-archive marker ends the walk even with entries after it, one zero block is enough
+  archive.size = marker + BLOCK;
+  add_entry(&archive, "after.txt", REGTYPE, "x", 1);
+  CHECK(count_entries(archive.data, archive.size) == 3);
+  archive.size = marker;
+
+  // Without a marker, the walk ends with the data
+  CHECK(count_entries(archive.data, archive.size) == 3);
+  CHECK(count_entries(archive.data, 0) == 0);
+
+  // A short last block is not read as a header, a header cut anywhere neither
+  add_header(&archive, "cut.txt", REGTYPE, 0);
+  for (size_t cut = 1; cut < BLOCK; cut += 73)
+    CHECK(count_entries(archive.data, marker + cut) == 3);
+  CHECK(count_entries(archive.data, marker + BLOCK) == 4);
+
+  // A content running past the end of the archive is cut to it, and the walk stops there
+  archive.size = 0;
+  add_header(&archive, "truncated.txt", REGTYPE, 10000);
+  tar_buffer_append(&archive, "partial", 7);
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1);
+  CHECK(view.declared_size == 10000 && view.size == 7 && memcmp(view.content, "partial", 7) == 0);
+  CHECK(tar_next(&reader, &view) == 0 && reader.offset == archive.size);
+  tar_close(&reader);
+
+  // A header cut in the middle of the content of the previous entry is not read
+  archive.size = 0;
+  add_header(&archive, "big.txt", REGTYPE, 3 * BLOCK);
+  tar_buffer_zeros(&archive, BLOCK);
+  add_header(&archive, "inside.txt", REGTYPE, 0);
+  CHECK(count_entries(archive.data, archive.size) == 1);
+
+  // A size field that cannot be read counts as 0, a negative base-256 size too
+  archive.size = 0;
+  add_entry(&archive, "first.txt", REGTYPE, NULL, 0);
+  tar_t *first = (tar_t *)archive.data;
+  memcpy(first->size, "notanumber", 10);
+  add_entry(&archive, "second.txt", REGTYPE, NULL, 0);
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1 && view.declared_size == -1 && view.size == 0);
+  CHECK(view.checksum == TAR_CHKSUM_BAD && reader.bad_checksums == 1);
+  CHECK(tar_next(&reader, &view) == 1 && strcmp(view.header->name, "second.txt") == 0);
+  num_encode(((tar_t *)(archive.data + BLOCK))->size, SIZE_LEN, -1, NUM_BASE256);
+  tar_close(&reader);
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1 && tar_next(&reader, &view) == 1 && view.declared_size == -1);
+  tar_close(&reader);
+
+  // The checksum of historic tars, summed over signed chars, is told apart from the usual one
+  archive.size = 0;
+  add_entry(&archive, "\xe9t\xe9.txt", REGTYPE, NULL, 0);
+  tar_t *high = (tar_t *)archive.data;
+  checksum_encode(high->chksum, checksum_header_signed(high));
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1 && view.checksum == TAR_CHKSUM_SIGNED && reader.bad_checksums == 0);
+  tar_close(&reader);
+
+  // The long names of pax and GNU are entries of their own, holding the name of the next one
+  char long_name[300], records[400];
+  memset(long_name, 'n', sizeof(long_name) - 1);
+  long_name[sizeof(long_name) - 1] = '\0';
+  size_t records_len = pax_record(records, sizeof(records), "path", long_name, strlen(long_name));
+  archive.size = 0;
+  add_entry(&archive, "PaxHeaders/long", XHDTYPE, records, records_len);
+  add_entry(&archive, "short_pax", REGTYPE, "p", 1);
+  add_entry(&archive, GNU_LONGLINK_NAME, GNUTYPE_LONGNAME, long_name, sizeof(long_name));
+  add_entry(&archive, "short_gnu", REGTYPE, "g", 1);
+  tar_buffer_zeros(&archive, END_LEN);
+  tar_open_memory(&reader, archive.data, archive.size);
+  CHECK(tar_next(&reader, &view) == 1 && view.header->typeflag == XHDTYPE);
+  CHECK(view.size == records_len && memcmp(view.content, records, records_len) == 0);
+  CHECK(tar_next(&reader, &view) == 1 && strcmp(view.header->name, "short_pax") == 0);
+  CHECK(tar_next(&reader, &view) == 1 && view.header->typeflag == GNUTYPE_LONGNAME);
+  CHECK(view.size == sizeof(long_name) && strcmp(view.content, long_name) == 0);
+  CHECK(tar_next(&reader, &view) == 1 && strcmp(view.header->name, "short_gnu") == 0);
+  CHECK(view.offset == 6 * BLOCK && memcmp(view.content, "g", 1) == 0);
+  CHECK(tar_next(&reader, &view) == 0 && reader.entries == 4 && reader.bad_checksums == 0);
+  tar_close(&reader);
+
+  // An archive read from its file: mapped, then walked the same way
+  CHECK(tar_buffer_flush(&archive, "long.tar") == 0);
+  CHECK(tar_open(&reader, "long.tar") == 0 && reader.size == archive.size);
+  unsigned entries = 0;
+  while (tar_next(&reader, &view))
+    entries++;
+  CHECK(entries == 4);
+  tar_close(&reader);
+  CHECK(tar_open(&reader, "missing.tar") == -1);
+  CHECK(tar_open(&reader, ".") == -1);
+  write_raw_tar(&archive, "empty.tar", NULL, 0);
+  CHECK(tar_open(&reader, "empty.tar") == 0 && reader.data == NULL && tar_next(&reader, &view) == 0);
+  tar_close(&reader);
+
+  tar_buffer_free(&archive);
+  return test_end("test_reader");
+}
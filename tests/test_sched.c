@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "test.h"
+#include "sched.h"
+
+int main(void)
+{
+  test_begin();
+  Fuzzer fuzzer;
+  memset(&fuzzer, 0, sizeof(fuzzer));
+  fuzzer.sched = sched_init("missing.dat");
+  sched_state *state = fuzzer.sched;
+
+  // Without statistics, every arm that can be applied is tried once before any is tried again
+  unsigned picked[MUT_COUNT] = {0};
+  unsigned available = 0;
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+    available += mutation_available(i);
+  for (unsigned i = 0; i < available; i++)
+    picked[sched_pick_mutation(&fuzzer)]++;
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+    CHECK(picked[i] == (unsigned)mutation_available(i));
+  CHECK(state->ops[MUT_DICT_TOKEN].runs == 0);
+
+  // Once all are tried, the arm with the best reward rate is picked
+  for (unsigned i = 0; i < MUT_COUNT; i++)
+    state->ops[i].runs = 100;
+  mutation_op best = MUT_FIELD_COPY;
+  sched_reward_mutations(&fuzzer, (mutation_op[]){best, best}, 2, 1);
+  for (int i = 0; i < 40; i++)
+    sched_reward_mutations(&fuzzer, &best, 1, 1);
+  sched_reward_mutations(&fuzzer, (mutation_op[]){MUT_BIT_FLIP}, 1, 0);
+  CHECK(state->ops[best].execs == 42 && state->ops[best].rewards == 42);
+  CHECK(state->ops[MUT_BIT_FLIP].execs == 1 && state->ops[MUT_BIT_FLIP].rewards == 0);
+  CHECK(sched_pick_mutation(&fuzzer) == best);
+  CHECK(state->ops[best].runs == 101);
+
+  // An arm played far less than the others gets explored despite a lower reward
+  state->ops[MUT_RANDOM_BYTE].runs = 1;
+  CHECK(sched_pick_mutation(&fuzzer) == MUT_RANDOM_BYTE);
+
+  // The statistics are saved and loaded again by name
+  state->families[3].runs = 7;
+  state->families[3].rewards = 2;
+  state->families[3].seconds = 1.5;
+  sched_save(state, "stats.dat");
+  sched_state *loaded = sched_init("stats.dat");
+  CHECK(memcmp(loaded->ops, state->ops, sizeof(state->ops)) == 0);
+  CHECK(loaded->families[3].runs == 7 && loaded->families[3].rewards == 2 && loaded->families[3].seconds == 1.5);
+  free(loaded);
+
+  // Unknown names and broken lines leave the other arms alone
+  FILE *f = fopen("stats.dat", "w");
+  fprintf(f, "op no_such_op 5 5 5 1.0\nop bit_flip 3 4 1 0.5\nfamily mode x\n");
+  fclose(f);
+  loaded = sched_init("stats.dat");
+  CHECK(loaded->ops[MUT_BIT_FLIP].runs == 3 && loaded->ops[MUT_BIT_FLIP].execs == 4);
+  CHECK(loaded->ops[MUT_RANDOM_BYTE].runs == 0 && loaded->families[1].runs == 0);
+  free(loaded);
+
+  // The stop conditions, the first one reached gives the reason
+  fuzzer.start_time = now_seconds();
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason == NULL);
+  fuzzer.options.max_crashes = 3;
+  fuzzer.crashes_number = 2;
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason == NULL);
+  fuzzer.crashes_number = 3;
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason && strcmp(fuzzer.stop_reason, "crash count reached") == 0);
+
+  fuzzer.stop_reason = NULL;
+  fuzzer.options.max_crashes = 0;
+  fuzzer.options.exec_budget = 10;
+  fuzzer.execs = 10;
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason && strcmp(fuzzer.stop_reason, "exec budget exhausted") == 0);
+
+  fuzzer.stop_reason = NULL;
+  fuzzer.options.exec_budget = 0;
+  fuzzer.options.time_budget = 0.5;
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason == NULL);
+  fuzzer.start_time -= 1;
+  sched_update_stop(&fuzzer);
+  CHECK(fuzzer.stop_reason && strcmp(fuzzer.stop_reason, "time budget exhausted") == 0);
+
+  free(state);
+  return test_end("test_sched");
+}
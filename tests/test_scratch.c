@@ -0,0 +1,95 @@
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "scratch.h"
+
+/**
+ * Counts the entries of a directory, "." and ".." left out.
+ *
+ * @return the number of entries, -1 if the directory cannot be opened
+**/
+static int count_entries(const char *path)
+{
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+    count += strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0;
+  closedir(dir);
+  return count;
+}
+
+/**
+ * Leaves in a scratch directory what an extractor may leave: files, nested directories without
+ * permissions, a symbolic link to a file outside and a link to a directory outside.
+**/
+static void fill(const scratch_dir *scratch)
+{
+  char path[PATH_MAX + 64];
+  snprintf(path, sizeof(path), "%s/file", scratch->path);
+  close(open(path, O_WRONLY | O_CREAT, 0000));
+  snprintf(path, sizeof(path), "%s/a", scratch->path);
+  mkdir(path, 0700);
+  snprintf(path, sizeof(path), "%s/a/b", scratch->path);
+  mkdir(path, 0700);
+  snprintf(path, sizeof(path), "%s/a/b/deep", scratch->path);
+  close(open(path, O_WRONLY | O_CREAT, 0644));
+  snprintf(path, sizeof(path), "%s/a/b", scratch->path);
+  chmod(path, 0000);
+  snprintf(path, sizeof(path), "%s/a", scratch->path);
+  chmod(path, 0500);
+  snprintf(path, sizeof(path), "%s/link", scratch->path);
+  symlink("../outside", path);
+  snprintf(path, sizeof(path), "%s/dirlink", scratch->path);
+  symlink("../kept", path);
+}
+
+int main(void)
+{
+  test_begin();
+  close(open("outside", O_WRONLY | O_CREAT, 0644));
+  mkdir("kept", 0700);
+  close(open("kept/inside", O_WRONLY | O_CREAT, 0644));
+
+  // The directory is named after the process and the worker, each worker gets its own
+  scratch_dir first, second;
+  CHECK(scratch_create(&first, 0) == 0);
+  CHECK(scratch_create(&second, 1) == 0);
+  char name[64];
+  snprintf(name, sizeof(name), "/" SCRATCH_PREFIX "%d_0", getpid());
+  CHECK(strstr(first.path, name) != NULL && first.path[0] == '/');
+  CHECK(strcmp(first.path, second.path) != 0);
+  CHECK(count_entries(first.path) == 0);
+
+  // The same worker cannot create it twice
+  scratch_dir again;
+  CHECK(scratch_create(&again, 0) == -1);
+
+  // Cleaning empties it between runs, the links are removed and not followed
+  for (int run = 0; run < 3; run++)
+  {
+    fill(&first);
+    CHECK(count_entries(first.path) == 4);
+    scratch_clean(&first);
+    CHECK(count_entries(first.path) == 0);
+  }
+  CHECK(access("outside", F_OK) == 0 && access("kept/inside", F_OK) == 0);
+
+  // Removing it takes what is left with it, the other workers keep theirs
+  fill(&first);
+  fill(&second);
+  scratch_remove(&first);
+  CHECK(access(first.path, F_OK) == -1);
+  CHECK(count_entries(second.path) == 4);
+  scratch_remove(&second);
+  CHECK(access(second.path, F_OK) == -1);
+  CHECK(access("outside", F_OK) == 0 && access("kept/inside", F_OK) == 0);
+
+  return test_end("test_scratch");
+}
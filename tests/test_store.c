@@ -0,0 +1,133 @@
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "test.h"
+#include "store.h"
+
+static const char *INPUTS[] = {"first input", "second, longer input", "third"};
+#define INPUTS_COUNT 3
+
+/**
+ * Writes a fresh store holding INPUTS.
+**/
+static void write_store(const char *path)
+{
+  store s;
+  char index[64];
+  snprintf(index, sizeof(index), "%s" STORE_INDEX_EXT, path);
+  unlink(path);
+  unlink(index);
+  CHECK(store_open(&s, path, 1) == 0);
+  for (int i = 0; i < INPUTS_COUNT; i++)
+    CHECK(store_add(&s, INPUTS[i], strlen(INPUTS[i]), STORE_CRASH, i, "test") == 1);
+  store_close(&s);
+}
+
+static off_t file_size(const char *path)
+{
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+/**
+ * Opens the store for appending, so that it recovers, then checks the inputs it kept by reading it.
+**/
+static void check_store(const char *path, size_t expected)
+{
+  store s;
+  CHECK(store_open(&s, path, 1) == 0);
+  CHECK(s.count == expected);
+  store_close(&s);
+
+  CHECK(store_open(&s, path, 0) == 0);
+  CHECK(s.count == expected);
+  for (size_t i = 0; i < s.count && i < INPUTS_COUNT; i++)
+  {
+    const char *data = store_data(&s, i);
+    CHECK(data != NULL && s.records[i].size == strlen(INPUTS[i]) && memcmp(data, INPUTS[i], s.records[i].size) == 0);
+  }
+  store_close(&s);
+}
+
+int main(void)
+{
+  test_begin();
+  const char *path = "fuzzy.store";
+  off_t log_size = (off_t)(3 * sizeof(store_prefix) + strlen(INPUTS[0]) + strlen(INPUTS[1]) + strlen(INPUTS[2]));
+
+  // A whole store is left as it is, and the same input is not kept twice
+  write_store(path);
+  check_store(path, 3);
+  store s;
+  CHECK(store_open(&s, path, 1) == 0);
+  CHECK(store_add(&s, INPUTS[0], strlen(INPUTS[0]), STORE_CRASH, 0, "test") == 0);
+  CHECK(store_add(&s, INPUTS[0], strlen(INPUTS[0]), STORE_OOM, 0, "test") == 1);
+  store_close(&s);
+
+  // Bytes written to the log without their record are cut
+  write_store(path);
+  int fd = open(path, O_WRONLY | O_APPEND);
+  CHECK(write(fd, "partial", 7) == 7);
+  close(fd);
+  check_store(path, 3);
+  CHECK(file_size(path) == log_size);
+
+  // A record cut in the middle is dropped with its input
+  write_store(path);
+  CHECK(truncate("fuzzy.store.idx", 2 * sizeof(store_record) + sizeof(store_record) / 2) == 0);
+  check_store(path, 2);
+  CHECK(file_size("fuzzy.store.idx") == 2 * sizeof(store_record));
+  CHECK(file_size(path) == log_size - (off_t)(sizeof(store_prefix) + strlen(INPUTS[2])));
+
+  // A record whose input is not all in the log is dropped
+  write_store(path);
+  CHECK(truncate(path, log_size - 2) == 0);
+  check_store(path, 2);
+
+  // A record whose prefix does not match its input is dropped
+  write_store(path);
+  fd = open(path, O_WRONLY);
+  store_prefix bad = {STORE_MAGIC, STORE_OOM, strlen(INPUTS[2])};
+  CHECK(pwrite(fd, &bad, sizeof(bad), log_size - sizeof(bad) - strlen(INPUTS[2])) == sizeof(bad));
+  close(fd);
+  check_store(path, 2);
+
+  // The new index of a replacement committed by the rename of its log is put in place by the next opening
+  write_store(path);
+  CHECK(rename("fuzzy.store.idx", "fuzzy.store.new.idx") == 0);
+  fd = open("fuzzy.store.idx", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  close(fd);
+  check_store(path, 3);
+  CHECK(access("fuzzy.store.new.idx", F_OK) == -1);
+
+  // A replacement not committed leaves the old store as it is
+  CHECK(truncate(path, 0) == 0 && truncate("fuzzy.store.idx", 0) == 0);
+  write_store("fuzzy.store.new");
+  check_store(path, 0);
+  CHECK(access("fuzzy.store.new.idx", F_OK) == 0);
+
+  // A replacement replaces both files
+  CHECK(store_replace(path) == 0);
+  CHECK(access("fuzzy.store.new", F_OK) == -1 && access("fuzzy.store.new.idx", F_OK) == -1);
+  check_store(path, 3);
+
+  // An input whose write failed is not taken as already there, it is added by the next try
+  struct rlimit limit, small = {0, 0};
+  CHECK(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+  signal(SIGXFSZ, SIG_IGN);
+  CHECK(store_open(&s, "full.store", 1) == 0);
+  small.rlim_max = limit.rlim_max;
+  CHECK(setrlimit(RLIMIT_FSIZE, &small) == 0);
+  CHECK(store_add(&s, INPUTS[0], strlen(INPUTS[0]), STORE_CRASH, 1, "full") == -1);
+  CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  CHECK(store_add(&s, INPUTS[0], strlen(INPUTS[0]), STORE_CRASH, 1, "full") == 1);
+  CHECK(store_add(&s, INPUTS[0], strlen(INPUTS[0]), STORE_CRASH, 1, "full") == 0);
+  store_close(&s);
+  check_store("full.store", 1);
+
+  return test_end("test_store");
+}
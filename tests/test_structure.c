@@ -0,0 +1,158 @@
+#include <string.h>
+#include <stddef.h>
+
+#include "test.h"
+#include "structure.h"
+#include "reader.h"
+
+#define ROUNDS 50 // mutations tried for each operator, with the random number generator seeded
+
+/**
+ * Appends an entry whose name is a single letter and whose content repeats it.
+**/
+static void add_entry(tar_buffer *buffer, char name, size_t size)
+{
+  tar_t header;
+  set_header(&header);
+  memset(header.name, 0, NAME_LEN);
+  header.name[0] = name;
+  set_size_header(&header, size);
+  calculate_checksum(&header);
+  tar_buffer_append(buffer, &header, sizeof(tar_t));
+  char content[2 * sizeof(tar_t)];
+  memset(content, name, sizeof(content));
+  tar_buffer_append(buffer, content, size);
+  tar_buffer_zeros(buffer, (sizeof(tar_t) - size % sizeof(tar_t)) % sizeof(tar_t));
+}
+
+/**
+ * Builds an archive of entries named by the letters of a string, ended by two null blocks.
+**/
+static void build(tar_buffer *buffer, const char *names)
+{
+  buffer->size = 0;
+  for (size_t i = 0; names[i]; i++)
+    add_entry(buffer, names[i], (i * 300) % 700);
+  tar_buffer_zeros(buffer, 2 * sizeof(tar_t));
+}
+
+/**
+ * Lists the entries of an archive by their names, the pax extended headers as 'x'.
+ *
+ * @param[out] out the names, null terminated
+ * @param[out] bad the number of headers whose checksum does not match
+**/
+static void list(const char *data, size_t size, char *out, size_t capacity, unsigned *bad)
+{
+  tar_reader reader;
+  tar_view view;
+  size_t n = 0;
+  tar_open_memory(&reader, data, size);
+  while (tar_next(&reader, &view) && n + 1 < capacity)
+    out[n++] = view.header->typeflag == XHDTYPE ? 'x' : view.header->name[0];
+  out[n] = '\0';
+  *bad = reader.bad_checksums;
+  tar_close(&reader);
+}
+
+/**
+ * Tells whether a string holds the letters of another one in the same order.
+**/
+static int in_order(const char *s, const char *letters)
+{
+  for (; *s && *letters; s++)
+    if (*s == *letters)
+      letters++;
+  return *letters == '\0';
+}
+
+int main(void)
+{
+  srand(1);
+  tar_buffer input = {NULL, 0, 0}, other = {NULL, 0, 0}, out = {NULL, 0, 0};
+  entry_list entries;
+  memset(&entries, 0, sizeof(entries));
+  build(&input, "ABCD");
+  build(&other, "WXYZ");
+  char names[32];
+  unsigned bad;
+
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    // What the buffer held before is left in place
+    out.size = 0;
+    tar_buffer_append(&out, "before", 6);
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_DUPLICATE, &out);
+    CHECK(memcmp(out.data, "before", 6) == 0);
+    list(out.data + 6, out.size - 6, names, sizeof(names), &bad);
+    CHECK(strlen(names) == 5 && in_order(names, "ABCD") && bad == 0);
+
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_SWAP, &out);
+    list(out.data, out.size, names, sizeof(names), &bad);
+    CHECK(out.size == input.size && strlen(names) == 4 && strchr(names, 'A') && strchr(names, 'B') &&
+          strchr(names, 'C') && strchr(names, 'D'));
+
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_DELETE, &out);
+    list(out.data, out.size, names, sizeof(names), &bad);
+    CHECK(out.size < input.size && strlen(names) == 3 && in_order("ABCD", names));
+
+    // The spliced entries are consecutive entries of the other input, put between the entries of the input
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_SPLICE, &out);
+    list(out.data, out.size, names, sizeof(names), &bad);
+    char run[8];
+    size_t spliced = strspn(names + strcspn(names, "WXYZ"), "WXYZ");
+    snprintf(run, sizeof(run), "%.*s", (int)spliced, names + strcspn(names, "WXYZ"));
+    CHECK(strlen(names) == 4 + spliced && spliced >= 1 && in_order(names, "ABCD") && strstr("WXYZ", run) != NULL);
+
+    // The pax extended header is right in front of an entry of the input
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_EXTENDED, &out);
+    list(out.data, out.size, names, sizeof(names), &bad);
+    char *x = strchr(names, 'x');
+    CHECK(strlen(names) == 5 && x != NULL && x[1] >= 'A' && x[1] <= 'D' && bad == 0 && out.size % sizeof(tar_t) == 0);
+
+    // Only the size and the checksum of a single header change, the content stays where it was
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_DESYNC, &out);
+    CHECK(out.size == input.size);
+    size_t changed_blocks = 0, changed_bytes = 0;
+    for (size_t b = 0; b < input.size && out.size == input.size; b += sizeof(tar_t))
+    {
+      if (memcmp(out.data + b, input.data + b, sizeof(tar_t)) == 0)
+        continue;
+      changed_blocks++;
+      for (size_t k = 0; k < sizeof(tar_t); k++)
+      {
+        int in_size = k >= offsetof(tar_t, size) && k < offsetof(tar_t, size) + SIZE_LEN;
+        int in_chksum = k >= offsetof(tar_t, chksum) && k < offsetof(tar_t, chksum) + CHKSUM_LEN;
+        changed_bytes += out.data[b + k] != input.data[b + k] && !in_size && !in_chksum;
+      }
+    }
+    CHECK(changed_blocks <= 1 && changed_bytes == 0);
+
+    // The archive is cut at a block boundary
+    out.size = 0;
+    mutate_entries(&entries, input.data, input.size, other.data, other.size, MUT_ENTRY_TRUNCATE, &out);
+    CHECK(out.size < input.size && out.size % sizeof(tar_t) == 0 && memcmp(out.data, input.data, out.size) == 0);
+  }
+
+  // An archive without entries is copied as it is
+  tar_buffer empty = {NULL, 0, 0};
+  tar_buffer_zeros(&empty, 2 * sizeof(tar_t));
+  for (mutation_op op = MUT_FIRST_ENTRY; op < MUT_ENTRY_TRUNCATE; op++)
+  {
+    out.size = 0;
+    mutate_entries(&entries, empty.data, empty.size, other.data, other.size, op, &out);
+    CHECK(out.size == empty.size && memcmp(out.data, empty.data, empty.size) == 0);
+  }
+
+  entry_list_free(&entries);
+  free(input.data);
+  free(other.data);
+  free(out.data);
+  free(empty.data);
+  return test_end("test_structure");
+}
@@ -0,0 +1,117 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "tar.h"
+
+/**
+ * Builds a path of runs of letters separated by '/', like "3a/2b" for "aaa/bb".
+**/
+static size_t make_path(char *path, const size_t runs[], const char letters[], size_t count)
+{
+  size_t len = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (i)
+      path[len++] = '/';
+    memset(path + len, letters[i], runs[i]);
+    len += runs[i];
+  }
+  path[len] = '\0';
+  return len;
+}
+
+/**
+ * Gives the path a header holds, as an extractor joins the prefix and the name fields.
+**/
+static void joined_path(const tar_t *header, char *out, size_t size)
+{
+  size_t prefix_len = strnlen(header->prefix, sizeof(header->prefix));
+  if (prefix_len)
+    snprintf(out, size, "%.*s/%.*s", (int)prefix_len, header->prefix, NAME_LEN, header->name);
+  else
+    snprintf(out, size, "%.*s", NAME_LEN, header->name);
+}
+
+/**
+ * Writes a path in a header and checks that the header gives it back, with a terminated name.
+**/
+static void check_split(const char *path, size_t len, size_t prefix_len)
+{
+  tar_t header;
+  char joined[2 * sizeof(tar_t)];
+  memset(&header, 'z', sizeof(header));
+  set_path_header(&header, path, len);
+  joined_path(&header, joined, sizeof(joined));
+  CHECK(strcmp(joined, path) == 0);
+  CHECK(strnlen(header.prefix, sizeof(header.prefix)) == prefix_len);
+  CHECK(memchr(header.name, '\0', NAME_LEN) != NULL);
+}
+
+/**
+ * Checks that a record formatted by pax_record() is as long as it says, its own digits included.
+**/
+static void check_record(const char *key, size_t value_len)
+{
+  char value[2048], record[2100];
+  memset(value, 'v', value_len);
+  size_t len = pax_record(record, sizeof(record), key, value, value_len);
+  CHECK(len == pax_record_len(NULL, key, value_len) && len <= sizeof(record));
+  CHECK(strtoul(record, NULL, 10) == len && record[len - 1] == '\n');
+  size_t digits = strspn(record, "0123456789");
+  CHECK(digits + 1 + strlen(key) + 1 + value_len + 1 == len);
+}
+
+int main(void)
+{
+  char path[512];
+  size_t len;
+
+  // A path shorter than the name field stays in it, the prefix is cleared
+  check_split("dir/file", 8, 0);
+  len = make_path(path, (size_t[]){NAME_LEN - 1}, "a", 1);
+  check_split(path, len, 0);
+
+  // A path that fills the name field goes to the prefix up to its first '/'
+  len = make_path(path, (size_t[]){3, NAME_LEN - 4}, "ab", 2);
+  check_split(path, len, 3);
+
+  // The split is at the first '/' leaving a name that fits
+  len = make_path(path, (size_t[]){60, 60, 50}, "abc", 3);
+  check_split(path, len, 121);
+  len = make_path(path, (size_t[]){10, 10, 10, 90}, "abcd", 4);
+  check_split(path, len, 32);
+
+  // The longest path ustar holds, a full prefix and a full name
+  len = make_path(path, (size_t[]){155, NAME_LEN - 1}, "ab", 2);
+  check_split(path, len, 155);
+
+  // A directory longer than the prefix: the prefix is full and the name keeps the end of the path
+  len = make_path(path, (size_t[]){200, 20}, "ab", 2);
+  tar_t header;
+  set_path_header(&header, path, len);
+  CHECK(memcmp(header.prefix, path, sizeof(header.prefix)) == 0);
+  CHECK(strlen(header.name) == len - sizeof(header.prefix) && strcmp(header.name, path + sizeof(header.prefix)) == 0);
+
+  // The length of a pax record counts its own digits, one more when they carry over
+  CHECK(pax_record_len(NULL, "a", 4) == 9);
+  CHECK(pax_record_len(NULL, "a", 5) == 11);
+  CHECK(pax_record_len(NULL, "path", 90) == 99);
+  CHECK(pax_record_len(NULL, "path", 91) == 101);
+  CHECK(pax_record_len(NULL, "path", 989) == 999);
+  CHECK(pax_record_len(NULL, "path", 990) == 1001);
+  for (size_t value_len = 0; value_len < 2000; value_len += value_len < 1100 ? 1 : 97)
+    check_record("path", value_len);
+
+  // A length given as written in the record is taken as it is, right or wrong
+  CHECK(pax_record_len("5", "path", 10) == 18);
+  CHECK(pax_record_len("999999", "size", 1) == 14);
+  CHECK(pax_record_len("", "a", 0) == 4);
+
+  // A record that does not fit is not written, its length is still given
+  char small[8];
+  memset(small, 'x', sizeof(small));
+  CHECK(pax_record(small, sizeof(small), "path", "long value", 10) == 19 && small[0] == 'x');
+
+  return test_end("test_tar");
+}